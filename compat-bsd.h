@@ -10,3 +10,8 @@ size_t strlcat(char *, const char *, size_t);
 #ifndef HAVE_STRLCPY
 size_t strlcpy(char *, const char *, size_t);
 #endif
+
+/* Where send() has no such flag, SIGPIPE is ignored instead, as axel does */
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
@@ -0,0 +1,335 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* Alternative services: where a server says it may also be reached */
+
+#include "config.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "altsvc.h"
+
+/* Enough for the servers of a download's mirrors, or of the downloads a
+   batch runs at once */
+#define ALTSVC_SIZE	32
+
+#define SPACE		" \t"
+
+struct alt {
+	altsvc_t a;
+	time_t expires, broken;
+};
+
+struct entry {
+	char *host;
+	int port;
+	time_t stamp;
+	int count;
+	struct alt alts[ALTSVC_ALTS];
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct entry cache[ALTSVC_SIZE];
+
+static
+time_t
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+static
+int
+hex(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* The protocol id, which is percent-encoded where a token could not have
+   it; returns 0 if it does not fit or is not a protocol id at all */
+static
+int
+proto_id(char *dst, size_t size, const char *s, size_t len)
+{
+	size_t n = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		char c = s[i];
+
+		if (c == '%') {
+			if (i + 2 >= len || hex(s[i + 1]) < 0 ||
+			    hex(s[i + 2]) < 0)
+				return 0;
+			c = hex(s[i + 1]) << 4 | hex(s[i + 2]);
+			i += 2;
+		}
+		if (n + 1 >= size)
+			return 0;
+		dst[n++] = c;
+	}
+	dst[n] = 0;
+	return n > 0;
+}
+
+/* "host:port", or "[v6]:port", or ":port" for the server's own name */
+static
+int
+authority(altsvc_t *a, const char *s, size_t len)
+{
+	const char *colon, *end = s + len;
+	size_t hlen;
+	char *stop;
+	long port;
+
+	if (*s == '[') {
+		const char *close = memchr(s, ']', len);
+
+		if (!close || close + 1 == end || close[1] != ':')
+			return 0;
+		s++;
+		colon = close + 1;
+		hlen = close - s;
+	} else {
+		colon = NULL;
+		for (const char *p = s; p < end; p++)
+			if (*p == ':')
+				colon = p;
+		if (!colon)
+			return 0;
+		hlen = colon - s;
+	}
+	if (hlen >= sizeof(a->host))
+		return 0;
+	memcpy(a->host, s, hlen);
+	a->host[hlen] = 0;
+
+	port = strtol(colon + 1, &stop, 10);
+	if (stop != end || stop == colon + 1 || port < 1 || port > 65535)
+		return 0;
+	a->port = port;
+	return 1;
+}
+
+/* A token, or a quoted string; returns its end, or NULL if it has none */
+static
+const char *
+value_end(const char *s)
+{
+	if (*s == '"') {
+		const char *q = strchr(s + 1, '"');
+
+		return q ? q + 1 : NULL;
+	}
+	return s + strcspn(s, ",;" SPACE);
+}
+
+int
+altsvc_parse(const char *value, altsvc_t *alts, int max)
+{
+	const char *p = value + strspn(value, SPACE);
+	int n = 0;
+
+	if (!strncasecmp(p, "clear", 5) && !p[5 + strspn(p + 5, SPACE)])
+		return 0;
+	if (!*p)
+		return -1;
+
+	while (*p) {
+		altsvc_t a = { .max_age = ALTSVC_MAX_AGE };
+		size_t len = strcspn(p, "=,;" SPACE);
+		const char *end;
+
+		if (p[len] != '=' || !proto_id(a.proto, sizeof(a.proto), p, len))
+			return -1;
+		p += len + 1;
+		if (*p != '"' || !(end = value_end(p)) ||
+		    !authority(&a, p + 1, end - p - 2))
+			return -1;
+		p = end;
+
+		/* Parameters: only how long it holds for matters here */
+		for (;;) {
+			p += strspn(p, SPACE);
+			if (*p != ';')
+				break;
+			p += 1 + strspn(p + 1, SPACE);
+			len = strcspn(p, "=,;" SPACE);
+			if (p[len] != '=' || !(end = value_end(p + len + 1)))
+				return -1;
+			if (len == 2 && !strncasecmp(p, "ma", 2)) {
+				const char *v = p + 3 + (p[3] == '"');
+				char *stop;
+
+				a.max_age = strtol(v, &stop, 10);
+				if (stop == v || a.max_age < 0)
+					return -1;
+			}
+			p = end;
+		}
+
+		if (*p == ',')
+			p += 1 + strspn(p + 1, SPACE);
+		else if (*p)
+			return -1;
+		if (n < max)
+			alts[n++] = a;
+	}
+	return n;
+}
+
+static
+struct entry *
+find(const char *host, int port)
+{
+	for (int i = 0; i < ALTSVC_SIZE; i++)
+		if (cache[i].host && cache[i].port == port &&
+		    !strcasecmp(cache[i].host, host))
+			return &cache[i];
+	return NULL;
+}
+
+static
+int
+same(const altsvc_t *a, const altsvc_t *b)
+{
+	return !strcmp(a->proto, b->proto) && !strcasecmp(a->host, b->host) &&
+	    a->port == b->port;
+}
+
+void
+altsvc_learn(const char *host, int port, const char *value)
+{
+	altsvc_t alts[ALTSVC_ALTS];
+	struct entry *e;
+	int n = altsvc_parse(value, alts, ALTSVC_ALTS);
+	time_t t = now();
+
+	if (n < 0)
+		return;
+
+	pthread_mutex_lock(&lock);
+	e = find(host, port);
+	if (!e) {
+		/* In place of the one heard from longest ago */
+		e = &cache[0];
+		for (int i = 0; i < ALTSVC_SIZE && e->host; i++)
+			if (!cache[i].host || cache[i].stamp < e->stamp)
+				e = &cache[i];
+		free(e->host);
+		memset(e, 0, sizeof(*e));
+		if (!(e->host = strdup(host))) {
+			pthread_mutex_unlock(&lock);
+			return;
+		}
+		e->port = port;
+	}
+	e->stamp = t;
+
+	/* What failed stays failed, whatever the server thinks of it */
+	struct alt was[ALTSVC_ALTS];
+	int had = e->count;
+
+	memcpy(was, e->alts, sizeof(was));
+	e->count = n;
+	for (int i = 0; i < n; i++) {
+		e->alts[i].a = alts[i];
+		e->alts[i].expires = t + alts[i].max_age;
+		e->alts[i].broken = 0;
+		for (int j = 0; j < had; j++)
+			if (same(&alts[i], &was[j].a))
+				e->alts[i].broken = was[j].broken;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+int
+altsvc_lookup(const char *host, int port, const char *proto,
+	      char *alt_host, size_t size, int *alt_port)
+{
+	struct entry *e;
+	time_t t = now();
+	int ret = 0;
+
+	pthread_mutex_lock(&lock);
+	e = find(host, port);
+	for (int i = 0; e && i < e->count; i++) {
+		const struct alt *a = &e->alts[i];
+		const char *h = *a->a.host ? a->a.host : host;
+
+		if (strcmp(a->a.proto, proto) || t >= a->expires ||
+		    t < a->broken)
+			continue;
+		/* Where it is already, which is no alternative; but for
+		   HTTP/3, whose port is UDP's */
+		if (strcmp(proto, "h3") && a->a.port == port &&
+		    !strcasecmp(h, host))
+			continue;
+		if (strlen(h) >= size)
+			continue;
+		memcpy(alt_host, h, strlen(h) + 1);
+		*alt_port = a->a.port;
+		ret = 1;
+		break;
+	}
+	pthread_mutex_unlock(&lock);
+	return ret;
+}
+
+void
+altsvc_broken(const char *host, int port, const char *proto)
+{
+	struct entry *e;
+
+	pthread_mutex_lock(&lock);
+	e = find(host, port);
+	for (int i = 0; e && i < e->count; i++)
+		if (!strcmp(e->alts[i].a.proto, proto))
+			e->alts[i].broken = now() + ALTSVC_BROKEN;
+	pthread_mutex_unlock(&lock);
+}
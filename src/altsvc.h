@@ -0,0 +1,78 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* Alternative services: where a server says it may also be reached */
+
+#ifndef AXEL_ALTSVC_H
+#define AXEL_ALTSVC_H
+
+#include <stddef.h>
+
+/* How long an alternative holds for when the server does not say, and how
+ * long one that failed is left alone, in seconds */
+#define ALTSVC_MAX_AGE	86400
+#define ALTSVC_BROKEN	300
+
+/* The most alternatives kept for a server */
+#define ALTSVC_ALTS	4
+
+typedef struct {
+	char proto[16];		/* ALPN protocol id, as "h2" or "h3" */
+	char host[256];		/* empty for the server's own name */
+	int port;
+	long max_age;
+} altsvc_t;
+
+/* Parse an Alt-Svc header value into at most max alternatives.  Returns
+ * how many there are, 0 for "clear", or -1 if the value is malformed. */
+int altsvc_parse(const char *value, altsvc_t *alts, int max);
+
+/* Take what host:port's reply said about itself, in place of whatever it
+ * said before; malformed values are ignored.  Safe to call from any
+ * thread, as are the two below. */
+void altsvc_learn(const char *host, int port, const char *value);
+
+/* Where host:port says it may be reached over proto, other than where it
+ * is; for "h3", that may be the same port, over UDP.  Returns 1, with
+ * alt_host and alt_port filled in, or 0. */
+int altsvc_lookup(const char *host, int port, const char *proto,
+		  char *alt_host, size_t size, int *alt_port);
+
+/* Leave an alternative that failed alone for ALTSVC_BROKEN seconds, even
+ * if the server keeps offering it */
+void altsvc_broken(const char *host, int port, const char *proto);
+
+#endif				/* AXEL_ALTSVC_H */
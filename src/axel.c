@@ -51,16 +51,36 @@
 #include "config.h"
 #include "axel.h"
 #include "assert.h"
+#include "checksum.h"
+#include "events.h"
+#include "file.h"
+#include "manifest.h"
+#include "multirange.h"
+#include "prealloc.h"
 #include "sleep.h"
 #include "stfile.h"
+#include "stream.h"
 
-/* Axel */
-static void *setup_thread(void *);
-
-static char *buffer = NULL;
+/* Take note of what tells this version of the file from any other, for a
+   state file to be checked against, and for If-Range.  A weak ETag is of no
+   use for the latter. */
+static
+void
+get_validators(axel_t *axel)
+{
+	const http_t *http = axel->conn[0].http;
 
-#define MIN_CHUNK_WORTH (100 * 1024) /* 100 KB */
+	if (!conn_is_http(&axel->conn[0]))
+		return;
 
+	http_header_value(http, "ETag:", axel->etag, sizeof(axel->etag));
+	http_header_value(http, "Last-Modified:", axel->last_modified,
+			  sizeof(axel->last_modified));
+	if (*axel->etag && strncmp(axel->etag, "W/", 2))
+		axel->if_range = axel->etag;
+	else if (*axel->last_modified)
+		axel->if_range = axel->last_modified;
+}
 
 /* Create a new axel_t structure */
 axel_t *
@@ -80,6 +100,7 @@ axel_new(conf_t *conf, int count, const search_t *res)
 		goto nomem;
 
 	axel->conf = conf;
+	axel->wake_pipe[0] = axel->wake_pipe[1] = -1;
 	axel->conn = calloc(axel->conf->num_connections, sizeof(conn_t));
 	if (!axel->conn)
 		goto nomem;
@@ -95,19 +116,7 @@ axel_new(conf_t *conf, int count, const search_t *res)
 					     _("Buffer resized for this speed."));
 			axel->conf->buffer_size = axel->conf->max_speed;
 		}
-		uint64_t delay =
-			UINT64_C(1073741824) * axel->conf->buffer_size *
-			axel->conf->num_connections / axel->conf->max_speed;
-
-		axel->delay_time.tv_sec  = delay / 1073741824;
-		axel->delay_time.tv_nsec = delay % 1073741824;
-	}
-	if (buffer == NULL) {
-		buffer = malloc(axel->conf->buffer_size);
-		if (!buffer)
-			goto nomem;
 	}
-
 	u = malloc(sizeof(url_t) * count);
 	if (!u)
 		goto nomem;
@@ -126,8 +135,9 @@ axel_new(conf_t *conf, int count, const search_t *res)
 		return axel;
 	}
 
-	axel->conn[0].local_if = axel->conf->interfaces->text;
-	axel->conf->interfaces = axel->conf->interfaces->next;
+	if (!iface_open(axel))
+		goto nomem;
+	iface_assign(axel, 0);
 
 	strlcpy(axel->filename, axel->conn[0].file, sizeof(axel->filename));
 	http_decode(axel->filename);
@@ -175,6 +185,8 @@ axel_new(conf_t *conf, int count, const search_t *res)
 
 	conn_url(axel->url->text, sizeof(axel->url->text) - 1, axel->conn);
 	axel->size = axel->conn[0].size;
+	get_validators(axel);
+	checksum_setup(axel);
 	if (axel->conf->verbose > 0) {
 		if (axel->size != LLONG_MAX) {
 			char hsize[32];
@@ -227,11 +239,117 @@ axel_conn_resize(axel_t *axel, uint16_t nconns)
 	return 1;
 }
 
+/* Room for a full buffer, or for 50 ms at full speed: any less and the reads
+   come in crumbs, any more and a stalled connection coming back to life gets
+   to burst well past the limit */
+static
+size_t
+bucket_burst(const axel_t *axel)
+{
+	return max((unsigned long long)axel->conf->buffer_size,
+		   axel->conf->max_speed / 20);
+}
+
+/* Draw from the speed group's bucket, if there is one, with max_speed as the
+   limit for the whole group rather than for this download alone */
+static
+int
+join_speed_group(axel_t *axel)
+{
+	const char *name = axel->conf->speed_group;
+
+	if (!*name)
+		return 1;
+
+	axel->speed_group = shbucket_open(name, axel->conf->max_speed,
+					  bucket_burst(axel));
+	if (!axel->speed_group) {
+		if (errno == ENOENT)
+			axel_message(axel, _("Speed group %s has no limit set, "
+					     "use --max-speed to give it one"),
+				     name);
+		else if (errno == ENOSYS)
+			axel_message(axel, _("Speed groups are not supported "
+					     "on this system"));
+		else
+			axel_message(axel, _("Error joining speed group %s: %s"),
+				     name, strerror(errno));
+		return 0;
+	}
+
+	if (axel->conf->verbose > 0)
+		axel_message(axel, _("Sharing %llu bytes per second with "
+				     "speed group %s"),
+			     shbucket_rate(axel->speed_group), name);
+	return 1;
+}
+
+/* Get a newly created output file ready to be written anywhere in */
+static
+int
+prepare_file(axel_t *axel)
+{
+	/* Every byte of this download is about to be written, so whatever
+	   the file already holds past the end of it belongs to something
+	   else and has to go.  Not worth stopping for: the target may be a
+	   device or a fifo, which has no length to set, and the writes
+	   themselves will say so if it is anything worse than that. */
+	if (axel->size != LLONG_MAX)
+		(void)ftruncate(axel->outfd, axel->size);
+
+	/* Claim the space up front where the file system can, which spares
+	   it the checks and the zero-fill below */
+	int claimed = axel->size != LLONG_MAX ?
+	    prealloc(axel->outfd, axel->size) : 0;
+	if (claimed == -1) {
+		axel_message(axel, _("Error creating local file: %s"),
+			     strerror(errno));
+		return 0;
+	}
+	if (claimed)
+		return 1;
+
+	/* And check whether the filesystem can handle seeks to past-EOF
+	   areas.. Speeds things up. :) AFAIK this should just not happen: */
+	if (lseek(axel->outfd, axel->size, SEEK_SET) != -1 ||
+	    axel->conf->num_connections == 1)
+		return 1;
+
+	/* But if the OS/fs does not allow to seek behind EOF, we have to
+	   fill the file with zeroes before starting. Slow.. */
+	axel_message(axel, _("Crappy filesystem/OS.. Working around. :-("));
+	char *zeros = calloc(1, axel->conf->buffer_size);
+	if (!zeros) {
+		axel_message(axel, "%s", strerror(errno));
+		return 0;
+	}
+	lseek(axel->outfd, 0, SEEK_SET);
+	for (off_t j = axel->size; j > 0;) {
+		ssize_t nwrite = write(axel->outfd, zeros,
+				       min(j, axel->conf->buffer_size));
+
+		if (nwrite < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			axel_message(axel, _("Error creating local file"));
+			free(zeros);
+			return 0;
+		}
+		j -= nwrite;
+	}
+	free(zeros);
+
+	return 1;
+}
+
 /* Open a local file to store the downloaded data */
 int
 axel_open(axel_t *axel)
 {
-	if (axel->conf->verbose > 0)
+	if (!join_speed_group(axel))
+		return 0;
+
+	if (axel->conf->verbose > 0 && !axel->sink)
 		axel_message(axel, _("Opening output file %s"), axel->filename);
 
 	axel->outfd = -1;
@@ -244,8 +362,9 @@ axel_open(axel_t *axel)
 		if (!axel_conn_resize(axel, 1))
 			return 0;
 
-		axel_divide(axel);
-	} else {
+		if (!axel_divide(axel))
+			return 0;
+	} else if (!axel->stream) {
 		int loaded = stfile_load(axel);
 
 		if (loaded < 0)
@@ -256,11 +375,17 @@ axel_open(axel_t *axel)
 			axel_message(axel, _("Error opening local file"));
 			return 0;
 		}
+		if (loaded > 0 && !axel_divide(axel))
+			return 0;
 	}
 
 	/* If outfd == -1 we have to start from scrath now */
-	if (axel->outfd == -1) {
-		axel_divide(axel);
+	if (axel->stream) {
+		if (!stream_open(axel))
+			return 0;
+	} else if (axel->outfd == -1) {
+		if (!axel_divide(axel))
+			return 0;
 
 		if ((axel->outfd =
 		     open(axel->filename, O_CREAT | O_WRONLY, 0666)) == -1) {
@@ -268,70 +393,74 @@ axel_open(axel_t *axel)
 			return 0;
 		}
 
-		/* Every byte of this download is about to be written, so
-		   whatever the file already holds past the end of it belongs
-		   to something else and has to go.  Not worth stopping for:
-		   the target may be a device or a fifo, which has no length
-		   to set, and the writes themselves will say so if it is
-		   anything worse than that. */
-		if (axel->size != LLONG_MAX)
-			(void)ftruncate(axel->outfd, axel->size);
-
-		/* And check whether the filesystem can handle seeks to
-		   past-EOF areas.. Speeds things up. :) AFAIK this
-		   should just not happen: */
-		if (lseek(axel->outfd, axel->size, SEEK_SET) == -1 &&
-		    axel->conf->num_connections > 1) {
-			/* But if the OS/fs does not allow to seek behind
-			   EOF, we have to fill the file with zeroes before
-			   starting. Slow.. */
-			axel_message(axel,
-				     _("Crappy filesystem/OS.. Working around. :-("));
-			lseek(axel->outfd, 0, SEEK_SET);
-			memset(buffer, 0, axel->conf->buffer_size);
-			off_t j = axel->size;
-			while (j > 0) {
-				ssize_t nwrite;
-
-				if ((nwrite =
-				     write(axel->outfd, buffer,
-					   min(j, axel->conf->buffer_size))) < 0) {
-					if (errno == EINTR || errno == EAGAIN)
-						continue;
-					axel_message(axel,
-						     _("Error creating local file"));
-					return 0;
-				}
-				j -= nwrite;
-			}
-		}
+		if (!file_clone(axel) && !prepare_file(axel))
+			return 0;
 	}
 
-	return 1;
+	axel->writer = writer_new(axel->outfd, axel->conf->buffer_size,
+				  axel->stream ? axel->conf->stream_buffers :
+				  axel->conf->write_buffers);
+	if (!axel->writer) {
+		axel_message(axel, _("Error starting the disk writer: %s"),
+			     strerror(errno));
+		return 0;
+	}
+	if (axel->sink)
+		writer_sink(axel->writer, axel->sink, axel->sink_arg,
+			    !axel->sink_seekable);
+	/* What a state file or a clone put there is as good as written */
+	for (size_t i = 0; i < axel->done.count; i++)
+		if (writer_mark(axel->writer, axel->done.r[i].start,
+				axel->done.r[i].end, 1) == -1)
+			return 0;
+	if (!checksum_open(axel))
+		return 0;
+
+	return manifest_seed(axel);
 }
 
 /**
- * Steals half of the largest available chunk of work of at least
- * MIN_CHUNK_WORTH size, from an active connection to feed a finished one.
+ * Feeds a finished connection: with the gaps nobody is working on if there
+ * are any, several at once if they are small, else with part of the chunk
+ * of work of at least MIN_CHUNK_WORTH size that would take longest to
+ * finish, stolen from an active connection.  Where interfaces differ in
+ * speed, the part is what has both finish together; else it is half.
  *
  * Must be called with the conn_t lock held.
  */
-static
 void
-reactivate_connection(axel_t *axel, int thread)
+axel_reactivate(axel_t *axel, int thread)
 {
 	/* TODO Make the minimum also depend on the connection speed */
-	off_t max_remaining = MIN_CHUNK_WORTH - 1;
+	off_t max_remaining = 0;
+	double max_left = 0;
 	int idx = -1;
+	range_t gap;
 
 	if (axel->conn[thread].enabled ||
 	    axel->conn[thread].currentbyte < axel->conn[thread].lastbyte)
 		return;
 
+	if (multirange_assign(axel, thread, MIN_CHUNK_WORTH))
+		return;
+	if (multirange_unowned(axel, &gap)) {
+		stream_trim(axel, &gap);
+		axel->conn[thread].currentbyte = gap.start;
+		axel->conn[thread].lastbyte = gap.end;
+		return;
+	}
+
 	for (int j = 0; j < axel->conf->num_connections; j++) {
-		off_t remaining =
-			axel->conn[j].lastbyte - axel->conn[j].currentbyte;
-		if (remaining > max_remaining) {
+		/* Nor cut into a copy the kernel is making */
+		off_t remaining = axel->conn[j].lastbyte -
+			axel->conn[j].currentbyte - axel->conn[j].copy_ahead;
+		/* Several ranges are not one chunk to cut in half */
+		if (axel->conn[j].multi && axel->conn[j].multi->count)
+			continue;
+		double left = iface_time_left(axel, j, remaining);
+
+		if (remaining >= MIN_CHUNK_WORTH && left > max_left) {
+			max_left = left;
 			max_remaining = remaining;
 			idx = j;
 		}
@@ -344,7 +473,8 @@ reactivate_connection(axel_t *axel, int thread)
 #endif
 	axel->conn[thread].lastbyte = axel->conn[idx].lastbyte;
 	axel->conn[idx].lastbyte = axel->conn[idx].currentbyte
-		+ max_remaining / 2;
+		+ axel->conn[idx].copy_ahead
+		+ iface_split(axel, idx, max_remaining);
 	axel->conn[thread].currentbyte = axel->conn[idx].lastbyte;
 }
 
@@ -361,85 +491,132 @@ axel_start(axel_t *axel)
 	for (i = 0; i < axel->conf->num_connections; i++) {
 		axel->conn[i].conf = axel->conf;
 		conn_set(&axel->conn[i], url_ptr->text);
+		axel->conn[i].url = url_ptr;
 		url_ptr = url_ptr->next;
-		axel->conn[i].local_if = axel->conf->interfaces->text;
-		axel->conf->interfaces = axel->conf->interfaces->next;
+		iface_assign(axel, i);
 		if (i)
 			axel->conn[i].supported = true;
+		axel->conn[i].if_range = axel->if_range;
 	}
 
 	if (axel->conf->verbose > 0)
 		axel_message(axel, _("Starting download"));
 
+	/* The real downloading will start now, so let's start counting */
+	axel->start_time = axel_gettime();
+	if (!events_init(axel, axel->start_time)) {
+		axel_message(axel, "%s", strerror(errno));
+		axel->ready = -1;
+		return;
+	}
+
 	for (i = 0; i < axel->conf->num_connections; i++) {
 		if (axel->conn[i].currentbyte >= axel->conn[i].lastbyte) {
 			pthread_mutex_lock(&axel->conn[i].lock);
-			reactivate_connection(axel, i);
+			axel_reactivate(axel, i);
 			pthread_mutex_unlock(&axel->conn[i].lock);
-		} else if (axel->conn[i].currentbyte < axel->conn[i].lastbyte) {
-			if (axel->conf->verbose >= 2) {
-				axel_message(axel,
-					     _("Connection %i downloading from %s:%i using interface %s"),
-					     i, axel->conn[i].host,
-					     axel->conn[i].port,
-					     axel->conn[i].local_if);
-			}
-
-			axel->conn[i].state = true;
-			if (pthread_create
-			    (axel->conn[i].setup_thread, NULL, setup_thread,
-			     &axel->conn[i]) != 0) {
-				axel_message(axel, _("pthread error!!!"));
-				axel->ready = -1;
-			}
+			/* Started on the first run, if it found work to do */
+			events_check(axel, i);
+		} else {
+			events_start(axel, i);
 		}
 	}
 
-	/* The real downloading will start now, so let's start counting */
-	axel->start_time = axel_gettime();
-	axel->ready = 0;
+	/* In a speed group the limit is the group's, not this download's */
+	throttle_init(&axel->throttle,
+		      axel->speed_group ? 0 : axel->conf->max_speed,
+		      bucket_burst(axel), axel->start_time);
+	if (axel->ready != -1)
+		axel->ready = 0;
+}
+
+/* A connection asking for several ranges, once its reply has been written as
+   far as it goes: it may have had all it asked for */
+static
+int
+read_parts(axel_t *axel, int i, int dry)
+{
+	conn_t *conn = &axel->conn[i];
+
+	if (!dry && conn->enabled && conn->currentbyte >= conn->lastbyte) {
+		if (axel->conf->verbose)
+			axel_message(axel, _("Connection %i finished"), i);
+		conn->multi->active = false;
+		conn_disconnect(conn);
+		axel_reactivate(axel, i);
+		events_check(axel, i);
+	}
+	return dry;
 }
 
 /**
- * Read whatever one connection has ready, and write it to the output file.
+ * Read whatever one connection has ready, and queue it for the writer.
  *
- * Must be called with the conn_t lock held; the caller releases it.
+ * Must be called with the conn_t lock held; the caller releases it.  nready
+ * counts the connections select() found ready that have yet to be read,
+ * which is what the tokens left are shared between.
  *
- * Returns -1 when the whole pass has to be abandoned, rather than merely
- * this connection: the output file is what failed, not the network.
+ * Returns 1 when the writer has no block left to read into, which ends the
+ * pass for every connection, rather than merely this one.
  */
 static
 int
-read_connection(axel_t *axel, int i, fd_set *fds)
+read_connection(axel_t *axel, int i, fd_set *fds, int *nready, double now)
 {
 	off_t remaining, size;
+	size_t want;
+	char *block;
+	int copied;
 
 	if (!axel->conn[i].enabled)
 		return 0;
 
-	if (!FD_ISSET(axel->conn[i].tcp->fd, fds)) {
-		time_t timeout = axel->conn[i].last_transfer +
-		    axel->conf->connection_timeout;
-		if (axel_gettime() > timeout) {
-			if (axel->conf->verbose)
-				axel_message(axel,
-					     _("Connection %i timed out"),
-					     i);
-			conn_disconnect(&axel->conn[i]);
-		}
+	/* What the last read left for want of blocks goes first */
+	if (multirange_pending(&axel->conn[i]))
+		return read_parts(axel, i, multirange_drain(axel, i));
+
+	/* Held back for the pipe's sake, which is no fault of its own */
+	if (!stream_may_read(axel, i)) {
+		axel->conn[i].last_transfer = now;
 		return 0;
 	}
 
-	axel->conn[i].last_transfer = axel_gettime();
-	size =
-	    tcp_read(axel->conn[i].tcp, buffer,
-		     axel->conf->buffer_size);
+	/* Timeouts are for the connection's timer to look after */
+	if (!FD_ISSET(axel->conn[i].tcp->fd, fds))
+		return 0;
+
+	block = writer_get(axel->writer);
+	if (!block)
+		return 1;
+
+	/* This connection's share of the tokens left for those still to go */
+	want = throttle_share(&axel->throttle, axel->conf->buffer_size,
+			      *nready);
+	if (want && axel->speed_group)
+		want = shbucket_take(axel->speed_group, want, *nready);
+	(*nready)--;
+	if (!want) {
+		writer_put(axel->writer, block, 0, 0);
+		return 0;
+	}
+
+	axel->conn[i].last_transfer = now;
+	copied = file_copy(axel, i, want, &size);
+	if (!copied)
+		size = tcp_read(axel->conn[i].tcp, block, want);
+	/* What the group lent and this read left unused goes back to it; a
+	   copy made in the kernel may have been asked for before the limit */
+	if (axel->speed_group && size < (off_t)want)
+		shbucket_give(axel->speed_group, want - max(size, (off_t)0));
+	if (size <= 0)
+		writer_put(axel->writer, block, 0, 0);
 	if (size == -1) {
 		if (axel->conf->verbose) {
 			axel_message(axel, _("Error on connection %i! "
 					     "Connection closed"), i);
 		}
 		conn_disconnect(&axel->conn[i]);
+		events_check(axel, i);
 		return 0;
 	}
 
@@ -462,10 +639,21 @@ read_connection(axel_t *axel, int i, fd_set *fds)
 			axel->ready = 1;
 		}
 		conn_disconnect(&axel->conn[i]);
-		reactivate_connection(axel, i);
+		axel_reactivate(axel, i);
+		events_check(axel, i);
 		return 0;
 	}
 
+	throttle_take(&axel->throttle, size);
+	iface_count(axel, i, size, now);
+
+	if (multirange_active(&axel->conn[i])) {
+		int dry = multirange_feed(axel, i, block, size);
+
+		writer_put(axel->writer, block, 0, 0);
+		return read_parts(axel, i, dry);
+	}
+
 	/* remaining == Bytes to go */
 	remaining = axel->conn[i].lastbyte - axel->conn[i].currentbyte;
 	if (remaining < size) {
@@ -477,91 +665,30 @@ read_connection(axel_t *axel, int i, fd_set *fds)
 		size = remaining;
 		/* Don't terminate, still stuff to write! */
 	}
-	/* This should always succeed.. */
-	lseek(axel->outfd, axel->conn[i].currentbyte, SEEK_SET);
-	if (write(axel->outfd, buffer, size) != size) {
-		axel_message(axel, _("Write error!"));
+	writer_put(axel->writer, block, axel->conn[i].currentbyte,
+		   copied ? 0 : size);
+	/* A copy made in the kernel is written already, behind the writer's
+	   back */
+	if (ranges_add(&axel->done, axel->conn[i].currentbyte,
+		       axel->conn[i].currentbyte + size) == -1 ||
+	    (copied && writer_mark(axel->writer, axel->conn[i].currentbyte,
+				   axel->conn[i].currentbyte + size, 1) == -1)) {
+		axel_message(axel, "%s", strerror(errno));
 		axel->ready = -1;
-		return -1;
 	}
+	checksum_source(axel, axel->conn[i].url, axel->conn[i].currentbyte,
+			axel->conn[i].currentbyte + size);
 	axel->conn[i].currentbyte += size;
 	axel->bytes_done += size;
-	if (remaining == size)
-		reactivate_connection(axel, i);
+	events_redraw(axel);
+	if (remaining == size) {
+		axel_reactivate(axel, i);
+		events_check(axel, i);
+	}
 
 	return 0;
 }
 
-/* Reap a connection's setup thread, if it has one left to reap.
- *
- * Joining a thread twice is undefined behaviour, and so is joining one that
- * was never created.  The handle is zero until pthread_create() fills it in
- * -- axel->conn is calloc'd, and the entries a state file grows it by are
- * memset -- so zeroing it on the way out is what tells a thread still to be
- * reaped from one that is already gone. */
-static
-void
-join_setup_thread(conn_t *conn)
-{
-	if (*conn->setup_thread == 0)
-		return;
-
-	pthread_join(*conn->setup_thread, NULL);
-	*conn->setup_thread = 0;
-}
-
-/* Look for aborted connections and attempt to restart them. */
-static
-void
-restart_connections(axel_t *axel)
-{
-	url_t *url_ptr = axel->url;
-
-	for (int i = 0; i < axel->conf->num_connections; i++) {
-		/* skip connection if setup thread hasn't released the lock yet */
-		if (pthread_mutex_trylock(&axel->conn[i].lock))
-			continue;
-
-		if (!axel->conn[i].enabled &&
-		    axel->conn[i].currentbyte < axel->conn[i].lastbyte) {
-			if (!axel->conn[i].state) {
-				// Wait for termination of this thread
-				join_setup_thread(&axel->conn[i]);
-
-				conn_set(&axel->conn[i], url_ptr->text);
-				url_ptr = url_ptr->next;
-				/* axel->conn[i].local_if = axel->conf->interfaces->text;
-				   axel->conf->interfaces = axel->conf->interfaces->next; */
-				if (axel->conf->verbose >= 2)
-					axel_message(axel,
-						     _("Connection %i downloading from %s:%i using interface %s"),
-						     i, axel->conn[i].host,
-						     axel->conn[i].port,
-						     axel->conn[i].local_if);
-
-				axel->conn[i].state = true;
-				if (pthread_create
-				    (axel->conn[i].setup_thread, NULL,
-				     setup_thread, &axel->conn[i]) == 0) {
-					axel->conn[i].last_transfer = axel_gettime();
-				} else {
-					axel_message(axel,
-						     _("pthread error!!!"));
-					axel->ready = -1;
-				}
-			} else {
-				if (axel_gettime() > (axel->conn[i].last_transfer +
-						 axel->conf->reconnect_delay)) {
-					pthread_cancel(*axel->conn[i].setup_thread);
-					axel->conn[i].state = false;
-					join_setup_thread(&axel->conn[i]);
-				}
-			}
-		}
-		pthread_mutex_unlock(&axel->conn[i].lock);
-	}
-}
-
 /* Calculate current average speed and finish_time */
 static
 void
@@ -580,40 +707,44 @@ update_speed(axel_t *axel)
 }
 
 /**
- * Check speed. If too high, delay for some time to slow things down a bit.
- * I think a 5% deviation should be acceptable.
+ * The least worth waking up for: a full buffer, or 20 ms worth of tokens at
+ * speeds too low to fill one that often.
+ */
+static
+size_t
+read_quantum(const axel_t *axel)
+{
+	unsigned long long rate = axel->speed_group ?
+	    shbucket_rate(axel->speed_group) : axel->conf->max_speed;
+	unsigned long long quantum = max(1ull, rate / 50);
+
+	return min(quantum, (unsigned long long)axel->conf->buffer_size);
+}
+
+/**
+ * Sleep until the bucket has a read's worth of tokens in it again.
  *
- * Returns -1 if the wait failed, having marked the download as broken.
+ * Returns 1 if it had to, 0 if there was no need, and -1 if the wait failed,
+ * having marked the download as broken.
  */
 static
 int
-enforce_throttling(axel_t *axel)
+wait_for_tokens(axel_t *axel)
 {
-	unsigned long long int max_speed_ratio;
+	throttle_refill(&axel->throttle, axel_gettime());
 
-	if (axel->conf->max_speed == 0)
+	size_t quantum = read_quantum(axel);
+	double wait = throttle_delay(&axel->throttle, quantum);
+	if (axel->speed_group)
+		wait = max(wait, shbucket_delay(axel->speed_group, quantum));
+	if (wait <= 0)
 		return 0;
 
-	max_speed_ratio = 1000 * axel->bytes_per_second /
-	    axel->conf->max_speed;
-	if (max_speed_ratio > 1050) {
-		axel->delay_time.tv_nsec += 10000000;
-		if (axel->delay_time.tv_nsec >= 1000000000) {
-			axel->delay_time.tv_sec++;
-			axel->delay_time.tv_nsec -= 1000000000;
-		}
-	} else if (max_speed_ratio < 950) {
-		if (axel->delay_time.tv_nsec >= 10000000) {
-			axel->delay_time.tv_nsec -= 10000000;
-		} else if (axel->delay_time.tv_sec > 0) {
-			axel->delay_time.tv_sec--;
-			axel->delay_time.tv_nsec += 999000000;
-		} else {
-			axel->delay_time.tv_sec = 0;
-			axel->delay_time.tv_nsec = 0;
-		}
-	}
-	if (axel_sleep(axel->delay_time) < 0) {
+	struct timespec delay = {
+		.tv_sec = wait,
+		.tv_nsec = (wait - (time_t)wait) * 1000000000,
+	};
+	if (axel_sleep(delay) < 0) {
 		axel_message(axel,
 			     _("Error while enforcing throttling: %s"),
 			     strerror(errno));
@@ -621,85 +752,142 @@ enforce_throttling(axel_t *axel)
 		return -1;
 	}
 
-	return 0;
+	return 1;
 }
 
-/* Main 'loop' */
-void
-axel_do(axel_t *axel)
+int
+axel_fds(axel_t *axel, fd_set *fds, int *pending)
 {
-	fd_set fds[1];
-	int hifd, i;
-	struct timeval timeval[1];
-	struct timespec delay = {.tv_sec = 0, .tv_nsec = 100000000};
-
-	/* Create statefile if necessary */
-	if (axel_gettime() > axel->next_state) {
-		stfile_save(axel);
-		axel->next_state = axel_gettime() + axel->conf->save_state_interval;
-	}
+	/* A setup thread that is done wakes the select() up through this */
+	int hifd = events_fd(axel);
 
-	/* Wait for data on (one of) the connections */
-	FD_ZERO(fds);
-	hifd = 0;
-	for (i = 0; i < axel->conf->num_connections; i++) {
+	FD_SET(hifd, fds);
+	*pending = 0;
+	for (int i = 0; i < axel->conf->num_connections; i++) {
 		/* skip connection if setup thread hasn't released the lock yet */
 		if (!pthread_mutex_trylock(&axel->conn[i].lock)) {
-			if (axel->conn[i].enabled) {
+			if (axel->conn[i].enabled &&
+			    stream_may_read(axel, i)) {
 				FD_SET(axel->conn[i].tcp->fd, fds);
 				hifd = max(hifd, axel->conn[i].tcp->fd);
 			}
+			*pending |= multirange_pending(&axel->conn[i]);
 			pthread_mutex_unlock(&axel->conn[i].lock);
 		}
 	}
 
-	if (hifd == 0) {
-		/* No connections yet. Wait... */
-		if (axel_sleep(delay) < 0) {
-			axel_message(axel,
-				     _("Error while waiting for connection: %s"),
-				     strerror(errno));
-			axel->ready = -1;
-			return;
-		}
-	} else {
-		timeval->tv_sec = 0;
-		timeval->tv_usec = 100000;
-		if (select(hifd + 1, fds, NULL, NULL, timeval) == -1) {
-			/* A select() error probably means it was interrupted
-			 * by a signal, or that something else's very wrong... */
-			axel->ready = -1;
-			return;
-		}
+	return hifd;
+}
 
-		/* Handle connections which need attention */
-		for (i = 0; i < axel->conf->num_connections; i++) {
-			int err;
+/**
+ * Wait for data on (one of) the connections, and read it.
+ *
+ * The connections take turns at going first, so that when the bucket holds
+ * less than a byte for each of them, it is not always the same ones that
+ * get nothing.
+ *
+ * Returns -1 when the download has to stop.
+ */
+static
+int
+read_connections(axel_t *axel)
+{
+	fd_set fds[1];
+	int hifd, i, nready, pending;
+	struct timeval timeval[1], now_tv = { 0 };
+	double now;
 
-			/* skip connection if setup thread hasn't released
-			 * the lock yet */
-			if (pthread_mutex_trylock(&axel->conn[i].lock))
-				continue;
+	FD_ZERO(fds);
+	hifd = axel_fds(axel, fds, &pending);
+
+	/* Nothing to wake up for before the next timer is due, unless some
+	   reply is still to be written out of what was read already */
+	nready = select(hifd + 1, fds, NULL, NULL, pending ? &now_tv :
+			events_timeout(axel, axel_gettime(), timeval));
+	if (nready == -1) {
+		/* A select() error probably means it was interrupted
+		 * by a signal, or that something else's very wrong... */
+		axel->ready = -1;
+		return -1;
+	}
 
-			err = read_connection(axel, i, fds);
-			pthread_mutex_unlock(&axel->conn[i].lock);
-			if (err)
-				return;
-		}
+	if (FD_ISSET(events_fd(axel), fds)) {
+		events_drain(axel);
+		nready--;
+	}
+
+	/* Handle connections which need attention */
+	now = axel_gettime();
+	throttle_refill(&axel->throttle, now);
+	int first = axel->first_reader++ % axel->conf->num_connections;
+	for (int n = 0; n < axel->conf->num_connections; n++) {
+		int err;
 
-		if (axel->ready)
-			return;
+		i = (first + n) % axel->conf->num_connections;
+
+		/* skip connection if setup thread hasn't released
+		 * the lock yet */
+		if (pthread_mutex_trylock(&axel->conn[i].lock))
+			continue;
+
+		err = read_connection(axel, i, fds, &nready, now);
+		pthread_mutex_unlock(&axel->conn[i].lock);
+		if (err)
+			break;
 	}
 
-	restart_connections(axel);
-	update_speed(axel);
+	return axel->ready ? -1 : 0;
+}
 
-	if (enforce_throttling(axel) < 0)
+/* Whether the writer has failed, which is the end of the download */
+static
+int
+write_failed(axel_t *axel, int err)
+{
+	if (!err)
+		return 0;
+
+	axel_message(axel, _("Write error!"));
+	axel->ready = -1;
+	return 1;
+}
+
+/* Main 'loop' */
+void
+axel_do(axel_t *axel)
+{
+	struct timeval timeval[1];
+
+	/* Connection checks, state saves, progress updates, and pieces to
+	   fetch again */
+	events_run(axel, axel_gettime());
+	checksum_poll(axel);
+	if (write_failed(axel, writer_error(axel->writer)))
+		return;
+
+	int throttled = wait_for_tokens(axel);
+	if (throttled < 0)
+		return;
+
+	/* With every block waiting on the disk there is nothing to read
+	   into: wait for one to come back, unless a timer is due first */
+	if (!throttled &&
+	    writer_wait(axel->writer,
+			events_timeout(axel, axel_gettime(), timeval)) &&
+	    read_connections(axel) < 0)
 		return;
 
-	/* Ready? */
-	if (axel->bytes_done == axel->size)
-		axel->ready = 1;
+	update_speed(axel);
+
+	/* Ready once it is all on disk, and hashes as it should: unless some
+	   pieces did not, and are to be fetched again */
+	if (axel->bytes_done == axel->size &&
+	    !write_failed(axel, writer_sync(axel->writer))) {
+		int ok = checksum_verify(axel);
+
+		if (ok >= 0)
+			axel->ready = ok ? 1 : -1;
+	}
 }
 
 /* Close an axel connection */
@@ -713,144 +901,92 @@ axel_close(axel_t *axel)
 	assert(axel->conn);
 
 	/* Terminate threads and close connections */
-	for (int i = 0; i < axel->conf->num_connections; i++) {
-		/* don't try to kill non existing thread */
-		if (*axel->conn[i].setup_thread != 0) {
-			pthread_cancel(*axel->conn[i].setup_thread);
-			join_setup_thread(&axel->conn[i]);
-		}
+	events_stop(axel);
+	for (int i = 0; i < axel->conf->num_connections; i++)
 		conn_disconnect(&axel->conn[i]);
-	}
 
 	free(axel->url);
-
-	/* Delete state file if necessary */
-	if (axel->ready == 1) {
+	metalink_free(axel->metalink);
+	zsync_free(axel->zsync);
+	ifaces_free(&axel->ifaces);
+	shbucket_close(axel->speed_group);
+
+	/* A state file must not count what never made it to the disk: the
+	   last one saved is the one to resume from */
+	int unwritten = writer_free(axel->writer) == -1;
+	axel->writer = NULL;
+	checksum_close(axel);
+	if (!unwritten)
+		stream_publish(axel);
+
+	/* Delete state file if necessary: a file that came out wrong is not
+	   one to resume, either */
+	if (axel->stream) {
+		/* Nothing to resume into a pipe */
+	} else if (axel->ready == 1 || axel->bad_checksum) {
 		stfile_unlink(axel->filename);
 	}
 	/* Else: Create it.. */
-	else if (axel->bytes_done > 0) {
+	else if (axel->bytes_done > 0 && !unwritten) {
 		stfile_save(axel);
 	}
+	stfile_close(axel);
 
 	print_messages(axel);
 
 	close(axel->outfd);
 
-	if (!PROTO_IS_FTP(axel->conn->proto) || axel->conn->proxy) {
+	if (conn_is_http(axel->conn)) {
 		abuf_setup(axel->conn->http->request, ABUF_FREE);
 		abuf_setup(axel->conn->http->headers, ABUF_FREE);
 	}
+	ranges_free(&axel->done);
+	for (int i = 0; i < axel->conf->num_connections; i++)
+		multirange_free(&axel->conn[i]);
 	free(axel->conn);
 	free(axel);
-	free(buffer);
 }
 
-/* time() with more precision */
+/* time() with more precision, from a clock that never goes backwards: only
+   the differences between its readings mean anything */
 double
 axel_gettime(void)
 {
-	struct timeval time[1];
+	struct timespec ts;
 
-	gettimeofday(time, NULL);
-	return (double)time->tv_sec + (double)time->tv_usec / 1000000;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000;
 }
 
-/* Thread used to set up a connection */
-static
-void *
-setup_thread(void *c)
-{
-	conn_t *conn = c;
-	int oldstate;
-
-	/* Allow this thread to be killed at any time. */
-	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &oldstate);
-	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldstate);
-
-	pthread_mutex_lock(&conn->lock);
-	if (conn_setup(conn)) {
-		conn->last_transfer = axel_gettime();
-		if (conn_exec(conn)) {
-			conn->last_transfer = axel_gettime();
-			conn->enabled = true;
-			goto out;
-		}
-	}
-
-	conn_disconnect(conn);
- out:
-	conn->state = false;
-	pthread_mutex_unlock(&conn->lock);
-
-	return NULL;
-}
-
-/* Add a message to the axel->message structure */
-void
-axel_message(axel_t *axel, const char *format, ...)
-{
-	message_t *m;
-	va_list params;
-
-	if (!axel)
-		goto nomem;
-
-	m = calloc(1, sizeof(message_t));
-	if (!m)
-		goto nomem;
-
-	va_start(params, format);
-	vsnprintf(m->text, MAX_STRING, format, params);
-	va_end(params);
-
-	if (axel->message == NULL) {
-		axel->message = axel->last_message = m;
-	} else {
-		axel->last_message->next = m;
-		axel->last_message = m;
-	}
-
-	return;
-
- nomem:
-	/* Flush previous messages */
-	print_messages(axel);
-	va_start(params, format);
-	vprintf(format, params);
-	va_end(params);
-}
-
-/* Divide the file and set the locations for each connection */
-void
+/* Lay the connections over what is left to download: the whole file, but
+   for what a state file said is done */
+int
 axel_divide(axel_t *axel)
 {
-	/* Optimize the number of connections in case the file is small */
-	off_t maxconns = max(1u, axel->size / MIN_CHUNK_WORTH);
-	if (maxconns < axel->conf->num_connections)
-		axel->conf->num_connections = maxconns;
-
-	/* Calculate each segment's size */
-	off_t seg_len = axel->size / axel->conf->num_connections;
-
-	if (!seg_len) {
-		printf(_("Too few bytes remaining, forcing a single connection\n"));
-		axel->conf->num_connections = 1;
-		seg_len = axel->size;
+	range_t *pieces = malloc(axel->conf->num_connections *
+				 sizeof(*pieces));
+	if (!pieces)
+		return 0;
 
-		conn_t *new_conn = realloc(axel->conn, sizeof(*axel->conn));
-		if (new_conn)
-			axel->conn = new_conn;
+	/* Fewer connections where there are too few bytes to go round */
+	int n = ranges_plan(&axel->done, stream_horizon(axel),
+			    axel->conf->num_connections, MIN_CHUNK_WORTH,
+			    pieces);
+	if (n < 0 || !axel_conn_resize(axel, max(n, 1))) {
+		free(pieces);
+		return 0;
 	}
 
-	for (int i = 0; i < axel->conf->num_connections; i++) {
-		axel->conn[i].currentbyte = seg_len * i;
-		axel->conn[i].lastbyte    = seg_len * i + seg_len;
+	/* With nothing left at all, the one connection has nothing to do */
+	for (int i = 0; i < n; i++) {
+		axel->conn[i].currentbyte = pieces[i].start;
+		axel->conn[i].lastbyte = pieces[i].end;
 	}
+	if (!n)
+		axel->conn[0].currentbyte = axel->conn[0].lastbyte =
+			axel->size;
+	free(pieces);
 
-	/* Last connection downloads remaining bytes */
-	size_t tail = axel->size % seg_len;
-	axel->conn[axel->conf->num_connections - 1].lastbyte += tail;
 #ifndef NDEBUG
 	for (int i = 0; i < axel->conf->num_connections; i++) {
 		printf(_("Downloading %jd-%jd using conn. %i\n"),
@@ -858,4 +994,5 @@ axel_divide(axel_t *axel)
 		       (intmax_t)axel->conn[i].lastbyte, i);
 	}
 #endif
+	return 1;
 }
@@ -61,6 +61,7 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <netinet/in_systm.h>
@@ -102,6 +103,7 @@
 #define MAX_REDIRECT		20
 #define DEFAULT_IO_TIMEOUT	120
 #define DEFAULT_USER_AGENT	"Axel/" VERSION " (" ARCH ")"
+#define MIN_CHUNK_WORTH		(100 * 1024)	/* 100 KB */
 
 typedef struct {
 	void *next;
@@ -115,10 +117,21 @@ typedef message_t axel_if_t;
 #include "conf.h"
 #include "tcp.h"
 #include "ftp.h"
+#include "ranges.h"
+#include "digest.h"
+#include "metalink.h"
+#include "zsync.h"
+#include "multipart.h"
 #include "http.h"
 #include "conn.h"
 #include "ssl.h"
 #include "search.h"
+#include "throttle.h"
+#include "shbucket.h"
+#include "wheel.h"
+#include "writer.h"
+#include "pieces.h"
+#include "iface.h"
 
 #define min(a, b) \
 	({ \
@@ -138,14 +151,45 @@ typedef struct {
 	conf_t *conf;
 	char filename[MAX_STRING];
 	double start_time;
-	int next_state, finish_time;
+	int finish_time;
 	off_t bytes_done, start_byte, size;
+	ranges_t done;
 	long long int bytes_per_second;
-	struct timespec delay_time;
+	throttle_t throttle;
+	shbucket_t *speed_group;
+	int first_reader;
 	int outfd;
+	bool stream;		/* the output is written from its start on */
+	writer_sink_fn *sink;	/* what takes the data, if not outfd */
+	void *sink_arg;
+	bool sink_seekable;	/* and it takes it at any offset */
+	writer_t *writer;
+	struct stfile *stfile;
 	int ready;
 	message_t *message, *last_message;
-	url_t *url;
+	url_t *url, *next_url;
+	char etag[MAX_STRING], last_modified[MAX_STRING];
+	const char *if_range;
+	bool no_multirange;	/* the server sends one range at a time */
+	int copy_range;		/* whether file:// data can be copied in the
+				   kernel: 1 or -1, 0 until tried */
+	digest_spec_t checksum;	/* what the file is to hash to, if known */
+	digest_t *digest;
+	bool bad_checksum;
+	metalink_t *metalink;	/* what the download was described by */
+	pieces_t *pieces;
+	url_t **piece_url;	/* the mirror each piece last came from */
+	zsync_t *zsync;		/* the blocks to look for in an older file */
+	ifaces_t ifaces;	/* the interfaces connections go out through */
+	wheel_t timers;
+	int wake_pipe[2];	/* from the setup threads to axel_do() */
+	wheel_timer_t *conn_timer, save_timer, checkpoint_timer, redraw_timer;
+	int redraw;
+	struct control *control;	/* the --control socket, if any */
+	/* Whoever embeds the download, and what takes its messages instead
+	   of print_messages() printing them */
+	void *owner;
+	void (*take_messages)(void *owner, message_t *first);
 } axel_t;
 
 axel_t *axel_new(conf_t *conf, int count, const search_t *urls);
@@ -158,8 +202,36 @@ void print_messages(axel_t *axel);
 /* Queue a line for the progress display to print between updates */
 void axel_message(axel_t *axel, const char *format, ...) PRINTF_FUNC(2);
 
-/* Hand each connection a share of the file to fetch */
-void axel_divide(axel_t *axel);
+/* Find a connection that has finished more to do; called with its lock
+   held */
+void axel_reactivate(axel_t *axel, int thread);
+
+/* Add what axel_do() waits on to fds, and say whether it has anything to
+   do without waiting; returns the highest descriptor added */
+int axel_fds(axel_t *axel, fd_set *fds, int *pending);
+
+/* Hand each connection a share of what is left to fetch; returns 0 if it
+   ran out of memory */
+int axel_divide(axel_t *axel);
+
+/* Take the interfaces from the configuration; returns 0 if out of memory */
+int iface_open(axel_t *axel);
+
+/* Send connection i out through the interface with the most headroom */
+void iface_assign(axel_t *axel, int i);
+
+/* Count what connection i read towards its interface's throughput */
+void iface_count(axel_t *axel, int i, off_t bytes, double now);
+
+/* How long connection i would take to fetch remaining bytes: in seconds,
+   by its interface's throughput or, until that is measured, by the mean of
+   those that are; in bytes, for every connection alike, until any is */
+double iface_time_left(const axel_t *axel, int i, off_t remaining);
+
+/* How much of remaining bytes connection i is to keep when an idle one
+   takes the rest: as much as has both finish together, judging by their
+   interfaces, or half if there is nothing to judge by */
+off_t iface_split(const axel_t *axel, int i, off_t remaining);
 
 /* Change how many connections there are, keeping conf and the array in step */
 int axel_conn_resize(axel_t *axel, uint16_t nconns);
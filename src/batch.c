@@ -0,0 +1,567 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Running a list of downloads in one process */
+
+#include "config.h"
+#include "axel.h"
+#include "batch.h"
+#include "ctlsock.h"
+#include "manifest.h"
+
+struct job {
+	char *url;
+	int id;
+	int fd;			/* where to tell of it, -1 if nowhere */
+};
+
+struct worker {
+	batch_t *batch;
+	int id;
+};
+
+struct batch {
+	conf_t *conf;
+	const char *dir;
+	const int *run;
+	struct job **jobs;	/* those waiting for a worker, in order */
+	int count;
+	int ids;		/* handed out so far */
+	bool closed;		/* no more jobs to come */
+	int status;
+	pthread_mutex_t lock;
+	pthread_cond_t queued;	/* a job was added, or the last one */
+	pthread_cond_t freed;	/* connections were given back */
+	int free;		/* connections nobody is using */
+	off_t *waiting;		/* each worker's download size, -1 if none */
+	pthread_mutex_t naming;	/* picking a file name, and creating it */
+	char (*names)[MAX_STRING];	/* each worker's file, "" if none */
+	pthread_mutex_t print;
+	struct worker *w;
+	pthread_t *threads;
+	int started;
+	bool own_group;		/* the speed group is the batch's to remove */
+};
+
+/* Read the URLs out of the list, leaving out blank lines and comments.
+   Returns NULL after saying why. */
+static
+char **
+read_list(const char *path, int *count)
+{
+	FILE *f = strcmp(path, "-") ? fopen(path, "r") : stdin;
+	char **urls = NULL, *line = NULL;
+	size_t len = 0;
+	ssize_t n;
+
+	if (!f) {
+		fprintf(stderr, _("Can't open %s: %s\n"), path,
+			strerror(errno));
+		return NULL;
+	}
+
+	*count = 0;
+	while ((n = getline(&line, &len, f)) != -1) {
+		char *s = line, **more;
+
+		while (n && isspace((unsigned char)s[n - 1]))
+			s[--n] = '\0';
+		while (isspace((unsigned char)*s))
+			s++;
+		if (!*s || *s == '#')
+			continue;
+		if (strlen(s) >= MAX_STRING) {
+			fprintf(stderr,
+				_("Can't handle URLs of length over %zu\n"),
+				MAX_STRING);
+			continue;
+		}
+
+		more = realloc(urls, (*count + 1) * sizeof(*urls));
+		if (!more || !(more[*count] = strdup(s))) {
+			fprintf(stderr, "%s\n", strerror(errno));
+			urls = more ? more : urls;
+			break;
+		}
+		urls = more;
+		(*count)++;
+	}
+	free(line);
+	if (f != stdin)
+		fclose(f);
+
+	if (!*count) {
+		fprintf(stderr, _("No URLs in %s\n"), path);
+		free(urls);
+		return NULL;
+	}
+	return urls;
+}
+
+static
+void
+free_job(struct job *job)
+{
+	if (job->fd != -1)
+		close(job->fd);
+	free(job->url);
+	free(job);
+}
+
+/* The next job to run, waiting for one if more are to come.  It is taken
+   off the queue, for the worker to free once it is done: a daemon that
+   runs for weeks holds on to no more than what is still waiting. */
+static
+struct job *
+next_job(batch_t *b)
+{
+	struct job *job = NULL;
+
+	pthread_mutex_lock(&b->lock);
+	while (*b->run && !b->count && !b->closed)
+		pthread_cond_wait(&b->queued, &b->lock);
+	if (*b->run && b->count) {
+		job = b->jobs[0];
+		memmove(b->jobs, b->jobs + 1, --b->count * sizeof(*b->jobs));
+	}
+	pthread_mutex_unlock(&b->lock);
+
+	return job;
+}
+
+/* Tell whoever asked for the job how it is getting on */
+static
+void PRINTF_FUNC(2)
+report(const struct job *job, const char *format, ...)
+{
+	va_list params;
+
+	if (job->fd == -1)
+		return;
+
+	va_start(params, format);
+	ctlsock_vreply(job->fd, format, params);
+	va_end(params);
+}
+
+/* Whether the download worker id waits on is the smallest waiting.  Called
+   locked. */
+static
+int
+first(const batch_t *b, int id)
+{
+	off_t size = b->waiting[id];
+
+	for (int j = 0; j < b->conf->num_connections; j++) {
+		if (j == id || b->waiting[j] < 0)
+			continue;
+		if (b->waiting[j] < size || (b->waiting[j] == size && j < id))
+			return 0;
+	}
+	return 1;
+}
+
+/* Wait for a connection to come free, then take as many of those free as
+   the download wants: the smallest download waiting goes first, so that
+   small files are not held up behind large ones */
+static
+int
+take(batch_t *b, int id, int want, off_t size)
+{
+	int got;
+
+	pthread_mutex_lock(&b->lock);
+	b->waiting[id] = size;
+	while (!b->free || !first(b, id))
+		pthread_cond_wait(&b->freed, &b->lock);
+	b->waiting[id] = -1;
+	got = min(want, b->free);
+	b->free -= got;
+
+	/* What is left is for whoever is next */
+	pthread_cond_broadcast(&b->freed);
+	pthread_mutex_unlock(&b->lock);
+
+	return got;
+}
+
+static
+void
+give(batch_t *b, int n, int status)
+{
+	pthread_mutex_lock(&b->lock);
+	b->free += n;
+	b->status = max(b->status, status);
+	pthread_cond_broadcast(&b->freed);
+	pthread_mutex_unlock(&b->lock);
+}
+
+static
+void
+show(batch_t *b, axel_t *axel)
+{
+	if (!axel || !axel->message)
+		return;
+	pthread_mutex_lock(&b->print);
+	print_messages(axel);
+	fflush(stdout);
+	pthread_mutex_unlock(&b->print);
+}
+
+/* How many connections a download is worth: no piece of it smaller than
+   the least worth a connection of its own */
+static
+int
+wanted(const axel_t *axel)
+{
+	if (!axel->conn[0].supported || axel->size == LLONG_MAX)
+		return 1;
+
+	off_t n = min(axel->size / MIN_CHUNK_WORTH,
+		      (off_t)axel->conf->num_connections);
+	return max(1, (int)n);
+}
+
+/* Whether a name can be had: the rule set_filename() goes by, that of a
+   file there is nothing or a download to resume, and one not being fetched
+   by another worker.  Called with the naming lock. */
+static
+int
+name_free(const batch_t *b, const axel_t *axel, const char *fn)
+{
+	char statefn[MAX_STRING + 3];
+
+	for (int j = 0; j < b->conf->num_connections; j++)
+		if (!strcmp(b->names[j], fn))
+			return 0;
+
+	snprintf(statefn, sizeof(statefn), "%s.st", fn);
+	if (!access(fn, F_OK))
+		return axel->conn[0].supported && !access(statefn, F_OK);
+	return access(statefn, F_OK) != 0;
+}
+
+/* Set the download up under the name it is to have.  The name is picked and
+   the file made in one go, for two downloads of the same name to end up
+   under two names. */
+static
+int
+open_download(batch_t *b, int id, axel_t *axel)
+{
+	char *s = axel->filename;
+	int ok;
+
+	if (*b->dir) {
+		char path[MAX_STRING];
+
+		if ((size_t)snprintf(path, sizeof(path), "%s/%s", b->dir,
+				     axel->filename) < sizeof(path))
+			strlcpy(axel->filename, path, sizeof(axel->filename));
+		else
+			*s = '\0';
+	}
+	/* With room left for a number after it */
+	s += strlen(s);
+	if (s == axel->filename ||
+	    s - axel->filename >= (ptrdiff_t)sizeof(axel->filename) - 12) {
+		axel_message(axel, _("Filename too long!"));
+		return 0;
+	}
+
+	pthread_mutex_lock(&b->naming);
+	for (int i = 0; !name_free(b, axel, axel->filename); i++)
+		snprintf(s, axel->filename + sizeof(axel->filename) - s,
+			 ".%i", i);
+	ok = axel_open(axel);
+	if (ok)
+		strlcpy(b->names[id], axel->filename, sizeof(b->names[id]));
+	pthread_mutex_unlock(&b->naming);
+
+	return ok;
+}
+
+static
+void
+fetch(batch_t *b, int id, struct job *job)
+{
+	/* A copy of its own, as a download writes to its conf */
+	conf_t conf = *b->conf;
+	axel_t *axel;
+	search_t s;
+	int got = 0, status = 2;
+	char hsize[32];
+	double next = 0;
+
+	if (manifest_named(job->url)) {
+		axel = manifest_new(&conf, job->url);
+	} else {
+		memset(&s, 0, sizeof(s));
+		strlcpy(s.url, job->url, sizeof(s.url));
+		axel = axel_new(&conf, 1, &s);
+	}
+	show(b, axel);
+	if (!axel || axel->ready == -1)
+		goto out;
+
+	got = take(b, id, wanted(axel), axel->size);
+	if (!*b->run || !axel_conn_resize(axel, got) ||
+	    !open_download(b, id, axel)) {
+		show(b, axel);
+		goto out;
+	}
+	show(b, axel);
+	report(job, "started %d %s\n", job->id, axel->filename);
+	axel_start(axel);
+	axel->start_byte = axel->bytes_done;
+
+	while (!axel->ready && *b->run) {
+		axel_do(axel);
+		show(b, axel);
+		if (axel_gettime() >= next) {
+			report(job, "progress %d %jd %jd %lld\n", job->id,
+			       (intmax_t)axel->bytes_done,
+			       (intmax_t)axel->size, axel->bytes_per_second);
+			next = axel_gettime() + 1;
+		}
+	}
+	status = axel->bad_checksum ? 1 : axel->ready == 1 ? 0 : 2;
+
+ out:
+	pthread_mutex_lock(&b->print);
+	if (!status) {
+		axel_size_human(hsize, sizeof(hsize), axel->size);
+		printf(_("Downloaded %s (%s)\n"), axel->filename, hsize);
+		report(job, "done %d %s\n", job->id, axel->filename);
+	} else {
+		printf(_("Failed to download %s\n"), job->url);
+		report(job, "failed %d %d\n", job->id, status);
+	}
+	fflush(stdout);
+	pthread_mutex_unlock(&b->print);
+
+	axel_close(axel);
+	pthread_mutex_lock(&b->naming);
+	*b->names[id] = '\0';
+	pthread_mutex_unlock(&b->naming);
+	give(b, got, status);
+}
+
+static
+void *
+worker(void *arg)
+{
+	struct worker *w = arg;
+	struct job *job;
+
+	while ((job = next_job(w->batch))) {
+		fetch(w->batch, w->id, job);
+		free_job(job);
+	}
+
+	return NULL;
+}
+
+batch_t *
+batch_new(conf_t *conf, const char *dir, const int *run)
+{
+	int workers = conf->num_connections;
+	batch_t *b;
+	struct stat st;
+
+	if (*dir && (stat(dir, &st) || !S_ISDIR(st.st_mode))) {
+		fprintf(stderr, _("With a list of URLs, -o names a "
+				  "directory\n"));
+		return NULL;
+	}
+	if (*conf->control_socket) {
+		fprintf(stderr, _("--control retunes one download, not a "
+				  "batch of them\n"));
+		return NULL;
+	}
+
+	b = calloc(1, sizeof(*b));
+	if (!b)
+		goto nomem;
+	b->conf = conf;
+	b->dir = dir;
+	b->run = run;
+	b->free = workers;
+	b->waiting = malloc(workers * sizeof(*b->waiting));
+	b->names = calloc(workers, sizeof(*b->names));
+	b->w = calloc(workers, sizeof(*b->w));
+	b->threads = calloc(workers, sizeof(*b->threads));
+	if (!b->waiting || !b->names || !b->w || !b->threads)
+		goto nomem;
+	for (int i = 0; i < workers; i++)
+		b->waiting[i] = -1;
+
+	/* One limit for the lot, the way a speed group shares one between
+	   processes; without speed groups, one for each download */
+#ifdef HAVE_SHM_OPEN
+	if (conf->max_speed && !*conf->speed_group) {
+		snprintf(conf->speed_group, sizeof(conf->speed_group),
+			 "batch-%ld", (long)getpid());
+		b->own_group = true;
+	}
+#endif
+
+	pthread_mutex_init(&b->lock, NULL);
+	pthread_mutex_init(&b->naming, NULL);
+	pthread_mutex_init(&b->print, NULL);
+	pthread_cond_init(&b->queued, NULL);
+	pthread_cond_init(&b->freed, NULL);
+
+	for (; b->started < workers; b->started++) {
+		b->w[b->started].batch = b;
+		b->w[b->started].id = b->started;
+		if (pthread_create(&b->threads[b->started], NULL, worker,
+				   &b->w[b->started]))
+			break;
+	}
+	if (!b->started) {
+		fprintf(stderr, _("pthread error!!!\n"));
+		b->closed = true;
+		batch_finish(b);
+		return NULL;
+	}
+
+	return b;
+
+ nomem:
+	fprintf(stderr, "%s\n", strerror(errno));
+	if (b) {
+		free(b->waiting);
+		free(b->names);
+		free(b->w);
+		free(b->threads);
+		free(b);
+	}
+	return NULL;
+}
+
+int
+batch_add(batch_t *b, const char *url, int fd)
+{
+	struct job *job = calloc(1, sizeof(*job)), **more;
+	int id = -1;
+
+	if (!job)
+		return -1;
+	job->url = strdup(url);
+	job->fd = fd == -1 ? -1 : fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (!job->url || (fd != -1 && job->fd == -1))
+		goto fail;
+
+	pthread_mutex_lock(&b->lock);
+	more = realloc(b->jobs, (b->count + 1) * sizeof(*b->jobs));
+	if (more) {
+		b->jobs = more;
+		b->jobs[b->count++] = job;
+		id = job->id = ++b->ids;
+		pthread_cond_signal(&b->queued);
+	}
+	pthread_mutex_unlock(&b->lock);
+	if (id != -1)
+		return id;
+
+ fail:
+	free_job(job);
+	return -1;
+}
+
+int
+batch_finish(batch_t *b)
+{
+	int status;
+
+	pthread_mutex_lock(&b->lock);
+	b->closed = true;
+	pthread_cond_broadcast(&b->queued);
+	pthread_mutex_unlock(&b->lock);
+
+	for (int i = 0; i < b->started; i++)
+		pthread_join(b->threads[i], NULL);
+
+	/* Anything never started did not get downloaded either */
+	if (b->count)
+		b->status = max(b->status, 2);
+	status = b->status;
+
+	if (b->own_group)
+		shbucket_unlink(b->conf->speed_group);
+	for (int i = 0; i < b->count; i++)
+		free_job(b->jobs[i]);
+	free(b->jobs);
+	free(b->waiting);
+	free(b->names);
+	free(b->w);
+	free(b->threads);
+	pthread_cond_destroy(&b->freed);
+	pthread_cond_destroy(&b->queued);
+	pthread_mutex_destroy(&b->print);
+	pthread_mutex_destroy(&b->naming);
+	pthread_mutex_destroy(&b->lock);
+	free(b);
+
+	return status;
+}
+
+int
+batch_run(conf_t *conf, const char *list, const char *dir, const int *run)
+{
+	batch_t *b;
+	char **urls;
+	int count, status = 1;
+
+	urls = read_list(list, &count);
+	if (!urls)
+		return 1;
+
+	b = batch_new(conf, dir, run);
+	if (b) {
+		for (int i = 0; i < count; i++)
+			if (batch_add(b, urls[i], -1) == -1)
+				fprintf(stderr, "%s\n", strerror(errno));
+		status = batch_finish(b);
+	}
+
+	for (int i = 0; i < count; i++)
+		free(urls[i]);
+	free(urls);
+
+	return status;
+}
@@ -0,0 +1,85 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Running a list of downloads in one process */
+
+#ifndef AXEL_BATCH_H
+#define AXEL_BATCH_H
+
+typedef struct batch batch_t;
+
+/* Start a batch of downloads, with no downloads in it yet.
+ *
+ * The downloads share the one process, and with it what it has learnt of
+ * each host's address and TLS session.  They also share a budget of
+ * conf->num_connections connections: as many downloads run at once as
+ * there are connections for, each given what is free of those its size is
+ * worth, and the smallest of those waiting goes first.  With max_speed set
+ * and no speed group, the limit is for all of them together.  The files go
+ * to the directory dir, if it is not empty.  Downloads stop, and no more
+ * are started, once *run is 0.
+ *
+ * Returns NULL after saying why it could not. */
+batch_t *batch_new(conf_t *conf, const char *dir, const int *run);
+
+/* Queue the download of url, which may name a Metalink or zsync file
+ * instead.  Unless fd is -1, a copy of it is told of the download, one line
+ * at a time:
+ *
+ *   started ID FILE
+ *   progress ID BYTES-DONE SIZE BYTES-PER-SECOND	(once a second)
+ *   done ID FILE
+ *   failed ID STATUS
+ *
+ * where STATUS is what axel would have exited with.  Returns the download's
+ * ID, counting from 1, or -1 if it cannot be queued.  Safe to call from
+ * any thread. */
+int batch_add(batch_t *b, const char *url, int fd);
+
+/* Wait for what is queued to be downloaded, or for *run to drop to 0, and
+ * free the batch.  Returns the status to exit with: 0 if every download
+ * finished, else the worst of what axel would have exited with for each
+ * of them. */
+int batch_finish(batch_t *b);
+
+/* Download every URL listed in the file called list, one to a line, or on
+ * standard input if that is "-", as one batch; blank lines and those
+ * starting with # are skipped.  Returns as batch_finish() does. */
+int batch_run(conf_t *conf, const char *list, const char *dir,
+	      const int *run);
+
+#endif				/* AXEL_BATCH_H */
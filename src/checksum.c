@@ -0,0 +1,312 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Checking a download against the checksum it was given, or the server's */
+
+#include "config.h"
+#include "axel.h"
+#include "checksum.h"
+#include "events.h"
+
+/* How many times a piece is fetched before it is given up on */
+#define PIECE_TRIES	5
+
+void
+checksum_setup(axel_t *axel)
+{
+	const http_t *http = axel->conn[0].http;
+	char value[MAX_STRING];
+
+	if (*axel->conf->checksum) {
+		digest_spec_parse(&axel->checksum, axel->conf->checksum);
+		return;
+	}
+	if (!conn_is_http(&axel->conn[0]))
+		return;
+
+	if (http_header_value(http, "Repr-Digest:", value, sizeof(value)) &&
+	    digest_spec_header(&axel->checksum, value, 1))
+		return;
+	if (http_header_value(http, "Digest:", value, sizeof(value)))
+		digest_spec_header(&axel->checksum, value, 0);
+}
+
+/* Get ready to check the pieces a Metalink has hashes for, passing those
+   that match on to the digest of the whole file, if there is one.  Returns
+   0 if they cannot be checked. */
+static
+int
+open_pieces(axel_t *axel)
+{
+	const metalink_t *ml = axel->metalink;
+
+	axel->pieces = pieces_new(ml->piece_algo, ml->piece_hashes,
+				  ml->piece_hash_len, ml->pieces,
+				  ml->piece_len, axel->filename, axel->size);
+	axel->piece_url = calloc(ml->pieces, sizeof(*axel->piece_url));
+	if (!axel->pieces || !axel->piece_url) {
+		axel_message(axel, _("Can't check %s pieces: %s"),
+			     ml->piece_algo, strerror(errno));
+		return 0;
+	}
+
+	if (axel->digest)
+		pieces_feed(axel->pieces, digest_written, axel->digest);
+	writer_watch(axel->writer, pieces_written, axel->pieces);
+
+	return 1;
+}
+
+int
+checksum_open(axel_t *axel)
+{
+	int given = *axel->conf->checksum || axel->metalink;
+	/* What a pipe has had cannot be fetched again, nor read back: only
+	   the whole file is checked, hashed as it goes down the pipe */
+	int pieces = axel->metalink && axel->metalink->pieces && !axel->stream;
+	ranges_t none;
+
+	if (!axel->checksum.len && !pieces)
+		return 1;
+	if (axel->size == LLONG_MAX) {
+		axel_message(axel, _("The size of the file is unknown, "
+				     "its checksum will not be checked"));
+		return !given;
+	}
+
+	if (axel->checksum.len) {
+		axel->digest = digest_new(&axel->checksum, axel->stream ?
+					  NULL : axel->filename, axel->size);
+		if (!axel->digest) {
+			if (given || axel->conf->verbose > 0)
+				axel_message(axel,
+					     _("Can't check a %s checksum: %s"),
+					     axel->checksum.algo,
+					     strerror(errno));
+			return !given;
+		}
+		writer_watch(axel->writer, digest_written, axel->digest);
+	}
+	if (pieces && !open_pieces(axel))
+		return 0;
+
+	/* With pieces, the digest has only what they pass on */
+	ranges_init(&none);
+	if ((axel->digest &&
+	     digest_start(axel->digest,
+			  axel->pieces ? &none : &axel->done) == -1) ||
+	    (axel->pieces && pieces_start(axel->pieces, &axel->done) == -1)) {
+		axel_message(axel, "%s", strerror(errno));
+		return 0;
+	}
+
+	return 1;
+}
+
+void
+checksum_source(axel_t *axel, url_t *url, off_t start, off_t end)
+{
+	off_t len;
+
+	if (!axel->piece_url)
+		return;
+	len = axel->metalink->piece_len;
+	for (off_t i = start / len; i * len < end; i++)
+		axel->piece_url[i] = url;
+}
+
+/* Stop going back to a mirror that sent a bad piece, unless it is the last
+   one left.  The connections on it are moved to the mirrors that are left,
+   whatever they were doing, for none of them to fetch the piece again from
+   where it came from. */
+static
+void
+drop_mirror(axel_t *axel, url_t *url)
+{
+	url_t *u = axel->next_url;
+
+	do {
+		if (u->next == url && u != url) {
+			u->next = url->next;
+			if (axel->next_url == url)
+				axel->next_url = url->next;
+			axel_message(axel, _("Dropping mirror %s"), url->text);
+			break;
+		}
+		u = u->next;
+	} while (u != axel->next_url);
+
+	/* The last one left, or one already dropped whose connections were
+	   busy setting up the last time */
+	if (axel->next_url == url)
+		return;
+
+	for (int i = 0; i < axel->conf->num_connections; i++) {
+		conn_t *conn = &axel->conn[i];
+
+		if (conn->url != url || pthread_mutex_trylock(&conn->lock))
+			continue;
+		if (!conn->state) {
+			conn_disconnect(conn);
+			conn_set(conn, axel->next_url->text);
+			conn->url = axel->next_url;
+			axel->next_url = axel->next_url->next;
+			if (conn->currentbyte < conn->lastbyte)
+				events_check(axel, i);
+		}
+		pthread_mutex_unlock(&conn->lock);
+	}
+}
+
+/* Put the connections with nothing to do onto what is to be fetched again */
+static
+void
+refetch(axel_t *axel)
+{
+	for (int i = 0; i < axel->conf->num_connections; i++) {
+		conn_t *conn = &axel->conn[i];
+
+		/* Busy setting up, and so not idle */
+		if (pthread_mutex_trylock(&conn->lock))
+			continue;
+		if (!conn->enabled && !conn->state &&
+		    conn->currentbyte >= conn->lastbyte) {
+			axel_reactivate(axel, i);
+			if (conn->currentbyte < conn->lastbyte)
+				events_check(axel, i);
+		}
+		pthread_mutex_unlock(&conn->lock);
+	}
+}
+
+void
+checksum_poll(axel_t *axel)
+{
+	off_t len, start, before;
+	int fails, again = 0;
+	size_t i;
+
+	while (axel->pieces && (fails = pieces_failed(axel->pieces, &i))) {
+		if (fails >= PIECE_TRIES) {
+			axel_message(axel, _("Piece %zu is still corrupt after "
+					     "%d tries, giving up"), i, fails);
+			axel->bad_checksum = true;
+			axel->ready = -1;
+			return;
+		}
+
+		len = axel->metalink->piece_len;
+		start = i * len;
+		before = ranges_total(&axel->done);
+		if (ranges_remove(&axel->done, start,
+				  min(start + len, axel->size)) == -1 ||
+		    writer_mark(axel->writer, start,
+				min(start + len, axel->size), 0) == -1) {
+			axel_message(axel, "%s", strerror(errno));
+			axel->ready = -1;
+			return;
+		}
+		axel->bytes_done -= before - ranges_total(&axel->done);
+		axel_message(axel, _("Piece %zu is corrupt, fetching it again"),
+			     i);
+		if (axel->piece_url[i])
+			drop_mirror(axel, axel->piece_url[i]);
+		again = 1;
+	}
+
+	if (again)
+		refetch(axel);
+}
+
+int
+checksum_verify(axel_t *axel)
+{
+	char hex[2 * DIGEST_MAX + 1], want[2 * DIGEST_MAX + 1];
+
+	if (axel->pieces) {
+		if (pieces_wait(axel->pieces) == -1) {
+			axel_message(axel, _("Can't check the pieces: %s"),
+				     strerror(errno));
+			axel->bad_checksum = true;
+			return 0;
+		}
+		checksum_poll(axel);
+		if (axel->ready == -1)
+			return 0;
+		if (axel->bytes_done < axel->size)
+			return -1;
+		if (!axel->digest) {
+			axel_message(axel, _("All %zu pieces verified"),
+				     axel->metalink->pieces);
+			return 1;
+		}
+	}
+	if (!axel->digest)
+		return 1;
+
+	switch (digest_result(axel->digest, hex, sizeof(hex))) {
+	case 1:
+		axel_message(axel, _("%s checksum verified"),
+			     axel->checksum.algo);
+		return 1;
+	case 0:
+		for (size_t i = 0; i < axel->checksum.len; i++)
+			snprintf(want + 2 * i, 3, "%02x",
+				 axel->checksum.want[i]);
+		axel_message(axel, _("%s checksum mismatch: expected %s, "
+				     "got %s"), axel->checksum.algo, want, hex);
+		break;
+	default:
+		axel_message(axel, _("Can't verify the %s checksum: %s"),
+			     axel->checksum.algo, strerror(errno));
+	}
+	axel->bad_checksum = true;
+
+	return 0;
+}
+
+void
+checksum_close(axel_t *axel)
+{
+	/* The pieces feed the digest, so they go first */
+	pieces_free(axel->pieces);
+	axel->pieces = NULL;
+	free(axel->piece_url);
+	axel->piece_url = NULL;
+	digest_free(axel->digest);
+	axel->digest = NULL;
+}
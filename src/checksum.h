@@ -0,0 +1,67 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Checking a download against the checksum it was given, or the server's */
+
+#ifndef AXEL_CHECKSUM_H
+#define AXEL_CHECKSUM_H
+
+/* Take note of what to check the file against: the --checksum given, else
+ * a digest the server sent along with the file, if any */
+void checksum_setup(axel_t *axel);
+
+/* Start hashing what the writer writes, and, with a Metalink that has
+ * hashes for its pieces, checking each piece as it is done.  Returns 0 if a
+ * checksum that was asked for cannot be checked. */
+int checksum_open(axel_t *axel);
+
+/* [start, end) was fetched from url: a piece it turns out to spoil is one
+ * to fetch from elsewhere */
+void checksum_source(axel_t *axel, url_t *url, off_t start, off_t end);
+
+/* Fetch the pieces found corrupt since the last call again, from other
+ * mirrors; or give up on the download if one is corrupt every time. */
+void checksum_poll(axel_t *axel);
+
+/* Once it is all written: returns 1 if the file is as it should be, or
+ * there was nothing to check it against, 0 if it is not, and -1 if some
+ * pieces of it turned out corrupt and are to be fetched again. */
+int checksum_verify(axel_t *axel);
+
+void checksum_close(axel_t *axel);
+
+#endif				/* AXEL_CHECKSUM_H */
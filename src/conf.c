@@ -106,6 +106,117 @@ parse_protocol(conf_t *conf, const char *value)
 	return 1;
 }
 
+int
+conf_set(conf_t *conf, const char *key, char *value)
+{
+	void *dst;
+
+	/* String options */
+	MATCH
+		KEY(default_filename)
+		KEY(http_proxy)
+		KEY(no_proxy)
+		KEY(speed_group)
+	else
+		goto num_keys;
+
+	/* Save string option */
+	strlcpy(dst, value, MAX_STRING);
+
+	/* Convert no_proxy to a 0-separated-and-00-terminated list.. */
+	if (dst == conf->no_proxy) {
+		int i;
+
+		for (i = 0; conf->no_proxy[i]; i++)
+			if (conf->no_proxy[i] == ',')
+				conf->no_proxy[i] = 0;
+		conf->no_proxy[i + 1] = 0;
+	}
+	return 1;
+
+	/* Numeric options */
+ num_keys:
+	MATCH
+		KEY(strip_cgi_parameters)
+		KEY(save_state_interval)
+		KEY(connection_timeout)
+		KEY(reconnect_delay)
+		KEY(max_redirect)
+		KEY(buffer_size)
+		KEY(write_buffers)
+		KEY(stream_buffers)
+		KEY(sequential)
+		KEY(verbose)
+		KEY(insecure)
+		KEY(no_clobber)
+		KEY(location_trusted)
+		KEY(http2)
+		KEY(http3)
+		KEY(mptcp)
+		KEY(search_timeout)
+		KEY(search_threads)
+		KEY(search_amount)
+		KEY(search_top)
+	else
+		goto long_num_keys;
+
+	/* Save numeric option */
+	*((int *)dst) = atoi(value);
+	return 1;
+
+	/* Long numeric options */
+ long_num_keys:
+	MATCH
+		KEY(max_speed)
+	else
+		goto other_keys;
+
+	/* Save numeric option */
+	*((unsigned long long *)dst) = strtoull(value, NULL, 10);
+	return 1;
+
+ other_keys:
+	/* Option defunct but shouldn't be an error */
+	if (strcmp(key, "speed_type") == 0)
+		return 1;
+	else if (strcmp(key, "interfaces") == 0) {
+		if (parse_interfaces(conf, value))
+			return 1;
+	} else if (strcmp(key, "progress_style") == 0) {
+		if (parse_progress_style(conf, value))
+			return 1;
+	} else if (strcmp(key, "use_protocol") == 0) {
+		if (parse_protocol(conf, value))
+			return 1;
+	} else if (strcmp(key, "num_connections") == 0) {
+		int num = atoi(value);
+
+		if (num <= USHRT_MAX) {
+			conf->num_connections = num;
+			return 1;
+		}
+
+		fprintf(stderr,
+			_("Requested too many connections, max is %i\n"),
+			USHRT_MAX);
+	} else if (!strcmp(key, "user_agent")) {
+		conf_hdr_make(conf->add_header[HDR_USER_AGENT],
+			      "User-Agent", DEFAULT_USER_AGENT);
+		return 1;
+	} else if (!strcmp(key, "netrc")) {
+		conf_netrc_set(conf, value);
+		return 1;
+	}
+#if 0
+	/* FIXME broken code */
+	get_config_number(add_header_count);
+	for (int i = 0; i < conf->add_header_count; i++)
+		get_config_string(add_header[i]);
+#endif
+
+	return 0;
+}
+
 int
 conf_loadfile(conf_t *conf, const char *file)
 {
@@ -119,7 +230,6 @@ conf_loadfile(conf_t *conf, const char *file)
 
 	while (!feof(fp)) {
 		char *tmp, *value = NULL;
-		void *dst;
 
 		line++;
 
@@ -142,97 +252,15 @@ conf_loadfile(conf_t *conf, const char *file)
 		/* Skip the "=" and any spaces following it */
 		while (isspace(*++tmp));	/* XXX isspace('\0') is false */
 		value = tmp;
-		/* Get to the end of the value string */
-		while (*tmp && !isspace(*tmp))
-			tmp++;
+		/* The rest of the line, which for a list is more than one
+		   word, less the blanks at its end */
+		tmp += strlen(tmp);
+		while (tmp > value && isspace(tmp[-1]))
+			tmp--;
 		*tmp = '\0';
 
-		/* String options */
-		MATCH
-			KEY(default_filename)
-			KEY(http_proxy)
-			KEY(no_proxy)
-		else
-			goto num_keys;
-
-		/* Save string option */
-		strlcpy(dst, value, MAX_STRING);
-		continue;
-
-		/* Numeric options */
- num_keys:
-		MATCH
-			KEY(strip_cgi_parameters)
-			KEY(save_state_interval)
-			KEY(connection_timeout)
-			KEY(reconnect_delay)
-			KEY(max_redirect)
-			KEY(buffer_size)
-			KEY(max_speed)
-			KEY(verbose)
-			KEY(insecure)
-			KEY(no_clobber)
-			KEY(location_trusted)
-			KEY(search_timeout)
-			KEY(search_threads)
-			KEY(search_amount)
-			KEY(search_top)
-		else
-			goto long_num_keys;
-
-		/* Save numeric option */
-		*((int *)dst) = atoi(value);
-		continue;
-
-		/* Long numeric options */
- long_num_keys:
-		MATCH
-			KEY(max_speed)
-		else
-			goto other_keys;
-
-		/* Save numeric option */
-		*((unsigned long long *)dst) = strtoull(value, NULL, 10);
-		continue;
-
- other_keys:
-		/* Option defunct but shouldn't be an error */
-		if (strcmp(key, "speed_type") == 0)
-			continue;
-		else if (strcmp(key, "interfaces") == 0) {
-			if (parse_interfaces(conf, value))
-				continue;
-		} else if (strcmp(key, "progress_style") == 0) {
-			if (parse_progress_style(conf, value))
-				continue;
-		} else if (strcmp(key, "use_protocol") == 0) {
-			if (parse_protocol(conf, value))
-				continue;
-		} else if (strcmp(key, "num_connections") == 0) {
-			int num = atoi(value);
-
-			if (num <= USHRT_MAX) {
-				conf->num_connections = num;
-				continue;
-			}
-
-			fprintf(stderr,
-				_("Requested too many connections, max is %i\n"),
-				USHRT_MAX);
-		} else if (!strcmp(key, "user_agent")) {
-			conf_hdr_make(conf->add_header[HDR_USER_AGENT],
-				      "User-Agent", DEFAULT_USER_AGENT);
-			continue;
-		} else if (!strcmp(key, "netrc")) {
-			conf_netrc_set(conf, value);
+		if (conf_set(conf, key, value))
 			continue;
-		}
-#if 0
-		/* FIXME broken code */
-		get_config_number(add_header_count);
-		for (int i = 0; i < conf->add_header_count; i++)
-			get_config_string(add_header[i]);
-#endif
 
 error:
 		fprintf(stderr, _("Error in %s line %i.\n"), file, line);
@@ -300,7 +328,6 @@ int
 conf_init(conf_t *conf)
 {
 	char *s2;
-	int i;
 
 	/* Set defaults */
 	memset(conf, 0, sizeof(conf_t));
@@ -316,6 +343,8 @@ conf_init(conf_t *conf)
 	conf->max_redirect = MAX_REDIRECT;
 	conf->io_timeout = DEFAULT_IO_TIMEOUT;
 	conf->buffer_size = 5120;
+	conf->write_buffers = 64;
+	conf->stream_buffers = 1024;
 	conf->max_speed = 0;
 	conf->verbose = 1;
 	conf->insecure = 0;
@@ -364,12 +393,6 @@ conf_init(conf_t *conf)
 			return 0;
 	}
 
-	/* Convert no_proxy to a 0-separated-and-00-terminated list.. */
-	for (i = 0; conf->no_proxy[i]; i++)
-		if (conf->no_proxy[i] == ',')
-			conf->no_proxy[i] = 0;
-	conf->no_proxy[i + 1] = 0;
-
 	return 1;
 }
 
@@ -427,6 +450,7 @@ parse_interfaces(conf_t *conf, char *s)
 {
 	char *s2;
 	axel_if_t *iface;
+	bool last;
 
 	iface = conf->interfaces->next;
 	while (iface != conf->interfaces) {
@@ -455,12 +479,12 @@ parse_interfaces(conf_t *conf, char *s)
 		while ((*s == ' ' || *s == '\t') && *s)
 			s++;
 		for (s2 = s; *s2 != ' ' && *s2 != '\t' && *s2; s2++) ;
+		last = !*s2;
 		*s2 = 0;
-		if (*s < '0' || *s > '9')
-			get_if_ip(iface->text, sizeof(iface->text), s);
-		else
-			strlcpy(iface->text, s, sizeof(iface->text));
-		s = s2 + 1;
+		/* Devices are looked up as each connection is made, for
+		   whichever address family it is */
+		strlcpy(iface->text, s, sizeof(iface->text));
+		s = last ? s2 : s2 + 1;
 		if (*s) {
 			iface->next = malloc(sizeof(*iface));
 			if (!iface->next)
@@ -50,6 +50,12 @@ typedef struct {
 	char default_filename[MAX_STRING];
 	char http_proxy[MAX_STRING];
 	char no_proxy[MAX_STRING];
+	char speed_group[MAX_STRING];
+	char checksum[MAX_STRING];	/* ALGO:HEX, from the command line */
+	char seed[MAX_STRING];	/* an older version of the file, for zsync */
+	char input[MAX_STRING];	/* a list of URLs to download, from -i */
+	char daemon_socket[MAX_STRING];	/* where to take downloads from */
+	char control_socket[MAX_STRING];	/* where to be retuned from */
 	uint16_t num_connections;
 	int strip_cgi_parameters;
 	int save_state_interval;
@@ -57,11 +63,17 @@ typedef struct {
 	int reconnect_delay;
 	int max_redirect;
 	int buffer_size;
+	int write_buffers;
+	int stream_buffers;
+	int sequential;
 	unsigned long long max_speed;
 	int verbose;
 	int insecure;
 	int no_clobber;
 	int location_trusted;
+	int http2;
+	int http3;
+	int mptcp;
 	enum {
 		AXEL_PROGRESS_STYLE_CLASSIC,
 		AXEL_PROGRESS_STYLE_ALTERNATIVE,
@@ -88,6 +100,9 @@ typedef struct {
 	bool untrusted_host;
 } conf_t;
 
+/* Set one of the keys an axelrc may set, to value as it would be written
+ * there.  Returns 0 if there is no such key, or value is no good for it. */
+int conf_set(conf_t *conf, const char *key, char *value);
 int conf_loadfile(conf_t *conf, const char *file);
 int conf_init(conf_t *conf);
 void conf_free(conf_t *conf);
@@ -47,6 +47,8 @@
 
 #include "config.h"
 #include "axel.h"
+#include "file.h"
+#include "multirange.h"
 #include "hash.h"
 
 /**
@@ -78,6 +80,9 @@ conn_set(conn_t *conn, const char *set_url)
 		} else if (strncmp(set_url, "https", proto_len) == 0) {
 			conn->proto = PROTO_HTTPS;
 			conn->port = PROTO_HTTPS_PORT;
+		} else if (strncmp(set_url, "file", proto_len) == 0) {
+			conn->proto = PROTO_FILE;
+			return file_set(conn, sep + 3);
 		} else {
 			fprintf(stderr, _("Unsupported protocol\n"));
 			return 0;
@@ -177,6 +182,8 @@ scheme_from_proto(int proto)
 		return "http://";
 	case PROTO_HTTPS:
 		return "https://";
+	case PROTO_FILE:
+		return "file://";
 	}
 }
 
@@ -188,6 +195,10 @@ conn_url(char *dst, size_t len, conn_t *conn)
 
 	const char *scheme = scheme_from_proto(conn->proto);
 
+	if (PROTO_IS_FILE(conn->proto))
+		return snprintf(dst, len, "%s%s%s", scheme, conn->dir,
+				conn->file);
+
 	size_t scheme_len = strlcpy(dst, scheme, len);
 	if (scheme_len > len)
 		return -1;
@@ -231,6 +242,9 @@ conn_init(conn_t *conn)
 	char *proxy = conn->conf->http_proxy, *host = conn->conf->no_proxy;
 	int i;
 
+	if (PROTO_IS_FILE(conn->proto))
+		return file_open(conn);
+
 	if (*conn->conf->http_proxy == 0) {
 		proxy = NULL;
 	} else if (*conn->conf->no_proxy != 0) {
@@ -250,6 +264,10 @@ conn_init(conn_t *conn)
 		conn->ftp->local_if = conn->local_if;
 		conn->ftp->ftp_mode = FTP_PASSIVE;
 		conn->ftp->tcp.ai_family = conn->conf->ai_family;
+		conn->ftp->tcp.mptcp = conn->conf->mptcp;
+		conn->ftp->data_tcp.mptcp = conn->conf->mptcp;
+		conn->ftp->tcp.insecure = conn->conf->insecure;
+		conn->ftp->data_tcp.insecure = conn->conf->insecure;
 		if (!ftp_connect(conn->ftp, conn->proto, conn->host, conn->port,
 				 conn->user, conn->pass,
 				 conn->conf->io_timeout)) {
@@ -264,7 +282,11 @@ conn_init(conn_t *conn)
 		}
 	} else {
 		conn->http->local_if = conn->local_if;
+		conn->http->h2 = conn->conf->http2;
+		conn->http->h3 = conn->conf->http3;
 		conn->http->tcp.ai_family = conn->conf->ai_family;
+		conn->http->tcp.mptcp = conn->conf->mptcp;
+		conn->http->tcp.insecure = conn->conf->insecure;
 		if (!http_connect(conn->http, conn->proto, proxy, conn->host,
 				  conn->port, conn->user, conn->pass,
 				  conn->conf->io_timeout)) {
@@ -286,6 +308,9 @@ conn_init(conn_t *conn)
 int
 conn_setup(conn_t *conn)
 {
+	if (PROTO_IS_FILE(conn->proto))
+		return file_setup(conn);
+
 	if (conn->ftp->tcp.fd <= 0 && conn->http->tcp.fd <= 0)
 		if (!conn_init(conn))
 			return 0;
@@ -311,6 +336,10 @@ conn_setup(conn_t *conn)
 		conn->http->firstbyte =
 			conn->supported ? conn->currentbyte : -1;
 		conn->http->lastbyte = conn->lastbyte;
+		conn->http->if_range = conn->if_range;
+		conn->http->nranges = conn->multi ? conn->multi->count : 0;
+		if (conn->http->nranges)
+			conn->http->ranges = conn->multi->r;
 
 		abuf_setup(conn->http->request, 2048);
 		http_get(conn->http, s);
@@ -327,9 +356,27 @@ conn_setup(conn_t *conn)
 	return 1;
 }
 
+/* Whether a reply carries the validator its range was asked for with */
+static
+int
+same_validator(const http_t *http)
+{
+	char value[MAX_STRING];
+
+	if (http_header_value(http, "ETag:", value, sizeof(value)) &&
+	    !strcmp(value, http->if_range))
+		return 1;
+	return http_header_value(http, "Last-Modified:", value,
+				 sizeof(value)) && !strcmp(value, http->if_range);
+}
+
 int
 conn_exec(conn_t *conn)
 {
+	/* There is nothing to ask a file for */
+	if (PROTO_IS_FILE(conn->proto))
+		return 1;
+
 	if (PROTO_IS_FTP(conn->proto) && !conn->proxy) {
 		if (!ftp_command(conn->ftp, "RETR %s", conn->file))
 			return 0;
@@ -338,6 +385,21 @@ conn_exec(conn_t *conn)
 		abuf_setup(conn->http->headers, 1024);
 		if (!http_exec(conn->http))
 			return 0;
+
+		/* The whole file where a piece of it was asked for: with an
+		   If-Range the file changed, unless the reply still matches it
+		   and the Range was merely ignored; either way it is only of any
+		   use from the start */
+		if (conn->http->status == 200 && conn->http->firstbyte >= 0 &&
+		    conn->http->if_range && *conn->http->if_range &&
+		    !same_validator(conn->http)) {
+			conn->changed = true;
+			return 0;
+		}
+		if (conn->http->nranges)
+			return multirange_reply(conn);
+		if (conn->http->status == 200 && conn->http->firstbyte > 0)
+			return 0;
 		return conn->http->status / 100 == 2;
 	}
 }
@@ -436,6 +498,13 @@ conn_redirect(conn_t *conn, const char *url)
 	if (!conn_set(conn, url))
 		return 0;
 
+	/* A server has no business reading the files of whoever asks it */
+	if (PROTO_IS_FILE(conn->proto)) {
+		fprintf(stderr, _("Redirected to a local file, "
+				  "not following it.\n"));
+		return 0;
+	}
+
 	if (conn->conf->location_trusted || conn->conf->untrusted_host)
 		return 1;
 
@@ -460,6 +529,12 @@ conn_info(conn_t *conn)
 		return conn_info_ftp(conn);
 	}
 
+	/* Opening the file found out all there is to know */
+	if (PROTO_IS_FILE(conn->proto)) {
+		conn_disconnect(conn);
+		return 1;
+	}
+
 	char s[1005];
 	long long int i = 0;
 
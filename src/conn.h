@@ -45,15 +45,18 @@
 #define AXEL_CONN_H
 
 #define PROTO_SECURE_MASK	(1<<0)	/* bit 0 - 0 = insecure, 1 = secure */
-#define PROTO_PROTO_MASK	(1<<1)	/* bit 1 = 0 = ftp,      1 = http   */
+#define PROTO_PROTO_MASK	(3<<1)	/* bits 1-2 = 0 = ftp, 1 = http, 2 = file */
 
 #define PROTO_INSECURE		(0<<0)
 #define PROTO_SECURE		(1<<0)
 #define PROTO_PROTO_FTP		(0<<1)
 #define PROTO_PROTO_HTTP	(1<<1)
+#define PROTO_PROTO_FILE	(2<<1)
 
 #define PROTO_IS_FTP(proto) \
 	(((proto) & PROTO_PROTO_MASK) == PROTO_PROTO_FTP)
+#define PROTO_IS_FILE(proto) \
+	(((proto) & PROTO_PROTO_MASK) == PROTO_PROTO_FILE)
 #define PROTO_IS_SECURE(proto) \
 	(((proto) & PROTO_SECURE_MASK) == PROTO_SECURE)
 
@@ -69,6 +72,8 @@
 #define PROTO_HTTPS		(PROTO_PROTO_HTTP|PROTO_SECURE)
 #define	PROTO_HTTPS_PORT	443
 
+#define PROTO_FILE		(PROTO_PROTO_FILE|PROTO_INSECURE)
+
 #define PROTO_DEFAULT          PROTO_HTTP
 #define PROTO_DEFAULT_PORT     PROTO_HTTP_PORT
 
@@ -103,12 +108,29 @@ typedef struct {
 	int last_transfer;
 	char *message;
 	char *local_if;
+	int iface;		/* which of the download's interfaces, if any */
+	url_t *url;		/* the mirror it is set to */
+	const char *if_range;	/* what the file has to match, if anything */
+	bool changed;		/* and it did not */
+	struct multirange *multi;	/* when asking for several ranges */
+	int copy_to;		/* the output file:// data is copied to by the
+				   kernel, if not 0 */
+	off_t copy_ahead;	/* asked of the kernel and not yet taken */
 
 	bool state;
 	pthread_t setup_thread[1];
+	int wake_fd;		/* written to once the setup thread is done */
 	pthread_mutex_t lock;
 } conn_t;
 
+/* Whether a connection speaks HTTP: to the server, or to a proxy for it */
+static inline
+int
+conn_is_http(const conn_t *conn)
+{
+	return is_proto_http(conn->proto) || conn->proxy;
+}
+
 int conn_set(conn_t *conn, const char *set_url);
 int conn_url(char *dst, size_t len, conn_t *conn);
 void conn_disconnect(conn_t *conn);
@@ -0,0 +1,285 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* Retuning a running download over a socket */
+
+#include "config.h"
+#include "axel.h"
+#include "control.h"
+#include "ctlsock.h"
+#include "events.h"
+
+#define CONTROL_CLIENTS	4
+
+/* How often the socket is looked at, in ms */
+#define CONTROL_INTERVAL	100
+
+struct control {
+	axel_t *axel;
+	int fd;
+	ctlsock_t clients[CONTROL_CLIENTS];
+	int nclients;
+	wheel_timer_t timer;
+	uint16_t want;		/* connections asked for, 0 once there */
+	url_t **added;		/* mirrors given over the socket */
+	int nadded;
+};
+
+static
+void
+set_connections(struct control *c, int fd, const char *value)
+{
+	axel_t *axel = c->axel;
+	char *end;
+	long n = strtol(value, &end, 10);
+
+	if (*end || n < 1 || n > USHRT_MAX) {
+		ctlsock_reply(fd, "error bad number of connections\n");
+	} else if (n > 1 && !axel->conn[0].supported) {
+		ctlsock_reply(fd, "error the server sends the file whole\n");
+	} else {
+		/* Applied from the timer, once the setup threads allow */
+		c->want = n;
+		ctlsock_reply(fd, "ok\n");
+	}
+}
+
+static
+void
+set_speed(struct control *c, int fd, const char *value)
+{
+	axel_t *axel = c->axel;
+	char *end;
+	unsigned long long rate = strtoull(value, &end, 10);
+
+	if (*end || *value == '-') {
+		ctlsock_reply(fd, "error bad speed\n");
+		return;
+	}
+	if (axel->speed_group) {
+		ctlsock_reply(fd, "error the speed group sets the limit\n");
+		return;
+	}
+
+	/* With the burst axel_start() gives it */
+	axel->conf->max_speed = rate;
+	throttle_init(&axel->throttle, rate,
+		      max((unsigned long long)axel->conf->buffer_size,
+			  rate / 20), axel_gettime());
+	ctlsock_reply(fd, "ok\n");
+}
+
+/* Put a mirror in the ring, for the next connection that starts over to go
+   to */
+static
+void
+add_mirror(struct control *c, int fd, const char *value)
+{
+	axel_t *axel = c->axel;
+	url_t *u, **more;
+	conn_t *probe = calloc(1, sizeof(*probe));
+	int ok;
+
+	if (!probe) {
+		ctlsock_reply(fd, "error %s\n", strerror(errno));
+		return;
+	}
+	probe->conf = axel->conf;
+	ok = strlen(value) < sizeof(u->text) && conn_set(probe, value);
+	free(probe);
+	if (!ok) {
+		ctlsock_reply(fd, "error bad URL\n");
+		return;
+	}
+	more = realloc(c->added, (c->nadded + 1) * sizeof(*c->added));
+	if (more)
+		c->added = more;
+	u = more ? malloc(sizeof(*u)) : NULL;
+	if (!u) {
+		ctlsock_reply(fd, "error %s\n", strerror(errno));
+		return;
+	}
+	c->added[c->nadded++] = u;
+
+	strlcpy(u->text, value, sizeof(u->text));
+	u->next = axel->next_url->next;
+	axel->next_url->next = u;
+	axel->next_url = u;
+	ctlsock_reply(fd, "ok\n");
+}
+
+static
+const char *
+conn_status(conn_t *conn)
+{
+	const char *status;
+
+	if (pthread_mutex_trylock(&conn->lock))
+		return "connecting";
+	if (conn->enabled)
+		status = "active";
+	else if (conn->state)
+		status = "connecting";
+	else if (conn->currentbyte < conn->lastbyte)
+		status = "waiting";
+	else
+		status = "idle";
+	pthread_mutex_unlock(&conn->lock);
+
+	return status;
+}
+
+static
+void
+stats(struct control *c, int fd)
+{
+	axel_t *axel = c->axel;
+
+	ctlsock_reply(fd, "total %jd %jd %lld %d %llu\n",
+		      (intmax_t)axel->bytes_done, (intmax_t)axel->size,
+		      axel->bytes_per_second, axel->conf->num_connections,
+		      axel->conf->max_speed);
+	for (int i = 0; i < axel->conf->num_connections; i++) {
+		conn_t *conn = &axel->conn[i];
+
+		ctlsock_reply(fd, "conn %d %s %jd %jd %s\n", i,
+			      conn_status(conn), (intmax_t)conn->currentbyte,
+			      (intmax_t)conn->lastbyte,
+			      conn->url ? conn->url->text : axel->url->text);
+	}
+	ctlsock_reply(fd, "ok\n");
+}
+
+static
+void
+command(void *arg, int fd, char *line)
+{
+	struct control *c = arg;
+	char *value = line + strcspn(line, " ");
+
+	if (*value)
+		*value++ = '\0';
+	value += strspn(value, " ");
+
+	if (!strcmp(line, "connections"))
+		set_connections(c, fd, value);
+	else if (!strcmp(line, "speed"))
+		set_speed(c, fd, value);
+	else if (!strcmp(line, "mirror"))
+		add_mirror(c, fd, value);
+	else if (!strcmp(line, "stats"))
+		stats(c, fd);
+	else
+		ctlsock_reply(fd, "error unknown command\n");
+}
+
+static
+void
+poll_socket(wheel_timer_t *t)
+{
+	struct control *c = t->data;
+	axel_t *axel = c->axel;
+	int fd;
+
+	while (c->nclients < CONTROL_CLIENTS &&
+	       (fd = ctlsock_accept(c->fd)) != -1) {
+		c->clients[c->nclients].fd = fd;
+		c->clients[c->nclients++].len = 0;
+	}
+	for (int i = c->nclients - 1; i >= 0; i--) {
+		if (ctlsock_read(&c->clients[i], command, c))
+			continue;
+		close(c->clients[i].fd);
+		c->clients[i] = c->clients[--c->nclients];
+	}
+
+	if (c->want) {
+		int ret = events_resize(axel, c->want);
+
+		if (ret)
+			c->want = 0;
+		if (ret < 0)
+			axel_message(axel, _("Error changing the number of "
+					     "connections: %s"),
+				     strerror(errno));
+	}
+
+	wheel_add(&axel->timers, t, axel->timers.tick + CONTROL_INTERVAL);
+}
+
+int
+control_open(axel_t *axel)
+{
+	struct control *c = calloc(1, sizeof(*c));
+
+	if (!c)
+		return 0;
+
+	c->fd = ctlsock_listen(axel->conf->control_socket, CONTROL_CLIENTS);
+	if (c->fd == -1) {
+		free(c);
+		return 0;
+	}
+	fcntl(c->fd, F_SETFL, O_NONBLOCK);
+
+	c->axel = axel;
+	c->timer.fire = poll_socket;
+	c->timer.data = c;
+	wheel_add(&axel->timers, &c->timer,
+		  axel->timers.tick + CONTROL_INTERVAL);
+	axel->control = c;
+
+	return 1;
+}
+
+void
+control_close(axel_t *axel)
+{
+	struct control *c = axel->control;
+
+	if (!c)
+		return;
+
+	for (int i = 0; i < c->nclients; i++)
+		close(c->clients[i].fd);
+	close(c->fd);
+	unlink(axel->conf->control_socket);
+	for (int i = 0; i < c->nadded; i++)
+		free(c->added[i]);
+	free(c->added);
+	free(c);
+	axel->control = NULL;
+}
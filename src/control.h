@@ -0,0 +1,61 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* Retuning a running download over a socket */
+
+#ifndef AXEL_CONTROL_H
+#define AXEL_CONTROL_H
+
+/* Listen on the Unix socket conf->control_socket names, for the download
+ * to be retuned while it runs.  It is looked at from the timer wheel, so
+ * this comes after events_init().  One command to a line, each answered
+ * with "ok" or "error ...":
+ *
+ *   connections N	grow or shrink the download to N connections
+ *   speed N		limit it to N bytes a second, 0 for no limit
+ *   mirror URL		have the next connection to start over use URL
+ *   stats		"total BYTES SIZE SPEED CONNECTIONS MAX-SPEED", and
+ *			"conn I STATUS CURRENT-BYTE LAST-BYTE URL" for each
+ *			connection, before the "ok"
+ *
+ * Returns 0 after saying why it could not. */
+int control_open(axel_t *axel);
+
+/* Close the socket, and free the mirrors it was given, once the setup
+ * threads that might use them are gone */
+void control_close(axel_t *axel);
+
+#endif				/* AXEL_CONTROL_H */
@@ -0,0 +1,155 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* Line-at-a-time Unix sockets, to be told what to do over */
+
+#include "config.h"
+#include <sys/un.h>
+#include "axel.h"
+#include "ctlsock.h"
+
+int
+ctlsock_listen(const char *path, int backlog)
+{
+	struct sockaddr_un sa = { .sun_family = AF_UNIX };
+	struct stat st;
+	mode_t mask;
+	int fd, ret;
+
+	if (strlcpy(sa.sun_path, path, sizeof(sa.sun_path))
+	    >= sizeof(sa.sun_path)) {
+		fprintf(stderr, _("Socket name too long: %s\n"), path);
+		return -1;
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd == -1)
+		goto err;
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	/* A socket left behind by one that died is taken over */
+	if (!connect(fd, (struct sockaddr *)&sa, sizeof(sa))) {
+		fprintf(stderr, _("Something is listening on %s already\n"),
+			path);
+		close(fd);
+		errno = EADDRINUSE;
+		return -1;
+	}
+	if (errno == ECONNREFUSED && !lstat(path, &st) && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	/* For nobody but the user to connect to */
+	mask = umask(077);
+	ret = bind(fd, (struct sockaddr *)&sa, sizeof(sa));
+	umask(mask);
+	if (ret == -1 || listen(fd, backlog) == -1)
+		goto err;
+
+	return fd;
+
+ err:
+	fprintf(stderr, "%s: %s\n", path, strerror(errno));
+	if (fd != -1)
+		close(fd);
+	return -1;
+}
+
+int
+ctlsock_accept(int lfd)
+{
+	int fd = accept(lfd, NULL, NULL);
+
+	if (fd == -1)
+		return -1;
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	return fd;
+}
+
+int
+ctlsock_read(ctlsock_t *c, void (*command)(void *arg, int fd, char *line),
+	     void *arg)
+{
+	ssize_t n = read(c->fd, c->line + c->len, sizeof(c->line) - c->len);
+	char *nl;
+
+	if (n <= 0)
+		return n == -1 && (errno == EINTR || errno == EAGAIN);
+	c->len += n;
+
+	while ((nl = memchr(c->line, '\n', c->len))) {
+		size_t used = nl - c->line + 1;
+
+		*nl = '\0';
+		if (nl > c->line && nl[-1] == '\r')
+			nl[-1] = '\0';
+		if (*c->line)
+			command(arg, c->fd, c->line);
+		c->len -= used;
+		memmove(c->line, c->line + used, c->len);
+	}
+
+	/* A line that long is no command anybody knows */
+	if (c->len == sizeof(c->line)) {
+		ctlsock_reply(c->fd, "error line too long\n");
+		return 0;
+	}
+	return 1;
+}
+
+void
+ctlsock_vreply(int fd, const char *format, va_list params)
+{
+	char line[MAX_STRING + 64];
+	int len;
+
+	len = vsnprintf(line, sizeof(line), format, params);
+	if (len >= (int)sizeof(line)) {
+		len = sizeof(line) - 1;
+		line[len - 1] = '\n';
+	}
+	send(fd, line, len, MSG_NOSIGNAL);
+}
+
+void
+ctlsock_reply(int fd, const char *format, ...)
+{
+	va_list params;
+
+	va_start(params, format);
+	ctlsock_vreply(fd, format, params);
+	va_end(params);
+}
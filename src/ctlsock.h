@@ -0,0 +1,72 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* Line-at-a-time Unix sockets, to be told what to do over */
+
+#ifndef AXEL_CTLSOCK_H
+#define AXEL_CTLSOCK_H
+
+/* One end of a connection to such a socket, with what it has sent short of
+ * a whole line */
+typedef struct {
+	int fd;
+	size_t len;
+	char line[MAX_STRING + 16];
+} ctlsock_t;
+
+/* Listen on a Unix socket at path, that only the user can connect to.  One
+ * left there by a process that died is replaced; one something answers on
+ * is not, nor is anything else that is not a socket.  Returns the socket,
+ * or -1 after saying why not. */
+int ctlsock_listen(const char *path, int backlog);
+
+/* Take a connection on the socket listening at lfd, one that neither reads
+ * nor replies wait on.  Returns it, or -1 if there is none to take. */
+int ctlsock_accept(int lfd);
+
+/* Read what there is to read from c, calling command for each whole line,
+ * with any \r before the \n taken off and blank lines left out.  Returns 0
+ * once the other end has gone, or has sent a line too long to take. */
+int ctlsock_read(ctlsock_t *c, void (*command)(void *arg, int fd, char *line),
+		 void *arg);
+
+/* Send a line, or as much of it as fits, without waiting on a connection
+ * from ctlsock_accept(): an end that does not read loses lines rather than
+ * holding the sender up. */
+void ctlsock_reply(int fd, const char *format, ...) PRINTF_FUNC(2);
+void ctlsock_vreply(int fd, const char *format, va_list params);
+
+#endif				/* AXEL_CTLSOCK_H */
@@ -0,0 +1,134 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* Taking downloads from other processes over a socket */
+
+#include "config.h"
+#include <poll.h>
+#include "axel.h"
+#include "batch.h"
+#include "ctlsock.h"
+#include "daemon.h"
+
+#define DAEMON_CLIENTS	16
+
+struct daemon {
+	batch_t *batch;
+	int *run;
+};
+
+/* Act on one line from a client */
+static
+void
+command(void *arg, int fd, char *line)
+{
+	struct daemon *d = arg;
+	int id;
+
+	if (!strncmp(line, "get ", 4)) {
+		for (line += 4; *line == ' '; line++) ;
+		id = *line ? batch_add(d->batch, line, fd) : -1;
+		if (id != -1)
+			ctlsock_reply(fd, "queued %d\n", id);
+		else
+			ctlsock_reply(fd, "error %s\n",
+				      *line ? strerror(errno) : "no URL");
+	} else if (!strcmp(line, "stop")) {
+		ctlsock_reply(fd, "stopping\n");
+		*d->run = 0;
+	} else {
+		ctlsock_reply(fd, "error unknown command\n");
+	}
+}
+
+int
+daemon_run(conf_t *conf, const char *path, const char *dir, int *run)
+{
+	struct pollfd fds[1 + DAEMON_CLIENTS];
+	ctlsock_t clients[DAEMON_CLIENTS];
+	struct daemon d = { .run = run };
+	int nclients = 0, lfd;
+
+	lfd = ctlsock_listen(path, DAEMON_CLIENTS);
+	if (lfd == -1)
+		return 1;
+	fds[0].events = POLLIN;
+
+	d.batch = batch_new(conf, dir, run);
+	if (!d.batch) {
+		close(lfd);
+		unlink(path);
+		return 1;
+	}
+	printf(_("Waiting for downloads on %s\n"), path);
+	fflush(stdout);
+
+	while (*run) {
+		/* The timeout is for a signal to be noticed */
+		for (int i = 0; i < nclients; i++) {
+			fds[1 + i].fd = clients[i].fd;
+			fds[1 + i].events = POLLIN;
+		}
+		fds[0].fd = nclients < DAEMON_CLIENTS ? lfd : -1;
+		if (poll(fds, 1 + nclients, 1000) <= 0)
+			continue;
+
+		for (int i = nclients - 1; i >= 0; i--) {
+			if (!fds[1 + i].revents ||
+			    ctlsock_read(&clients[i], command, &d))
+				continue;
+			close(clients[i].fd);
+			clients[i] = clients[--nclients];
+		}
+		if (fds[0].revents & POLLIN) {
+			int fd = ctlsock_accept(lfd);
+
+			if (fd != -1) {
+				clients[nclients].fd = fd;
+				clients[nclients++].len = 0;
+			}
+		}
+	}
+
+	for (int i = 0; i < nclients; i++)
+		close(clients[i].fd);
+	close(lfd);
+	unlink(path);
+
+	/* What is running stops, its state saved to resume from */
+	batch_finish(d.batch);
+	return 0;
+}
@@ -0,0 +1,54 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* Taking downloads from other processes over a socket */
+
+#ifndef AXEL_DAEMON_H
+#define AXEL_DAEMON_H
+
+/* Listen on the Unix socket at path, and download what is asked for there
+ * as one batch (see batch.h), until *run drops to 0.  The protocol is one
+ * line at a time, each way:
+ *
+ *   get URL	queue a download, answered with "queued ID", and followed by
+ *		what batch_add() says of the download as it goes
+ *   stop	stop the daemon, leaving what is unfinished to resume
+ *
+ * anything else being answered with "error ...".  A client that goes away
+ * leaves its downloads running.  Returns the status to exit with. */
+int daemon_run(conf_t *conf, const char *path, const char *dir, int *run);
+
+#endif				/* AXEL_DAEMON_H */
@@ -0,0 +1,453 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Checking the download against a checksum as it is written */
+
+#include "config.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#ifdef HAVE_WOLFSSL
+#include <wolfssl/options.h>
+#include <wolfssl/wolfcrypt/settings.h>
+#include <wolfssl/openssl/evp.h>
+#elif defined(HAVE_SSL)
+#include <openssl/evp.h>
+#endif
+
+#include "ranges.h"
+#include "digest.h"
+
+/* How much of what was written out of order is read back at a time */
+#define READ_BACK	(1 << 20)
+
+int
+digest_spec_parse(digest_spec_t *spec, const char *arg)
+{
+	const char *hex = strchr(arg, ':');
+	size_t n;
+
+	memset(spec, 0, sizeof(*spec));
+	if (!hex || hex == arg || (size_t)(hex - arg) >= sizeof(spec->algo))
+		return -1;
+
+	/* SHA-256 is sha256 to OpenSSL */
+	for (const char *p = arg; p < hex; p++)
+		if (*p != '-' || strncasecmp(arg, "sha-", 4))
+			spec->algo[strlen(spec->algo)] = tolower(*p);
+
+	n = strlen(++hex);
+	if (!n || n % 2 || n / 2 > DIGEST_MAX ||
+	    strspn(hex, "0123456789abcdefABCDEF") != n)
+		return -1;
+	for (size_t i = 0; i < n / 2; i++) {
+		char byte[3] = { hex[2 * i], hex[2 * i + 1], 0 };
+
+		spec->want[i] = strtoul(byte, NULL, 16);
+	}
+	spec->len = n / 2;
+
+	return 0;
+}
+
+/* Decode n characters of base64 at s into out, padded or not.  Returns the
+   number of bytes, or -1 if it is not base64 or there are more than max. */
+static
+ssize_t
+unbase64(const char *s, size_t n, unsigned char *out, size_t max)
+{
+	static const char set[] =
+	    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	uint32_t bits = 0;
+	size_t len = 0;
+	int have = 0;
+
+	while (n && s[n - 1] == '=')
+		n--;
+	for (size_t i = 0; i < n; i++) {
+		const char *c = s[i] ? strchr(set, s[i]) : NULL;
+
+		if (!c)
+			return -1;
+		bits = bits << 6 | (c - set);
+		have += 6;
+		if (have >= 8) {
+			if (len == max)
+				return -1;
+			have -= 8;
+			out[len++] = bits >> have;
+		}
+	}
+
+	return len;
+}
+
+int
+digest_spec_header(digest_spec_t *spec, const char *value, int structured)
+{
+	static const struct {
+		const char *name, *algo;
+		size_t len;
+	} known[] = {
+		{ "sha-256", "sha256", 32 },
+		{ "sha-512", "sha512", 64 },
+	};
+	int found = 0;
+
+	memset(spec, 0, sizeof(*spec));
+	for (const char *p = value; *p; p += *p == ',') {
+		p += strspn(p, " \t");
+		const char *key = p;
+		size_t name = strcspn(key, "=,");
+		const char *v = key + name + 1;
+		size_t n = strcspn(v, ",; \t\r\n");
+
+		p += strcspn(p, ",");
+		if (name >= (size_t)(p - key))
+			continue;
+
+		/* A byte sequence, in a structured field: :base64: */
+		if (structured) {
+			if (n < 2 || *v != ':' || v[n - 1] != ':')
+				continue;
+			v++;
+			n -= 2;
+		}
+
+		for (size_t i = 0; i < sizeof(known) / sizeof(*known); i++) {
+			unsigned char want[DIGEST_MAX];
+
+			if (strlen(known[i].name) != name ||
+			    strncasecmp(key, known[i].name, name) ||
+			    known[i].len <= spec->len ||
+			    unbase64(v, n, want, sizeof(want)) !=
+			    (ssize_t)known[i].len)
+				continue;
+			strcpy(spec->algo, known[i].algo);
+			memcpy(spec->want, want, known[i].len);
+			spec->len = known[i].len;
+			found = 1;
+		}
+	}
+
+	return found;
+}
+
+#ifdef HAVE_SSL
+
+struct digest {
+	const EVP_MD *md;
+	EVP_MD_CTX *ctx;
+	unsigned char want[DIGEST_MAX], got[DIGEST_MAX];
+	size_t len;
+	int fd;
+	off_t size;
+	off_t cursor;		/* how far it is hashed */
+	ranges_t written;	/* what is on disk, past it or not */
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t work;	/* there is some to read back, or stop */
+	pthread_cond_t done;	/* it is all hashed, or it never will be */
+	bool started, stop;
+	bool reading;		/* the thread has the hash */
+	bool finished;
+	int err;
+	char *buf;
+};
+
+digest_t *
+digest_new(const digest_spec_t *spec, const char *filename, off_t size)
+{
+	const EVP_MD *md = EVP_get_digestbyname(spec->algo);
+	digest_t *d;
+
+	if (!md || (size_t)EVP_MD_size(md) != spec->len) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return NULL;
+	d->md = md;
+	d->len = spec->len;
+	memcpy(d->want, spec->want, spec->len);
+	d->size = size;
+	ranges_init(&d->written);
+	pthread_mutex_init(&d->lock, NULL);
+	pthread_cond_init(&d->work, NULL);
+	pthread_cond_init(&d->done, NULL);
+	d->fd = filename ? open(filename, O_RDONLY) : -1;
+	d->ctx = EVP_MD_CTX_new();
+	d->buf = malloc(READ_BACK);
+	if ((filename && d->fd == -1) || !d->ctx || !d->buf ||
+	    !EVP_DigestInit_ex(d->ctx, md, NULL)) {
+		int err = filename && d->fd == -1 ? errno : ENOMEM;
+
+		digest_free(d);
+		errno = err;
+		return NULL;
+	}
+
+	return d;
+}
+
+/* Where what is on disk from the cursor on stops.  Called locked. */
+static
+off_t
+available(const digest_t *d)
+{
+	range_t gap;
+
+	return ranges_gap(&d->written, d->cursor, d->size, &gap) ?
+	    gap.start : d->size;
+}
+
+/* The hash has moved on.  Called locked. */
+static
+void
+advance(digest_t *d)
+{
+	if (d->cursor == d->size && !d->finished) {
+		EVP_DigestFinal_ex(d->ctx, d->got, NULL);
+		d->finished = true;
+	} else if (available(d) > d->cursor) {
+		pthread_cond_signal(&d->work);
+	}
+	/* For digest_result() to see whether it is stuck, too */
+	pthread_cond_broadcast(&d->done);
+}
+
+void
+digest_written(void *arg, const void *data, off_t offset, size_t len)
+{
+	digest_t *d = arg;
+
+	pthread_mutex_lock(&d->lock);
+	if (!d->reading && !d->err && offset == d->cursor) {
+		EVP_DigestUpdate(d->ctx, data, len);
+		d->cursor += len;
+	} else if (ranges_add(&d->written, offset, offset + len) == -1) {
+		d->err = errno;
+		pthread_cond_broadcast(&d->done);
+	}
+	advance(d);
+	pthread_mutex_unlock(&d->lock);
+}
+
+/* Read len bytes at offset, however many goes it takes */
+static
+int
+read_back(digest_t *d, off_t offset, size_t len)
+{
+	for (size_t got = 0; got < len;) {
+		ssize_t n = pread(d->fd, d->buf + got, len - got,
+				  offset + got);
+
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return n ? errno : EIO;
+		got += n;
+	}
+	return 0;
+}
+
+/* Hashes what was written ahead of the cursor once the cursor gets to it,
+   a READ_BACK at a time, so that the writer is never kept waiting long */
+static
+void *
+digest_thread(void *arg)
+{
+	digest_t *d = arg;
+
+	pthread_mutex_lock(&d->lock);
+	for (;;) {
+		while (!d->stop && !d->err && !d->finished &&
+		       available(d) == d->cursor)
+			pthread_cond_wait(&d->work, &d->lock);
+		if (d->stop || d->err || d->finished)
+			break;
+
+		off_t from = d->cursor;
+		size_t len = available(d) - from;
+
+		if (len > READ_BACK)
+			len = READ_BACK;
+		d->reading = true;
+		pthread_mutex_unlock(&d->lock);
+
+		int err = read_back(d, from, len);
+		if (!err)
+			EVP_DigestUpdate(d->ctx, d->buf, len);
+
+		pthread_mutex_lock(&d->lock);
+		d->reading = false;
+		if (err) {
+			d->err = err;
+			pthread_cond_broadcast(&d->done);
+			break;
+		}
+		d->cursor = from + len;
+		advance(d);
+	}
+	pthread_mutex_unlock(&d->lock);
+
+	return NULL;
+}
+
+int
+digest_start(digest_t *d, const ranges_t *done)
+{
+	for (size_t i = 0; i < done->count; i++)
+		if (ranges_add(&d->written, done->r[i].start,
+			       done->r[i].end) == -1)
+			return -1;
+
+	int err = pthread_create(&d->thread, NULL, digest_thread, d);
+	if (err) {
+		errno = err;
+		return -1;
+	}
+	d->started = true;
+
+	pthread_mutex_lock(&d->lock);
+	advance(d);
+	pthread_mutex_unlock(&d->lock);
+
+	return 0;
+}
+
+int
+digest_result(digest_t *d, char *hex, size_t len)
+{
+	int ret;
+
+	pthread_mutex_lock(&d->lock);
+	while (!d->finished && !d->err) {
+		/* Nothing more is coming: some of it was never written */
+		if (!d->reading && available(d) == d->cursor) {
+			d->err = EIO;
+			break;
+		}
+		pthread_cond_wait(&d->done, &d->lock);
+	}
+
+	if (d->err) {
+		errno = d->err;
+		ret = -1;
+	} else {
+		ret = !memcmp(d->got, d->want, d->len);
+	}
+	if (len)
+		*hex = 0;
+	for (size_t i = 0; !d->err && i < d->len && 2 * i + 2 < len; i++)
+		snprintf(hex + 2 * i, 3, "%02x", d->got[i]);
+	pthread_mutex_unlock(&d->lock);
+
+	return ret;
+}
+
+void
+digest_free(digest_t *d)
+{
+	if (!d)
+		return;
+
+	if (d->started) {
+		pthread_mutex_lock(&d->lock);
+		d->stop = true;
+		pthread_cond_signal(&d->work);
+		pthread_mutex_unlock(&d->lock);
+		pthread_join(d->thread, NULL);
+	}
+
+	pthread_cond_destroy(&d->done);
+	pthread_cond_destroy(&d->work);
+	pthread_mutex_destroy(&d->lock);
+	if (d->fd != -1)
+		close(d->fd);
+	EVP_MD_CTX_free(d->ctx);
+	ranges_free(&d->written);
+	free(d->buf);
+	free(d);
+}
+
+#else				/* HAVE_SSL */
+
+digest_t *
+digest_new(const digest_spec_t *spec, const char *filename, off_t size)
+{
+	errno = ENOSYS;
+	return NULL;
+}
+
+int
+digest_start(digest_t *d, const ranges_t *done)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+void
+digest_written(void *d, const void *data, off_t offset, size_t len)
+{
+}
+
+int
+digest_result(digest_t *d, char *hex, size_t len)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+void
+digest_free(digest_t *d)
+{
+}
+
+#endif				/* HAVE_SSL */
@@ -0,0 +1,90 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Checking the download against a checksum as it is written */
+
+#ifndef AXEL_DIGEST_H
+#define AXEL_DIGEST_H
+
+#define DIGEST_MAX	64	/* bytes, as much as SHA-512 needs */
+
+/* What the file is meant to hash to, and with what */
+typedef struct {
+	char algo[16];		/* as OpenSSL names it */
+	unsigned char want[DIGEST_MAX];
+	size_t len;
+} digest_spec_t;
+
+/* The hash follows the file from its start: a block written where the hash
+ * has got to is hashed there and then, from memory, while one written
+ * further on is only noted, and read back from the file by a thread of the
+ * digest's own once the hash reaches it.  That covers what a resume found
+ * already done, too.  The last byte to land finishes it. */
+typedef struct digest digest_t;
+
+/* Read ALGO:HEX, as given with --checksum.  Returns 0, or -1 if it is not
+ * one. */
+int digest_spec_parse(digest_spec_t *spec, const char *arg);
+
+/* Pick the strongest digest the server offers in a Repr-Digest header, or
+ * in the older Digest header when structured is 0.  Returns 1 if there is
+ * one to check against, 0 if not. */
+int digest_spec_header(digest_spec_t *spec, const char *value,
+		       int structured);
+
+/* Get ready to hash size bytes of filename, or, with no filename, of
+ * bytes that are all to be written in order.  Returns NULL with errno set:
+ * ENOSYS if there is no hashing in this build, EINVAL if the algorithm is
+ * unknown or the checksum the wrong length for it. */
+digest_t *digest_new(const digest_spec_t *spec, const char *filename,
+		     off_t size);
+
+/* Start following the writes, with what done says is on disk already.
+ * Returns 0, or -1 with errno set. */
+int digest_start(digest_t *d, const ranges_t *done);
+
+/* For writer_watch(): len bytes of data are now at offset in the file */
+void digest_written(void *d, const void *data, off_t offset, size_t len);
+
+/* Wait for the whole file to be hashed, and put the result in hex, which
+ * has room for len characters.  Returns 1 if it matches, 0 if it does not,
+ * and -1 with errno set if the file could not be read back. */
+int digest_result(digest_t *d, char *hex, size_t len);
+
+void digest_free(digest_t *d);
+
+#endif				/* AXEL_DIGEST_H */
@@ -0,0 +1,213 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Remembering what host names resolved to */
+
+#include "config.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dnscache.h"
+
+/* Enough for the hosts of a download's mirrors, or of the downloads a
+   batch runs at once */
+#define DNSCACHE_SIZE	32
+
+struct entry {
+	char *host, *port;
+	int family, socktype, flags;
+	time_t stamp;
+	struct addrinfo *ai;
+};
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct entry cache[DNSCACHE_SIZE];
+
+static
+time_t
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+void
+dnscache_free(struct addrinfo *ai)
+{
+	int cancel;
+
+	/* For a setup thread not to be cancelled inside free() */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel);
+	while (ai) {
+		struct addrinfo *next = ai->ai_next;
+
+		free(ai);
+		ai = next;
+	}
+	pthread_setcancelstate(cancel, NULL);
+}
+
+/* A list of our own, each entry with its address in the same allocation,
+   for dnscache_free() to free */
+static
+struct addrinfo *
+copy(const struct addrinfo *ai)
+{
+	struct addrinfo *head = NULL, **tail = &head;
+
+	for (; ai; ai = ai->ai_next) {
+		struct addrinfo *c = malloc(sizeof(*c) + ai->ai_addrlen);
+
+		if (!c) {
+			dnscache_free(head);
+			return NULL;
+		}
+		*c = *ai;
+		c->ai_addr = (struct sockaddr *)(c + 1);
+		memcpy(c->ai_addr, ai->ai_addr, ai->ai_addrlen);
+		c->ai_canonname = NULL;
+		c->ai_next = NULL;
+		*tail = c;
+		tail = &c->ai_next;
+	}
+	return head;
+}
+
+static
+int
+same(const struct entry *e, const char *host, const char *port,
+     const struct addrinfo *hints)
+{
+	return e->ai && !strcmp(e->host, host) && !strcmp(e->port, port) &&
+	    e->family == hints->ai_family &&
+	    e->socktype == hints->ai_socktype &&
+	    e->flags == hints->ai_flags;
+}
+
+static
+void
+forget(struct entry *e)
+{
+	free(e->host);
+	free(e->port);
+	dnscache_free(e->ai);
+	memset(e, 0, sizeof(*e));
+}
+
+/* Keep an answer, in place of an older one for the same question, else of
+   the oldest there is.  Called locked. */
+static
+void
+remember(const char *host, const char *port, const struct addrinfo *hints,
+	 struct addrinfo *ai)
+{
+	struct entry *e = &cache[0];
+
+	for (int i = 0; i < DNSCACHE_SIZE; i++) {
+		if (same(&cache[i], host, port, hints)) {
+			e = &cache[i];
+			break;
+		}
+		if (!cache[i].ai || cache[i].stamp < e->stamp)
+			e = &cache[i];
+	}
+	forget(e);
+
+	e->host = strdup(host);
+	e->port = strdup(port);
+	if (!e->host || !e->port) {
+		forget(e);
+		dnscache_free(ai);
+		return;
+	}
+	e->family = hints->ai_family;
+	e->socktype = hints->ai_socktype;
+	e->flags = hints->ai_flags;
+	e->stamp = now();
+	e->ai = ai;
+}
+
+int
+dnscache_lookup(const char *host, const char *port,
+		const struct addrinfo *hints, struct addrinfo **res)
+{
+	struct addrinfo *found;
+	int cancel, ret;
+
+	/* A setup thread can be cancelled at any instruction: not while it
+	   holds the lock, nor inside malloc(), or the next to want either
+	   would wait for good */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel);
+	pthread_mutex_lock(&lock);
+	for (int i = 0; i < DNSCACHE_SIZE; i++) {
+		if (same(&cache[i], host, port, hints) &&
+		    now() - cache[i].stamp < DNSCACHE_TTL) {
+			*res = copy(cache[i].ai);
+			pthread_mutex_unlock(&lock);
+			pthread_setcancelstate(cancel, NULL);
+			return *res ? 0 : EAI_MEMORY;
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	pthread_setcancelstate(cancel, NULL);
+
+	/* Not holding the others up while it asks, and a resolver that does
+	   not answer still times out */
+	ret = getaddrinfo(host, port, hints, &found);
+	if (ret)
+		return ret;
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel);
+	*res = copy(found);
+	freeaddrinfo(found);
+	if (*res) {
+		struct addrinfo *keep = copy(*res);
+
+		if (keep) {
+			pthread_mutex_lock(&lock);
+			remember(host, port, hints, keep);
+			pthread_mutex_unlock(&lock);
+		}
+	}
+	pthread_setcancelstate(cancel, NULL);
+	return *res ? 0 : EAI_MEMORY;
+}
@@ -0,0 +1,63 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Remembering what host names resolved to */
+
+#ifndef AXEL_DNSCACHE_H
+#define AXEL_DNSCACHE_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+/* How long an answer is used for before asking again, in seconds.  Longer
+ * than it takes to open a download's connections, or to reopen one that
+ * dropped; short enough for a batch of downloads to follow a host that
+ * moves. */
+#define DNSCACHE_TTL	60
+
+/* Resolve host and port as getaddrinfo() would, with the same answer as
+ * last time if the same was asked less than DNSCACHE_TTL seconds ago.
+ * Failures are not remembered.  Returns 0, with a list to free with
+ * dnscache_free(), or a getaddrinfo() error.  Safe to call from any
+ * thread, and to cancel one in, as a setup thread is on a timeout. */
+int dnscache_lookup(const char *host, const char *port,
+		    const struct addrinfo *hints, struct addrinfo **res);
+
+void dnscache_free(struct addrinfo *ai);
+
+#endif				/* AXEL_DNSCACHE_H */
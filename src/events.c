@@ -0,0 +1,481 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Timed events of a download */
+
+#include "config.h"
+#include "axel.h"
+#include "control.h"
+#include "events.h"
+#include "file.h"
+#include "multirange.h"
+#include "stfile.h"
+#include "stream.h"
+
+/* How often the progress display is told to redraw, at most, in ms */
+#define REDRAW_INTERVAL 100
+
+/* How often the state file gets a checkpoint between saves, and a file read
+   as it comes is told how much of it there is, in ms */
+#define CHECKPOINT_INTERVAL 1000
+
+static void *setup_thread(void *);
+
+static
+unsigned long long
+ticks(double t)
+{
+	return t * 1000;
+}
+
+/* Each download has a pipe of its own, so that several of them in one
+   process only ever wake up for their own connections */
+static
+int
+open_wake_pipe(axel_t *axel)
+{
+	if (axel->wake_pipe[0] != -1)
+		return 0;
+
+	if (pipe(axel->wake_pipe) == -1)
+		return -1;
+
+	for (int i = 0; i < 2; i++) {
+		fcntl(axel->wake_pipe[i], F_SETFL, O_NONBLOCK);
+		fcntl(axel->wake_pipe[i], F_SETFD, FD_CLOEXEC);
+	}
+	return 0;
+}
+
+int
+events_fd(const axel_t *axel)
+{
+	return axel->wake_pipe[0];
+}
+
+/* Reap a connection's setup thread, if it has one left to reap.
+ *
+ * Joining a thread twice is undefined behaviour, and so is joining one that
+ * was never created.  The handle is zero until pthread_create() fills it in
+ * -- axel->conn is calloc'd, and the entries a state file grows it by are
+ * memset -- so zeroing it on the way out is what tells a thread still to be
+ * reaped from one that is already gone. */
+static
+void
+join_setup_thread(conn_t *conn)
+{
+	if (*conn->setup_thread == 0)
+		return;
+
+	pthread_join(*conn->setup_thread, NULL);
+	*conn->setup_thread = 0;
+}
+
+void
+events_start(axel_t *axel, int i)
+{
+	conn_t *conn = &axel->conn[i];
+
+	if (axel->conf->verbose >= 2)
+		axel_message(axel,
+			     _("Connection %i downloading from %s:%i using interface %s"),
+			     i, conn->host, conn->port, conn->local_if);
+
+	conn->state = true;
+	conn->wake_fd = axel->wake_pipe[1];
+	conn->copy_to = file_copy_to(axel, i);
+	conn->last_transfer = axel_gettime();
+	if (pthread_create(conn->setup_thread, NULL, setup_thread, conn)) {
+		axel_message(axel, _("pthread error!!!"));
+		axel->ready = -1;
+		return;
+	}
+
+	/* Time the setup out, unless the thread calls first */
+	wheel_add(&axel->timers, &axel->conn_timer[i],
+		  ticks(conn->last_transfer + axel->conf->reconnect_delay) + 1);
+}
+
+/* Start over on a connection that dropped, from the next mirror along */
+static
+void
+restart(axel_t *axel, int i)
+{
+	conn_t *conn = &axel->conn[i];
+
+	/* Wait for termination of this thread */
+	join_setup_thread(conn);
+
+	conn_set(conn, axel->next_url->text);
+	conn->url = axel->next_url;
+	axel->next_url = axel->next_url->next;
+	iface_assign(axel, i);
+	events_start(axel, i);
+}
+
+/* Whatever connection t watches has done something, or was meant to by now */
+static
+void
+check_conn(wheel_timer_t *t)
+{
+	axel_t *axel = t->data;
+	conn_t *conn = &axel->conn[t->id];
+	double now = axel_gettime();
+
+	/* Busy setting up: the thread writes to the pipe when it is done, and
+	   this is only in case that goes astray */
+	if (pthread_mutex_trylock(&conn->lock)) {
+		wheel_add(&axel->timers, t,
+			  ticks(now + axel->conf->reconnect_delay));
+		return;
+	}
+
+	if (conn->enabled) {
+		double deadline = conn->last_transfer +
+		    axel->conf->connection_timeout;
+
+		if (now <= deadline) {
+			wheel_add(&axel->timers, t, ticks(deadline) + 1);
+			goto out;
+		}
+		if (axel->conf->verbose)
+			axel_message(axel, _("Connection %i timed out"), t->id);
+		conn_disconnect(conn);
+	}
+
+	if (conn->currentbyte >= conn->lastbyte)
+		goto out;
+
+	/* Nothing more of it is of any use; the state file stays, for the
+	   next run to find it does not match */
+	if (conn->changed) {
+		axel_message(axel, _("The file has changed on the server, "
+				     "run again to start over"));
+		axel->ready = -1;
+		goto out;
+	}
+	if (conn->multi && conn->multi->refused)
+		multirange_refused(axel, t->id);
+
+	if (!conn->state) {
+		restart(axel, t->id);
+	} else if (now > conn->last_transfer + axel->conf->reconnect_delay) {
+		pthread_cancel(*conn->setup_thread);
+		conn->state = false;
+		join_setup_thread(conn);
+		wheel_add(&axel->timers, t, 0);
+	} else {
+		wheel_add(&axel->timers, t,
+			  ticks(conn->last_transfer +
+				axel->conf->reconnect_delay) + 1);
+	}
+ out:
+	pthread_mutex_unlock(&conn->lock);
+}
+
+void
+events_check(axel_t *axel, int i)
+{
+	wheel_add(&axel->timers, &axel->conn_timer[i], 0);
+}
+
+static
+void
+save_state(wheel_timer_t *t)
+{
+	axel_t *axel = t->data;
+
+	/* Should the writer have failed, axel_do() finds out next */
+	stfile_save(axel);
+	wheel_add(&axel->timers, t, ticks(axel_gettime()) +
+		  1000ull * axel->conf->save_state_interval);
+}
+
+static
+void
+checkpoint(wheel_timer_t *t)
+{
+	axel_t *axel = t->data;
+
+	stfile_checkpoint(axel);
+	stream_publish(axel);
+	wheel_add(&axel->timers, t, ticks(axel_gettime()) +
+		  CHECKPOINT_INTERVAL);
+}
+
+static
+void
+redraw(wheel_timer_t *t)
+{
+	axel_t *axel = t->data;
+
+	axel->redraw = 1;
+}
+
+void
+events_redraw(axel_t *axel)
+{
+	if (!wheel_pending(&axel->redraw_timer))
+		wheel_add(&axel->timers, &axel->redraw_timer,
+			  axel->timers.tick + REDRAW_INTERVAL);
+}
+
+int
+events_init(axel_t *axel, double now)
+{
+	if (open_wake_pipe(axel) == -1)
+		return 0;
+
+	axel->conn_timer = calloc(axel->conf->num_connections,
+				  sizeof(wheel_timer_t));
+	if (!axel->conn_timer)
+		return 0;
+
+	wheel_init(&axel->timers, ticks(now));
+	for (int i = 0; i < axel->conf->num_connections; i++) {
+		axel->conn_timer[i].fire = check_conn;
+		axel->conn_timer[i].data = axel;
+		axel->conn_timer[i].id = i;
+	}
+	axel->redraw_timer.fire = redraw;
+	axel->redraw_timer.data = axel;
+	axel->save_timer.fire = save_state;
+	axel->save_timer.data = axel;
+	if (axel->conf->save_state_interval > 0)
+		wheel_add(&axel->timers, &axel->save_timer, ticks(now) +
+			  1000ull * axel->conf->save_state_interval);
+	axel->checkpoint_timer.fire = checkpoint;
+	axel->checkpoint_timer.data = axel;
+	wheel_add(&axel->timers, &axel->checkpoint_timer,
+		  ticks(now) + CHECKPOINT_INTERVAL);
+	axel->next_url = axel->url;
+
+	return !*axel->conf->control_socket || control_open(axel);
+}
+
+void
+events_stop(axel_t *axel)
+{
+	for (int i = 0; i < axel->conf->num_connections; i++) {
+		/* don't try to kill non existing thread */
+		if (*axel->conn[i].setup_thread != 0) {
+			pthread_cancel(*axel->conn[i].setup_thread);
+			join_setup_thread(&axel->conn[i]);
+		}
+	}
+
+	free(axel->conn_timer);
+	axel->conn_timer = NULL;
+	control_close(axel);
+
+	for (int i = 0; i < 2; i++) {
+		if (axel->wake_pipe[i] != -1)
+			close(axel->wake_pipe[i]);
+		axel->wake_pipe[i] = -1;
+	}
+}
+
+/* Whether any of connections from to to has its setup thread busy */
+static
+int
+setting_up(axel_t *axel, int from, int to)
+{
+	for (int i = from; i < to; i++) {
+		conn_t *conn = &axel->conn[i];
+		bool busy;
+
+		if (pthread_mutex_trylock(&conn->lock))
+			return 1;
+		busy = conn->state;
+		pthread_mutex_unlock(&conn->lock);
+		if (busy)
+			return 1;
+	}
+	return 0;
+}
+
+/* Set a connection added to a running download up the way axel_start() sets
+   up those it starts with */
+static
+void
+add_conn(axel_t *axel, int i)
+{
+	conn_t *conn = &axel->conn[i];
+
+	pthread_mutex_init(&conn->lock, NULL);
+	conn->conf = axel->conf;
+	conn_set(conn, axel->next_url->text);
+	conn->url = axel->next_url;
+	axel->next_url = axel->next_url->next;
+	iface_assign(axel, i);
+	conn->supported = true;
+	conn->if_range = axel->if_range;
+}
+
+int
+events_resize(axel_t *axel, uint16_t n)
+{
+	int old = axel->conf->num_connections;
+	int from = n > old ? 0 : n;
+	wheel_timer_t *timers;
+
+	/* Growing moves every connection, shrinking only ends the last ones */
+	if (setting_up(axel, from, old))
+		return 0;
+
+	/* Whatever the threads wrote down the pipe points into the array */
+	for (int i = from; i < old; i++)
+		join_setup_thread(&axel->conn[i]);
+	events_drain(axel);
+
+	/* What the connections let go of was theirs alone, and is a gap nobody
+	   works on to the ones left */
+	for (int i = n; i < old; i++) {
+		wheel_del(&axel->timers, &axel->conn_timer[i]);
+		conn_disconnect(&axel->conn[i]);
+		multirange_free(&axel->conn[i]);
+		pthread_mutex_destroy(&axel->conn[i].lock);
+	}
+	if (n <= old) {
+		axel->conf->num_connections = n;
+		goto share;
+	}
+
+	for (int i = 0; i < old; i++)
+		wheel_del(&axel->timers, &axel->conn_timer[i]);
+	timers = realloc(axel->conn_timer, n * sizeof(*timers));
+	if (timers)
+		axel->conn_timer = timers;
+	if (!timers || !axel_conn_resize(axel, n)) {
+		for (int i = 0; i < old; i++)
+			events_check(axel, i);
+		return -1;
+	}
+	for (int i = 0; i < n; i++) {
+		axel->conn_timer[i] = (wheel_timer_t){
+			.fire = check_conn, .data = axel, .id = i,
+		};
+		if (i >= old)
+			add_conn(axel, i);
+	}
+
+ share:
+	/* The work goes to whichever connections have none; one busy setting
+	   up has some */
+	for (int i = 0; i < n; i++) {
+		if (!pthread_mutex_trylock(&axel->conn[i].lock)) {
+			axel_reactivate(axel, i);
+			pthread_mutex_unlock(&axel->conn[i].lock);
+		}
+		events_check(axel, i);
+	}
+	return 1;
+}
+
+void
+events_run(axel_t *axel, double now)
+{
+	wheel_run(&axel->timers, ticks(now));
+}
+
+struct timeval *
+events_timeout(const axel_t *axel, double now, struct timeval *tv)
+{
+	unsigned long long next = wheel_next(&axel->timers);
+	unsigned long long wait = 0;
+
+	if (next == ULLONG_MAX)
+		return NULL;
+
+	if (next > ticks(now))
+		wait = next - ticks(now);
+	tv->tv_sec = wait / 1000;
+	tv->tv_usec = wait % 1000 * 1000;
+	return tv;
+}
+
+void
+events_drain(axel_t *axel)
+{
+	conn_t *done[64];
+	ssize_t n;
+
+	/* Each thread writes a whole pointer at once, so they come whole */
+	while ((n = read(axel->wake_pipe[0], done, sizeof(done))) > 0) {
+		for (size_t k = 0; k < n / sizeof(*done); k++) {
+			ptrdiff_t i = done[k] - axel->conn;
+
+			if (i >= 0 && i < axel->conf->num_connections)
+				events_check(axel, i);
+		}
+	}
+}
+
+/* Thread used to set up a connection */
+static
+void *
+setup_thread(void *c)
+{
+	conn_t *conn = c;
+	int oldstate;
+
+	/* Allow this thread to be killed at any time. */
+	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &oldstate);
+	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldstate);
+
+	pthread_mutex_lock(&conn->lock);
+	if (conn_setup(conn)) {
+		conn->last_transfer = axel_gettime();
+		if (conn_exec(conn)) {
+			conn->last_transfer = axel_gettime();
+			conn->enabled = true;
+			goto out;
+		}
+	}
+
+	conn_disconnect(conn);
+ out:
+	conn->state = false;
+	pthread_mutex_unlock(&conn->lock);
+
+	/* Only once the lock is free, or the look would find it still busy.
+	   Should the pipe be full, the setup timeout still comes round. */
+	if (write(conn->wake_fd, &conn, sizeof(conn)) != sizeof(conn)) {
+	}
+
+	return NULL;
+}
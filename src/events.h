@@ -0,0 +1,89 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+
+/* Timed events of a download */
+
+#ifndef AXEL_EVENTS_H
+#define AXEL_EVENTS_H
+
+/* Everything a download has to do at some time rather than when data comes
+ * in: looking again at a connection that dropped, whose setup is taking too
+ * long or that has gone quiet; saving the state file; telling the progress
+ * display there is something new to draw.  They all run off the timer wheel
+ * in axel_t, which sets how long axel_do() may wait for data, so a download
+ * with nothing due sleeps until something is.
+ *
+ * The setup threads have no business with the wheel; when one is done, it
+ * writes its connection down the download's own pipe, the one events_fd()
+ * gives, to wake the main thread up and have it look at that connection. */
+
+int events_init(axel_t *axel, double now);
+
+/* Cancel and reap whatever setup threads are left */
+void events_stop(axel_t *axel);
+
+/* Start setting up connection i in a thread of its own */
+void events_start(axel_t *axel, int i);
+
+/* Have connection i looked at on the next run, to restart it if it has
+ * dropped or to watch it for a timeout if it is working */
+void events_check(axel_t *axel, int i);
+
+/* Grow or shrink a running download to n connections: the new ones take
+ * their share of the work the way a connection that finished does, and
+ * what the ones dropped were working on is left for the rest.  Growing
+ * moves the connections, so it waits for no setup thread to be busy, and
+ * shrinking for none of those going away to be.  Returns 1 once done, 0 to
+ * be tried again later, and -1 if there is no memory for it. */
+int events_resize(axel_t *axel, uint16_t n);
+
+/* There is progress to draw, to be drawn soon but not for every read */
+void events_redraw(axel_t *axel);
+
+void events_run(axel_t *axel, double now);
+
+/* How long select() may wait, NULL for as long as it likes */
+struct timeval *events_timeout(const axel_t *axel, double now,
+			       struct timeval *tv);
+
+int events_fd(const axel_t *axel);
+
+/* Read whatever the setup threads have written, and check those connections */
+void events_drain(axel_t *axel);
+
+#endif				/* AXEL_EVENTS_H */
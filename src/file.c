@@ -0,0 +1,385 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* A file system as the source: file:// URLs */
+
+#include "config.h"
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
+#include "axel.h"
+#include "file.h"
+
+/* As much as a thread reads or copies at once */
+#define FILE_READ	(128 * 1024)
+#define FILE_COPY	(4 * 1024 * 1024)
+
+struct reader {
+	int src, sock;
+	int out;		/* what to copy to, if not -1 */
+	off_t pos, end;
+};
+
+int
+file_set(conn_t *conn, const char *path)
+{
+	const char *name;
+
+	/* file:///path, or file://localhost/path */
+	if (!strncmp(path, "localhost/", 10))
+		path += 9;
+	if (*path != '/')
+		return 0;
+
+	name = strrchr(path, '/') + 1;
+	if (strlcpy(conn->file, name, sizeof(conn->file)) >=
+	    sizeof(conn->file) || name - path >= (ptrdiff_t)sizeof(conn->dir))
+		return 0;
+	memcpy(conn->dir, path, name - path);
+	conn->dir[name - path] = '\0';
+	strcpy(conn->host, "localhost");
+	*conn->user = *conn->pass = '\0';
+	conn->port = 0;
+
+	return 1;
+}
+
+/* Open the file the connection names; returns -1 after setting
+   conn->message */
+static
+int
+open_source(conn_t *conn, struct stat *st)
+{
+	char path[MAX_STRING * 2];
+	int fd, err;
+
+	snprintf(path, sizeof(path), "%s%s", conn->dir, conn->file);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1 || fstat(fd, st) == -1)
+		err = errno;
+	else if (!S_ISREG(st->st_mode))
+		err = S_ISDIR(st->st_mode) ? EISDIR : EINVAL;
+	else
+		return fd;
+
+	if (fd != -1)
+		close(fd);
+	conn->message = strerror(err);
+	return -1;
+}
+
+int
+file_open(conn_t *conn)
+{
+	struct stat st;
+	int fd = open_source(conn, &st);
+
+	if (fd == -1)
+		return 0;
+	close(fd);
+
+	conn->proxy = 0;
+	conn->size = st.st_size;
+	conn->supported = true;
+	return 1;
+}
+
+static
+int
+send_all(int sock, const void *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = send(sock, buf, len, MSG_NOSIGNAL);
+
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf = (const char *)buf + n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* Copy a piece at a time, each once the connection has taken the last and
+   said how much more it wants */
+static
+void
+copy_range(struct reader *r)
+{
+	off_t want = FILE_READ;
+
+	while (r->pos < r->end) {
+		loff_t from = r->pos, to = r->pos;
+		off_t n = -1;
+
+#ifdef HAVE_COPY_FILE_RANGE
+		n = copy_file_range(r->src, &from, r->out, &to,
+				    min(r->end - r->pos, want), 0);
+#endif
+		if (n == -1)
+			n = -errno;
+		if (send_all(r->sock, &n, sizeof(n)) == -1 || n <= 0 ||
+		    recv(r->sock, &want, sizeof(want), MSG_WAITALL) !=
+		    sizeof(want))
+			return;
+		r->pos += n;
+	}
+}
+
+static
+void
+read_range(struct reader *r)
+{
+	char *buf = malloc(FILE_READ);
+
+	while (buf && r->pos < r->end) {
+		ssize_t n = pread(r->src, buf, min(r->end - r->pos,
+						   (off_t)FILE_READ), r->pos);
+
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0 || send_all(r->sock, buf, n) == -1)
+			break;
+		r->pos += n;
+	}
+	free(buf);
+}
+
+/* Until the range is done, or the connection is closed on its other end */
+static
+void *
+reader(void *arg)
+{
+	struct reader *r = arg;
+
+	if (r->out == -1)
+		read_range(r);
+	else
+		copy_range(r);
+
+	close(r->sock);
+	close(r->src);
+	if (r->out != -1)
+		close(r->out);
+	free(r);
+	return NULL;
+}
+
+int
+file_setup(conn_t *conn)
+{
+	struct reader *r;
+	struct stat st;
+	pthread_t thread;
+	int sock[2] = { -1, -1 };
+
+	conn_disconnect(conn);
+	r = calloc(1, sizeof(*r));
+	if (!r)
+		return 0;
+	r->out = -1;
+	r->src = open_source(conn, &st);
+	if (r->src == -1)
+		goto fail;
+
+	/* Its own copy of the output, which axel_close() cannot take from
+	   under it */
+	if (conn->copy_to) {
+		r->out = fcntl(conn->copy_to, F_DUPFD_CLOEXEC, 0);
+		if (r->out == -1)
+			goto fail;
+	}
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock) == -1)
+		goto fail;
+	fcntl(sock[0], F_SETFD, FD_CLOEXEC);
+	fcntl(sock[1], F_SETFD, FD_CLOEXEC);
+	r->sock = sock[1];
+	r->pos = conn->currentbyte;
+	r->end = min(conn->lastbyte, (off_t)st.st_size);
+	if (pthread_create(&thread, NULL, reader, r))
+		goto fail;
+	pthread_detach(thread);
+
+	conn->tcp = &conn->http->tcp;
+	conn->tcp->fd = sock[0];
+	return 1;
+
+ fail:
+	if (sock[0] != -1) {
+		close(sock[0]);
+		close(sock[1]);
+	}
+	if (r->out != -1)
+		close(r->out);
+	if (r->src != -1)
+		close(r->src);
+	free(r);
+	return 0;
+}
+
+/* Whether the output is a file the data can be written to behind the
+   writer's back: nothing watches it go past */
+static
+int
+plain_output(const axel_t *axel)
+{
+	return !axel->stream && axel->outfd != -1 && !axel->digest &&
+	    !axel->pieces;
+}
+
+/* Whether the kernel can copy from the file to the output at all: one
+   byte of it, which is where it belongs */
+static
+int
+can_copy(axel_t *axel, int i)
+{
+#ifdef HAVE_COPY_FILE_RANGE
+	loff_t from = 0, to = 0;
+	struct stat st;
+	int fd;
+
+	if (axel->copy_range)
+		return axel->copy_range > 0;
+
+	fd = open_source(&axel->conn[i], &st);
+	if (fd == -1)
+		return 0;
+	axel->copy_range = st.st_size == 0 ||
+	    copy_file_range(fd, &from, axel->outfd, &to, 1, 0) == 1 ? 1 : -1;
+	close(fd);
+	return axel->copy_range > 0;
+#else
+	(void)axel;
+	(void)i;
+	return 0;
+#endif				/* HAVE_COPY_FILE_RANGE */
+}
+
+int
+file_copy_to(axel_t *axel, int i)
+{
+	conn_t *conn = &axel->conn[i];
+
+	conn->copy_ahead = 0;
+	if (!PROTO_IS_FILE(conn->proto) || !plain_output(axel) ||
+	    axel->outfd <= 0 || !can_copy(axel, i))
+		return 0;
+
+	/* The first copy is made without being asked for */
+	conn->copy_ahead = min(conn->lastbyte - conn->currentbyte,
+			       (off_t)FILE_READ);
+	return axel->outfd;
+}
+
+int
+file_clone(axel_t *axel)
+{
+#ifdef FICLONE
+	conn_t *conn = &axel->conn[0];
+	struct stat st;
+	int fd, err;
+
+	/* The one source, and nothing of it fetched yet */
+	if (!PROTO_IS_FILE(conn->proto) || axel->url->next != axel->url ||
+	    axel->size == LLONG_MAX || axel->done.count || axel->stream)
+		return 0;
+
+	fd = open_source(conn, &st);
+	if (fd == -1)
+		return 0;
+	err = st.st_size != axel->size ||
+	    ioctl(axel->outfd, FICLONE, fd) == -1;
+	close(fd);
+	if (err || ranges_add(&axel->done, 0, axel->size) == -1)
+		return 0;
+
+	/* Nothing is left for the connections to do */
+	axel->bytes_done = axel->size;
+	if (!axel_divide(axel)) {
+		axel->bytes_done = 0;
+		ranges_free(&axel->done);
+		return 0;
+	}
+	if (axel->conf->verbose > 0)
+		axel_message(axel, _("Cloned %s%s"), conn->dir, conn->file);
+
+	return 1;
+#else
+	(void)axel;
+	return 0;
+#endif				/* FICLONE */
+}
+
+int
+file_copy(axel_t *axel, int i, size_t want, off_t *size)
+{
+	conn_t *conn = &axel->conn[i];
+	off_t copied, left, more = FILE_COPY;
+	ssize_t got;
+
+	if (!PROTO_IS_FILE(conn->proto) || !conn->copy_to)
+		return 0;
+
+	/* The next copy is as big as a read would be, under a speed limit */
+	if (axel->conf->max_speed || axel->speed_group)
+		more = want;
+
+	got = tcp_read(conn->tcp, &copied, sizeof(copied));
+	conn->copy_ahead = 0;
+	if (got <= 0) {
+		*size = got;
+	} else if (got != sizeof(copied)) {
+		*size = -1;
+	} else if (copied < 0) {
+		errno = -copied;
+		*size = -1;
+	} else {
+		/* Never past the connection's range, which may have been cut
+		   short since the last copy.  A thread that copied its last is
+		   gone, and says so at the next read. */
+		left = conn->lastbyte - conn->currentbyte - copied;
+		more = left > 0 ? min(more, left) : 0;
+		conn->copy_ahead = more;
+		send(conn->tcp->fd, &more, sizeof(more), MSG_NOSIGNAL);
+		*size = copied;
+	}
+
+	return 1;
+}
@@ -0,0 +1,84 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* A file system as the source: file:// URLs */
+
+#ifndef AXEL_FILE_H
+#define AXEL_FILE_H
+
+/* A file:// URL names a file on a mounted file system, local or not.  Each
+ * connection to it is a thread of its own, reading the file from the
+ * connection's current byte to its last with pread(), and passing the data
+ * on down a socket that stands in for a server's, so that the segmenting,
+ * stealing and resuming done for servers spread the latency of an NFS or
+ * CephFS mount over as many reads in flight as there are connections.
+ *
+ * Where the data is not looked at on its way to a file, the threads have
+ * the kernel copy it there with copy_file_range() instead, which a file
+ * system may do without the data leaving its servers, and pass on only how
+ * much they copied, waiting to be asked for more between copies.  A new
+ * output on the same file system as the source may instead be cloned whole,
+ * sharing the blocks between them. */
+
+/* Take the path of a file:// URL, after the scheme.  Returns 0 if it is
+ * not an absolute path on this host. */
+int file_set(conn_t *conn, const char *path);
+
+/* Find the file's size.  Returns 0 with conn->message saying why it could
+ * not. */
+int file_open(conn_t *conn);
+
+/* Start reading the file from the connection's current byte */
+int file_setup(conn_t *conn);
+
+/* The output a connection about to be set up may have the kernel copy to,
+ * or 0 if it is to pass the data on.  What the kernel copies, and has yet
+ * to say it has, is kept in conn->copy_ahead, for no other connection to
+ * take over. */
+int file_copy_to(axel_t *axel, int i);
+
+/* Fill a newly created output with the whole of the file at once, if the
+ * file system can share the blocks between them.  Returns whether it has;
+ * 0 leaves the output as it was. */
+int file_clone(axel_t *axel);
+
+/* Take what connection i's thread has copied to the output, if that is
+ * what it does, and ask for the next copy: of want bytes when a speed limit
+ * is in force, and never past the connection's last byte.  Returns 0 if its data is to be read the usual way, or 1
+ * with *size set as a read of that data would have set it. */
+int file_copy(axel_t *axel, int i, size_t want, off_t *size);
+
+#endif				/* AXEL_FILE_H */
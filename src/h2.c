@@ -0,0 +1,809 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* HTTP/2: requests as streams of a connection shared between them */
+
+#include "config.h"
+#include <poll.h>
+#include <sys/socket.h>
+#include <nghttp2/nghttp2.h>
+#include "axel.h"
+#include "altsvc.h"
+#include "h2.h"
+#include "sleep.h"
+
+/* The room the server is given on each stream, and on the connection as a
+   whole: enough for data to flow in bulk from however far away */
+#define H2_STREAM_WINDOW	(4 << 20)
+#define H2_WINDOW		(64 << 20)
+
+/* The most streams taken on at once, whatever the server takes */
+#define H2_STREAMS		100
+
+/* The longest request to be taken */
+#define H2_REQUEST		8192
+
+/* How long, in seconds, a connection left without streams waits for more */
+#define H2_LINGER		5
+
+/* What is offered to the server, as ALPN has it */
+static const char alpn[] = "\x02h2\x08http/1.1";
+
+enum { H2_CONNECTING, H2_READY, H2_HTTP1, H2_GONE };
+
+struct stream {
+	struct stream *next;
+	int32_t id;		/* 0 until the request is sent */
+	int sock;		/* -1 once the connection has hung up */
+	char req[H2_REQUEST + 1];
+	size_t req_len;
+	char *out;		/* still to go down the socket */
+	size_t out_len, out_off, out_size;
+	size_t head;		/* how much of out is headers, not data */
+	bool closed;		/* by the server */
+};
+
+struct session {
+	struct session *next;
+	char host[MAX_STRING];
+	int port;
+	char local_if[MAX_STRING];
+	int state;
+	int streams;		/* taken on and not yet done with */
+	uint32_t max_streams;
+	tcp_t tcp;
+	nghttp2_session *ng;
+	int wake[2];		/* new connections' sockets come down this */
+	struct stream *list;
+};
+
+static pthread_mutex_t h2_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct session *sessions;
+
+static
+int
+out_add(struct stream *st, const void *data, size_t len)
+{
+	if (st->out_len + len > st->out_size) {
+		size_t size = max(st->out_len + len, 2 * st->out_size);
+		char *out = realloc(st->out, size);
+
+		if (!out)
+			return -1;
+		st->out = out;
+		st->out_size = size;
+	}
+	memcpy(st->out + st->out_len, data, len);
+	st->out_len += len;
+	return 0;
+}
+
+/* A line of the reply's headers, as HTTP/1 would write it */
+static
+int
+out_header(struct stream *st, const char *a, size_t a_len, const char *sep,
+	   const char *b, size_t b_len)
+{
+	size_t len = st->out_len;
+
+	if (out_add(st, a, a_len) || out_add(st, sep, strlen(sep)) ||
+	    out_add(st, b, b_len) || out_add(st, "\r\n", 2))
+		return -1;
+	st->head += st->out_len - len;
+	return 0;
+}
+
+static
+ssize_t
+send_cb(nghttp2_session *ng, const uint8_t *data, size_t len, int flags,
+	void *arg)
+{
+	struct session *s = arg;
+	ssize_t n = tcp_write(&s->tcp, (void *)data, min(len, (size_t)INT_MAX));
+
+	return n > 0 ? n : NGHTTP2_ERR_CALLBACK_FAILURE;
+}
+
+static
+int
+header_cb(nghttp2_session *ng, const nghttp2_frame *frame,
+	  const uint8_t *name, size_t name_len, const uint8_t *value,
+	  size_t value_len, uint8_t flags, void *arg)
+{
+	struct stream *st;
+	int err = 0;
+
+	if (frame->hd.type != NGHTTP2_HEADERS ||
+	    frame->headers.cat != NGHTTP2_HCAT_RESPONSE)
+		return 0;
+	st = nghttp2_session_get_stream_user_data(ng, frame->hd.stream_id);
+	if (!st)
+		return 0;
+
+	if (name_len == 7 && !memcmp(name, ":status", 7))
+		err = out_header(st, "HTTP/2", 6, " ", (const char *)value,
+				 value_len);
+	else if (*name != ':')
+		err = out_header(st, (const char *)name, name_len, ": ",
+				 (const char *)value, value_len);
+
+	return err ? NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE : 0;
+}
+
+static
+int
+frame_cb(nghttp2_session *ng, const nghttp2_frame *frame, void *arg)
+{
+	struct session *s = arg;
+	struct stream *st;
+
+	switch (frame->hd.type) {
+	case NGHTTP2_GOAWAY:
+		/* Only the streams it has are to be finished on it */
+		pthread_mutex_lock(&h2_lock);
+		s->state = H2_GONE;
+		pthread_mutex_unlock(&h2_lock);
+		break;
+	case NGHTTP2_SETTINGS:
+		/* Streams are only taken on once it is known how many fit,
+		   lest the server refuse those over */
+		pthread_mutex_lock(&h2_lock);
+		s->max_streams = min(nghttp2_session_get_remote_settings(ng,
+			NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS), H2_STREAMS);
+		if (s->state == H2_CONNECTING)
+			s->state = H2_READY;
+		pthread_mutex_unlock(&h2_lock);
+		break;
+	case NGHTTP2_HEADERS:
+		st = nghttp2_session_get_stream_user_data(ng,
+							  frame->hd.stream_id);
+		if (st && frame->headers.cat == NGHTTP2_HCAT_RESPONSE &&
+		    frame->hd.flags & NGHTTP2_FLAG_END_HEADERS &&
+		    out_header(st, "", 0, "", "", 0))
+			return NGHTTP2_ERR_CALLBACK_FAILURE;
+		break;
+	}
+	return 0;
+}
+
+static
+int
+data_cb(nghttp2_session *ng, uint8_t flags, int32_t id, const uint8_t *data,
+	size_t len, void *arg)
+{
+	struct stream *st = nghttp2_session_get_stream_user_data(ng, id);
+
+	/* Nobody to take it any more */
+	if (!st || st->sock == -1) {
+		nghttp2_session_consume(ng, id, len);
+		return 0;
+	}
+	if (out_add(st, data, len)) {
+		nghttp2_session_consume(ng, id, len);
+		return nghttp2_submit_rst_stream(ng, NGHTTP2_FLAG_NONE, id,
+						 NGHTTP2_INTERNAL_ERROR);
+	}
+	return 0;
+}
+
+static
+int
+close_cb(nghttp2_session *ng, int32_t id, uint32_t error, void *arg)
+{
+	struct stream *st = nghttp2_session_get_stream_user_data(ng, id);
+
+	if (st)
+		st->closed = true;
+	return 0;
+}
+
+/* The connection hung up: the rest of the stream is of no use to anyone */
+static
+void
+hang_up(struct session *s, struct stream *st)
+{
+	close(st->sock);
+	st->sock = -1;
+	if (st->id > 0 && !st->closed) {
+		nghttp2_submit_rst_stream(s->ng, NGHTTP2_FLAG_NONE, st->id,
+					  NGHTTP2_CANCEL);
+		nghttp2_session_consume(s->ng, st->id, st->out_len -
+					max(st->out_off, st->head));
+	}
+	st->out_len = st->out_off = st->head = 0;
+}
+
+/* Give the connection as much of the reply as it takes, and the server as
+   much room again for the data in it */
+static
+void
+flush(struct session *s, struct stream *st)
+{
+	while (st->sock != -1 && st->out_off < st->out_len) {
+		ssize_t n = send(st->sock, st->out + st->out_off,
+				 st->out_len - st->out_off, MSG_NOSIGNAL);
+		size_t from = max(st->out_off, st->head);
+
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				hang_up(s, st);
+			return;
+		}
+		st->out_off += n;
+		if (st->out_off > from)
+			nghttp2_session_consume(s->ng, st->id,
+						st->out_off - from);
+	}
+	st->out_len = st->out_off = st->head = 0;
+}
+
+static
+bool
+hop_by_hop(const char *name)
+{
+	static const char *const names[] = {
+		"host", "connection", "keep-alive", "proxy-connection",
+		"transfer-encoding", "upgrade", "te",
+	};
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++)
+		if (!strcmp(name, names[i]))
+			return true;
+	return false;
+}
+
+#define NV(n, v, vl) \
+	((nghttp2_nv){ (uint8_t *)(n), (uint8_t *)(v), strlen(n), (vl), \
+		       NGHTTP2_NV_FLAG_NONE })
+
+/* Make a stream of the request the connection sent, once all of it is in */
+static
+void
+submit(struct session *s, struct stream *st)
+{
+	nghttp2_nv nv[4 + MAX_ADD_HEADERS + 16];
+	char *line, *next, *method, *path, *authority = s->host;
+	size_t n = 4, authority_len = strlen(s->host);
+
+	if (!strstr(st->req, "\r\n\r\n")) {
+		if (st->req_len == H2_REQUEST)
+			hang_up(s, st);
+		return;
+	}
+
+	/* GET path HTTP/1.0 */
+	line = st->req;
+	next = strstr(line, "\r\n");
+	*next = '\0';
+	method = line;
+	path = strchr(line, ' ');
+	if (!path) {
+		hang_up(s, st);
+		return;
+	}
+	*path++ = '\0';
+	path[strcspn(path, " ")] = '\0';
+
+	for (line = next + 2; *line && n < sizeof(nv) / sizeof(*nv);
+	     line = next + 2) {
+		char *value;
+
+		next = strstr(line, "\r\n");
+		*next = '\0';
+		value = strchr(line, ':');
+		if (!value)
+			break;
+		*value++ = '\0';
+		value += strspn(value, " \t");
+		for (char *c = line; *c; c++)
+			*c = tolower((unsigned char)*c);
+
+		if (!strcmp(line, "host")) {
+			authority = value;
+			authority_len = strlen(value);
+		}
+		if (!hop_by_hop(line))
+			nv[n++] = NV(line, value, strlen(value));
+	}
+	nv[0] = NV(":method", method, strlen(method));
+	nv[1] = NV(":scheme", "https", 5);
+	nv[2] = NV(":authority", authority, authority_len);
+	nv[3] = NV(":path", path, strlen(path));
+
+	st->id = nghttp2_submit_request(s->ng, NULL, nv, n, NULL, st);
+	if (st->id < 0) {
+		st->id = 0;
+		hang_up(s, st);
+	}
+}
+
+/* Something from the connection: its request, or that it hung up */
+static
+void
+take(struct session *s, struct stream *st)
+{
+	char rest[256];
+	ssize_t n;
+
+	if (st->id)
+		n = recv(st->sock, rest, sizeof(rest), 0);
+	else
+		n = recv(st->sock, st->req + st->req_len,
+			 H2_REQUEST - st->req_len, 0);
+	if (n == -1 && (errno == EINTR || errno == EAGAIN ||
+			errno == EWOULDBLOCK))
+		return;
+	if (n <= 0) {
+		hang_up(s, st);
+	} else if (!st->id) {
+		st->req_len += n;
+		st->req[st->req_len] = '\0';
+		submit(s, st);
+	}
+}
+
+/* Take on the connections whose sockets came down the pipe */
+static
+void
+take_new(struct session *s)
+{
+	int fds[64];
+	ssize_t n;
+
+	while ((n = read(s->wake[0], fds, sizeof(fds))) > 0) {
+		for (int i = 0; i < n / (ssize_t)sizeof(*fds); i++) {
+			struct stream *st = calloc(1, sizeof(*st));
+
+			if (!st) {
+				close(fds[i]);
+				pthread_mutex_lock(&h2_lock);
+				s->streams--;
+				pthread_mutex_unlock(&h2_lock);
+				continue;
+			}
+			st->sock = fds[i];
+			st->next = s->list;
+			s->list = st;
+		}
+	}
+}
+
+/* Let go of the streams that are done with: the reply all given to the
+   connection, or the connection gone and the server told */
+static
+void
+sweep(struct session *s)
+{
+	for (struct stream **p = &s->list, *st; (st = *p);) {
+		bool done = st->sock == -1 ? !st->id || st->closed :
+		    st->closed && st->out_off == st->out_len;
+
+		if (!done) {
+			p = &st->next;
+			continue;
+		}
+		if (st->sock != -1)
+			close(st->sock);
+		if (st->id > 0)
+			nghttp2_session_set_stream_user_data(s->ng, st->id,
+							     NULL);
+		*p = st->next;
+		free(st->out);
+		free(st);
+		pthread_mutex_lock(&h2_lock);
+		s->streams--;
+		pthread_mutex_unlock(&h2_lock);
+	}
+}
+
+/* Whether the connection is to go: broken, or long enough without work */
+static
+bool
+finished(struct session *s, double *idle_since)
+{
+	bool gone;
+
+	if (!nghttp2_session_want_read(s->ng) &&
+	    !nghttp2_session_want_write(s->ng))
+		return true;
+
+	pthread_mutex_lock(&h2_lock);
+	if (s->streams)
+		*idle_since = 0;
+	else if (!*idle_since)
+		*idle_since = axel_gettime();
+	gone = *idle_since && axel_gettime() - *idle_since >= H2_LINGER;
+	if (gone)
+		s->state = H2_GONE;
+	pthread_mutex_unlock(&h2_lock);
+
+	return gone;
+}
+
+/* Take a session off the list; with the lock held */
+static
+void
+drop(struct session *s)
+{
+	s->state = H2_GONE;
+	for (struct session **p = &sessions; *p; p = &(*p)->next) {
+		if (*p == s) {
+			*p = s->next;
+			break;
+		}
+	}
+}
+
+static
+void
+session_free(struct session *s)
+{
+	int fds[64];
+	ssize_t n;
+
+	pthread_mutex_lock(&h2_lock);
+	drop(s);
+	pthread_mutex_unlock(&h2_lock);
+
+	/* Every socket handed over is in the pipe by now */
+	while ((n = read(s->wake[0], fds, sizeof(fds))) > 0)
+		for (int i = 0; i < n / (ssize_t)sizeof(*fds); i++)
+			close(fds[i]);
+	if (s->ng)
+		nghttp2_session_del(s->ng);
+	while (s->list) {
+		struct stream *st = s->list;
+
+		s->list = st->next;
+		if (st->sock != -1)
+			close(st->sock);
+		free(st->out);
+		free(st);
+	}
+	tcp_close(&s->tcp);
+	if (s->wake[0] != -1) {
+		close(s->wake[0]);
+		close(s->wake[1]);
+	}
+	free(s);
+}
+
+static
+void *
+session_thread(void *arg)
+{
+	struct session *s = arg;
+	struct pollfd *fds = NULL;
+	struct stream **polled = NULL;
+	size_t size = 0;
+	double idle_since = 0;
+	char buf[16384];
+
+	while (nghttp2_session_send(s->ng) == 0) {
+		int n = 2, timeout;
+
+		for (struct stream *st = s->list; st; st = st->next)
+			flush(s, st);
+		sweep(s);
+		if (finished(s, &idle_since))
+			break;
+
+		for (struct stream *st = s->list; st; st = st->next)
+			n++;
+		if (n > (int)size) {
+			size = n * 2;
+			free(fds);
+			free(polled);
+			fds = malloc(size * sizeof(*fds));
+			polled = malloc(size * sizeof(*polled));
+			if (!fds || !polled)
+				break;
+		}
+		fds[0] = (struct pollfd){ .fd = s->wake[0], .events = POLLIN };
+		fds[1] = (struct pollfd){ .fd = s->tcp.fd, .events = POLLIN };
+		n = 2;
+		for (struct stream *st = s->list; st; st = st->next) {
+			if (st->sock == -1)
+				continue;
+			polled[n] = st;
+			fds[n].fd = st->sock;
+			fds[n].events = POLLIN;
+			if (st->out_off < st->out_len)
+				fds[n].events |= POLLOUT;
+			fds[n++].revents = 0;
+		}
+
+		timeout = SSL_pending(s->tcp.ssl) ? 0 :
+		    idle_since ? H2_LINGER * 1000 : -1;
+		if (poll(fds, n, timeout) == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (fds[0].revents)
+			take_new(s);
+		if (fds[1].revents || SSL_pending(s->tcp.ssl)) {
+			ssize_t len = tcp_read(&s->tcp, buf, sizeof(buf));
+
+			if (len <= 0 ||
+			    nghttp2_session_mem_recv(s->ng, (uint8_t *)buf,
+						     len) < 0)
+				break;
+		}
+		for (int i = 2; i < n; i++) {
+			if (fds[i].revents & POLLOUT)
+				flush(s, polled[i]);
+			if (fds[i].revents & (POLLIN | POLLHUP | POLLERR) &&
+			    polled[i]->sock != -1)
+				take(s, polled[i]);
+		}
+	}
+
+	free(fds);
+	free(polled);
+	session_free(s);
+	return NULL;
+}
+
+static
+int
+session_start(struct session *s)
+{
+	nghttp2_session_callbacks *cb;
+	nghttp2_option *opt;
+	nghttp2_settings_entry settings[] = {
+		{ NGHTTP2_SETTINGS_ENABLE_PUSH, 0 },
+		{ NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, H2_STREAM_WINDOW },
+	};
+	pthread_t thread;
+	int err;
+
+	if (pipe(s->wake) == -1) {
+		s->wake[0] = s->wake[1] = -1;
+		return 0;
+	}
+	fcntl(s->wake[0], F_SETFL, O_NONBLOCK);
+	fcntl(s->wake[0], F_SETFD, FD_CLOEXEC);
+	fcntl(s->wake[1], F_SETFD, FD_CLOEXEC);
+
+	if (nghttp2_session_callbacks_new(&cb))
+		return 0;
+	nghttp2_session_callbacks_set_send_callback(cb, send_cb);
+	nghttp2_session_callbacks_set_on_header_callback(cb, header_cb);
+	nghttp2_session_callbacks_set_on_frame_recv_callback(cb, frame_cb);
+	nghttp2_session_callbacks_set_on_data_chunk_recv_callback(cb, data_cb);
+	nghttp2_session_callbacks_set_on_stream_close_callback(cb, close_cb);
+	err = nghttp2_option_new(&opt);
+	if (!err) {
+		/* Room is made for more as the connections take the data */
+		nghttp2_option_set_no_auto_window_update(opt, 1);
+		err = nghttp2_session_client_new2(&s->ng, cb, s, opt);
+		nghttp2_option_del(opt);
+	}
+	nghttp2_session_callbacks_del(cb);
+	if (err)
+		return 0;
+
+	if (nghttp2_submit_settings(s->ng, NGHTTP2_FLAG_NONE, settings,
+				    sizeof(settings) / sizeof(*settings)) ||
+	    nghttp2_session_set_local_window_size(s->ng, NGHTTP2_FLAG_NONE, 0,
+						  H2_WINDOW))
+		return 0;
+
+	if (pthread_create(&thread, NULL, session_thread, s))
+		return 0;
+	pthread_detach(thread);
+	return 1;
+}
+
+/* A TLS connection to host:port for the session's server; returns 1 if it
+   speaks HTTP/2 there, 0 if not, and -1 if it failed */
+static
+int
+session_tls(struct session *s, char *host, int port,
+	    unsigned io_timeout)
+{
+	const unsigned char *proto = NULL;
+	unsigned len = 0;
+
+	if (tcp_connect(&s->tcp, host, port, 0,
+			*s->local_if ? s->local_if : NULL, io_timeout) == -1)
+		return -1;
+	/* Wherever it is, it is the server's name the certificate is for */
+	if (!(s->tcp.ssl = ssl_connect(s->tcp.fd, s->host, alpn,
+				       s->tcp.insecure))) {
+		tcp_close(&s->tcp);
+		return -1;
+	}
+	SSL_get0_alpn_selected(s->tcp.ssl, &proto, &len);
+	return len == 2 && !memcmp(proto, "h2", 2);
+}
+
+/* Connect a new session, where the server said HTTP/2 is if it said so;
+   returns 1 if it speaks HTTP/2, 0 if it handed its connection over to
+   tcp for HTTP/1, and -1 if it failed */
+static
+int
+session_connect(struct session *s, tcp_t *tcp, unsigned io_timeout)
+{
+	char alt[MAX_STRING];
+	int alt_port, ret = -1;
+
+	s->tcp.ai_family = tcp->ai_family;
+	s->tcp.mptcp = tcp->mptcp;
+	if (altsvc_lookup(s->host, s->port, "h2", alt, sizeof(alt),
+			  &alt_port)) {
+		ret = session_tls(s, alt, alt_port, io_timeout);
+		if (ret != 1) {
+			/* Somewhere else is no use for HTTP/1 */
+			tcp_close(&s->tcp);
+			altsvc_broken(s->host, s->port, "h2");
+		}
+	}
+	if (ret != 1)
+		ret = session_tls(s, s->host, s->port, io_timeout);
+
+	if (ret == 0) {
+		*tcp = s->tcp;
+		s->tcp.fd = -1;
+		s->tcp.ssl = NULL;
+		pthread_mutex_lock(&h2_lock);
+		s->state = H2_HTTP1;
+		pthread_mutex_unlock(&h2_lock);
+	} else if (ret == 1 && !session_start(s)) {
+		ret = -1;
+	}
+
+	/* Otherwise ready once the server's settings are in */
+	if (ret == -1)
+		session_free(s);
+	return ret;
+}
+
+/* Hand the connection's socket to the session; called with the lock held */
+static
+int
+attach(struct session *s, tcp_t *tcp, unsigned io_timeout)
+{
+	struct timeval tout = { .tv_sec = io_timeout };
+	int sv[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1)
+		return -1;
+	fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+	fcntl(sv[1], F_SETFD, FD_CLOEXEC);
+	/* The session's end, for it never to wait on any one connection */
+	fcntl(sv[1], F_SETFL, O_NONBLOCK);
+	if (write(s->wake[1], &sv[1], sizeof(sv[1])) != sizeof(sv[1])) {
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+	s->streams++;
+
+	tcp->fd = sv[0];
+	tcp->ssl = NULL;
+	setsockopt(sv[0], SOL_SOCKET, SO_RCVTIMEO, &tout, sizeof(tout));
+	setsockopt(sv[0], SOL_SOCKET, SO_SNDTIMEO, &tout, sizeof(tout));
+	return 1;
+}
+
+/* A session to host:port that may take another stream, or that is on its
+   way to; with the lock held */
+static
+struct session *
+find(const char *host, int port, const char *local_if, bool insecure)
+{
+	/* A session whose certificate went unchecked is not for a connection
+	   that is to check it */
+	for (struct session *s = sessions; s; s = s->next)
+		if (s->state != H2_GONE && s->port == port &&
+		    !strcmp(s->host, host) && !strcmp(s->local_if, local_if) &&
+		    s->tcp.insecure == insecure &&
+		    (s->state != H2_READY ||
+		     (uint32_t)s->streams < s->max_streams))
+			return s;
+	return NULL;
+}
+
+int
+h2_connect(tcp_t *tcp, char *host, int port, char *local_if,
+	   unsigned io_timeout)
+{
+	double give_up = axel_gettime() + io_timeout;
+	struct session *s;
+	char alt[MAX_STRING];
+	int alt_port, cancel, state, ret = -1;
+
+	if (!local_if)
+		local_if = "";
+
+	/* The list is not to be left locked by a setup that times out */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel);
+	for (;;) {
+		pthread_mutex_lock(&h2_lock);
+		s = find(host, port, local_if, tcp->insecure);
+		if (s && s->state == H2_HTTP1 &&
+		    altsvc_lookup(host, port, "h2", alt, sizeof(alt),
+				  &alt_port)) {
+			/* Told since where it does speak HTTP/2 */
+			drop(s);
+			free(s);
+			s = NULL;
+		}
+		if (!s && (s = calloc(1, sizeof(*s)))) {
+			strlcpy(s->host, host, sizeof(s->host));
+			strlcpy(s->local_if, local_if, sizeof(s->local_if));
+			s->port = port;
+			s->tcp.insecure = tcp->insecure;
+			s->state = H2_CONNECTING;
+			s->max_streams = H2_STREAMS;
+			s->tcp.fd = s->wake[0] = s->wake[1] = -1;
+			s->next = sessions;
+			sessions = s;
+			state = -1;
+		} else {
+			state = s ? s->state : H2_GONE;
+		}
+		if (state == H2_READY)
+			ret = attach(s, tcp, io_timeout);
+		pthread_mutex_unlock(&h2_lock);
+
+		if (state == -1) {
+			/* A new one, for this connection to make */
+			ret = session_connect(s, tcp, io_timeout);
+			if (ret == 1)
+				continue;
+			ret = ret ? -1 : 1;
+		} else if (state == H2_CONNECTING &&
+			   axel_gettime() < give_up) {
+			struct timespec delay = { .tv_nsec = 10000000 };
+
+			axel_sleep(delay);
+			continue;
+		} else if (state != H2_READY) {
+			ret = tcp_connect(tcp, host, port, 1, *local_if ?
+					  local_if : NULL, io_timeout);
+		}
+		break;
+	}
+	pthread_setcancelstate(cancel, NULL);
+
+	return ret;
+}
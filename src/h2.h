@@ -0,0 +1,62 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* HTTP/2: requests as streams of a connection shared between them */
+
+#ifndef AXEL_H2_H
+#define AXEL_H2_H
+
+/* Many servers limit how many connections a client may open to them, but
+ * not how many requests it may have on each, and HTTP/2 lets those run side
+ * by side on one connection.  A connection offering it is shared by as many
+ * of a download's connections to its server as it takes streams at once,
+ * and those after them by another such connection.
+ *
+ * Each of the shared connections has a thread of its own, which plays an
+ * HTTP/1 server to every connection it takes on: through a socket standing
+ * in for the server's, it takes the request they send, makes it a stream of
+ * its own, and sends back the reply with its headers written as HTTP/1
+ * would, then the data, as it comes.  The data on each stream is held back,
+ * by not giving the server room for more, until the connection has taken
+ * what came before it. */
+
+/* Connect to host:port over TLS as HTTP/2 would, for tcp to be a stream of
+ * a shared connection; or of one of its own, should the server only speak
+ * HTTP/1.  Returns as tcp_connect() does. */
+int h2_connect(tcp_t *tcp, char *host, int port, char *local_if,
+	       unsigned io_timeout);
+
+#endif				/* AXEL_H2_H */
@@ -0,0 +1,475 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* HTTP/3: requests as streams of a QUIC connection shared between them */
+
+#include "config.h"
+#include <poll.h>
+#include <sys/socket.h>
+#include "axel.h"
+#include "altsvc.h"
+#include "h3.h"
+#include "quic.h"
+#include "sleep.h"
+
+/* The most streams taken on at once, whatever the server takes */
+#define H3_STREAMS		100
+
+/* How long, in seconds, a connection left without streams waits for more */
+#define H3_LINGER		5
+
+static pthread_mutex_t h3_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct session *sessions;
+
+/* Give the connection as much of the reply as it takes, and the server as
+   much room again for the data in it */
+static
+void
+flush(struct session *s, struct stream *st)
+{
+	while (st->sock != -1 && st->out_off < st->out_len) {
+		ssize_t n = send(st->sock, st->out + st->out_off,
+				 st->out_len - st->out_off, MSG_NOSIGNAL);
+		size_t from = max(st->out_off, st->head);
+
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				quic_hang_up(s, st);
+			return;
+		}
+		st->out_off += n;
+		if (st->out_off > from)
+			quic_consume(s, st->id, st->out_off - from);
+	}
+	st->out_len = st->out_off = st->head = 0;
+}
+
+/* Something from the connection: its request, or that it hung up */
+static
+void
+take(struct session *s, struct stream *st)
+{
+	char rest[256];
+	ssize_t n;
+
+	if (st->whole)
+		n = recv(st->sock, rest, sizeof(rest), 0);
+	else
+		n = recv(st->sock, st->req + st->req_len,
+			 H3_REQUEST - st->req_len, 0);
+	if (n == -1 && (errno == EINTR || errno == EAGAIN ||
+			errno == EWOULDBLOCK))
+		return;
+	if (n <= 0) {
+		quic_hang_up(s, st);
+	} else if (!st->whole) {
+		st->req_len += n;
+		st->req[st->req_len] = '\0';
+		quic_submit(s, st);
+	}
+}
+
+/* Take on the connections whose sockets came down the pipe */
+static
+void
+take_new(struct session *s)
+{
+	int fds[64];
+	ssize_t n;
+
+	while ((n = read(s->wake[0], fds, sizeof(fds))) > 0) {
+		for (int i = 0; i < n / (ssize_t)sizeof(*fds); i++) {
+			struct stream *st = calloc(1, sizeof(*st));
+
+			if (!st) {
+				close(fds[i]);
+				pthread_mutex_lock(&h3_lock);
+				s->streams--;
+				pthread_mutex_unlock(&h3_lock);
+				continue;
+			}
+			st->id = -1;
+			st->sock = fds[i];
+			st->next = s->list;
+			s->list = st;
+		}
+	}
+}
+
+/* Let go of the streams that are done with: the reply all given to the
+   connection, or the connection gone and the server told */
+static
+void
+sweep(struct session *s)
+{
+	for (struct stream **p = &s->list, *st; (st = *p);) {
+		bool done = st->sock == -1 ? st->id < 0 || st->closed :
+		    st->closed && st->out_off == st->out_len;
+
+		if (!done) {
+			p = &st->next;
+			continue;
+		}
+		if (st->sock != -1)
+			close(st->sock);
+		*p = st->next;
+		free(st->out);
+		free(st);
+		pthread_mutex_lock(&h3_lock);
+		s->streams--;
+		pthread_mutex_unlock(&h3_lock);
+	}
+}
+
+/* Whether the connection is to go: broken, or long enough without work */
+static
+bool
+finished(struct session *s, double *idle_since)
+{
+	bool gone;
+
+	if (ngtcp2_conn_in_closing_period(s->qc) ||
+	    ngtcp2_conn_in_draining_period(s->qc))
+		return true;
+
+	pthread_mutex_lock(&h3_lock);
+	if (s->streams)
+		*idle_since = 0;
+	else if (!*idle_since)
+		*idle_since = axel_gettime();
+	gone = *idle_since && axel_gettime() - *idle_since >= H3_LINGER;
+	if (gone)
+		s->state = H3_GONE;
+	pthread_mutex_unlock(&h3_lock);
+
+	return gone;
+}
+
+/* Take a session off the list; with the lock held */
+static
+void
+drop(struct session *s)
+{
+	s->state = H3_GONE;
+	for (struct session **p = &sessions; *p; p = &(*p)->next) {
+		if (*p == s) {
+			*p = s->next;
+			break;
+		}
+	}
+}
+
+/* Let go of the QUIC connection, and all that goes with it */
+static
+void
+session_free(struct session *s)
+{
+	int fds[64];
+	ssize_t n;
+
+	pthread_mutex_lock(&h3_lock);
+	drop(s);
+	pthread_mutex_unlock(&h3_lock);
+
+	/* Every socket handed over is in the pipe by now */
+	while ((n = read(s->wake[0], fds, sizeof(fds))) > 0)
+		for (int i = 0; i < n / (ssize_t)sizeof(*fds); i++)
+			close(fds[i]);
+	while (s->list) {
+		struct stream *st = s->list;
+
+		s->list = st->next;
+		if (st->sock != -1)
+			close(st->sock);
+		free(st->out);
+		free(st);
+	}
+	quic_free(s);
+	if (s->wake[0] != -1) {
+		close(s->wake[0]);
+		close(s->wake[1]);
+	}
+	free(s);
+}
+
+static
+void *
+session_thread(void *arg)
+{
+	struct session *s = arg;
+	struct pollfd *fds = NULL;
+	struct stream **polled = NULL;
+	size_t size = 0;
+	double idle_since = 0;
+
+	while (quic_write(s) == 0) {
+		int n = 2, timeout;
+
+		for (struct stream *st = s->list; st; st = st->next)
+			flush(s, st);
+		sweep(s);
+		if (finished(s, &idle_since))
+			break;
+
+		for (struct stream *st = s->list; st; st = st->next)
+			n++;
+		if (n > (int)size) {
+			size = n * 2;
+			free(fds);
+			free(polled);
+			fds = malloc(size * sizeof(*fds));
+			polled = malloc(size * sizeof(*polled));
+			if (!fds || !polled)
+				break;
+		}
+		fds[0] = (struct pollfd){ .fd = s->wake[0], .events = POLLIN };
+		fds[1] = (struct pollfd){ .fd = s->fd, .events = POLLIN };
+		n = 2;
+		for (struct stream *st = s->list; st; st = st->next) {
+			if (st->sock == -1)
+				continue;
+			polled[n] = st;
+			fds[n].fd = st->sock;
+			fds[n].events = POLLIN;
+			if (st->out_off < st->out_len)
+				fds[n].events |= POLLOUT;
+			fds[n++].revents = 0;
+		}
+
+		timeout = quic_timeout(s);
+		if (idle_since)
+			timeout = min(timeout, H3_LINGER * 1000);
+		if (poll(fds, n, timeout) == -1) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (fds[0].revents)
+			take_new(s);
+		if ((fds[1].revents && quic_read(s) == -1) || quic_expire(s) == -1)
+			break;
+		for (int i = 2; i < n; i++) {
+			if (fds[i].revents & POLLOUT)
+				flush(s, polled[i]);
+			if (fds[i].revents & (POLLIN | POLLHUP | POLLERR) &&
+			    polled[i]->sock != -1)
+				take(s, polled[i]);
+		}
+
+		/* Those that waited for the server to let more streams be
+		   opened */
+		for (struct stream *st = s->list; st; st = st->next)
+			if (st->whole && st->id < 0 && st->sock != -1)
+				quic_submit(s, st);
+	}
+
+	quic_goodbye(s);
+	free(fds);
+	free(polled);
+	session_free(s);
+	return NULL;
+}
+
+static
+int
+session_start(struct session *s)
+{
+	pthread_t thread;
+
+	if (pipe(s->wake) == -1) {
+		s->wake[0] = s->wake[1] = -1;
+		return 0;
+	}
+	fcntl(s->wake[0], F_SETFL, O_NONBLOCK);
+	fcntl(s->wake[0], F_SETFD, FD_CLOEXEC);
+	fcntl(s->wake[1], F_SETFD, FD_CLOEXEC);
+
+	if (pthread_create(&thread, NULL, session_thread, s))
+		return 0;
+	pthread_detach(thread);
+	return 1;
+}
+
+/* Connect a new session, where the server said HTTP/3 is if it said so,
+   or on its own port otherwise; returns 1 if it speaks HTTP/3, or 0 after
+   marking the session as failed */
+static
+int
+session_connect(struct session *s, unsigned io_timeout)
+{
+	char alt[MAX_STRING];
+	int alt_port, ret = -1;
+
+	if (altsvc_lookup(s->host, s->port, "h3", alt, sizeof(alt),
+			  &alt_port)) {
+		ret = quic_handshake(s, alt, alt_port, io_timeout);
+		if (ret != 1) {
+			quic_free(s);
+			altsvc_broken(s->host, s->port, "h3");
+		}
+	}
+	if (ret != 1)
+		ret = quic_handshake(s, s->host, s->port, io_timeout);
+
+	pthread_mutex_lock(&h3_lock);
+	if (ret == 1 && session_start(s)) {
+		s->state = H3_READY;
+	} else {
+		/* Left to TCP for a while, the session kept to say so */
+		ret = 0;
+		s->state = H3_FAILED;
+		s->retry = axel_gettime() + ALTSVC_BROKEN;
+	}
+	pthread_mutex_unlock(&h3_lock);
+
+	if (!ret) {
+		quic_free(s);
+		if (s->wake[0] != -1) {
+			close(s->wake[0]);
+			close(s->wake[1]);
+			s->wake[0] = s->wake[1] = -1;
+		}
+	}
+	return ret;
+}
+
+/* Hand the connection's socket to the session; called with the lock held */
+static
+int
+attach(struct session *s, tcp_t *tcp, unsigned io_timeout)
+{
+	struct timeval tout = { .tv_sec = io_timeout };
+	int sv[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1)
+		return 0;
+	fcntl(sv[0], F_SETFD, FD_CLOEXEC);
+	fcntl(sv[1], F_SETFD, FD_CLOEXEC);
+	/* The session's end, for it never to wait on any one connection */
+	fcntl(sv[1], F_SETFL, O_NONBLOCK);
+	if (write(s->wake[1], &sv[1], sizeof(sv[1])) != sizeof(sv[1])) {
+		close(sv[0]);
+		close(sv[1]);
+		return 0;
+	}
+	s->streams++;
+
+	tcp->fd = sv[0];
+	tcp->ssl = NULL;
+	setsockopt(sv[0], SOL_SOCKET, SO_RCVTIMEO, &tout, sizeof(tout));
+	setsockopt(sv[0], SOL_SOCKET, SO_SNDTIMEO, &tout, sizeof(tout));
+	return 1;
+}
+
+/* A session to host:port that may take another stream, is on its way to,
+   or failed not long ago; with the lock held */
+static
+struct session *
+find(const char *host, int port, const char *local_if, bool insecure)
+{
+	for (struct session *s = sessions; s; s = s->next)
+		if (s->state != H3_GONE && s->port == port &&
+		    !strcmp(s->host, host) && !strcmp(s->local_if, local_if) &&
+		    s->insecure == insecure &&
+		    (s->state != H3_READY || s->streams < H3_STREAMS))
+			return s;
+	return NULL;
+}
+
+int
+h3_connect(tcp_t *tcp, char *host, int port, char *local_if,
+	   unsigned io_timeout)
+{
+	double give_up = axel_gettime() + io_timeout;
+	struct session *s;
+	char alt[MAX_STRING];
+	int alt_port, cancel, state, ret = 0;
+
+	if (!local_if)
+		local_if = "";
+
+	/* The list is not to be left locked by a setup that times out */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel);
+	for (;;) {
+		pthread_mutex_lock(&h3_lock);
+		s = find(host, port, local_if, tcp->insecure);
+		if (s && s->state == H3_FAILED &&
+		    (axel_gettime() >= s->retry ||
+		     altsvc_lookup(host, port, "h3", alt, sizeof(alt),
+				   &alt_port))) {
+			/* Time to try again, or told since where to */
+			drop(s);
+			free(s);
+			s = NULL;
+		}
+		if (!s && (s = calloc(1, sizeof(*s)))) {
+			strlcpy(s->host, host, sizeof(s->host));
+			strlcpy(s->local_if, local_if, sizeof(s->local_if));
+			s->port = port;
+			s->insecure = tcp->insecure;
+			s->ai_family = tcp->ai_family;
+			s->state = H3_CONNECTING;
+			s->fd = s->wake[0] = s->wake[1] = -1;
+			s->next = sessions;
+			sessions = s;
+			state = -1;
+		} else {
+			state = s ? s->state : H3_GONE;
+		}
+		if (state == H3_READY)
+			ret = attach(s, tcp, io_timeout);
+		pthread_mutex_unlock(&h3_lock);
+
+		if (state == -1) {
+			/* A new one, for this connection to make */
+			if (session_connect(s, io_timeout))
+				continue;
+		} else if (state == H3_CONNECTING &&
+			   axel_gettime() < give_up) {
+			struct timespec delay = { .tv_nsec = 10000000 };
+
+			axel_sleep(delay);
+			continue;
+		}
+		break;
+	}
+	pthread_setcancelstate(cancel, NULL);
+
+	return ret;
+}
@@ -0,0 +1,59 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* HTTP/3: requests as streams of a QUIC connection shared between them */
+
+#ifndef AXEL_H3_H
+#define AXEL_H3_H
+
+/* QUIC runs over UDP, where a lost packet holds up only the stream it was
+ * for, and each stream has room of its own, so one connection carries a
+ * download's requests side by side the way HTTP/2 does, without TCP's
+ * head-of-line blocking on a lossy link.
+ *
+ * A server is tried over QUIC where its Alt-Svc header said HTTP/3 is, or
+ * failing that on its own port, over UDP.  One that does not answer there
+ * is left to TCP for ALTSVC_BROKEN seconds, or until it says where else
+ * HTTP/3 is.  The connections are handed to a thread that plays an HTTP/1
+ * server to them, as the HTTP/2 sessions' threads do. */
+
+/* Make tcp a stream of a QUIC connection to host:port, one already open or
+ * a new one.  Returns 1 if it is, or 0 if it is to be connected over TCP
+ * instead. */
+int h3_connect(tcp_t *tcp, char *host, int port, char *local_if,
+	       unsigned io_timeout);
+
+#endif				/* AXEL_H3_H */
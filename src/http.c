@@ -49,6 +49,9 @@
 
 #include "config.h"
 #include "axel.h"
+#include "altsvc.h"
+#include "h2.h"
+#include "h3.h"
 
 #define HDR_CHUNK 512
 
@@ -126,6 +129,19 @@ http_connect(http_t *conn, int proto, char *proxy, char *host, int port,
 		conn->proxy = 1;
 	}
 
+#ifdef HAVE_NGTCP2
+	if (conn->h3 && !conn->proxy && PROTO_IS_SECURE(proto) &&
+	    h3_connect(&conn->tcp, host, port, conn->local_if, io_timeout)) {
+		/* A stream of a QUIC connection; over TCP if there is none */
+	} else
+#endif				/* HAVE_NGTCP2 */
+#ifdef HAVE_NGHTTP2
+	if (conn->h2 && !conn->proxy && PROTO_IS_SECURE(proto)) {
+		if (h2_connect(&conn->tcp, host, port, conn->local_if,
+			       io_timeout) == -1)
+			return 0;
+	} else
+#endif				/* HAVE_NGHTTP2 */
 	if (tcp_connect(&conn->tcp, host, port, PROTO_IS_SECURE(proto),
 			conn->local_if, io_timeout) == -1)
 		return 0;
@@ -190,7 +206,17 @@ http_get(http_t *conn, char *lurl)
 			       conn->proxy_auth);
 	http_addheader(conn, "Accept: */*");
 	http_addheader(conn, "Accept-Encoding: identity");
-	if (conn->lastbyte && conn->firstbyte >= 0) {
+	if (conn->nranges) {
+		char list[MAX_STRING] = "";
+		size_t len = 0;
+
+		for (int i = 0; i < conn->nranges && len < sizeof(list); i++)
+			len += snprintf(list + len, sizeof(list) - len,
+					"%s%jd-%jd", i ? "," : "",
+					(intmax_t)conn->ranges[i].start,
+					(intmax_t)(conn->ranges[i].end - 1));
+		http_addheader(conn, "Range: bytes=%s", list);
+	} else if (conn->lastbyte && conn->firstbyte >= 0) {
 		http_addheader(conn, "Range: bytes=%jd-%jd",
 			       (intmax_t)conn->firstbyte,
 			       (intmax_t)(conn->lastbyte - 1));
@@ -198,6 +224,10 @@ http_get(http_t *conn, char *lurl)
 		http_addheader(conn, "Range: bytes=%jd-",
 			       (intmax_t)conn->firstbyte);
 	}
+	/* Should the file have changed, the whole of the new one comes back
+	   instead, rather than a piece of it to mix with the old */
+	if (conn->firstbyte >= 0 && conn->if_range && *conn->if_range)
+		http_addheader(conn, "If-Range: %s", conn->if_range);
 }
 
 void
@@ -294,6 +324,15 @@ http_exec(http_t *conn)
 	memcpy(conn->request->p, conn->headers->p, reslen);
 	*s2 = '\n';
 
+	/* Where else the server says it is, for connections yet to be made */
+	if ((conn->h2 || conn->h3) && !conn->proxy &&
+	    PROTO_IS_SECURE(conn->proto)) {
+		char alt[MAX_STRING];
+
+		if (http_header_value(conn, "Alt-Svc:", alt, sizeof(alt)))
+			altsvc_learn(conn->host, conn->port, alt);
+	}
+
 	return 1;
 }
 
@@ -347,6 +386,27 @@ http_size_from_range(http_t *conn)
 	return j;
 }
 
+size_t
+http_header_value(const http_t *conn, const char *header, char *dst,
+		  size_t len)
+{
+	const char *h = http_header(conn, header);
+	size_t n = 0;
+
+	if (h) {
+		h += strspn(h, " \t");
+		n = strcspn(h, "\n");
+		while (n && strchr(" \t", h[n - 1]))
+			n--;
+	}
+	if (len) {
+		n = min(n, len - 1);
+		memcpy(dst, h ? h : "", n);
+		dst[n] = 0;
+	}
+	return n;
+}
+
 /**
  * Extract file name from Content-Disposition HTTP header.
  *
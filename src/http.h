@@ -55,9 +55,14 @@ typedef struct {
 	char proxy_auth[MAX_STRING];
 	off_t firstbyte;
 	off_t lastbyte;
+	const char *if_range;	/* validator a range is only wanted for */
+	const range_t *ranges;	/* several, rather than firstbyte-lastbyte */
+	int nranges;
 	int status;
 	tcp_t tcp;
 	char *local_if;
+	bool h2;		/* may be a stream of a shared HTTP/2 connection */
+	bool h3;		/* or of a shared QUIC one, as HTTP/3 */
 } http_t;
 
 int http_connect(http_t *conn, int proto, char *proxy, char *host, int port,
@@ -71,6 +76,11 @@ void http_addheader(http_t *conn, const char *format, ...);
 int http_exec(http_t *conn);
 const char *http_header(const http_t *conn, const char *header);
 void http_filename(const http_t *conn, char *filename);
+
+/* Copy the value of a reply header to dst, or an empty string if there is
+   none; returns its length */
+size_t http_header_value(const http_t *conn, const char *header, char *dst,
+			 size_t len);
 off_t http_size(http_t *conn);
 off_t http_size_from_range(http_t *conn);
 void http_decode(char *s);
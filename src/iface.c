@@ -0,0 +1,236 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* Sharing a download's connections out between its interfaces */
+
+#include "config.h"
+#include "axel.h"
+
+int
+ifaces_add(ifaces_t *ifs, char *name)
+{
+	iface_t *i;
+
+	for (int k = 0; k < ifs->count; k++) {
+		if (!strcmp(ifs->i[k].name, name)) {
+			ifs->i[k].weight++;
+			return 0;
+		}
+	}
+
+	i = realloc(ifs->i, (ifs->count + 1) * sizeof(*i));
+	if (!i)
+		return -1;
+	ifs->i = i;
+	i += ifs->count++;
+	memset(i, 0, sizeof(*i));
+	i->name = name;
+	i->weight = 1;
+	return 0;
+}
+
+void
+ifaces_free(ifaces_t *ifs)
+{
+	free(ifs->i);
+	memset(ifs, 0, sizeof(*ifs));
+}
+
+int
+ifaces_count(ifaces_t *ifs, int i, off_t bytes, double now)
+{
+	double dt = now - ifs->stamp;
+
+	if (i >= 0 && i < ifs->count)
+		ifs->i[i].bytes += bytes;
+	if (!ifs->stamp) {
+		ifs->stamp = now;
+		return 0;
+	}
+	if (dt < IFACE_SAMPLE)
+		return 0;
+
+	/* Smoothed over a few samples, so that one slow second does not send
+	   every connection elsewhere; one left without connections keeps what
+	   it last did, for when there is more to spread */
+	for (int k = 0; k < ifs->count; k++) {
+		iface_t *f = &ifs->i[k];
+		double rate = f->bytes / dt;
+
+		if (!f->conns && !f->bytes)
+			continue;
+		f->rate = f->rate ? (f->rate + rate) / 2 : rate;
+		f->bytes = 0;
+	}
+	ifs->stamp = now;
+	return 1;
+}
+
+int
+ifaces_pick(const ifaces_t *ifs)
+{
+	bool rated = false;
+	double best = -1;
+	int pick = -1;
+
+	for (int k = 0; k < ifs->count; k++) {
+		if (!ifs->i[k].used)
+			return k;
+		rated |= ifs->i[k].rate > 0;
+	}
+
+	for (int k = 0; k < ifs->count; k++) {
+		const iface_t *f = &ifs->i[k];
+		double score = rated ? f->rate / (f->conns + 1) :
+		    -(double)f->conns / f->weight;
+
+		if (score > best || pick == -1) {
+			best = score;
+			pick = k;
+		}
+	}
+	return pick;
+}
+
+double
+ifaces_conn_rate(const ifaces_t *ifs, int i)
+{
+	if (i < 0 || i >= ifs->count)
+		return 0;
+	return ifs->i[i].rate / max(ifs->i[i].conns, 1);
+}
+
+int
+iface_open(axel_t *axel)
+{
+	axel_if_t *f = axel->conf->interfaces;
+
+	/* An empty list is one blank entry, for no interface in particular */
+	do {
+		if (*f->text && ifaces_add(&axel->ifaces, f->text) == -1)
+			return 0;
+	} while ((f = f->next) != axel->conf->interfaces);
+	return 1;
+}
+
+/* How many connections each interface has, setting up or reading; those
+   with nothing to do are not counted */
+static
+void
+recount(axel_t *axel)
+{
+	for (int k = 0; k < axel->ifaces.count; k++)
+		axel->ifaces.i[k].conns = 0;
+	for (int j = 0; j < axel->conf->num_connections; j++) {
+		const conn_t *c = &axel->conn[j];
+
+		if ((c->state || c->enabled) && c->iface >= 0 &&
+		    c->iface < axel->ifaces.count)
+			axel->ifaces.i[c->iface].conns++;
+	}
+}
+
+void
+iface_assign(axel_t *axel, int i)
+{
+	conn_t *conn = &axel->conn[i];
+
+	recount(axel);
+	conn->iface = ifaces_pick(&axel->ifaces);
+	if (conn->iface >= 0) {
+		conn->local_if = axel->ifaces.i[conn->iface].name;
+		axel->ifaces.i[conn->iface].conns++;
+		axel->ifaces.i[conn->iface].used = true;
+	} else {
+		conn->local_if = axel->conf->interfaces->text;
+	}
+}
+
+void
+iface_count(axel_t *axel, int i, off_t bytes, double now)
+{
+	if (axel->ifaces.count > 1 &&
+	    ifaces_count(&axel->ifaces, axel->conn[i].iface, bytes, now))
+		recount(axel);
+}
+
+/* What a connection gets on average, over the interfaces in use that have
+   been measured; 0 until one has */
+static
+double
+mean_conn_rate(const ifaces_t *ifs)
+{
+	double sum = 0;
+	int n = 0;
+
+	for (int k = 0; k < ifs->count; k++)
+		if (ifs->i[k].used && ifs->i[k].rate > 0) {
+			sum += ifaces_conn_rate(ifs, k);
+			n++;
+		}
+	return n ? sum / n : 0;
+}
+
+double
+iface_time_left(const axel_t *axel, int i, off_t remaining)
+{
+	double rate = ifaces_conn_rate(&axel->ifaces, axel->conn[i].iface);
+
+	/* One yet to be measured is taken to be as fast as the rest, so
+	   that all are in seconds as soon as any is */
+	if (rate <= 0)
+		rate = mean_conn_rate(&axel->ifaces);
+	return rate > 0 ? remaining / rate : remaining;
+}
+
+off_t
+iface_split(const axel_t *axel, int i, off_t remaining)
+{
+	double mine = ifaces_conn_rate(&axel->ifaces, axel->conn[i].iface);
+	double theirs = 0;
+	int k = ifaces_pick(&axel->ifaces);
+
+	/* The idle connection goes wherever the next one would */
+	if (k >= 0 && axel->ifaces.i[k].used)
+		theirs = axel->ifaces.i[k].rate / (axel->ifaces.i[k].conns + 1);
+	if (mine <= 0 || theirs <= 0)
+		return remaining / 2;
+
+	/* Neither is left with crumbs, however lopsided the rates */
+	double share = max(mine / (mine + theirs), 0.1);
+
+	return remaining * min(share, 0.9);
+}
@@ -0,0 +1,81 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* Sharing a download's connections out between its interfaces */
+
+#ifndef AXEL_IFACE_H
+#define AXEL_IFACE_H
+
+/* How often, in seconds, each interface's throughput is taken */
+#define IFACE_SAMPLE	1.0
+
+typedef struct {
+	char *name;		/* an address, or a device */
+	int weight;		/* how many times it was listed */
+	int conns;		/* connections going out through it */
+	bool used;		/* by any connection yet */
+	off_t bytes;		/* since the last sample */
+	double rate;		/* bytes per second, smoothed */
+} iface_t;
+
+typedef struct {
+	iface_t *i;
+	int count;
+	double stamp;		/* of the last sample */
+} ifaces_t;
+
+/* Add an interface, or weigh one listed before more; returns -1 if out of
+ * memory */
+int ifaces_add(ifaces_t *ifs, char *name);
+void ifaces_free(ifaces_t *ifs);
+
+/* Count bytes that came in through interface i, taking every interface's
+ * throughput whenever IFACE_SAMPLE has gone by since it was last taken;
+ * returns 1 if it took it this time */
+int ifaces_count(ifaces_t *ifs, int i, off_t bytes, double now);
+
+/* The interface one more connection would get the most out of: one not yet
+ * tried, else the one whose connections would each get the most with
+ * another among them, which is the one with headroom wherever a link is
+ * full.  Until there is a rate to go by, connections are spread in
+ * proportion to the weights.  Returns -1 if there are no interfaces. */
+int ifaces_pick(const ifaces_t *ifs);
+
+/* What one connection through interface i gets, in bytes per second, or 0
+ * if that is not known */
+double ifaces_conn_rate(const ifaces_t *ifs, int i);
+
+#endif				/* AXEL_IFACE_H */
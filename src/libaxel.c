@@ -0,0 +1,465 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* The download engine, for programs of their own to embed */
+
+#include "config.h"
+#include <sys/mman.h>
+#include "axel.h"
+#include "events.h"
+#include "libaxel.h"
+#include "manifest.h"
+#include "stream.h"
+
+struct libaxel {
+	conf_t conf;
+	axel_t *axel;
+	char url[MAX_STRING];
+	char path[MAX_STRING];	/* the file to write, if named */
+	libaxel_sink_fn *sink;
+	void *sink_arg;
+	bool in_order;
+	int fd;			/* for fd_sink() */
+	bool fd_seekable;
+	bool fd_sized;		/* and is to be as long as the download */
+	char *mem;		/* for mem_sink() */
+	size_t mem_len;
+	message_t *message, *last_message;
+	char text[MAX_STRING];	/* the message last taken */
+	libaxel_stats_t last;	/* how it ended, once it has */
+};
+
+static pthread_once_t process_once = PTHREAD_ONCE_INIT;
+static int process_ready;
+
+/* What is set up once for every download the process makes: TLS, of which
+   each connection has what its own download's settings say */
+static
+void
+process_init(void)
+{
+#ifdef HAVE_SSL
+	ssl_init();
+#endif				/* HAVE_SSL */
+	process_ready = axel_rnd_init() != -1;
+}
+
+static
+void
+take_messages(void *owner, message_t *first)
+{
+	libaxel_t *d = owner;
+
+	if (!first)
+		return;
+	if (d->message)
+		d->last_message->next = first;
+	else
+		d->message = first;
+	while (first->next)
+		first = first->next;
+	d->last_message = first;
+}
+
+static
+int
+fd_sink(void *arg, const void *data, size_t len, off_t offset)
+{
+	const libaxel_t *d = arg;
+
+	while (len) {
+		ssize_t n = d->fd_seekable ?
+		    pwrite(d->fd, data, len, offset) :
+		    write(d->fd, data, len);
+
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			return errno;
+		}
+		data = (const char *)data + n;
+		len -= n;
+		offset += n;
+	}
+
+	return 0;
+}
+
+static
+int
+mem_sink(void *arg, const void *data, size_t len, off_t offset)
+{
+	const libaxel_t *d = arg;
+
+	if ((size_t)offset > d->mem_len || len > d->mem_len - offset)
+		return EFBIG;
+	memcpy(d->mem + offset, data, len);
+
+	return 0;
+}
+
+libaxel_t *
+libaxel_new(const char *url)
+{
+	libaxel_t *d = calloc(1, sizeof(*d));
+
+	if (!d)
+		return NULL;
+	if (strlcpy(d->url, url, sizeof(d->url)) >= sizeof(d->url)) {
+		free(d);
+		errno = ENAMETOOLONG;
+		return NULL;
+	}
+	if (!conf_init(&d->conf)) {
+		conf_free(&d->conf);
+		free(d);
+		errno = EINVAL;
+		return NULL;
+	}
+	d->fd = -1;
+	d->last.status = -1;
+
+	return d;
+}
+
+int
+libaxel_set(libaxel_t *d, const char *key, const char *value)
+{
+	char v[MAX_STRING];
+
+	if (d->axel || d->last.status != -1) {
+		errno = EBUSY;
+		return -1;
+	}
+	if (strlcpy(v, value, sizeof(v)) >= sizeof(v) ||
+	    !conf_set(&d->conf, key, v)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+libaxel_output_file(libaxel_t *d, const char *path)
+{
+	if (d->axel || d->last.status != -1) {
+		errno = EBUSY;
+		return -1;
+	}
+	if (path && strlcpy(d->path, path, sizeof(d->path)) >= sizeof(d->path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	if (!path)
+		*d->path = '\0';
+	d->sink = NULL;
+	d->fd_sized = false;
+	d->mem = NULL;
+
+	return 0;
+}
+
+int
+libaxel_output_fd(libaxel_t *d, int fd)
+{
+	if (libaxel_output_sink(d, fd_sink, d, 0) == -1)
+		return -1;
+	d->fd = fd;
+	d->fd_seekable = lseek(fd, 0, SEEK_CUR) != -1;
+	d->in_order = !d->fd_seekable;
+
+	return 0;
+}
+
+int
+libaxel_output_memory(libaxel_t *d, void *buf, size_t len)
+{
+	if (libaxel_output_sink(d, mem_sink, d, 0) == -1)
+		return -1;
+	d->mem = buf;
+	d->mem_len = len;
+
+	return 0;
+}
+
+int
+libaxel_output_memfd(libaxel_t *d)
+{
+#ifdef HAVE_MEMFD_CREATE
+	int fd;
+
+	if (d->axel || d->last.status != -1) {
+		errno = EBUSY;
+		return -1;
+	}
+	fd = memfd_create("axel", MFD_CLOEXEC);
+	if (fd == -1)
+		return -1;
+	libaxel_output_fd(d, fd);
+	d->fd_sized = true;
+
+	return fd;
+#else
+	(void)d;
+	errno = ENOSYS;
+	return -1;
+#endif				/* HAVE_MEMFD_CREATE */
+}
+
+int
+libaxel_output_sink(libaxel_t *d, libaxel_sink_fn *fn, void *arg,
+		    int in_order)
+{
+	if (d->axel || d->last.status != -1) {
+		errno = EBUSY;
+		return -1;
+	}
+	d->sink = fn;
+	d->sink_arg = arg;
+	d->in_order = in_order;
+	d->fd_sized = false;
+	d->mem = NULL;
+
+	return 0;
+}
+
+/* Take the download's last figures, and let it go */
+static
+void
+finish(libaxel_t *d)
+{
+	axel_t *axel = d->axel;
+
+	libaxel_stats(d, &d->last);
+	d->last.active = 0;
+	d->last.status = axel->bad_checksum ? 1 : axel->ready == 1 ? 0 : 2;
+	axel_close(axel);
+	d->axel = NULL;
+}
+
+/* Make sure the memory the data goes to has room for it, now that its size
+   is known; returns 0 after saying why it has not */
+static
+int
+fit_memory(libaxel_t *d, axel_t *axel)
+{
+	if (axel->size == LLONG_MAX)
+		return 1;
+	if (d->mem && (uintmax_t)axel->size > d->mem_len) {
+		axel_message(axel, _("%jd bytes do not fit in the %zu "
+				     "given for them"),
+			     (intmax_t)axel->size, d->mem_len);
+		return 0;
+	}
+	if (d->fd_sized && ftruncate(d->fd, axel->size) == -1) {
+		axel_message(axel, _("Error creating local file: %s"),
+			     strerror(errno));
+		return 0;
+	}
+
+	return 1;
+}
+
+int
+libaxel_start(libaxel_t *d)
+{
+	axel_t *axel;
+	search_t s;
+
+	if (d->axel || d->last.status != -1) {
+		errno = EBUSY;
+		return -1;
+	}
+	pthread_once(&process_once, process_init);
+	if (!process_ready) {
+		errno = EIO;
+		return -1;
+	}
+
+	if (manifest_named(d->url)) {
+		axel = manifest_new(&d->conf, d->url);
+	} else {
+		memset(&s, 0, sizeof(s));
+		strlcpy(s.url, d->url, sizeof(s.url));
+		axel = axel_new(&d->conf, 1, &s);
+	}
+	if (!axel) {
+		d->last.status = 2;
+		return -1;
+	}
+	d->axel = axel;
+	axel->owner = d;
+	axel->take_messages = take_messages;
+	print_messages(axel);
+	if (axel->ready == -1)
+		goto fail;
+
+	if (!fit_memory(d, axel))
+		goto fail;
+	if (d->sink) {
+		/* A checksum is worked out in order, there being no file to
+		   read the data back from */
+		axel->stream = true;
+		axel->sink = d->sink;
+		axel->sink_arg = d->sink_arg;
+		axel->sink_seekable = !d->in_order && !axel->checksum.len;
+	} else if (*d->path) {
+		strlcpy(axel->filename, d->path, sizeof(axel->filename));
+		axel->stream = stream_named(d->path);
+	}
+	if (!axel_open(axel))
+		goto fail;
+	axel_start(axel);
+	axel->start_byte = axel->bytes_done;
+	if (axel->ready == -1)
+		goto fail;
+
+	return 0;
+
+ fail:
+	finish(d);
+	return -1;
+}
+
+int
+libaxel_fds(libaxel_t *d, fd_set *fds, int *maxfd, struct timeval *tv)
+{
+	struct timeval due;
+	int pending;
+
+	if (!d->axel) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	*maxfd = max(*maxfd, axel_fds(d->axel, fds, &pending));
+	if (pending || d->axel->ready)
+		timerclear(tv);
+	else if (events_timeout(d->axel, axel_gettime(), &due) &&
+		 timercmp(&due, tv, <))
+		*tv = due;
+
+	return 0;
+}
+
+int
+libaxel_step(libaxel_t *d)
+{
+	if (!d->axel)
+		return d->last.status ? -1 : 0;
+
+	if (!d->axel->ready)
+		axel_do(d->axel);
+	print_messages(d->axel);
+	if (!d->axel->ready)
+		return 1;
+
+	finish(d);
+	return d->last.status ? -1 : 0;
+}
+
+int
+libaxel_run(libaxel_t *d)
+{
+	int ret;
+
+	while ((ret = libaxel_step(d)) == 1)
+		;
+
+	return ret;
+}
+
+void
+libaxel_stats(const libaxel_t *d, libaxel_stats_t *st)
+{
+	axel_t *axel = d->axel;
+
+	if (!axel) {
+		*st = d->last;
+		return;
+	}
+
+	memset(st, 0, sizeof(*st));
+	st->size = axel->size == LLONG_MAX ? -1 : axel->size;
+	st->done = axel->bytes_done;
+	st->bytes_per_second = axel->bytes_per_second;
+	st->eta = -1;
+	if (st->size != -1 && axel->finish_time != INT_MAX &&
+	    axel->bytes_per_second)
+		st->eta = max(0, axel->finish_time -
+			      (int)axel_gettime());
+	st->connections = axel->conf->num_connections;
+	for (int i = 0; i < axel->conf->num_connections; i++) {
+		/* One being set up is not transferring anything yet */
+		if (pthread_mutex_trylock(&axel->conn[i].lock))
+			continue;
+		st->active += axel->conn[i].enabled;
+		pthread_mutex_unlock(&axel->conn[i].lock);
+	}
+	st->status = -1;
+}
+
+const char *
+libaxel_message(libaxel_t *d)
+{
+	message_t *m;
+
+	if (d->axel)
+		print_messages(d->axel);
+	m = d->message;
+	if (!m)
+		return NULL;
+
+	strlcpy(d->text, m->text, sizeof(d->text));
+	d->message = m->next;
+	free(m);
+
+	return d->text;
+}
+
+void
+libaxel_free(libaxel_t *d)
+{
+	if (!d)
+		return;
+	if (d->axel)
+		finish(d);
+	while (libaxel_message(d))
+		;
+	conf_free(&d->conf);
+	free(d);
+}
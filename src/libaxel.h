@@ -0,0 +1,152 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* The download engine, for programs of their own to embed */
+
+#ifndef LIBAXEL_H
+#define LIBAXEL_H
+
+#include <stddef.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+/* A libaxel download goes through these steps:
+ *
+ *   libaxel_new()	names what to fetch
+ *   libaxel_set()	changes its settings, as an axelrc would
+ *   libaxel_output_*()	says where the data goes: a file by default
+ *   libaxel_start()	finds the file and starts fetching it
+ *   libaxel_step()	moves it along, until it says it is done
+ *   libaxel_free()	stops it if it is not, and frees it
+ *
+ * and may be looked at with libaxel_stats() and libaxel_message() at any
+ * point.  Each download is independent, but its functions are to be called
+ * from one thread at a time.
+ *
+ * A program that has a loop of its own adds what the download waits on to
+ * it with libaxel_fds(), and steps it when any of that is ready or the time
+ * it asked for has passed.  One that has nothing else to do can leave the
+ * waiting to libaxel_run().
+ *
+ * Writing to a connection the server has closed raises SIGPIPE, which the
+ * program is to ignore, as axel does. */
+typedef struct libaxel libaxel_t;
+
+/* Takes len bytes of the download, at offset from its start.  Returns 0, or
+ * an errno to stop the download with. */
+typedef int libaxel_sink_fn(void *arg, const void *data, size_t len,
+			    off_t offset);
+
+typedef struct {
+	off_t size;		/* of the whole download, or -1 if unknown */
+	off_t done;		/* how much of it is fetched */
+	long long bytes_per_second;
+	int eta;		/* seconds left, or -1 if unknown */
+	int connections;	/* how many it is fetched over */
+	int active;		/* how many of those are transferring */
+	int status;		/* -1 until it is done, then as axel exits */
+} libaxel_stats_t;
+
+/* A download of url, which may also name a Metalink or zsync file.  Its
+ * settings start out as axel's would, from the axelrc files.  Returns NULL
+ * with errno set if it cannot be had. */
+libaxel_t *libaxel_new(const char *url);
+
+/* Set key to value, both as they would be written in an axelrc; only
+ * before the download is started.  Returns -1 with errno set to EINVAL if
+ * there is no such key or value is no good for it. */
+int libaxel_set(libaxel_t *d, const char *key, const char *value);
+
+/* Where the data goes, before the download is started.
+ *
+ * A file is named path, or after the URL if path is NULL, and is resumed
+ * from its state file if it has one, as with axel -o.  The other two
+ * create no file: the data is written to fd, or handed to fn, at offsets
+ * that follow no order unless in_order is set or fd cannot seek, and is
+ * not resumed.  fn is called from a thread of the download's own; fd is
+ * neither truncated nor closed.  With a checksum to check, the data comes
+ * in order whatever was asked for. */
+int libaxel_output_file(libaxel_t *d, const char *path);
+int libaxel_output_fd(libaxel_t *d, int fd);
+int libaxel_output_sink(libaxel_t *d, libaxel_sink_fn *fn, void *arg,
+			int in_order);
+
+/* Where the data goes, for something small enough to be kept in memory.
+ * Neither creates a file or is resumed; both are written at offsets in no
+ * order, straight from the blocks the connections read into, so the data
+ * is copied no more often than a write() to a file would copy it, and
+ * kept only the once.
+ *
+ * A region of len bytes is filled from its start; a download larger than
+ * it fails before anything is fetched, if its size is known, or at the
+ * first byte past it if not.
+ *
+ * A memory file is made by libaxel_output_memfd() itself, sized to the
+ * download when it starts, and returned for the caller to read, map and
+ * close; or -1 with errno set if there is none to be had. */
+int libaxel_output_memory(libaxel_t *d, void *buf, size_t len);
+int libaxel_output_memfd(libaxel_t *d);
+
+/* Find the file and start fetching it.  Waits for the first server to
+ * answer.  Returns -1 if it cannot, and libaxel_message() says why. */
+int libaxel_start(libaxel_t *d);
+
+/* Add what the download waits on to fds, raising *maxfd to the highest of
+ * it, and lower *tv to when it is next to be stepped whatever it hears.
+ * Returns -1 with errno set to EINVAL if it is not running. */
+int libaxel_fds(libaxel_t *d, fd_set *fds, int *maxfd, struct timeval *tv);
+
+/* Read what has come in, and do whatever is due.  May wait for as long as
+ * libaxel_fds() said it would, and longer to keep to a speed limit.
+ * Returns 1 while the download runs, 0 once it is done, and -1 if it has
+ * failed; either way the data is all out of it by then. */
+int libaxel_step(libaxel_t *d);
+
+/* Step the download until it is done.  Returns as libaxel_step() does. */
+int libaxel_run(libaxel_t *d);
+
+void libaxel_stats(const libaxel_t *d, libaxel_stats_t *st);
+
+/* The oldest thing the download has to say that has not been taken yet,
+ * or NULL.  Valid until the next call. */
+const char *libaxel_message(libaxel_t *d);
+
+/* Stop the download if it runs, leaving a file its state file to resume
+ * from, and free it. */
+void libaxel_free(libaxel_t *d);
+
+#endif				/* LIBAXEL_H */
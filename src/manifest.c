@@ -0,0 +1,243 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+
+/* Downloads described by a file rather than a URL */
+
+#include "config.h"
+#include "axel.h"
+#include "manifest.h"
+
+int
+manifest_named(const char *arg)
+{
+	return metalink_named(arg) || zsync_named(arg);
+}
+
+/**
+ * Build the download from the n mirrors in search, to be saved under name
+ * unless -o says otherwise, and of size bytes unless that is -1.
+ */
+static
+axel_t *
+from_mirrors(conf_t *conf, const search_t *search, int n, const char *name,
+	     off_t size)
+{
+	axel_t *axel = axel_new(conf, n, search);
+
+	if (!axel)
+		return NULL;
+
+	/* Each mirror has validators of its own: it is the hashes that tell
+	   this file from any other */
+	axel->if_range = NULL;
+	*axel->etag = *axel->last_modified = 0;
+	strlcpy(axel->filename, name, sizeof(axel->filename));
+	if (axel->ready != -1 && size >= 0 && axel->size != size) {
+		axel_message(axel, _("The file is %jd bytes, %jd were "
+				     "expected"), (intmax_t)axel->size,
+			     (intmax_t)size);
+		axel->ready = -1;
+	}
+	return axel;
+}
+
+/* The mirrors a Metalink lists, best first */
+static
+axel_t *
+from_metalink(conf_t *conf, const char *path)
+{
+	metalink_t *ml = metalink_load(path);
+	search_t *search;
+	axel_t *axel;
+
+	if (!ml) {
+		fprintf(stderr, _("Can't read Metalink %s: %s\n"), path,
+			strerror(errno));
+		return NULL;
+	}
+	search = calloc(ml->nurls, sizeof(search_t));
+	if (!search) {
+		metalink_free(ml);
+		return NULL;
+	}
+	for (int i = 0; i < ml->nurls; i++)
+		strlcpy(search[i].url, ml->urls[i].url, sizeof(search[i].url));
+	axel = from_mirrors(conf, search, ml->nurls, ml->name, ml->size);
+	free(search);
+	if (!axel) {
+		metalink_free(ml);
+		return NULL;
+	}
+
+	axel->metalink = ml;
+	if (!*conf->checksum && ml->hash.len)
+		axel->checksum = ml->hash;
+	return axel;
+}
+
+/* The mirrors a zsync control file lists; relative URLs are relative to
+   where it was downloaded from, which a local file does not say */
+static
+axel_t *
+from_zsync(conf_t *conf, const char *path)
+{
+	zsync_t *z = zsync_load(path);
+	search_t *search;
+	axel_t *axel;
+	int n = 0;
+
+	if (!z) {
+		fprintf(stderr, _("Can't read zsync control file %s: %s\n"),
+			path, strerror(errno));
+		return NULL;
+	}
+	search = calloc(z->nurls, sizeof(search_t));
+	if (!search) {
+		zsync_free(z);
+		return NULL;
+	}
+	for (int i = 0; i < z->nurls; i++)
+		if (strstr(z->urls[i], "://"))
+			strlcpy(search[n++].url, z->urls[i],
+				sizeof(search->url));
+	if (!n) {
+		fprintf(stderr, _("%s has only relative URLs\n"), path);
+		free(search);
+		zsync_free(z);
+		return NULL;
+	}
+	axel = from_mirrors(conf, search, n, z->filename, z->length);
+	free(search);
+	if (!axel) {
+		zsync_free(z);
+		return NULL;
+	}
+
+	axel->zsync = z;
+	if (!*conf->checksum && z->sha1.len)
+		axel->checksum = z->sha1;
+	return axel;
+}
+
+axel_t *
+manifest_new(conf_t *conf, const char *path)
+{
+	return metalink_named(path) ? from_metalink(conf, path) :
+	    from_zsync(conf, path);
+}
+
+/* Queue len bytes of data to be written at offset, as if downloaded */
+static
+void
+put(axel_t *axel, const char *data, off_t offset, size_t len)
+{
+	while (len) {
+		size_t n = min(len, (size_t)axel->conf->buffer_size);
+		char *block;
+
+		while (!(block = writer_get(axel->writer)))
+			writer_wait(axel->writer, NULL);
+		memcpy(block, data, n);
+		writer_put(axel->writer, block, offset, n);
+		if (ranges_add(&axel->done, offset, offset + n) == -1) {
+			axel_message(axel, "%s", strerror(errno));
+			axel->ready = -1;
+		}
+		axel->bytes_done += n;
+		data += n;
+		offset += n;
+		len -= n;
+	}
+}
+
+/* For zsync_seed(): a block found, of which only what a run before did not
+   get is needed */
+static
+void
+copy_block(void *arg, const void *data, off_t offset, size_t len)
+{
+	axel_t *axel = arg;
+	range_t gap;
+
+	for (off_t at = offset;
+	     ranges_gap(&axel->done, at, offset + len, &gap); at = gap.end)
+		put(axel, (const char *)data + (gap.start - offset), gap.start,
+		    gap.end - gap.start);
+}
+
+int
+manifest_seed(axel_t *axel)
+{
+	const char *seed = axel->conf->seed;
+	struct stat st, out;
+	char found[32], total[32];
+	off_t before = axel->bytes_done;
+
+	/* A pipe takes the blocks in order, and a seed has them in any */
+	if (!axel->zsync || !axel->conn[0].supported || axel->stream)
+		return 1;
+	if (!*seed) {
+		seed = axel->zsync->filename;
+		if (access(seed, R_OK))
+			return 1;
+	}
+
+	/* Blocks move about: copying the file over itself would lose some */
+	errno = 0;
+	if (stat(seed, &st) || fstat(axel->outfd, &out) ||
+	    (st.st_dev == out.st_dev && st.st_ino == out.st_ino)) {
+		axel_message(axel, _("Can't use %s as the seed: %s"), seed,
+			     errno ? strerror(errno) : _("it is the output"));
+		return !*axel->conf->seed;
+	}
+
+	if (zsync_seed(axel->zsync, seed, copy_block, axel) == -1) {
+		axel_message(axel, _("Can't read %s: %s"), seed,
+			     strerror(errno));
+		return !*axel->conf->seed;
+	}
+	if (axel->bytes_done == before)
+		return 1;
+
+	axel_size_human(found, sizeof(found), axel->bytes_done - before);
+	axel_size_human(total, sizeof(total), axel->size);
+	axel_message(axel, _("Found %s of %s in %s"), found, total, seed);
+
+	/* Only the rest is for the connections to share */
+	return axel_divide(axel);
+}
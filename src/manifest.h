@@ -0,0 +1,59 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+
+/* Downloads described by a file rather than a URL */
+
+#ifndef AXEL_MANIFEST_H
+#define AXEL_MANIFEST_H
+
+/* Whether a command line argument names a Metalink or a zsync control file
+ * rather than a URL */
+int manifest_named(const char *arg);
+
+/* Build the download from the mirrors the file at path lists, under the
+ * name it gives, to be checked against the hashes it has.  Returns NULL
+ * after reporting why. */
+axel_t *manifest_new(conf_t *conf, const char *path);
+
+/* Once the output file is open: with a zsync control file, copy what the
+ * older file given with --seed, or the one under the name the control file
+ * gives, still has of the new one, so that only the rest is downloaded.
+ * Returns 0 if the seed that was asked for cannot be used. */
+int manifest_seed(axel_t *axel);
+
+#endif				/* AXEL_MANIFEST_H */
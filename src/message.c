@@ -0,0 +1,136 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2001-2007 Wilmer van der Gaast
+  Copyright 2007-2009 Y Giridhar Appaji Nag
+  Copyright 2008-2009 Philipp Hagemeister
+  Copyright 2015-2017 Joao Eriberto Mota Filho
+  Copyright 2016      Denis Denisov
+  Copyright 2016      Ivan Gimenez
+  Copyright 2016      Sjjad Hashemian
+  Copyright 2016      Stephen Thirlwall
+  Copyright 2017      Antonio Quartulli
+  Copyright 2017-2019 Ismael Luceno
+  Copyright 2017      nemermollon
+  Copyright 2018      Shankar
+  Copyright 2019      Evangelos Foutras
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* What a download has to say, and how it is said */
+
+#include "config.h"
+#include "axel.h"
+
+/* Add a message to the axel->message structure */
+void
+axel_message(axel_t *axel, const char *format, ...)
+{
+	message_t *m;
+	va_list params;
+
+	if (!axel)
+		goto nomem;
+
+	m = calloc(1, sizeof(message_t));
+	if (!m)
+		goto nomem;
+
+	va_start(params, format);
+	vsnprintf(m->text, MAX_STRING, format, params);
+	va_end(params);
+
+	if (axel->message == NULL) {
+		axel->message = axel->last_message = m;
+	} else {
+		axel->last_message->next = m;
+		axel->last_message = m;
+	}
+
+	return;
+
+ nomem:
+	/* Flush previous messages */
+	print_messages(axel);
+	va_start(params, format);
+	vprintf(format, params);
+	va_end(params);
+}
+
+/* Print any message in the axel structure */
+void
+print_messages(axel_t *axel)
+{
+	message_t *m;
+
+	if (!axel)
+		return;
+
+	/* Whoever embeds the download takes them as they are */
+	if (axel->take_messages) {
+		axel->take_messages(axel->owner, axel->message);
+		axel->message = NULL;
+		return;
+	}
+
+	while ((m = axel->message)) {
+		printf("%s\n", m->text);
+		axel->message = m->next;
+		free(m);
+	}
+}
+
+/**
+ * Integer base-2 logarithm.
+ */
+static inline
+unsigned
+log2i(unsigned long long x)
+{
+	return x ? sizeof(x) * 8 - 1 - __builtin_clzll(x) : 0;
+}
+
+/* Convert a number of bytes to a human-readable form */
+char *
+axel_size_human(char *dst, size_t len, size_t value)
+{
+	double fval = (double)value;
+	const char * const oname[] = {
+		"", _("Kilo"), _("Mega"), _("Giga"), _("Tera"),
+	};
+	const unsigned int order = min(sizeof(oname) / sizeof(oname[0]) - 1,
+				       log2i(fval) / 10);
+
+	fval /= (double)(1 << order * 10);
+	int ret = snprintf(dst, len, _("%g %sbyte(s)"), fval, oname[order]);
+	return ret < 0 ? NULL : dst;
+}
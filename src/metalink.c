@@ -0,0 +1,488 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+
+/* Reading a Metalink (RFC 5854): where a file is, and what it hashes to */
+
+#include "config.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+
+#include "ranges.h"
+#include "digest.h"
+#include "metalink.h"
+
+/* No Metalink is that long; whatever is, is something else */
+#define METALINK_MAX	(16 << 20)
+
+/* How a mirror that gives no priority ranks: last, RFC 5854 says */
+#define PRIORITY_NONE	999999
+
+/* Not a full XML parser: elements, attributes, the five predefined entities
+ * and character references, with comments, processing instructions and
+ * declarations skipped, which is all a Metalink is made of.  Namespaces are
+ * read by their local names alone. */
+struct parser {
+	metalink_t *ml;
+	int depth;
+	int file;		/* depth of the first <file>; -1 once it ends */
+	bool in_pieces;
+	char elem[8];		/* the one whose text is being read, if any */
+	int elem_depth;
+	const char *text;	/* where that text starts */
+	char type[16];		/* its type attribute, for a <hash> */
+	int priority;		/* and its priority, for a <url> */
+	size_t hashes_alloc;
+};
+
+int
+metalink_named(const char *arg)
+{
+	static const char *const ext[] = { ".meta4", ".metalink" };
+	size_t len = strlen(arg);
+
+	if (strstr(arg, "://"))
+		return 0;
+	for (size_t i = 0; i < sizeof(ext) / sizeof(*ext); i++) {
+		size_t n = strlen(ext[i]);
+
+		if (len > n && !strcasecmp(arg + len - n, ext[i]))
+			return 1;
+	}
+	return 0;
+}
+
+/* Replace entities and character references in place; ones it does not
+   know, and characters past ASCII, are left as they are */
+static
+void
+unescape(char *s)
+{
+	static const struct {
+		const char *name;
+		char c;
+	} entity[] = {
+		{ "amp;", '&' }, { "lt;", '<' }, { "gt;", '>' },
+		{ "quot;", '"' }, { "apos;", '\'' },
+	};
+	char *d = s;
+
+	while (*s) {
+		if (*s != '&') {
+			*d++ = *s++;
+			continue;
+		}
+
+		size_t i;
+		for (i = 0; i < sizeof(entity) / sizeof(*entity); i++)
+			if (!strncmp(s + 1, entity[i].name,
+				     strlen(entity[i].name)))
+				break;
+		if (i < sizeof(entity) / sizeof(*entity)) {
+			*d++ = entity[i].c;
+			s += 1 + strlen(entity[i].name);
+			continue;
+		}
+
+		char *e;
+		unsigned long c = s[1] != '#' ? 0 :
+		    s[2] == 'x' ? strtoul(s + 3, &e, 16) : strtoul(s + 2, &e, 10);
+		if (c && c < 128 && *e == ';') {
+			*d++ = c;
+			s = e + 1;
+		} else {
+			*d++ = *s++;
+		}
+	}
+	*d = 0;
+}
+
+/* Copy [s, end) without the space around it, and with its entities
+   replaced.  Returns NULL if out of memory. */
+static
+char *
+text(const char *s, const char *end)
+{
+	char *t;
+
+	while (s < end && isspace((unsigned char)*s))
+		s++;
+	while (end > s && isspace((unsigned char)end[-1]))
+		end--;
+	t = strndup(s, end - s);
+	if (t)
+		unescape(t);
+	return t;
+}
+
+/* The value of attribute name among those in [s, end), at most size - 1
+   characters of it.  Returns 1 if there is one, 0 if not. */
+static
+int
+attr(const char *s, const char *end, const char *name, char *buf,
+     size_t size)
+{
+	while (s < end) {
+		const char *n = s, *v;
+		size_t len;
+
+		while (s < end && *s != '=' && !isspace((unsigned char)*s))
+			s++;
+		len = s - n;
+		while (s < end && isspace((unsigned char)*s))
+			s++;
+		if (s == end || *s != '=') {
+			s += s < end && s == n;
+			continue;
+		}
+		while (++s < end && isspace((unsigned char)*s))
+			;
+		if (s == end || (*s != '"' && *s != '\''))
+			return 0;
+		v = s + 1;
+		s = memchr(v, *s, end - v);
+		if (!s)
+			return 0;
+		if (len == strlen(name) && !memcmp(n, name, len)) {
+			len = s - v < (ptrdiff_t)size ? (size_t)(s - v) : size - 1;
+			memcpy(buf, v, len);
+			buf[len] = 0;
+			unescape(buf);
+			return 1;
+		}
+		s++;
+	}
+	return 0;
+}
+
+static
+int
+is(const char *name, size_t len, const char *what)
+{
+	return len == strlen(what) && !memcmp(name, what, len);
+}
+
+/* An element starts, its attributes in [attrs, gt) */
+static
+int
+open_elem(struct parser *p, const char *name, size_t len, const char *attrs,
+	  const char *gt)
+{
+	char value[32], spec[sizeof(value) + 3];
+	digest_spec_t hash;
+
+	if (!p->file && is(name, len, "file")) {
+		char path[1024];
+		const char *base;
+
+		/* Where it goes is up to the user: only the name is taken */
+		if (!attr(attrs, gt, "name", path, sizeof(path)))
+			return -1;
+		base = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+		if (!*base || !strcmp(base, ".") || !strcmp(base, ".."))
+			return -1;
+		p->ml->name = strdup(base);
+		if (!p->ml->name)
+			return -1;
+		p->file = p->depth;
+		return 0;
+	}
+	if (p->file <= 0)
+		return 0;
+
+	if (p->depth == p->file + 1 && is(name, len, "pieces")) {
+		if (!attr(attrs, gt, "length", value, sizeof(value)) ||
+		    (p->ml->piece_len = strtoll(value, NULL, 10)) <= 0 ||
+		    !attr(attrs, gt, "type", value, sizeof(value)))
+			return -1;
+		/* By the name OpenSSL knows it by */
+		snprintf(spec, sizeof(spec), "%s:00", value);
+		if (digest_spec_parse(&hash, spec))
+			return -1;
+		strcpy(p->ml->piece_algo, hash.algo);
+		p->in_pieces = true;
+		return 0;
+	}
+
+	if (p->depth == p->file + 1 ?
+	    !is(name, len, "size") && !is(name, len, "hash") &&
+	    !is(name, len, "url") :
+	    !p->in_pieces || p->depth != p->file + 2 || !is(name, len, "hash"))
+		return 0;
+
+	memcpy(p->elem, name, len);
+	p->elem[len] = 0;
+	p->elem_depth = p->depth;
+	p->text = gt + 1;
+	if (!attr(attrs, gt, "type", p->type, sizeof(p->type)))
+		*p->type = 0;
+	p->priority = attr(attrs, gt, "priority", value, sizeof(value)) ?
+	    atoi(value) : PRIORITY_NONE;
+	return 0;
+}
+
+/* The text of the element being read is [p->text, end) */
+static
+int
+got_text(struct parser *p, const char *end)
+{
+	metalink_t *ml = p->ml;
+	char *t = text(p->text, end), *e;
+	char spec[16 + 2 * DIGEST_MAX + 2];
+	digest_spec_t hash;
+	int ret = 0;
+
+	if (!t)
+		return -1;
+
+	if (!strcmp(p->elem, "size")) {
+		ml->size = strtoll(t, &e, 10);
+		if (!*t || *e || ml->size < 0)
+			ret = -1;
+	} else if (!strcmp(p->elem, "url")) {
+		metalink_url_t *u = realloc(ml->urls,
+					    (ml->nurls + 1) * sizeof(*u));
+
+		if (!u) {
+			ret = -1;
+		} else {
+			ml->urls = u;
+			u[ml->nurls].url = t;
+			u[ml->nurls++].priority = p->priority;
+			t = NULL;
+		}
+	} else if (!p->in_pieces) {
+		/* Several may be given: the strongest known one is kept */
+		snprintf(spec, sizeof(spec), "%s:%s", p->type, t);
+		if (!digest_spec_parse(&hash, spec) && hash.len > ml->hash.len)
+			ml->hash = hash;
+	} else {
+		snprintf(spec, sizeof(spec), "%s:%s", ml->piece_algo, t);
+		if (digest_spec_parse(&hash, spec) ||
+		    (ml->pieces && hash.len != ml->piece_hash_len))
+			ret = -1;
+		else if (ml->pieces == p->hashes_alloc) {
+			size_t alloc = p->hashes_alloc ? 2 * p->hashes_alloc : 64;
+			unsigned char *h = realloc(ml->piece_hashes,
+						   alloc * hash.len);
+
+			if (h) {
+				ml->piece_hashes = h;
+				p->hashes_alloc = alloc;
+			} else {
+				ret = -1;
+			}
+		}
+		if (!ret) {
+			memcpy(ml->piece_hashes + ml->pieces * hash.len,
+			       hash.want, hash.len);
+			ml->piece_hash_len = hash.len;
+			ml->pieces++;
+		}
+	}
+	free(t);
+	return ret;
+}
+
+/* An element ends, its text, if it is one being read, ending at end */
+static
+int
+close_elem(struct parser *p, const char *name, size_t len, const char *end)
+{
+	int ret = 0;
+
+	if (*p->elem && p->depth == p->elem_depth && is(name, len, p->elem)) {
+		ret = got_text(p, end);
+		*p->elem = 0;
+	}
+	if (p->in_pieces && p->depth == p->file + 1 && is(name, len, "pieces"))
+		p->in_pieces = false;
+	if (p->depth == p->file && is(name, len, "file"))
+		p->file = -1;
+	p->depth--;
+	return ret;
+}
+
+/* The tag in [lt, gt] */
+static
+int
+tag(struct parser *p, const char *lt, const char *gt)
+{
+	bool closing = lt[1] == '/', empty = !closing && gt[-1] == '/';
+	const char *name = lt + 1 + closing, *end = name, *local;
+	int ret = 0;
+
+	while (end < gt && !isspace((unsigned char)*end) && *end != '/')
+		end++;
+	local = memchr(name, ':', end - name);
+	local = local ? local + 1 : name;
+
+	if (!closing) {
+		p->depth++;
+		ret = open_elem(p, local, end - local, end, gt - empty);
+	}
+	if (!ret && (closing || empty))
+		ret = close_elem(p, local, end - local, closing ? lt : p->text);
+	return ret;
+}
+
+/* Where the markup starting at s ends: past the closing of a comment, and
+   of anything else at the first > out of quotes */
+static
+const char *
+markup_end(const char *s, const char *end)
+{
+	char quote = 0;
+
+	if (end - s >= 4 && !memcmp(s, "<!--", 4)) {
+		for (s += 4; end - s >= 3; s++)
+			if (!memcmp(s, "-->", 3))
+				return s + 2;
+		return NULL;
+	}
+	for (s++; s < end; s++) {
+		if (quote) {
+			quote = *s == quote ? 0 : quote;
+		} else if (*s == '"' || *s == '\'') {
+			quote = *s;
+		} else if (*s == '>') {
+			return s;
+		}
+	}
+	return NULL;
+}
+
+/* Best first, and in the order given between equals */
+static
+void
+sort_urls(metalink_t *ml)
+{
+	for (int i = 1; i < ml->nurls; i++) {
+		metalink_url_t u = ml->urls[i];
+		int j;
+
+		for (j = i; j > 0 && ml->urls[j - 1].priority > u.priority; j--)
+			ml->urls[j] = ml->urls[j - 1];
+		ml->urls[j] = u;
+	}
+}
+
+metalink_t *
+metalink_parse(const char *xml, size_t len)
+{
+	const char *s = xml, *end = xml + len, *gt;
+	struct parser p = { 0 };
+
+	p.ml = calloc(1, sizeof(*p.ml));
+	if (!p.ml)
+		return NULL;
+	p.ml->size = -1;
+
+	while (s < end && (s = memchr(s, '<', end - s))) {
+		gt = markup_end(s, end);
+		if (!gt)
+			goto invalid;
+		errno = 0;
+		if (s[1] != '?' && s[1] != '!' && tag(&p, s, gt) == -1) {
+			if (errno == ENOMEM)
+				goto fail;
+			goto invalid;
+		}
+		s = gt + 1;
+	}
+
+	/* The pieces have to cover the file, exactly */
+	if (p.file != -1 || !p.ml->nurls || (p.ml->piece_len && p.ml->size >= 0 &&
+	     p.ml->pieces != (size_t)((p.ml->size + p.ml->piece_len - 1) /
+				      p.ml->piece_len)))
+		goto invalid;
+	sort_urls(p.ml);
+
+	return p.ml;
+ invalid:
+	errno = EINVAL;
+ fail:
+	metalink_free(p.ml);
+	return NULL;
+}
+
+metalink_t *
+metalink_load(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	metalink_t *ml = NULL;
+	char *xml;
+	size_t len;
+
+	if (!f)
+		return NULL;
+	xml = malloc(METALINK_MAX);
+	if (xml) {
+		len = fread(xml, 1, METALINK_MAX, f);
+		if (ferror(f))
+			errno = EIO;
+		else if (len == METALINK_MAX)
+			errno = EFBIG;
+		else
+			ml = metalink_parse(xml, len);
+		free(xml);
+	}
+	fclose(f);
+	return ml;
+}
+
+void
+metalink_free(metalink_t *ml)
+{
+	if (!ml)
+		return;
+
+	for (int i = 0; i < ml->nurls; i++)
+		free(ml->urls[i].url);
+	free(ml->urls);
+	free(ml->piece_hashes);
+	free(ml->name);
+	free(ml);
+}
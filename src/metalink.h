@@ -0,0 +1,79 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+
+/* Reading a Metalink (RFC 5854): where a file is, and what it hashes to */
+
+#ifndef AXEL_METALINK_H
+#define AXEL_METALINK_H
+
+/* A mirror, and how much it is to be preferred: the lower the better */
+typedef struct {
+	char *url;
+	int priority;
+} metalink_url_t;
+
+/* The first <file> a Metalink describes.  Only what a download can use is
+ * kept: the mirrors, best first, the size, the strongest hash given for
+ * the whole file, and the hashes of its pieces, which are piece_len bytes
+ * each but the last, and piece_hash_len bytes one after the other in
+ * piece_hashes. */
+typedef struct {
+	char *name;
+	off_t size;		/* -1 if it does not say */
+	digest_spec_t hash;	/* len is 0 if it gives none */
+	char piece_algo[16];
+	off_t piece_len;
+	size_t pieces, piece_hash_len;
+	unsigned char *piece_hashes;
+	metalink_url_t *urls;
+	int nurls;
+} metalink_t;
+
+/* Whether a command line argument names a Metalink file rather than a URL */
+int metalink_named(const char *arg);
+
+/* Read a Metalink from len bytes of XML.  Returns NULL with errno set:
+ * EINVAL if it is not one axel can use. */
+metalink_t *metalink_parse(const char *xml, size_t len);
+
+/* The same, from a file */
+metalink_t *metalink_load(const char *path);
+
+void metalink_free(metalink_t *ml);
+
+#endif				/* AXEL_METALINK_H */
@@ -0,0 +1,206 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Reading a multipart/byteranges reply */
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+
+#include "multipart.h"
+
+enum {
+	MP_DELIM,		/* before a delimiter, or between parts */
+	MP_HEADERS,
+	MP_BODY,
+	MP_DONE,		/* past the closing delimiter */
+};
+
+int
+multipart_init(multipart_t *mp, const char *content_type)
+{
+	static const char type[] = "multipart/byteranges";
+	const char *p = content_type + strspn(content_type, " \t");
+	size_t len;
+
+	memset(mp, 0, sizeof(*mp));
+	if (strncasecmp(p, type, sizeof(type) - 1))
+		return 0;
+
+	for (p += sizeof(type) - 1; (p = strchr(p, ';')); ) {
+		p++;
+		p += strspn(p, " \t");
+		if (strncasecmp(p, "boundary=", 9))
+			continue;
+		p += 9;
+		if (*p == '"')
+			len = strcspn(++p, "\"");
+		else
+			len = strcspn(p, "; \t\r\n");
+		if (!len || len > MULTIPART_BOUNDARY)
+			return 0;
+		mp->delim[0] = mp->delim[1] = '-';
+		memcpy(mp->delim + 2, p, len);
+		mp->delim[len + 2] = 0;
+		mp->state = MP_DELIM;
+		return 1;
+	}
+
+	return 0;
+}
+
+void
+multipart_single(multipart_t *mp, off_t start, off_t end)
+{
+	memset(mp, 0, sizeof(*mp));
+	mp->state = end > start ? MP_BODY : MP_DONE;
+	mp->offset = start;
+	mp->left = end - start;
+}
+
+/* A whole line of the text between the parts has been read */
+static
+int
+line_end(multipart_t *mp)
+{
+	char *line = mp->line;
+	size_t len = mp->line_len;
+	intmax_t first, last;
+
+	if (len && line[len - 1] == '\r')
+		len--;
+	line[len] = 0;
+	mp->line_len = 0;
+
+	switch (mp->state) {
+	case MP_DELIM:
+		/* Anything else is the preamble, or the line break that
+		   belongs to the delimiter after a part */
+		if (strncmp(line, mp->delim, strlen(mp->delim)))
+			return 0;
+		line += strlen(mp->delim);
+		if (!strcmp(line, "--")) {
+			mp->state = MP_DONE;
+		} else if (!*line) {
+			mp->state = MP_HEADERS;
+			mp->have_range = false;
+		}
+		return 0;
+	case MP_HEADERS:
+		if (!*line) {
+			if (!mp->have_range)
+				return -1;
+			mp->state = MP_BODY;
+			return 0;
+		}
+		if (strncasecmp(line, "Content-Range:", 14))
+			return 0;
+		if (sscanf(line + 14, " bytes %jd-%jd", &first, &last) != 2 ||
+		    first < 0 || last < first)
+			return -1;
+		mp->offset = first;
+		mp->left = last - first + 1;
+		mp->have_range = true;
+		return 0;
+	}
+	return -1;
+}
+
+ssize_t
+multipart_parse(multipart_t *mp, const char *buf, size_t len, size_t max,
+		size_t *n, off_t *offset)
+{
+	size_t used = 0;
+
+	*n = 0;
+	while (used < len) {
+		if (mp->state == MP_DONE)
+			return len;	/* the epilogue */
+
+		if (mp->state == MP_BODY) {
+			off_t take = len - used;
+
+			if (take > mp->left)
+				take = mp->left;
+			if ((size_t)take > max)
+				take = max;
+			*n = take;
+			*offset = mp->offset;
+			mp->offset += take;
+			mp->left -= take;
+			/* A body that is not in parts ends with its range */
+			if (!mp->left)
+				mp->state = *mp->delim ? MP_DELIM : MP_DONE;
+			return used + take;
+		}
+
+		char c = buf[used++];
+		if (c == '\n') {
+			if (line_end(mp) < 0)
+				return -1;
+			/* Stop where the payload starts */
+			if (mp->state == MP_BODY)
+				return used;
+			continue;
+		}
+		if (mp->line_len + 1 >= sizeof(mp->line))
+			return -1;
+		mp->line[mp->line_len++] = c;
+	}
+
+	return used;
+}
+
+int
+multipart_in_body(const multipart_t *mp, off_t *offset)
+{
+	if (mp->state != MP_BODY)
+		return 0;
+	*offset = mp->offset;
+	return 1;
+}
+
+int
+multipart_done(const multipart_t *mp)
+{
+	return mp->state == MP_DONE;
+}
@@ -0,0 +1,85 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Reading a multipart/byteranges reply */
+
+#ifndef AXEL_MULTIPART_H
+#define AXEL_MULTIPART_H
+
+/* RFC 2046 caps a boundary at 70 characters */
+#define MULTIPART_BOUNDARY	70
+
+/* The reply to a Range header asking for more than one range comes back in
+ * parts, each with a Content-Range saying where it goes and the bytes after
+ * it.  The parser is fed the body as it arrives, in whatever pieces the
+ * reads cut it into, and hands back the payload one stretch at a time, so
+ * that each can be written where it belongs. */
+typedef struct {
+	char delim[MULTIPART_BOUNDARY + 3];	/* "--" and the boundary */
+	char line[256];		/* the delimiter or header being read */
+	size_t line_len;
+	int state;
+	bool have_range;
+	off_t offset;		/* where the next payload byte goes */
+	off_t left;		/* and how many the part has left */
+} multipart_t;
+
+/* Whether a Content-Type is multipart/byteranges, and if it is, set up to
+ * read a body delimited by its boundary.  Returns 1 if it is, 0 if not. */
+int multipart_init(multipart_t *mp, const char *content_type);
+
+/* Read a body that is not in parts, but all of it the range given: a server
+ * may answer a multi-range request with one range covering all it was asked
+ * for. */
+void multipart_single(multipart_t *mp, off_t start, off_t end);
+
+/* Parse on from buf, stopping after at most max bytes of payload, or as
+ * soon as a part's headers are done, so that where its payload goes is
+ * known before any of it is read.  The payload found, if any, is the last
+ * *n bytes of those consumed, and goes at *offset.
+ *
+ * Returns the number of bytes consumed, or -1 if the body is malformed. */
+ssize_t multipart_parse(multipart_t *mp, const char *buf, size_t len,
+			size_t max, size_t *n, off_t *offset);
+
+/* Whether the next bytes are payload, and if so where they go */
+int multipart_in_body(const multipart_t *mp, off_t *offset);
+
+/* Whether the closing delimiter has been read */
+int multipart_done(const multipart_t *mp);
+
+#endif				/* AXEL_MULTIPART_H */
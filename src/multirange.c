@@ -0,0 +1,303 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Fetching several small gaps in one request */
+
+#include "config.h"
+#include "axel.h"
+#include "checksum.h"
+#include "events.h"
+#include "multirange.h"
+
+/* Whether some connection is working on a gap.  The connections' chunks tile
+   every gap they were laid over, so one that overlaps a gap at all has it
+   covered; one asking for several ranges spans the gaps between them, which
+   are either among them or someone else's. */
+static
+int
+owned(const axel_t *axel, const range_t *gap)
+{
+	for (int j = 0; j < axel->conf->num_connections; j++) {
+		const conn_t *conn = &axel->conn[j];
+
+		if (conn->currentbyte < conn->lastbyte &&
+		    conn->currentbyte < gap->end &&
+		    conn->lastbyte > gap->start)
+			return 1;
+	}
+	return 0;
+}
+
+/* A state file can leave more gaps than there are connections */
+int
+multirange_unowned(const axel_t *axel, range_t *gap)
+{
+	for (off_t pos = 0; ranges_gap(&axel->done, pos, axel->size, gap);
+	     pos = gap->end)
+		if (!owned(axel, gap))
+			return 1;
+	return 0;
+}
+
+/* Point the connection's span at the ranges it has left */
+static
+void
+span(conn_t *conn)
+{
+	struct multirange *m = conn->multi;
+
+	if (m->count) {
+		conn->currentbyte = m->r[0].start;
+		conn->lastbyte = m->r[m->count - 1].end;
+	} else {
+		conn->currentbyte = conn->lastbyte;
+	}
+}
+
+int
+multirange_assign(axel_t *axel, int thread, off_t small)
+{
+	conn_t *conn = &axel->conn[thread];
+	range_t gaps[MULTIRANGE_MAX], gap;
+	int n = 0;
+
+	if (axel->no_multirange || !conn->supported ||
+	    axel->size == LLONG_MAX ||
+	    !conn_is_http(conn))
+		return 0;
+
+	/* In order, stopping at the first wide one: the span is to hold no
+	   gap that is neither among them nor someone else's */
+	for (off_t pos = 0; n < MULTIRANGE_MAX &&
+	     ranges_gap(&axel->done, pos, axel->size, &gap); pos = gap.end) {
+		if (owned(axel, &gap))
+			continue;
+		if (gap.end - gap.start >= small)
+			break;
+		gaps[n++] = gap;
+	}
+	if (n < 2)
+		return 0;
+
+	if (!conn->multi) {
+		conn->multi = calloc(1, sizeof(*conn->multi));
+		if (!conn->multi)
+			return 0;
+		conn->multi->raw = malloc(axel->conf->buffer_size);
+		if (!conn->multi->raw) {
+			multirange_free(conn);
+			return 0;
+		}
+	}
+	memcpy(conn->multi->r, gaps, n * sizeof(*gaps));
+	conn->multi->count = n;
+	conn->multi->active = false;
+	span(conn);
+
+	return 1;
+}
+
+int
+multirange_reply(conn_t *conn)
+{
+	struct multirange *m = conn->multi;
+	const char *h;
+	intmax_t first, last;
+
+	m->active = false;
+	m->pos = m->len = 0;
+	if (conn->http->status == 200)
+		m->refused = true;
+	if (conn->http->status != 206)
+		return 0;
+
+	h = http_header(conn->http, "Content-Type:");
+	if (h && multipart_init(&m->mp, h)) {
+		m->active = true;
+		return 1;
+	}
+
+	/* All it was asked for as one range, or only the first of them: the
+	   bytes in between are already done, and get skipped.  Anything else,
+	   a range starting past the first one asked for among it, would come
+	   the same way every time it was asked again */
+	h = http_header(conn->http, "Content-Range:");
+	if (!h || sscanf(h, " bytes %jd-%jd", &first, &last) != 2 ||
+	    first > m->r[0].start || last < first) {
+		m->refused = true;
+		return 0;
+	}
+	multipart_single(&m->mp, first, last + 1);
+	m->active = true;
+	/* Which is as good as a refusal, if it falls short of the rest */
+	m->refused = last + 1 < m->r[m->count - 1].end;
+	return 1;
+}
+
+void
+multirange_refused(axel_t *axel, int thread)
+{
+	conn_t *conn = &axel->conn[thread];
+	struct multirange *m = conn->multi;
+
+	if (axel->conf->verbose)
+		axel_message(axel, _("Connection %i: the server will not send "
+				     "several ranges at once"), thread);
+	axel->no_multirange = true;
+	conn->currentbyte = m->r[0].start;
+	conn->lastbyte = m->r[0].end;
+	m->count = 0;
+	m->active = m->refused = false;
+}
+
+/* How much of the payload ahead to take, at most, and whether to keep it:
+   only what starts one of the ranges still wanted is, so that they shrink
+   from the front and never get split */
+static
+int
+wanted(const struct multirange *m, size_t *max)
+{
+	off_t offset;
+
+	if (!multipart_in_body(&m->mp, &offset))
+		return 0;
+	for (int j = 0; j < m->count; j++) {
+		const range_t *r = &m->r[j];
+
+		if (r->start == offset) {
+			*max = min(*max, (size_t)(r->end - offset));
+			return 1;
+		}
+		if (r->start > offset) {
+			*max = min(*max, (size_t)(r->start - offset));
+			return 0;
+		}
+	}
+	return 0;
+}
+
+/* The payload [start, end) is on its way to the disk */
+static
+void
+trim(conn_t *conn, off_t start, off_t end)
+{
+	struct multirange *m = conn->multi;
+
+	for (int j = 0; j < m->count; j++) {
+		if (m->r[j].start != start)
+			continue;
+		m->r[j].start = end;
+		if (m->r[j].start == m->r[j].end) {
+			m->count--;
+			memmove(&m->r[j], &m->r[j + 1],
+				(m->count - j) * sizeof(m->r[0]));
+		}
+		break;
+	}
+	span(conn);
+}
+
+int
+multirange_feed(axel_t *axel, int thread, const char *buf, size_t len)
+{
+	struct multirange *m = axel->conn[thread].multi;
+
+	memcpy(m->raw, buf, len);
+	m->pos = 0;
+	m->len = len;
+	return multirange_drain(axel, thread);
+}
+
+int
+multirange_drain(axel_t *axel, int thread)
+{
+	conn_t *conn = &axel->conn[thread];
+	struct multirange *m = conn->multi;
+
+	while (m->pos < m->len) {
+		size_t max = axel->conf->buffer_size, n;
+		char *block = NULL;
+		off_t offset;
+
+		if (wanted(m, &max) && !(block = writer_get(axel->writer)))
+			return 1;
+
+		ssize_t used = multipart_parse(&m->mp, m->raw + m->pos,
+					       m->len - m->pos, max, &n,
+					       &offset);
+		if (used < 0) {
+			if (block)
+				writer_put(axel->writer, block, 0, 0);
+			axel_message(axel, _("Connection %i: malformed "
+					     "multipart reply"), thread);
+			m->active = false;
+			conn_disconnect(conn);
+			events_check(axel, thread);
+			return 0;
+		}
+		m->pos += used;
+		if (!block)
+			continue;
+		if (!n) {
+			writer_put(axel->writer, block, 0, 0);
+			continue;
+		}
+
+		memcpy(block, m->raw + m->pos - n, n);
+		writer_put(axel->writer, block, offset, n);
+		if (ranges_add(&axel->done, offset, offset + n) == -1) {
+			axel_message(axel, "%s", strerror(errno));
+			axel->ready = -1;
+		}
+		checksum_source(axel, conn->url, offset, offset + n);
+		axel->bytes_done += n;
+		trim(conn, offset, offset + n);
+	}
+	events_redraw(axel);
+
+	return 0;
+}
+
+void
+multirange_free(conn_t *conn)
+{
+	if (!conn->multi)
+		return;
+	free(conn->multi->raw);
+	free(conn->multi);
+	conn->multi = NULL;
+}
@@ -0,0 +1,102 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Fetching several small gaps in one request */
+
+#ifndef AXEL_MULTIRANGE_H
+#define AXEL_MULTIRANGE_H
+
+/* As many ranges as one Range header asks for: enough to make a round trip
+ * for each stand out, few enough to keep it well inside a header line */
+#define MULTIRANGE_MAX	16
+
+/* A connection's share of the work, when that is more than one range.  The
+ * connection's own currentbyte and lastbyte span them all, which is how the
+ * others know to keep out of the gaps it holds; the reply is read here
+ * first, and what of it lands in the ranges asked for is written. */
+struct multirange {
+	range_t r[MULTIRANGE_MAX];	/* what is left of those asked for */
+	int count;
+	bool active;		/* the reply is being read through mp */
+	bool refused;		/* the server would not send them in parts */
+	multipart_t mp;
+	char *raw;		/* read from the connection, not yet parsed */
+	size_t pos, len;
+};
+
+/* The first gap in what is done that no connection is working on */
+int multirange_unowned(const axel_t *axel, range_t *gap);
+
+/* Give a connection that is done every gap narrower than small nobody is
+ * working on, up to MULTIRANGE_MAX of them, to ask for at once.  Returns 1
+ * if it got two or more, 0 if it is better off with a single range. */
+int multirange_assign(axel_t *axel, int thread, off_t small);
+
+/* Make sense of the reply to a multi-range request, from the setup thread.
+ * Returns 1 if there is something to read, 0 if not; with refused set if
+ * the server answered with the whole file, with only the first range, or
+ * with a single range that is of no use. */
+int multirange_reply(conn_t *conn);
+
+/* Fall back to one range at a time: the connection keeps the first of its
+ * ranges, and leaves the rest to be handed out again. */
+void multirange_refused(axel_t *axel, int thread);
+
+/* Take in what a connection reading a multi-range reply got, and queue the
+ * payload for the writer.  Return 1 when the writer ran out of blocks, with
+ * whatever is left over kept for the next call to multirange_drain(). */
+int multirange_feed(axel_t *axel, int thread, const char *buf, size_t len);
+int multirange_drain(axel_t *axel, int thread);
+
+void multirange_free(conn_t *conn);
+
+static inline
+int
+multirange_active(const conn_t *conn)
+{
+	return conn->multi && conn->multi->active;
+}
+
+/* Whether there is some of a reply read and not yet written */
+static inline
+int
+multirange_pending(const conn_t *conn)
+{
+	return multirange_active(conn) && conn->multi->pos < conn->multi->len;
+}
+
+#endif				/* AXEL_MULTIRANGE_H */
@@ -0,0 +1,399 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+
+/* Checking a download a piece at a time, as each is written */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#ifdef HAVE_WOLFSSL
+#include <wolfssl/options.h>
+#include <wolfssl/wolfcrypt/settings.h>
+#include <wolfssl/openssl/evp.h>
+#elif defined(HAVE_SSL)
+#include <openssl/evp.h>
+#endif
+
+#include "ranges.h"
+#include "writer.h"
+#include "pieces.h"
+
+#ifdef HAVE_SSL
+
+enum {
+	PIECE_OPEN,		/* being written */
+	PIECE_QUEUED,		/* written, to be checked */
+	PIECE_GOOD,
+};
+
+struct pieces {
+	const EVP_MD *md;
+	EVP_MD_CTX *ctx;
+	unsigned char *hashes;
+	size_t hash_len, count;
+	off_t len, size;
+	int fd;
+	unsigned char *state, *fails;
+	ranges_t written;
+	size_t *todo, ntodo;	/* written in full, to be checked */
+	size_t *bad, nbad;	/* checked, and found wrong */
+	writer_watch_fn *feed;
+	void *feed_arg;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t work;	/* there is a piece to check, or stop */
+	pthread_cond_t idle;	/* one has been checked */
+	bool started, stop;
+	bool busy;		/* the thread is checking one */
+	int err;
+	unsigned char *buf;
+};
+
+pieces_t *
+pieces_new(const char *algo, const unsigned char *hashes, size_t hash_len,
+	   size_t count, off_t len, const char *filename, off_t size)
+{
+	const EVP_MD *md = EVP_get_digestbyname(algo);
+	pieces_t *p;
+
+	if (!md || (size_t)EVP_MD_size(md) != hash_len || !count || len <= 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	p = calloc(1, sizeof(*p));
+	if (!p)
+		return NULL;
+	p->md = md;
+	p->hash_len = hash_len;
+	p->count = count;
+	p->len = len;
+	p->size = size;
+	ranges_init(&p->written);
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->work, NULL);
+	pthread_cond_init(&p->idle, NULL);
+	p->fd = open(filename, O_RDONLY);
+	p->ctx = EVP_MD_CTX_new();
+	p->hashes = malloc(count * hash_len);
+	p->state = calloc(count, 2);
+	p->todo = malloc(2 * count * sizeof(*p->todo));
+	p->buf = malloc(len);
+	if (p->fd == -1 || !p->ctx || !p->hashes || !p->state || !p->todo ||
+	    !p->buf) {
+		int err = p->fd == -1 ? errno : ENOMEM;
+
+		pieces_free(p);
+		errno = err;
+		return NULL;
+	}
+	memcpy(p->hashes, hashes, count * hash_len);
+	p->fails = p->state + count;
+	p->bad = p->todo + count;
+
+	return p;
+}
+
+void
+pieces_feed(pieces_t *p, writer_watch_fn *fn, void *arg)
+{
+	p->feed = fn;
+	p->feed_arg = arg;
+}
+
+/* Where piece i ends */
+static
+off_t
+piece_end(const pieces_t *p, size_t i)
+{
+	return (off_t)(i + 1) * p->len < p->size ?
+	    (off_t)(i + 1) * p->len : p->size;
+}
+
+/* Queue piece i if it is all written.  Called locked. */
+static
+void
+check(pieces_t *p, size_t i)
+{
+	range_t gap;
+
+	if (p->state[i] != PIECE_OPEN ||
+	    ranges_gap(&p->written, i * p->len, piece_end(p, i), &gap))
+		return;
+	p->state[i] = PIECE_QUEUED;
+	p->todo[p->ntodo++] = i;
+	pthread_cond_signal(&p->work);
+}
+
+void
+pieces_written(void *arg, const void *data, off_t offset, size_t len)
+{
+	pieces_t *p = arg;
+
+	pthread_mutex_lock(&p->lock);
+	if (ranges_add(&p->written, offset, offset + len) == -1) {
+		p->err = errno;
+		pthread_cond_broadcast(&p->idle);
+	} else {
+		for (size_t i = offset / p->len;
+		     i < p->count && (off_t)i * p->len < offset + (off_t)len;
+		     i++)
+			check(p, i);
+	}
+	pthread_mutex_unlock(&p->lock);
+}
+
+/* Read len bytes at offset, however many goes it takes */
+static
+int
+read_back(pieces_t *p, off_t offset, size_t len)
+{
+	for (size_t got = 0; got < len;) {
+		ssize_t n = pread(p->fd, p->buf + got, len - got,
+				  offset + got);
+
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return n ? errno : EIO;
+		got += n;
+	}
+	return 0;
+}
+
+/* Whether the len bytes read back are what piece i should be */
+static
+bool
+matches(pieces_t *p, size_t i, size_t len)
+{
+	unsigned char got[EVP_MAX_MD_SIZE];
+
+	return EVP_DigestInit_ex(p->ctx, p->md, NULL) &&
+	    EVP_DigestUpdate(p->ctx, p->buf, len) &&
+	    EVP_DigestFinal_ex(p->ctx, got, NULL) &&
+	    !memcmp(got, p->hashes + i * p->hash_len, p->hash_len);
+}
+
+/* Checks each piece as it is queued, one at a time */
+static
+void *
+pieces_thread(void *arg)
+{
+	pieces_t *p = arg;
+
+	pthread_mutex_lock(&p->lock);
+	for (;;) {
+		while (!p->stop && !p->err && !p->ntodo)
+			pthread_cond_wait(&p->work, &p->lock);
+		if (p->stop || p->err)
+			break;
+
+		size_t i = p->todo[--p->ntodo];
+		off_t start = i * p->len, end = piece_end(p, i);
+		p->busy = true;
+		pthread_mutex_unlock(&p->lock);
+
+		int err = read_back(p, start, end - start);
+		bool good = !err && matches(p, i, end - start);
+		if (good && p->feed)
+			p->feed(p->feed_arg, p->buf, start, end - start);
+
+		pthread_mutex_lock(&p->lock);
+		p->busy = false;
+		if (!err && !good &&
+		    ranges_remove(&p->written, start, end) == -1)
+			err = errno;
+		if (err) {
+			p->err = err;
+			pthread_cond_broadcast(&p->idle);
+			break;
+		}
+		if (good) {
+			p->state[i] = PIECE_GOOD;
+		} else {
+			p->state[i] = PIECE_OPEN;
+			if (p->fails[i] < 255)
+				p->fails[i]++;
+			if (p->nbad < p->count)
+				p->bad[p->nbad++] = i;
+		}
+		pthread_cond_broadcast(&p->idle);
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	return NULL;
+}
+
+int
+pieces_start(pieces_t *p, const ranges_t *done)
+{
+	for (size_t i = 0; i < done->count; i++)
+		if (ranges_add(&p->written, done->r[i].start,
+			       done->r[i].end) == -1)
+			return -1;
+
+	pthread_mutex_lock(&p->lock);
+	for (size_t i = 0; i < p->count; i++)
+		check(p, i);
+	pthread_mutex_unlock(&p->lock);
+
+	int err = pthread_create(&p->thread, NULL, pieces_thread, p);
+	if (err) {
+		errno = err;
+		return -1;
+	}
+	p->started = true;
+
+	return 0;
+}
+
+int
+pieces_failed(pieces_t *p, size_t *index)
+{
+	int fails = 0;
+
+	pthread_mutex_lock(&p->lock);
+	if (p->nbad) {
+		*index = p->bad[--p->nbad];
+		fails = p->fails[*index];
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	return fails;
+}
+
+int
+pieces_wait(pieces_t *p)
+{
+	int err;
+
+	pthread_mutex_lock(&p->lock);
+	while ((p->ntodo || p->busy) && !p->err)
+		pthread_cond_wait(&p->idle, &p->lock);
+	err = p->err;
+	pthread_mutex_unlock(&p->lock);
+
+	if (err) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+void
+pieces_free(pieces_t *p)
+{
+	if (!p)
+		return;
+
+	if (p->started) {
+		pthread_mutex_lock(&p->lock);
+		p->stop = true;
+		pthread_cond_signal(&p->work);
+		pthread_mutex_unlock(&p->lock);
+		pthread_join(p->thread, NULL);
+	}
+
+	pthread_cond_destroy(&p->idle);
+	pthread_cond_destroy(&p->work);
+	pthread_mutex_destroy(&p->lock);
+	if (p->fd != -1)
+		close(p->fd);
+	EVP_MD_CTX_free(p->ctx);
+	ranges_free(&p->written);
+	free(p->hashes);
+	free(p->state);
+	free(p->todo);
+	free(p->buf);
+	free(p);
+}
+
+#else				/* HAVE_SSL */
+
+pieces_t *
+pieces_new(const char *algo, const unsigned char *hashes, size_t hash_len,
+	   size_t count, off_t len, const char *filename, off_t size)
+{
+	errno = ENOSYS;
+	return NULL;
+}
+
+void
+pieces_feed(pieces_t *p, writer_watch_fn *fn, void *arg)
+{
+}
+
+int
+pieces_start(pieces_t *p, const ranges_t *done)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+void
+pieces_written(void *p, const void *data, off_t offset, size_t len)
+{
+}
+
+int
+pieces_failed(pieces_t *p, size_t *index)
+{
+	return 0;
+}
+
+int
+pieces_wait(pieces_t *p)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+void
+pieces_free(pieces_t *p)
+{
+}
+
+#endif				/* HAVE_SSL */
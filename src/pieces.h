@@ -0,0 +1,82 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+
+/* Checking a download a piece at a time, as each is written */
+
+#ifndef AXEL_PIECES_H
+#define AXEL_PIECES_H
+
+/* A file whose pieces each have a hash of their own can be checked long
+ * before it is all there: a piece is read back and hashed by a thread of
+ * its own as soon as the last of its bytes is written, and one that does
+ * not match can be fetched again on its own, rather than the whole file.
+ * What does match can be passed on, to a digest of the whole file, say. */
+typedef struct pieces pieces_t;
+
+/* Get ready to check count pieces of len bytes, the last one cut short by
+ * size, against the count hashes of hash_len bytes each in hashes, which
+ * are copied.  Returns NULL with errno set: ENOSYS if there is no hashing
+ * in this build, EINVAL if the algorithm is unknown or the hashes the wrong
+ * length for it. */
+pieces_t *pieces_new(const char *algo, const unsigned char *hashes,
+		     size_t hash_len, size_t count, off_t len,
+		     const char *filename, off_t size);
+
+/* Have each piece that matches passed on to fn, from the checking thread.
+ * To be called before pieces_start(). */
+void pieces_feed(pieces_t *p, writer_watch_fn *fn, void *arg);
+
+/* Start checking, with what done says is on disk already: the pieces it
+ * covers are checked first.  Returns 0, or -1 with errno set. */
+int pieces_start(pieces_t *p, const ranges_t *done);
+
+/* For writer_watch(): len bytes are now at offset in the file */
+void pieces_written(void *p, const void *data, off_t offset, size_t len);
+
+/* Take the next piece that did not match off the list of those that did
+ * not, into *index.  Its bytes count as not written any more.  Returns how
+ * many times that piece has failed, or 0 if none is waiting. */
+int pieces_failed(pieces_t *p, size_t *index);
+
+/* Wait for every piece that is written to be checked.  Returns 0, or -1
+ * with errno set if the file could not be read back. */
+int pieces_wait(pieces_t *p);
+
+void pieces_free(pieces_t *p);
+
+#endif				/* AXEL_PIECES_H */
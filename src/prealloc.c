@@ -0,0 +1,116 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Claiming disk space ahead of the download */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#include "prealloc.h"
+
+/* Whether an error says there is no room, rather than no way to tell */
+static
+int
+out_of_room(int err)
+{
+	switch (err) {
+	case ENOSPC:
+	case EFBIG:
+#ifdef EDQUOT
+	case EDQUOT:
+#endif
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* What the file system has to find room for, on top of what the file
+ * already holds: a file downloaded over again has blocks of its own */
+static
+int
+check_room(int fd, const struct stat *st, off_t size)
+{
+	struct statvfs vfs;
+	off_t held = (off_t)st->st_blocks * 512;
+
+	if (fstatvfs(fd, &vfs) == -1 || size <= held)
+		return 0;
+
+	if ((unsigned long long)vfs.f_bavail * vfs.f_frsize <
+	    (unsigned long long)(size - held)) {
+		errno = ENOSPC;
+		return -1;
+	}
+	return 0;
+}
+
+int
+prealloc(int fd, off_t size)
+{
+	struct stat st;
+	int err;
+
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || size <= 0)
+		return 0;
+
+	if (check_room(fd, &st, size) == -1)
+		return -1;
+
+	/* Not posix_fallocate() on Linux: where the file system cannot
+	   allocate, glibc writes a byte into every block instead, which is
+	   the very zero-fill this is meant to spare */
+#if defined(HAVE_FALLOCATE)
+	err = fallocate(fd, 0, 0, size) == -1 ? errno : 0;
+#elif defined(HAVE_POSIX_FALLOCATE)
+	err = posix_fallocate(fd, 0, size);
+#else
+	err = EOPNOTSUPP;
+#endif
+	if (!err)
+		return 1;
+
+	if (out_of_room(err)) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,55 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+
+/* Claiming disk space ahead of the download */
+
+#ifndef AXEL_PREALLOC_H
+#define AXEL_PREALLOC_H
+
+#include <sys/types.h>
+
+/* Claim room for the first size bytes of fd, which has just been created
+ * for them, so that they get contiguous extents and a full disk shows up
+ * now rather than halfway through.
+ *
+ * Returns 1 if the room is claimed, 0 if there is no way to on this system
+ * or file system (or for this kind of file), and -1 with errno set if there
+ * is no room for it. */
+int prealloc(int fd, off_t size);
+
+#endif				/* AXEL_PREALLOC_H */
@@ -0,0 +1,791 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* QUIC connections through ngtcp2, and HTTP/3 on them through nghttp3 */
+
+#include "config.h"
+#include <poll.h>
+#include <sys/socket.h>
+#include <openssl/rand.h>
+#include "axel.h"
+#include "quic.h"
+#ifndef HAVE_NGTCP2_CRYPTO_OSSL
+#include <ngtcp2/ngtcp2_crypto_quictls.h>
+#endif
+
+/* The room the server is given on each stream, and on the connection as a
+   whole, as for HTTP/2 */
+#define H3_STREAM_WINDOW	(4 << 20)
+#define H3_WINDOW		(64 << 20)
+
+/* How long, in seconds, the handshake gets: a network that drops UDP is to
+   be found out before the connections have waited long on it */
+#define H3_HANDSHAKE		3
+
+/* How long, in seconds, the server may stay silent before the connection
+   is given up on */
+#define H3_IDLE			30
+
+/* The largest datagram taken */
+#define H3_DATAGRAM		65536
+
+/* What is offered to the server, as ALPN has it */
+static const char alpn[] = "\x02h3";
+
+/* One TLS context for every QUIC connection, set up for ngtcp2 */
+static pthread_mutex_t ctx_lock = PTHREAD_MUTEX_INITIALIZER;
+static SSL_CTX *h3_ctx;
+
+static
+ngtcp2_tstamp
+timestamp(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ngtcp2_tstamp)ts.tv_sec * NGTCP2_SECONDS + ts.tv_nsec;
+}
+
+static
+int
+out_add(struct stream *st, const void *data, size_t len)
+{
+	if (st->out_len + len > st->out_size) {
+		size_t size = max(st->out_len + len, 2 * st->out_size);
+		char *out = realloc(st->out, size);
+
+		if (!out)
+			return -1;
+		st->out = out;
+		st->out_size = size;
+	}
+	memcpy(st->out + st->out_len, data, len);
+	st->out_len += len;
+	return 0;
+}
+
+/* A line of the reply's headers, as HTTP/1 would write it */
+static
+int
+out_header(struct stream *st, const char *a, size_t a_len, const char *sep,
+	   const char *b, size_t b_len)
+{
+	size_t len = st->out_len;
+
+	if (out_add(st, a, a_len) || out_add(st, sep, strlen(sep)) ||
+	    out_add(st, b, b_len) || out_add(st, "\r\n", 2))
+		return -1;
+	st->head += st->out_len - len;
+	return 0;
+}
+
+void
+quic_consume(struct session *s, int64_t id, size_t len)
+{
+	ngtcp2_conn_extend_max_stream_offset(s->qc, id, len);
+	ngtcp2_conn_extend_max_offset(s->qc, len);
+}
+
+static
+void
+rand_cb(uint8_t *dest, size_t len, const ngtcp2_rand_ctx *ctx)
+{
+	if (RAND_bytes(dest, len) != 1)
+		memset(dest, 0, len);
+}
+
+static
+int
+new_cid_cb(ngtcp2_conn *qc, ngtcp2_cid *cid, uint8_t *token, size_t len,
+	   void *arg)
+{
+	if (RAND_bytes(cid->data, len) != 1 ||
+	    RAND_bytes(token, NGTCP2_STATELESS_RESET_TOKENLEN) != 1)
+		return NGTCP2_ERR_CALLBACK_FAILURE;
+	cid->datalen = len;
+	return 0;
+}
+
+static
+int
+handshake_cb(ngtcp2_conn *qc, void *arg)
+{
+	struct session *s = arg;
+
+	s->handshaken = true;
+	return 0;
+}
+
+static
+int
+recv_stream_cb(ngtcp2_conn *qc, uint32_t flags, int64_t id, uint64_t offset,
+	       const uint8_t *data, size_t len, void *arg, void *st_arg)
+{
+	struct session *s = arg;
+	nghttp3_ssize n = nghttp3_conn_read_stream(s->h3, id, data, len,
+					flags & NGTCP2_STREAM_DATA_FLAG_FIN);
+
+	if (n < 0) {
+		ngtcp2_ccerr_set_application_error(&s->err,
+			nghttp3_err_infer_quic_app_error_code(n), NULL, 0);
+		return NGTCP2_ERR_CALLBACK_FAILURE;
+	}
+	/* All but the data, which is as the connections take it */
+	quic_consume(s, id, n);
+	return 0;
+}
+
+static
+int
+acked_cb(ngtcp2_conn *qc, int64_t id, uint64_t offset, uint64_t len,
+	 void *arg, void *st_arg)
+{
+	struct session *s = arg;
+
+	return nghttp3_conn_add_ack_offset(s->h3, id, len) ?
+	    NGTCP2_ERR_CALLBACK_FAILURE : 0;
+}
+
+static
+int
+stream_close_cb(ngtcp2_conn *qc, uint32_t flags, int64_t id, uint64_t error,
+		void *arg, void *st_arg)
+{
+	struct session *s = arg;
+	struct stream *st = st_arg;
+	int ret;
+
+	if (st)
+		st->closed = true;
+	if (!(flags & NGTCP2_STREAM_CLOSE_FLAG_APP_ERROR_CODE_SET))
+		error = NGHTTP3_H3_NO_ERROR;
+	ret = nghttp3_conn_close_stream(s->h3, id, error);
+	if (ret && ret != NGHTTP3_ERR_STREAM_NOT_FOUND) {
+		ngtcp2_ccerr_set_application_error(&s->err,
+			nghttp3_err_infer_quic_app_error_code(ret), NULL, 0);
+		return NGTCP2_ERR_CALLBACK_FAILURE;
+	}
+	return 0;
+}
+
+static
+int
+reset_cb(ngtcp2_conn *qc, int64_t id, uint64_t final_size, uint64_t error,
+	 void *arg, void *st_arg)
+{
+	struct session *s = arg;
+
+	return nghttp3_conn_shutdown_stream_read(s->h3, id) ?
+	    NGTCP2_ERR_CALLBACK_FAILURE : 0;
+}
+
+static
+int
+stop_sending_cb(ngtcp2_conn *qc, int64_t id, uint64_t error, void *arg,
+		void *st_arg)
+{
+	struct session *s = arg;
+
+	return nghttp3_conn_shutdown_stream_read(s->h3, id) ?
+	    NGTCP2_ERR_CALLBACK_FAILURE : 0;
+}
+
+static
+int
+extend_data_cb(ngtcp2_conn *qc, int64_t id, uint64_t max_data, void *arg,
+	       void *st_arg)
+{
+	struct session *s = arg;
+
+	return nghttp3_conn_unblock_stream(s->h3, id) ?
+	    NGTCP2_ERR_CALLBACK_FAILURE : 0;
+}
+
+static
+int
+header_cb(nghttp3_conn *h3, int64_t id, int32_t token, nghttp3_rcbuf *name,
+	  nghttp3_rcbuf *value, uint8_t flags, void *arg, void *st_arg)
+{
+	struct stream *st = st_arg;
+	nghttp3_vec n = nghttp3_rcbuf_get_buf(name);
+	nghttp3_vec v = nghttp3_rcbuf_get_buf(value);
+	int err = 0;
+
+	if (!st)
+		return 0;
+	if (token == NGHTTP3_QPACK_TOKEN__STATUS)
+		err = out_header(st, "HTTP/3", 6, " ", (const char *)v.base,
+				 v.len);
+	else if (n.len && *n.base != ':')
+		err = out_header(st, (const char *)n.base, n.len, ": ",
+				 (const char *)v.base, v.len);
+
+	return err ? NGHTTP3_ERR_CALLBACK_FAILURE : 0;
+}
+
+static
+int
+end_headers_cb(nghttp3_conn *h3, int64_t id, int fin, void *arg, void *st_arg)
+{
+	struct stream *st = st_arg;
+
+	if (st && out_header(st, "", 0, "", "", 0))
+		return NGHTTP3_ERR_CALLBACK_FAILURE;
+	return 0;
+}
+
+static
+int
+data_cb(nghttp3_conn *h3, int64_t id, const uint8_t *data, size_t len,
+	void *arg, void *st_arg)
+{
+	struct session *s = arg;
+	struct stream *st = st_arg;
+
+	/* Nobody to take it any more */
+	if (!st || st->sock == -1) {
+		quic_consume(s, id, len);
+		return 0;
+	}
+	if (out_add(st, data, len)) {
+		quic_consume(s, id, len);
+		quic_hang_up(s, st);
+	}
+	return 0;
+}
+
+/* What nghttp3 kept back for a while, and is now done with */
+static
+int
+deferred_cb(nghttp3_conn *h3, int64_t id, size_t len, void *arg, void *st_arg)
+{
+	quic_consume(arg, id, len);
+	return 0;
+}
+
+static
+int
+h3_stop_sending_cb(nghttp3_conn *h3, int64_t id, uint64_t error, void *arg,
+		   void *st_arg)
+{
+	struct session *s = arg;
+
+	return ngtcp2_conn_shutdown_stream_read(s->qc, 0, id, error) ?
+	    NGHTTP3_ERR_CALLBACK_FAILURE : 0;
+}
+
+static
+int
+h3_reset_cb(nghttp3_conn *h3, int64_t id, uint64_t error, void *arg,
+	    void *st_arg)
+{
+	struct session *s = arg;
+
+	return ngtcp2_conn_shutdown_stream_write(s->qc, 0, id, error) ?
+	    NGHTTP3_ERR_CALLBACK_FAILURE : 0;
+}
+
+void
+quic_hang_up(struct session *s, struct stream *st)
+{
+	close(st->sock);
+	st->sock = -1;
+	if (st->id >= 0 && !st->closed) {
+		nghttp3_conn_shutdown_stream_read(s->h3, st->id);
+		ngtcp2_conn_shutdown_stream(s->qc, 0, st->id,
+					    NGHTTP3_H3_REQUEST_CANCELLED);
+		quic_consume(s, st->id, st->out_len - max(st->out_off, st->head));
+	}
+	st->out_len = st->out_off = st->head = 0;
+}
+
+static
+bool
+hop_by_hop(const char *name)
+{
+	static const char *const names[] = {
+		"host", "connection", "keep-alive", "proxy-connection",
+		"transfer-encoding", "upgrade", "te",
+	};
+
+	for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++)
+		if (!strcmp(name, names[i]))
+			return true;
+	return false;
+}
+
+#define NV(n, v, vl) \
+	((nghttp3_nv){ (uint8_t *)(n), (uint8_t *)(v), strlen(n), (vl), \
+		       NGHTTP3_NV_FLAG_NONE })
+
+void
+quic_submit(struct session *s, struct stream *st)
+{
+	nghttp3_nv nv[4 + MAX_ADD_HEADERS + 16];
+	char *line, *next, *method, *path, *authority = s->host;
+	size_t n = 4, authority_len = strlen(s->host);
+	int64_t id;
+	int ret;
+
+	if (!st->whole) {
+		if (!strstr(st->req, "\r\n\r\n")) {
+			if (st->req_len == H3_REQUEST)
+				quic_hang_up(s, st);
+			return;
+		}
+		st->whole = true;
+	}
+	ret = ngtcp2_conn_open_bidi_stream(s->qc, &id, st);
+	if (ret == NGTCP2_ERR_STREAM_ID_BLOCKED)
+		return;
+	if (ret) {
+		quic_hang_up(s, st);
+		return;
+	}
+	st->id = id;
+
+	/* GET path HTTP/1.0 */
+	line = st->req;
+	next = strstr(line, "\r\n");
+	*next = '\0';
+	method = line;
+	path = strchr(line, ' ');
+	if (!path) {
+		quic_hang_up(s, st);
+		return;
+	}
+	*path++ = '\0';
+	path[strcspn(path, " ")] = '\0';
+
+	for (line = next + 2; *line && n < sizeof(nv) / sizeof(*nv);
+	     line = next + 2) {
+		char *value;
+
+		next = strstr(line, "\r\n");
+		*next = '\0';
+		value = strchr(line, ':');
+		if (!value)
+			break;
+		*value++ = '\0';
+		value += strspn(value, " \t");
+		for (char *c = line; *c; c++)
+			*c = tolower((unsigned char)*c);
+
+		if (!strcmp(line, "host")) {
+			authority = value;
+			authority_len = strlen(value);
+		}
+		if (!hop_by_hop(line))
+			nv[n++] = NV(line, value, strlen(value));
+	}
+	nv[0] = NV(":method", method, strlen(method));
+	nv[1] = NV(":scheme", "https", 5);
+	nv[2] = NV(":authority", authority, authority_len);
+	nv[3] = NV(":path", path, strlen(path));
+
+	if (nghttp3_conn_submit_request(s->h3, id, nv, n, NULL, st))
+		quic_hang_up(s, st);
+}
+
+int
+quic_write(struct session *s)
+{
+	uint8_t buf[H3_DATAGRAM];
+	size_t size = min(sizeof(buf),
+			  ngtcp2_conn_get_path_max_tx_udp_payload_size(s->qc));
+	ngtcp2_tstamp ts = timestamp();
+	ngtcp2_pkt_info pi;
+
+	for (;;) {
+		uint32_t flags = NGTCP2_WRITE_STREAM_FLAG_MORE;
+		ngtcp2_ssize n, taken = -1;
+		nghttp3_vec vec[16];
+		nghttp3_ssize nvec;
+		int64_t id = -1;
+		int fin = 0;
+
+		nvec = nghttp3_conn_writev_stream(s->h3, &id, &fin, vec,
+						  sizeof(vec) / sizeof(*vec));
+		if (nvec < 0) {
+			ngtcp2_ccerr_set_application_error(&s->err,
+				nghttp3_err_infer_quic_app_error_code(nvec),
+				NULL, 0);
+			return -1;
+		}
+		if (fin)
+			flags |= NGTCP2_WRITE_STREAM_FLAG_FIN;
+
+		n = ngtcp2_conn_writev_stream(s->qc, &s->path.path, &pi, buf,
+					      size, &taken, flags, id,
+					      (const ngtcp2_vec *)vec, nvec,
+					      ts);
+		switch (n) {
+		case NGTCP2_ERR_STREAM_DATA_BLOCKED:
+			nghttp3_conn_block_stream(s->h3, id);
+			continue;
+		case NGTCP2_ERR_STREAM_SHUT_WR:
+			nghttp3_conn_shutdown_stream_write(s->h3, id);
+			continue;
+		case NGTCP2_ERR_WRITE_MORE:
+			if (nghttp3_conn_add_write_offset(s->h3, id, taken))
+				return -1;
+			continue;
+		}
+		if (n < 0) {
+			ngtcp2_ccerr_set_liberr(&s->err, n, NULL, 0);
+			return -1;
+		}
+		if (taken >= 0 &&
+		    nghttp3_conn_add_write_offset(s->h3, id, taken))
+			return -1;
+		/* All sent, or as much as congestion control lets out */
+		if (!n)
+			break;
+		/* One that does not go is as good as lost, which QUIC makes
+		   up for */
+		if (send(s->fd, buf, n, 0) == -1 && errno != EAGAIN &&
+		    errno != EWOULDBLOCK && errno != EINTR &&
+		    errno != ENOBUFS)
+			return -1;
+	}
+	ngtcp2_conn_update_pkt_tx_time(s->qc, ts);
+	return 0;
+}
+
+int
+quic_read(struct session *s)
+{
+	uint8_t buf[H3_DATAGRAM];
+	ngtcp2_pkt_info pi = { 0 };
+
+	for (;;) {
+		ssize_t n = recv(s->fd, buf, sizeof(buf), 0);
+		int ret;
+
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+		}
+		ret = ngtcp2_conn_read_pkt(s->qc, &s->path.path, &pi, buf, n,
+					   timestamp());
+		if (ret) {
+			if (ret != NGTCP2_ERR_CALLBACK_FAILURE)
+				ngtcp2_ccerr_set_liberr(&s->err, ret, NULL, 0);
+			return -1;
+		}
+	}
+}
+
+int
+quic_expire(struct session *s)
+{
+	ngtcp2_tstamp now = timestamp();
+	int ret;
+
+	if (ngtcp2_conn_get_expiry(s->qc) > now)
+		return 0;
+	ret = ngtcp2_conn_handle_expiry(s->qc, now);
+	if (ret)
+		ngtcp2_ccerr_set_liberr(&s->err, ret, NULL, 0);
+	return ret ? -1 : 0;
+}
+
+int
+quic_timeout(struct session *s)
+{
+	ngtcp2_tstamp expiry = ngtcp2_conn_get_expiry(s->qc), now = timestamp();
+
+	if (expiry <= now)
+		return 0;
+	return min((expiry - now) / NGTCP2_MILLISECONDS + 1,
+		   (ngtcp2_tstamp)INT_MAX);
+}
+
+void
+quic_goodbye(struct session *s)
+{
+	uint8_t buf[1500];
+	ngtcp2_pkt_info pi;
+	ngtcp2_ssize n;
+
+	if (!s->qc || ngtcp2_conn_in_closing_period(s->qc) ||
+	    ngtcp2_conn_in_draining_period(s->qc) ||
+	    s->err.type == NGTCP2_CCERR_TYPE_IDLE_CLOSE)
+		return;
+	n = ngtcp2_conn_write_connection_close(s->qc, &s->path.path, &pi, buf,
+					       sizeof(buf), &s->err,
+					       timestamp());
+	if (n > 0)
+		send(s->fd, buf, n, 0);
+}
+
+void
+quic_free(struct session *s)
+{
+	if (s->h3)
+		nghttp3_conn_del(s->h3);
+	if (s->qc)
+		ngtcp2_conn_del(s->qc);
+#ifdef HAVE_NGTCP2_CRYPTO_OSSL
+	if (s->ossl)
+		ngtcp2_crypto_ossl_ctx_del(s->ossl);
+	s->ossl = NULL;
+#endif
+	if (s->ssl)
+		SSL_free(s->ssl);
+	if (s->fd != -1)
+		close(s->fd);
+	s->h3 = NULL;
+	s->qc = NULL;
+	s->ssl = NULL;
+	s->fd = -1;
+	s->handshaken = false;
+	ngtcp2_ccerr_default(&s->err);
+}
+
+static
+ngtcp2_conn *
+get_conn(ngtcp2_crypto_conn_ref *ref)
+{
+	struct session *s = ref->user_data;
+
+	return s->qc;
+}
+
+/* The TLS side of the QUIC connection; the certificate, wherever the
+   server is, is for its own name */
+static
+int
+tls_new(struct session *s)
+{
+	int cancel;
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel);
+	pthread_mutex_lock(&ctx_lock);
+	if (!h3_ctx) {
+#ifdef HAVE_NGTCP2_CRYPTO_OSSL
+		if (!ngtcp2_crypto_ossl_init())
+			h3_ctx = SSL_CTX_new(TLS_client_method());
+#else
+		h3_ctx = SSL_CTX_new(TLS_client_method());
+		if (h3_ctx &&
+		    ngtcp2_crypto_quictls_configure_client_context(h3_ctx)) {
+			SSL_CTX_free(h3_ctx);
+			h3_ctx = NULL;
+		}
+#endif
+		if (h3_ctx) {
+			SSL_CTX_set_default_verify_paths(h3_ctx);
+			SSL_CTX_set_verify(h3_ctx, SSL_VERIFY_PEER, NULL);
+		}
+	}
+	pthread_mutex_unlock(&ctx_lock);
+	pthread_setcancelstate(cancel, NULL);
+
+	if (!h3_ctx || !(s->ssl = SSL_new(h3_ctx)))
+		return 0;
+	s->ref.get_conn = get_conn;
+	s->ref.user_data = s;
+	SSL_set_app_data(s->ssl, &s->ref);
+	SSL_set_connect_state(s->ssl);
+	SSL_set_alpn_protos(s->ssl, (const unsigned char *)alpn,
+			    strlen(alpn));
+	SSL_set_tlsext_host_name(s->ssl, s->host);
+	if (s->insecure)
+		SSL_set_verify(s->ssl, SSL_VERIFY_NONE, NULL);
+
+#ifdef HAVE_NGTCP2_CRYPTO_OSSL
+	if (ngtcp2_crypto_ossl_configure_client_session(s->ssl) ||
+	    ngtcp2_crypto_ossl_ctx_new(&s->ossl, s->ssl))
+		return 0;
+	ngtcp2_conn_set_tls_native_handle(s->qc, s->ossl);
+#else
+	ngtcp2_conn_set_tls_native_handle(s->qc, s->ssl);
+#endif
+	return 1;
+}
+
+/* A QUIC connection to the server over fd, not yet shaken hands on, and
+   the HTTP/3 one on top of it */
+static
+int
+quic_new(struct session *s)
+{
+	ngtcp2_callbacks cb = {
+		.client_initial = ngtcp2_crypto_client_initial_cb,
+		.recv_crypto_data = ngtcp2_crypto_recv_crypto_data_cb,
+		.encrypt = ngtcp2_crypto_encrypt_cb,
+		.decrypt = ngtcp2_crypto_decrypt_cb,
+		.hp_mask = ngtcp2_crypto_hp_mask_cb,
+		.recv_retry = ngtcp2_crypto_recv_retry_cb,
+		.update_key = ngtcp2_crypto_update_key_cb,
+		.delete_crypto_aead_ctx =
+		    ngtcp2_crypto_delete_crypto_aead_ctx_cb,
+		.delete_crypto_cipher_ctx =
+		    ngtcp2_crypto_delete_crypto_cipher_ctx_cb,
+		.get_path_challenge_data =
+		    ngtcp2_crypto_get_path_challenge_data_cb,
+		.version_negotiation = ngtcp2_crypto_version_negotiation_cb,
+		.rand = rand_cb,
+		.get_new_connection_id = new_cid_cb,
+		.handshake_completed = handshake_cb,
+		.recv_stream_data = recv_stream_cb,
+		.acked_stream_data_offset = acked_cb,
+		.stream_close = stream_close_cb,
+		.stream_reset = reset_cb,
+		.stream_stop_sending = stop_sending_cb,
+		.extend_max_stream_data = extend_data_cb,
+	};
+	nghttp3_callbacks h3cb = {
+		.recv_header = header_cb,
+		.end_headers = end_headers_cb,
+		.recv_data = data_cb,
+		.deferred_consume = deferred_cb,
+		.stop_sending = h3_stop_sending_cb,
+		.reset_stream = h3_reset_cb,
+	};
+	ngtcp2_settings settings;
+	ngtcp2_transport_params params;
+	nghttp3_settings h3settings;
+	ngtcp2_cid dcid, scid;
+
+	dcid.datalen = NGTCP2_MIN_INITIAL_DCIDLEN;
+	scid.datalen = NGTCP2_MIN_INITIAL_DCIDLEN;
+	if (RAND_bytes(dcid.data, dcid.datalen) != 1 ||
+	    RAND_bytes(scid.data, scid.datalen) != 1)
+		return 0;
+
+	ngtcp2_settings_default(&settings);
+	settings.initial_ts = timestamp();
+	settings.handshake_timeout = H3_HANDSHAKE * NGTCP2_SECONDS;
+
+	/* Room on the server's streams for its control and QPACK ones, and
+	   as much on ours as HTTP/2 gives */
+	ngtcp2_transport_params_default(&params);
+	params.initial_max_streams_uni = 3;
+	params.initial_max_stream_data_uni = 128 * 1024;
+	params.initial_max_stream_data_bidi_local = H3_STREAM_WINDOW;
+	params.initial_max_data = H3_WINDOW;
+	params.max_idle_timeout = H3_IDLE * NGTCP2_SECONDS;
+
+	if (ngtcp2_conn_client_new(&s->qc, &dcid, &scid, &s->path.path,
+				   NGTCP2_PROTO_VER_V1, &cb, &settings,
+				   &params, NULL, s))
+		return 0;
+
+	/* Ready for the server's streams, which may come along with the end
+	   of the handshake */
+	nghttp3_settings_default(&h3settings);
+	if (nghttp3_conn_client_new(&s->h3, &h3cb, &h3settings,
+				    nghttp3_mem_default(), s))
+		return 0;
+	return tls_new(s);
+}
+
+/* The streams HTTP/3 has of its own, once the handshake lets them open */
+static
+int
+bind_streams(struct session *s)
+{
+	int64_t control, encoder, decoder;
+
+	return !ngtcp2_conn_open_uni_stream(s->qc, &control, NULL) &&
+	    !nghttp3_conn_bind_control_stream(s->h3, control) &&
+	    !ngtcp2_conn_open_uni_stream(s->qc, &encoder, NULL) &&
+	    !ngtcp2_conn_open_uni_stream(s->qc, &decoder, NULL) &&
+	    !nghttp3_conn_bind_qpack_streams(s->h3, encoder, decoder);
+}
+
+/* Whether the server's certificate is for its name; a TLS error is already
+   a failed handshake */
+static
+bool
+verified(struct session *s)
+{
+	X509 *cert;
+	bool ok;
+
+	if (s->insecure)
+		return true;
+	if (SSL_get_verify_result(s->ssl) != X509_V_OK ||
+	    !(cert = SSL_get_peer_certificate(s->ssl)))
+		return false;
+	ok = ssl_validate_hostname(s->host, cert);
+	X509_free(cert);
+	return ok;
+}
+
+int
+quic_handshake(struct session *s, char *host, int port, unsigned io_timeout)
+{
+	double give_up = axel_gettime() + min(io_timeout, H3_HANDSHAKE);
+	struct sockaddr_storage local, remote;
+	socklen_t local_len = sizeof(local), remote_len = sizeof(remote);
+
+	ngtcp2_ccerr_default(&s->err);
+	s->fd = udp_connect(host, port, s->ai_family,
+			    *s->local_if ? s->local_if : NULL);
+	if (s->fd == -1)
+		return -1;
+	if (getsockname(s->fd, (struct sockaddr *)&local, &local_len) ||
+	    getpeername(s->fd, (struct sockaddr *)&remote, &remote_len))
+		return -1;
+	ngtcp2_path_storage_init(&s->path, (struct sockaddr *)&local,
+				 local_len, (struct sockaddr *)&remote,
+				 remote_len, NULL);
+	if (!quic_new(s))
+		return -1;
+
+	while (!s->handshaken) {
+		struct pollfd pfd = { .fd = s->fd, .events = POLLIN };
+		double left = give_up - axel_gettime();
+
+		if (left <= 0 || quic_write(s) == -1)
+			return -1;
+		if (poll(&pfd, 1, min(quic_timeout(s), (int)(left * 1000) + 1))
+		    == -1 && errno != EINTR)
+			return -1;
+		if ((pfd.revents && quic_read(s) == -1) || quic_expire(s) == -1)
+			return -1;
+	}
+
+	if (!verified(s)) {
+		fprintf(stderr, _("SSL error: Certificate error\n"));
+		return -1;
+	}
+	return bind_streams(s) ? 1 : -1;
+}
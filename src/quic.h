@@ -0,0 +1,132 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/* QUIC connections, and HTTP/3 on them, for the sessions of h3.c */
+
+#ifndef AXEL_QUIC_H
+#define AXEL_QUIC_H
+
+#include <ngtcp2/ngtcp2.h>
+#include <ngtcp2/ngtcp2_crypto.h>
+#ifdef HAVE_NGTCP2_CRYPTO_OSSL
+#include <ngtcp2/ngtcp2_crypto_ossl.h>
+#endif
+#include <nghttp3/nghttp3.h>
+
+/* The longest request to be taken */
+#define H3_REQUEST		8192
+
+enum { H3_CONNECTING, H3_READY, H3_FAILED, H3_GONE };
+
+/* A connection's request, and the reply to it */
+struct stream {
+	struct stream *next;
+	int64_t id;		/* -1 until the request is sent */
+	int sock;		/* -1 once the connection has hung up */
+	char req[H3_REQUEST + 1];
+	size_t req_len;
+	bool whole;		/* all of the request is in */
+	char *out;		/* still to go down the socket */
+	size_t out_len, out_off, out_size;
+	size_t head;		/* how much of out is headers, not data */
+	bool closed;		/* by the server */
+};
+
+/* A QUIC connection to a server, and the connections it carries */
+struct session {
+	struct session *next;
+	char host[MAX_STRING];
+	int port;
+	char local_if[MAX_STRING];
+	bool insecure;
+	sa_family_t ai_family;
+	int state;
+	int streams;		/* taken on and not yet done with */
+	double retry;		/* when one that failed may be tried again */
+	int fd;			/* UDP, connected to the server */
+	ngtcp2_path_storage path;
+	ngtcp2_conn *qc;
+	nghttp3_conn *h3;
+	SSL *ssl;
+	ngtcp2_crypto_conn_ref ref;
+#ifdef HAVE_NGTCP2_CRYPTO_OSSL
+	ngtcp2_crypto_ossl_ctx *ossl;
+#endif
+	ngtcp2_ccerr err;	/* what the connection is to be closed with */
+	bool handshaken;
+	int wake[2];		/* new connections' sockets come down this */
+	struct stream *list;
+};
+
+/* Shake hands with the server over QUIC at host:port, which may be where
+ * Alt-Svc said the session's server is.  Returns 1 if it speaks HTTP/3
+ * there, or -1 if not, or not in time; quic_free() is then left to do. */
+int quic_handshake(struct session *s, char *host, int port,
+		   unsigned io_timeout);
+
+/* Let go of the QUIC connection, and all that goes with it */
+void quic_free(struct session *s);
+
+/* Send what QUIC has to send: requests, acknowledgements, and room made
+ * for more.  Returns -1 if the connection is broken. */
+int quic_write(struct session *s);
+
+/* Take in what came from the server.  Returns -1 if the connection is
+ * broken, or closed. */
+int quic_read(struct session *s);
+
+/* Retransmit, or give up on a server gone quiet, if it is time to.
+ * Returns -1 if the connection is over. */
+int quic_expire(struct session *s);
+
+/* How long until QUIC has something to do, in milliseconds */
+int quic_timeout(struct session *s);
+
+/* Tell the server the connection is over, unless it is the one that said
+ * so, or has gone quiet */
+void quic_goodbye(struct session *s);
+
+/* Make a stream of the request the connection sent, once all of it is in
+ * and the server lets another stream be opened */
+void quic_submit(struct session *s, struct stream *st);
+
+/* The connection hung up: the rest of the stream is of no use to anyone */
+void quic_hang_up(struct session *s, struct stream *st);
+
+/* Give the server room again for len more bytes taken off stream id */
+void quic_consume(struct session *s, int64_t id, size_t len);
+
+#endif				/* AXEL_QUIC_H */
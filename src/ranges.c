@@ -0,0 +1,248 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* The bytes of a download that are done, as a set of ranges */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "ranges.h"
+
+void
+ranges_init(ranges_t *set)
+{
+	memset(set, 0, sizeof(*set));
+}
+
+void
+ranges_free(ranges_t *set)
+{
+	free(set->r);
+	ranges_init(set);
+}
+
+/* The first range ending at or after pos */
+static
+size_t
+find(const ranges_t *set, off_t pos)
+{
+	size_t lo = 0, hi = set->count;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (set->r[mid].end < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Room for one more range.  Returns 0, or -1 with errno set. */
+static
+int
+grow(ranges_t *set)
+{
+	if (set->count < set->alloc)
+		return 0;
+
+	size_t alloc = set->alloc ? 2 * set->alloc : 16;
+	range_t *r = realloc(set->r, alloc * sizeof(*r));
+
+	if (!r)
+		return -1;
+	set->r = r;
+	set->alloc = alloc;
+	return 0;
+}
+
+int
+ranges_add(ranges_t *set, off_t start, off_t end)
+{
+	size_t i, j;
+
+	if (start >= end)
+		return 0;
+
+	/* The ones from i up to j overlap or touch the new one */
+	i = find(set, start);
+	for (j = i; j < set->count && set->r[j].start <= end; j++)
+		;
+
+	if (i < j) {
+		set->r[i].start = set->r[i].start < start ?
+			set->r[i].start : start;
+		set->r[i].end = set->r[j - 1].end > end ?
+			set->r[j - 1].end : end;
+		memmove(set->r + i + 1, set->r + j,
+			(set->count - j) * sizeof(*set->r));
+		set->count -= j - i - 1;
+		return 0;
+	}
+
+	if (grow(set) == -1)
+		return -1;
+	memmove(set->r + i + 1, set->r + i,
+		(set->count - i) * sizeof(*set->r));
+	set->r[i].start = start;
+	set->r[i].end = end;
+	set->count++;
+	return 0;
+}
+
+int
+ranges_remove(ranges_t *set, off_t start, off_t end)
+{
+	size_t i, j;
+
+	if (start >= end)
+		return 0;
+
+	/* Out of the middle of one, which leaves two */
+	i = find(set, start);
+	if (i < set->count && set->r[i].start < start && set->r[i].end > end) {
+		if (grow(set) == -1)
+			return -1;
+		memmove(set->r + i + 1, set->r + i,
+			(set->count - i) * sizeof(*set->r));
+		set->r[i].end = start;
+		set->r[i + 1].start = end;
+		set->count++;
+		return 0;
+	}
+
+	/* Else the tail of the first, the ones inside and the head of the
+	   last it overlaps */
+	if (i < set->count && set->r[i].start < start) {
+		if (set->r[i].end > start)
+			set->r[i].end = start;
+		i++;
+	}
+	for (j = i; j < set->count && set->r[j].end <= end; j++)
+		;
+	if (j < set->count && set->r[j].start < end)
+		set->r[j].start = end;
+	memmove(set->r + i, set->r + j, (set->count - j) * sizeof(*set->r));
+	set->count -= j - i;
+	return 0;
+}
+
+off_t
+ranges_total(const ranges_t *set)
+{
+	off_t total = 0;
+
+	for (size_t i = 0; i < set->count; i++)
+		total += set->r[i].end - set->r[i].start;
+	return total;
+}
+
+int
+ranges_gap(const ranges_t *set, off_t pos, off_t size, range_t *gap)
+{
+	size_t i = find(set, pos);
+
+	/* Ranges never touch, so the next one starts past a gap */
+	if (i < set->count && set->r[i].start <= pos)
+		pos = set->r[i++].end;
+
+	gap->start = pos;
+	gap->end = i < set->count && set->r[i].start < size ?
+		set->r[i].start : size;
+	return gap->start < gap->end;
+}
+
+int
+ranges_plan(const ranges_t *set, off_t size, int n, off_t min_piece,
+	    range_t *pieces)
+{
+	range_t *gaps = malloc(n * sizeof(*gaps));
+	int *split = malloc(n * sizeof(*split));
+	int ngaps = 0, npieces;
+
+	if (!gaps || !split) {
+		free(gaps);
+		free(split);
+		return -1;
+	}
+
+	for (off_t pos = 0; ngaps < n &&
+	     ranges_gap(set, pos, size, &gaps[ngaps]); ngaps++) {
+		pos = gaps[ngaps].end;
+		split[ngaps] = 1;
+	}
+
+	/* Another piece for whichever gap it leaves the widest pieces in */
+	for (npieces = ngaps; npieces < n; npieces++) {
+		off_t widest = 0;
+		int best = -1;
+
+		for (int i = 0; i < ngaps; i++) {
+			off_t width = (gaps[i].end - gaps[i].start) /
+				(split[i] + 1);
+
+			if (width > widest) {
+				widest = width;
+				best = i;
+			}
+		}
+		if (best == -1 || widest < min_piece)
+			break;
+		split[best]++;
+	}
+
+	/* Cut each gap evenly, the last piece taking what does not divide */
+	range_t *p = pieces;
+	for (int i = 0; i < ngaps; i++) {
+		off_t width = (gaps[i].end - gaps[i].start) / split[i];
+
+		for (int k = 0; k < split[i]; k++, p++) {
+			p->start = gaps[i].start + k * width;
+			p->end = p->start + width;
+		}
+		p[-1].end = gaps[i].end;
+	}
+
+	free(gaps);
+	free(split);
+	return npieces;
+}
@@ -0,0 +1,83 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* The bytes of a download that are done, as a set of ranges */
+
+#ifndef AXEL_RANGES_H
+#define AXEL_RANGES_H
+
+/* Half-open, [start, end) */
+typedef struct {
+	off_t start, end;
+} range_t;
+
+/* Sorted, and never two that overlap or touch: adding a range merges it
+ * with its neighbours, so a download fetched in order stays one range
+ * however many reads it took. */
+typedef struct {
+	range_t *r;
+	size_t count, alloc;
+} ranges_t;
+
+void ranges_init(ranges_t *set);
+void ranges_free(ranges_t *set);
+
+/* Returns 0, or -1 with errno set if it could not be added */
+int ranges_add(ranges_t *set, off_t start, off_t end);
+
+/* Take [start, end) out of the set.  Returns 0, or -1 with errno set if a
+ * range it split in two had no room for the second half. */
+int ranges_remove(ranges_t *set, off_t start, off_t end);
+
+/* How many bytes the set holds */
+off_t ranges_total(const ranges_t *set);
+
+/* The first gap at or after pos and before size, into gap.  Returns 1 if
+ * there is one, 0 if the set covers all of [pos, size). */
+int ranges_gap(const ranges_t *set, off_t pos, off_t size, range_t *gap);
+
+/* Lay up to n pieces over the gaps in [0, size), into pieces, which has
+ * room for n.  While there are fewer gaps than n the widest gets split,
+ * never into pieces narrower than min_piece; when there are more, the
+ * first n are given and the rest left for later.
+ *
+ * Returns the number of pieces, 0 if there are no gaps, -1 with errno set
+ * if it ran out of memory. */
+int ranges_plan(const ranges_t *set, off_t size, int n, off_t min_piece,
+		range_t *pieces);
+
+#endif				/* AXEL_RANGES_H */
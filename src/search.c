@@ -63,7 +63,7 @@ main(int argc, char *argv[])
 	}
 
 	conf_init(conf);
-	ssl_init(conf);
+	ssl_init();
 
 	res = calloc(conf->search_amount + 1, sizeof(search_t));
 	if (!res)
@@ -0,0 +1,358 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Bandwidth budget shared between processes
+ *
+ * Every download given the same speed group draws from one token bucket,
+ * kept in a POSIX shared memory object, so that however many of them run at
+ * once, together they stay within the one limit.  Nothing but atomic
+ * operations guards it: a process killed halfway through taking tokens can
+ * leave nothing locked behind.
+ *
+ * The bucket outlives the processes using it, and is picked up again by the
+ * next one to join the group.  The refill is done by whichever process
+ * happens to look first, and the tokens that earned are credited by the one
+ * that manages to move the timestamp on, so no two processes can both add
+ * the same stretch of time.
+ *
+ * A group is the user's own: the object is named after the user as well as
+ * the group, and nobody else may open it, so that another user can neither
+ * starve a group of its tokens nor stop it being made. */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shbucket.h"
+
+#define SHBUCKET_MAGIC		UINT32_C(0x41584c42)	/* AXLB */
+#define SHBUCKET_VERSION	1
+
+/* Nowhere to keep a bucket for other processes to find, and so no buckets */
+#ifndef HAVE_SHM_OPEN
+static
+int
+no_shm(void)
+{
+	errno = ENOSYS;
+	return -1;
+}
+#define shm_open(path, flags, mode)	no_shm()
+#define shm_unlink(path)		no_shm()
+#endif
+
+/* How long to give whoever is creating a bucket to finish setting it up */
+#define SHBUCKET_SETUP_TRIES	100
+#define SHBUCKET_SETUP_WAIT	10000000	/* ns */
+
+struct shbucket {
+	uint32_t magic;		/* stored last, once the rest is valid */
+	uint32_t version;
+	uint64_t rate;		/* bytes per second */
+	uint64_t burst;
+	int64_t tokens;
+	uint64_t stamp;		/* ns on CLOCK_MONOTONIC, system-wide */
+};
+
+static
+uint64_t
+now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static
+void
+setup_wait(void)
+{
+	struct timespec ts = { .tv_nsec = SHBUCKET_SETUP_WAIT };
+
+	nanosleep(&ts, NULL);
+}
+
+/* Wait for the creator to give the object its size: mapping it any earlier
+ * would leave nothing behind the mapping to touch */
+static
+int
+wait_for_size(int fd)
+{
+	for (int i = 0; i < SHBUCKET_SETUP_TRIES; i++) {
+		struct stat st;
+
+		if (fstat(fd, &st) == -1)
+			return -1;
+		if (st.st_size >= (off_t)sizeof(struct shbucket))
+			return 0;
+		setup_wait();
+	}
+
+	errno = EAGAIN;
+	return -1;
+}
+
+static
+int
+wait_for_magic(const shbucket_t *b)
+{
+	for (int i = 0; i < SHBUCKET_SETUP_TRIES; i++) {
+		if (__atomic_load_n(&b->magic, __ATOMIC_ACQUIRE) ==
+		    SHBUCKET_MAGIC)
+			return b->version == SHBUCKET_VERSION ? 0 : -1;
+		setup_wait();
+	}
+
+	return -1;
+}
+
+static
+int
+open_object(const char *path, unsigned long long rate, bool *created)
+{
+	int fd = -1;
+
+	*created = false;
+	if (rate) {
+		fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd == -1 && errno != EEXIST)
+			return -1;
+		*created = fd != -1;
+	}
+	if (fd == -1)
+		fd = shm_open(path, O_RDWR, 0);
+
+	return fd;
+}
+
+/* The name of the shared memory object behind this user's bucket called
+   name */
+static
+int
+object_name(char *path, size_t len, const char *name)
+{
+	if (!*name || strchr(name, '/')) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (snprintf(path, len, "/axel-%lu-%s", (unsigned long)getuid(),
+		     name) >= (int)len) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	return 0;
+}
+
+shbucket_t *
+shbucket_open(const char *name, unsigned long long rate, size_t burst)
+{
+	char path[256];
+	bool created;
+	shbucket_t *b;
+
+	if (object_name(path, sizeof(path), name) == -1)
+		return NULL;
+
+	int fd = open_object(path, rate, &created);
+	if (fd == -1)
+		return NULL;
+
+	if ((created ? ftruncate(fd, sizeof(*b)) : wait_for_size(fd)) == -1) {
+		int err = errno;
+		if (created)
+			shm_unlink(path);
+		close(fd);
+		errno = err;
+		return NULL;
+	}
+
+	b = mmap(NULL, sizeof(*b), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (b == MAP_FAILED)
+		return NULL;
+
+	if (created) {
+		b->version = SHBUCKET_VERSION;
+		b->rate = rate;
+		b->burst = burst;
+		b->tokens = burst;
+		b->stamp = now_ns();
+		__atomic_store_n(&b->magic, SHBUCKET_MAGIC, __ATOMIC_RELEASE);
+		return b;
+	}
+
+	if (wait_for_magic(b) == -1) {
+		munmap(b, sizeof(*b));
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (rate) {
+		__atomic_store_n(&b->rate, rate, __ATOMIC_RELAXED);
+		__atomic_store_n(&b->burst, burst, __ATOMIC_RELAXED);
+	}
+
+	return b;
+}
+
+void
+shbucket_close(shbucket_t *b)
+{
+	if (b)
+		munmap(b, sizeof(*b));
+}
+
+int
+shbucket_unlink(const char *name)
+{
+	char path[256];
+
+	if (object_name(path, sizeof(path), name) == -1)
+		return -1;
+	return shm_unlink(path);
+}
+
+unsigned long long
+shbucket_rate(const shbucket_t *b)
+{
+	return __atomic_load_n(&b->rate, __ATOMIC_RELAXED);
+}
+
+/* Bring tokens back down to the burst, t being what was last seen there.
+ * Whatever a racing taker got in the meantime stays taken. */
+static
+void
+trim(shbucket_t *b, int64_t t)
+{
+	int64_t burst = __atomic_load_n(&b->burst, __ATOMIC_RELAXED);
+
+	while (t > burst &&
+	       !__atomic_compare_exchange_n(&b->tokens, &t, burst, false,
+					    __ATOMIC_ACQ_REL,
+					    __ATOMIC_ACQUIRE)) ;
+}
+
+static
+void
+refill(shbucket_t *b)
+{
+	uint64_t rate = __atomic_load_n(&b->rate, __ATOMIC_RELAXED);
+	uint64_t burst = __atomic_load_n(&b->burst, __ATOMIC_RELAXED);
+	uint64_t stamp = __atomic_load_n(&b->stamp, __ATOMIC_ACQUIRE);
+	uint64_t now = now_ns();
+
+	if (!rate || now <= stamp)
+		return;
+
+	/* Only whole tokens are credited, and the stamp only moves on by the
+	 * time they took, so the fractions left over are not lost */
+	double earned = (double)(now - stamp) * rate / 1000000000;
+	uint64_t next;
+	if (earned >= burst) {
+		earned = burst;
+		next = now;
+	} else {
+		earned = (uint64_t)earned;
+		next = stamp + (uint64_t)(earned * 1000000000 / rate);
+	}
+	if (earned < 1)
+		return;
+
+	if (!__atomic_compare_exchange_n(&b->stamp, &stamp, next, false,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		return;
+
+	trim(b, __atomic_add_fetch(&b->tokens, (int64_t)earned,
+				   __ATOMIC_ACQ_REL));
+}
+
+size_t
+shbucket_take(shbucket_t *b, size_t want, int nreaders)
+{
+	refill(b);
+
+	int64_t t = __atomic_load_n(&b->tokens, __ATOMIC_ACQUIRE);
+	for (;;) {
+		if (t <= 0)
+			return 0;
+
+		/* An even share, rounded up as throttle_share() does */
+		int64_t n = (t + nreaders - 1) / (nreaders > 0 ? nreaders : 1);
+		if ((uint64_t)n > want)
+			n = want;
+
+		if (__atomic_compare_exchange_n(&b->tokens, &t, t - n, false,
+						__ATOMIC_ACQ_REL,
+						__ATOMIC_ACQUIRE))
+			return n;
+	}
+}
+
+void
+shbucket_give(shbucket_t *b, size_t n)
+{
+	if (n)
+		trim(b, __atomic_add_fetch(&b->tokens, (int64_t)n,
+					   __ATOMIC_ACQ_REL));
+}
+
+double
+shbucket_delay(shbucket_t *b, size_t want)
+{
+	refill(b);
+
+	uint64_t rate = __atomic_load_n(&b->rate, __ATOMIC_RELAXED);
+	uint64_t burst = __atomic_load_n(&b->burst, __ATOMIC_RELAXED);
+	int64_t t = __atomic_load_n(&b->tokens, __ATOMIC_ACQUIRE);
+
+	if (want > burst)
+		want = burst;
+	if (!rate || t >= (int64_t)want)
+		return 0;
+
+	return (double)((int64_t)want - t) / rate;
+}
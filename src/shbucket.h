@@ -0,0 +1,75 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Bandwidth budget shared between processes */
+
+#ifndef AXEL_SHBUCKET_H
+#define AXEL_SHBUCKET_H
+
+#include <stddef.h>
+
+typedef struct shbucket shbucket_t;
+
+/* Join the user's token bucket called name, creating it if need be; other
+ * users' buckets of that name are theirs, and out of reach.
+ *
+ * A rate of zero joins the bucket at whatever rate it already has, and
+ * fails with ENOENT if there is no such bucket yet; any other rate becomes
+ * the bucket's own, for every process drawing from it.  Returns NULL with
+ * errno set on failure. */
+shbucket_t *shbucket_open(const char *name, unsigned long long rate,
+			  size_t burst);
+void shbucket_close(shbucket_t *b);
+
+/* Remove the bucket called name once no more processes are to join it;
+ * those still drawing from it carry on.  Returns -1 with errno set if
+ * there is no such bucket. */
+int shbucket_unlink(const char *name);
+
+unsigned long long shbucket_rate(const shbucket_t *b);
+
+/* Take up to want tokens, no more than an even share of them between
+ * nreaders, and return how many were taken */
+size_t shbucket_take(shbucket_t *b, size_t want, int nreaders);
+
+/* Hand back tokens that were taken and not used */
+void shbucket_give(shbucket_t *b, size_t n);
+
+/* How long until there are want tokens, 0 if there already are */
+double shbucket_delay(shbucket_t *b, size_t want);
+
+#endif				/* AXEL_SHBUCKET_H */
@@ -53,21 +53,44 @@
 
 #include "axel.h"
 
+/* A setup thread can be cancelled at any instruction, and one cancelled
+   holding the lock, or inside malloc(), would leave every later connection
+   waiting on it: whatever takes the lock does so with cancellation off */
 static pthread_mutex_t ssl_lock;
 static bool ssl_inited = false;
-static conf_t *conf = NULL;
+
+/* One context for every connection, for the sessions to be shared.  Whether
+   the server's certificate is checked is each connection's own setting: in
+   a batch or a program using libaxel, each download's. */
+static SSL_CTX *ssl_ctx = NULL;
+
+/* The last session each host gave, for the next connection to it to resume
+   rather than go through a full handshake again: a download's own
+   connections, or, in a batch, those of the next download from the same
+   host.  Replaced in turn once full.  A session from a connection that did
+   not check the certificate is only for another that does not either. */
+#define SSL_SESSIONS 32
+static struct {
+	char *host;
+	bool insecure;
+	SSL_SESSION *session;
+} sessions[SSL_SESSIONS];
+static int next_session = 0;
 
 void
-ssl_init(conf_t *global_conf)
+ssl_init(void)
 {
 	pthread_mutex_init(&ssl_lock, NULL);
-	conf = global_conf;
 }
 
+/* Returns 0 if there is no context to be had */
 static
-void
+int
 ssl_startup(void)
 {
+	int cancel;
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel);
 	pthread_mutex_lock(&ssl_lock);
 	if (!ssl_inited) {
 		SSL_library_init();
@@ -75,59 +98,139 @@ ssl_startup(void)
 
 		ssl_inited = true;
 	}
+	if (!ssl_ctx) {
+		ssl_ctx = SSL_CTX_new(SSLv23_client_method());
+		if (ssl_ctx) {
+			SSL_CTX_set_default_verify_paths(ssl_ctx);
+			SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, NULL);
+		}
+		if (ssl_ctx)
+			SSL_CTX_set_mode(ssl_ctx, SSL_MODE_AUTO_RETRY);
+	}
+	pthread_mutex_unlock(&ssl_lock);
+	pthread_setcancelstate(cancel, NULL);
+
+	return ssl_ctx != NULL;
+}
+
+/* Offer the session hostname last gave, if it gave one */
+static
+void
+ssl_resume(SSL *ssl, const char *hostname, bool insecure)
+{
+	int cancel;
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel);
+	pthread_mutex_lock(&ssl_lock);
+	for (int i = 0; i < SSL_SESSIONS; i++) {
+		if (sessions[i].host && !strcmp(sessions[i].host, hostname) &&
+		    sessions[i].insecure == insecure) {
+			SSL_set_session(ssl, sessions[i].session);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&ssl_lock);
+	pthread_setcancelstate(cancel, NULL);
+}
+
+/* Keep the session a connection leaves, once it is over: with TLS 1.3 the
+   server only sends its ticket after the handshake.  Called with
+   cancellation off. */
+static
+void
+ssl_keep(SSL *ssl)
+{
+	const char *hostname = SSL_get_servername(ssl,
+						  TLSEXT_NAMETYPE_host_name);
+	SSL_SESSION *session = SSL_get1_session(ssl);
+	bool insecure = SSL_get_verify_mode(ssl) == SSL_VERIFY_NONE;
+	bool keep = session && hostname;
+	int i;
+
+#if !defined(HAVE_WOLFSSL) && OPENSSL_VERSION_NUMBER >= 0x10101000L
+	keep = keep && SSL_SESSION_is_resumable(session);
+#endif
+	if (!keep) {
+		if (session)
+			SSL_SESSION_free(session);
+		return;
+	}
+
+	pthread_mutex_lock(&ssl_lock);
+	for (i = 0; i < SSL_SESSIONS; i++)
+		if (sessions[i].host && !strcmp(sessions[i].host, hostname) &&
+		    sessions[i].insecure == insecure)
+			break;
+	if (i == SSL_SESSIONS) {
+		char *host = strdup(hostname);
+
+		if (!host) {
+			pthread_mutex_unlock(&ssl_lock);
+			SSL_SESSION_free(session);
+			return;
+		}
+		i = next_session;
+		next_session = (next_session + 1) % SSL_SESSIONS;
+		free(sessions[i].host);
+		sessions[i].host = host;
+		sessions[i].insecure = insecure;
+	}
+	if (sessions[i].session)
+		SSL_SESSION_free(sessions[i].session);
+	sessions[i].session = session;
 	pthread_mutex_unlock(&ssl_lock);
 }
 
 SSL *
-ssl_connect(int fd, char *hostname)
+ssl_connect(int fd, char *hostname, const char *alpn, bool insecure)
 {
 	X509 *server_cert;
-	SSL_CTX *ssl_ctx;
 	SSL *ssl;
 
-	ssl_startup();
-
-	ssl_ctx = SSL_CTX_new(SSLv23_client_method());
-	if (!conf->insecure) {
-		SSL_CTX_set_default_verify_paths(ssl_ctx);
-		SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER, NULL);
+	if (!ssl_startup() || !(ssl = SSL_new(ssl_ctx))) {
+		fprintf(stderr, _("SSL error: %s\n"),
+			ERR_reason_error_string(ERR_get_error()));
+		return NULL;
 	}
-	SSL_CTX_set_mode(ssl_ctx, SSL_MODE_AUTO_RETRY);
-
-	ssl = SSL_new(ssl_ctx);
+	if (insecure)
+		SSL_set_verify(ssl, SSL_VERIFY_NONE, NULL);
 	SSL_set_fd(ssl, fd);
 	SSL_set_tlsext_host_name(ssl, hostname);
+	if (alpn)
+		SSL_set_alpn_protos(ssl, (const unsigned char *)alpn,
+				    strlen(alpn));
+	ssl_resume(ssl, hostname, insecure);
 
 	int err = SSL_connect(ssl);
 	if (err <= 0) {
 		fprintf(stderr, _("SSL error: %s\n"),
 			ERR_reason_error_string(ERR_get_error()));
-		SSL_CTX_free(ssl_ctx);
+		SSL_free(ssl);
 		return NULL;
 	}
 
-	if (conf->insecure) {
+	if (insecure) {
 		return ssl;
 	}
 
 	err = SSL_get_verify_result(ssl);
 	if (err != X509_V_OK) {
 		fprintf(stderr, _("SSL error: Certificate error\n"));
-		SSL_CTX_free(ssl_ctx);
+		SSL_free(ssl);
 		return NULL;
 	}
 
 	server_cert =  SSL_get_peer_certificate(ssl);
 	if (server_cert == NULL) {
 		fprintf(stderr, _("SSL error: Certificate not found\n"));
-		SSL_CTX_free(ssl_ctx);
+		SSL_free(ssl);
 		return NULL;
 	}
 
 	if (!ssl_validate_hostname(hostname, server_cert)) {
 		fprintf(stderr, _("SSL error: Hostname verification failed\n"));
 		X509_free(server_cert);
-		SSL_CTX_free(ssl_ctx);
+		SSL_free(ssl);
 		return NULL;
 	}
 
@@ -139,6 +242,11 @@ ssl_connect(int fd, char *hostname)
 void
 ssl_disconnect(SSL *ssl)
 {
+	int cancel;
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel);
+	ssl_keep(ssl);
+	pthread_setcancelstate(cancel, NULL);
 	SSL_shutdown(ssl);
 	SSL_free(ssl);
 }
@@ -52,8 +52,11 @@
 #endif
 
 
-void ssl_init(conf_t *conf);
-SSL *ssl_connect(int fd, char *hostname);
+void ssl_init(void);
+/* Connect over fd, offering the protocols in alpn if it is not NULL: each
+   a length byte and the name, as ALPN has them.  The certificate is
+   checked unless insecure. */
+SSL *ssl_connect(int fd, char *hostname, const char *alpn, bool insecure);
 void ssl_disconnect(SSL *ssl);
 bool ssl_validate_hostname(const char *hostname, const X509 *server_cert);
 
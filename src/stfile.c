@@ -39,29 +39,90 @@
 
 /* The .st file that lets an interrupted download be resumed.
  *
- * It holds the number of connections, how many bytes are done in total, and
- * the range each connection was working on, all in the machine's own
- * representation.  A file older than the range fields is recognised by its
- * length and still read; the ranges are recomputed for it. */
+ * It holds the size of the download and the ranges of it that are done, in
+ * three slots of the same size, each a multiple of SLOT_ALIGN:
+ *
+ *	"AXST"  magic
+ *	u16     format version, STFILE_VERSION
+ *	u16     SLOT_DURABLE or SLOT_CHECKPOINT
+ *	i64     size of the download
+ *	u64     sequence number, higher for every slot written
+ *	u8[16]  boot id, for a checkpoint
+ *	u32     how many ranges the slot has room for
+ *	u32     number of ranges
+ *	u16     length of the ETag
+ *	u16     length of the Last-Modified date
+ *	u32     zero
+ *	        the ETag and the Last-Modified date, padded to 8 bytes
+ *	i64 i64 start and end of each range, in order
+ *	u32     CRC-32 of all of the above
+ *
+ * all little-endian.  The file is mapped, and a save is a matter of filling
+ * a slot in and flushing it.  The first two are durable: the one written
+ * next is always the older, and only once the data it describes is on disk,
+ * so that a crash halfway through leaves the other whole, and neither is
+ * ever ahead of the data.  The third is a checkpoint, filled in far more
+ * often and never flushed: what it describes is on its way to the disk, but
+ * may not be there, so it is only believed while the machine has not gone
+ * down since, which is what the boot id in it tells.  A file that runs out
+ * of room for ranges is replaced by a bigger one.
+ *
+ * What the connections were doing is not kept: they are laid afresh over
+ * the gaps, however many there are of either.  What the server said the
+ * file was is, for the file it says it is now to be checked against.
+ *
+ * Older files are still read.  Version 4 has no ETag nor date, and the
+ * ranges right after their number.  Version 3 is a single such slot with neither
+ * boot id nor room to spare, and the number of ranges in the i64 right after
+ * the size.  Earlier ones hold the range each connection was working on
+ * instead, from which the ranges done are worked out: version 2 with the
+ * number of connections in the u16 after the version, and the bytes done
+ * in place of the number of ranges; those from before the format had a
+ * version just these, less the magic and checksum, in the machine's own
+ * representation.  Those older still, with no end to each connection's
+ * range, are recognised by their length, and the ends recomputed. */
 
 #include "config.h"
+
+#include <sys/mman.h>
+
 #include "axel.h"
-#include "assert.h"
 #include "stfile.h"
 
+#ifndef HAVE_FDATASYNC
+#define fdatasync fsync
+#endif
+
+#define STFILE_MAGIC	"AXST"
+#define STFILE_VERSION	5
+#define STFILE_HEADER	24	/* up to the first range, in version 3 */
+
+#define SLOT_ALIGN	4096	/* a page, on most machines */
+#define SLOT_HEADER	56	/* up to the validators */
+#define SLOT_DURABLE	0
+#define SLOT_CHECKPOINT	1
+
+/* The mapped state file */
+struct stfile {
+	unsigned char *map;
+	size_t slot_size, capacity;
+	uint64_t seq;
+	int last;		/* the durable slot written last */
+};
+
 static
 char *
-stfile_makename(const char *bname)
+stfile_makename(const char *bname, const char *suffix)
 {
-	const char suffix[] = ".st";
 	const size_t bname_len = strlen(bname);
-	char *buf = malloc(bname_len + sizeof(suffix));
+	const size_t suffix_len = strlen(suffix);
+	char *buf = malloc(bname_len + suffix_len + 1);
 	if (!buf) {
 		perror("stfile_open");
 		abort();
 	}
 	memcpy(buf, bname, bname_len);
-	memcpy(buf + bname_len, suffix, sizeof(suffix));
+	memcpy(buf + bname_len, suffix, suffix_len + 1);
 	return buf;
 }
 
@@ -69,7 +130,7 @@ stfile_makename(const char *bname)
 int
 stfile_unlink(const char *bname)
 {
-	char *stname = stfile_makename(bname);
+	char *stname = stfile_makename(bname, ".st");
 	int ret = unlink(stname);
 	free(stname);
 	return ret;
@@ -78,7 +139,7 @@ stfile_unlink(const char *bname)
 int
 stfile_access(const char *bname, int mode)
 {
-	char *stname = stfile_makename(bname);
+	char *stname = stfile_makename(bname, ".st");
 	int ret = access(stname, mode);
 	free(stname);
 	return ret;
@@ -89,20 +150,55 @@ static
 int
 stfile_open(const char *bname, int flags, mode_t mode)
 {
-	char *stname = stfile_makename(bname);
+	char *stname = stfile_makename(bname, ".st");
 	int fd = open(stname, flags, mode);
 	free(stname);
 	return fd;
 }
 
 
+static
+void
+put_le(unsigned char *p, uint64_t v, int len)
+{
+	for (int i = 0; i < len; i++)
+		p[i] = v >> (8 * i);
+}
+
+static
+uint64_t
+get_le(const unsigned char *p, int len)
+{
+	uint64_t v = 0;
+
+	for (int i = len - 1; i >= 0; i--)
+		v = v << 8 | p[i];
+	return v;
+}
+
+static
+uint32_t
+crc32(const unsigned char *p, size_t len)
+{
+	uint32_t crc = 0xffffffff;
+
+	while (len--) {
+		crc ^= *p++;
+		for (int k = 0; k < 8; k++)
+			crc = crc >> 1 ^ (0xedb88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+
 /* Does the state just read describe the file the server just described?
  *
- * The state file names neither the URL nor the size it was written for, so a
- * download whose output name collides with an unfinished, unrelated one will
- * happily load the other's progress.  Nothing then adds up: the byte counts
- * print as nonsense, every connection asks for a range past the end of the
- * file, and none of it is ever going to finish.
+ * A state file that predates the ranges may name neither the URL nor the
+ * size it was written for, so a download whose output name collides with an
+ * unfinished, unrelated one will happily load the other's progress.
+ * Nothing then adds up: the byte counts print as nonsense, every connection
+ * asks for a range past the end of the file, and none of it is ever going
+ * to finish.
  *
  * What can be checked is the shape.  The chunks axel_divide() lays down tile
  * the file in order, and a connection stops at the end of its own chunk, so
@@ -134,78 +230,379 @@ state_fits_download(const axel_t *axel)
 	return start == axel->size;
 }
 
-
+/* What the connections a state file that predates the ranges describes had
+ * done: each one's chunk, from where the one before it ends, up to where it
+ * got.  Returns as the loaders do. */
+static
 int
-stfile_load(axel_t *axel)
+ranges_from_conns(axel_t *axel)
 {
-	int fd = stfile_open(axel->filename, O_RDONLY, 0);
-	if (fd == -1)
+	off_t start = 0;
+
+	if (!state_fits_download(axel)) {
+		axel_message(axel, _("State file %s.st belongs to another "
+				     "download, ignoring it."), axel->filename);
 		return 0;
+	}
 
-	/* What to go back to if the state turns out not to be ours */
-	uint16_t wanted_conns = axel->conf->num_connections;
+	for (int i = 0; i < axel->conf->num_connections; i++) {
+		if (ranges_add(&axel->done, start,
+			       axel->conn[i].currentbyte) == -1)
+			return -1;
+		start = axel->conn[i].lastbyte;
+	}
+
+	return 1;
+}
+
+
+/* Read a state file written before the format had a version.  Returns 1 if
+ * it was read, 0 if it is to be ignored, having said why, -1 if the
+ * download cannot go ahead. */
+static
+int
+load_unversioned(axel_t *axel, const unsigned char *buf, size_t len)
+{
 	uint16_t nconns;
 	int old_format = 0;
-	off_t stsize = lseek(fd, 0, SEEK_END);
-	lseek(fd, 0, SEEK_SET);
 
-	ssize_t nread = read(fd, &nconns, sizeof(nconns));
-	if (nread != sizeof(nconns)) {
+	if (len < sizeof(nconns)) {
 		printf(_("%s.st: Error, truncated state file\n"),
 		       axel->filename);
-		close(fd);
 		return -1;
 	}
+	memcpy(&nconns, buf, sizeof(nconns));
 
 	if (nconns < 1) {
 		fprintf(stderr,
 			_("Bogus number of connections stored in state file\n"));
-		close(fd);
 		return -1;
 	}
 
-	if (stsize < (off_t)(sizeof(nconns) +
-			     sizeof(axel->bytes_done) +
-			     2 * nconns *
-			     sizeof(axel->conn[0].currentbyte))) {
+	size_t need = sizeof(nconns) + sizeof(axel->bytes_done) +
+	    2 * nconns * sizeof(axel->conn[0].currentbyte);
+	if (len < need) {
 		/* FIXME this might be wrong, the file may have been
 		 * truncated, we need another way to check. */
 #ifndef NDEBUG
 		printf(_("State file has old format.\n"));
 #endif
 		old_format = 1;
+		need -= nconns * sizeof(axel->conn[0].lastbyte);
 	}
-
-	if (!axel_conn_resize(axel, nconns)) {
-		close(fd);
+	if (len < need) {
+		printf(_("%s.st: Error, truncated state file\n"),
+		       axel->filename);
 		return -1;
 	}
 
-	if (old_format)
-		axel_divide(axel);
+	if (!axel_conn_resize(axel, nconns))
+		return -1;
+
+	if (old_format && !axel_divide(axel))
+		return -1;
 
-	nread = read(fd, &axel->bytes_done, sizeof(axel->bytes_done));
-	assert(nread == sizeof(axel->bytes_done));
+	buf += sizeof(nconns);
+	memcpy(&axel->bytes_done, buf, sizeof(axel->bytes_done));
+	buf += sizeof(axel->bytes_done);
 	for (int i = 0; i < axel->conf->num_connections; i++) {
-		nread = read(fd, &axel->conn[i].currentbyte,
-			     sizeof(axel->conn[i].currentbyte));
-		assert(nread == sizeof(axel->conn[i].currentbyte));
+		memcpy(&axel->conn[i].currentbyte, buf,
+		       sizeof(axel->conn[i].currentbyte));
+		buf += sizeof(axel->conn[i].currentbyte);
 		if (!old_format) {
-			nread = read(fd, &axel->conn[i].lastbyte,
-				     sizeof(axel->conn[i].lastbyte));
-			assert(nread == sizeof(axel->conn[i].lastbyte));
+			memcpy(&axel->conn[i].lastbyte, buf,
+			       sizeof(axel->conn[i].lastbyte));
+			buf += sizeof(axel->conn[i].lastbyte);
+		}
+	}
+
+	return ranges_from_conns(axel);
+}
+
+static
+int
+damaged(axel_t *axel)
+{
+	axel_message(axel, _("State file %s.st is damaged, ignoring it."),
+		     axel->filename);
+	return 0;
+}
+
+/* The ranges at p.  Returns as the loaders do. */
+static
+int
+load_ranges(axel_t *axel, const unsigned char *p, uint64_t count)
+{
+	off_t end = 0;
+
+	for (uint64_t i = 0; i < count; i++, p += 16) {
+		off_t start = get_le(p, 8);
+
+		if (start < end)
+			return damaged(axel);
+		end = get_le(p + 8, 8);
+		if (end <= start || end > axel->size)
+			return damaged(axel);
+		if (ranges_add(&axel->done, start, end) == -1)
+			return -1;
+	}
+
+	return 1;
+}
+
+/* Checked rather than left to the shape of the ranges: the server may have
+   sent a file of another size under the same name */
+static
+int
+same_size(axel_t *axel, const unsigned char *p)
+{
+	if ((off_t)get_le(p, 8) == axel->size)
+		return 1;
+
+	axel_message(axel, _("State file %s.st belongs to another "
+			     "download, ignoring it."), axel->filename);
+	return 0;
+}
+
+static
+int
+newer(axel_t *axel)
+{
+	axel_message(axel, _("State file %s.st is from a newer "
+			     "version of Axel, ignoring it."), axel->filename);
+	return 0;
+}
+
+/* Read a state file of version 2 or 3.  Returns as load_unversioned() does. */
+static
+int
+load_versioned(axel_t *axel, const unsigned char *buf, size_t len)
+{
+	if (len < STFILE_HEADER + 4 ||
+	    get_le(buf + len - 4, 4) != crc32(buf, len - 4))
+		return damaged(axel);
+
+	int version = get_le(buf + 4, 2);
+	if (version > STFILE_VERSION)
+		return newer(axel);
+	if (version != 2 && version != 3)
+		return damaged(axel);
+
+	uint64_t count = version == 2 ? get_le(buf + 6, 2) :
+		get_le(buf + 16, 8);
+	if ((version == 2 && count < 1) ||
+	    count > (len - STFILE_HEADER - 4) / 16 ||
+	    len != STFILE_HEADER + 16 * count + 4)
+		return damaged(axel);
+
+	if (!same_size(axel, buf + 8))
+		return 0;
+	if (version == 3)
+		return load_ranges(axel, buf + STFILE_HEADER, count);
+
+	const unsigned char *p = buf + STFILE_HEADER;
+	if (!axel_conn_resize(axel, count))
+		return -1;
+	axel->bytes_done = get_le(buf + 16, 8);
+	for (uint64_t i = 0; i < count; i++, p += 16) {
+		axel->conn[i].currentbyte = get_le(p, 8);
+		axel->conn[i].lastbyte = get_le(p + 8, 8);
+	}
+	return ranges_from_conns(axel);
+}
+
+/* What identifies this boot of the machine, if anything does */
+static
+int
+boot_id(unsigned char id[16])
+{
+	static unsigned char cached[16];
+	static int known = -1;
+
+	if (known == -1) {
+		char text[64];
+		int fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY);
+		ssize_t n = fd == -1 ? -1 : read(fd, text, sizeof(text) - 1);
+		int digits = 0;
+
+		if (fd != -1)
+			close(fd);
+		for (ssize_t i = 0; i < n && digits < 32; i++) {
+			int c = tolower((unsigned char)text[i]);
+			int v = isdigit(c) ? c - '0' :
+				c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+
+			if (v < 0)
+				continue;
+			cached[digits / 2] = cached[digits / 2] << 4 | v;
+			digits++;
+		}
+		known = digits == 32;
+	}
+
+	memcpy(id, cached, 16);
+	return known;
+}
+
+/* Where the ranges start in a slot, 0 if it is of no version known here,
+ * or does not add up */
+static
+size_t
+ranges_at(const unsigned char *p, size_t slot_size)
+{
+	size_t at;
+
+	switch (get_le(p + 4, 2)) {
+	case 4:
+		return 48;
+	case 5:
+		at = SLOT_HEADER + get_le(p + 48, 2) + get_le(p + 50, 2);
+		at = (at + 7) / 8 * 8;
+		return at + 4 <= slot_size ? at : 0;
+	}
+	return 0;
+}
+
+/* Is what the server says about the file what it said when the state was
+ * saved?  Where either side does not say, there is no telling. */
+static
+int
+same_file(axel_t *axel, const unsigned char *p)
+{
+	size_t etag_len = 0, modified_len = 0;
+
+	if (get_le(p + 4, 2) >= 5) {
+		etag_len = get_le(p + 48, 2);
+		modified_len = get_le(p + 50, 2);
+	}
+	p += SLOT_HEADER;
+
+	if ((etag_len && *axel->etag &&
+	     (etag_len != strlen(axel->etag) ||
+	      memcmp(p, axel->etag, etag_len))) ||
+	    (modified_len && *axel->last_modified &&
+	     (modified_len != strlen(axel->last_modified) ||
+	      memcmp(p + etag_len, axel->last_modified, modified_len)))) {
+		axel_message(axel, _("The file has changed on the server since "
+				     "%s.st was saved, ignoring it."),
+			     axel->filename);
+		return 0;
+	}
+	return 1;
+}
+
+/* Read a state file of slots.  Returns as load_unversioned() does. */
+static
+int
+load_slots(axel_t *axel, const unsigned char *buf, size_t len)
+{
+	const size_t slot_size = len / 3;
+	const unsigned char *best = NULL;
+	uint64_t best_seq = 0;
+	unsigned char boot[16];
+	int booted = boot_id(boot), newest = 0;
+
+	for (int i = 0; i < 3; i++) {
+		const unsigned char *p = buf + i * slot_size;
+		uint64_t count = get_le(p + 44, 4);
+		size_t at = ranges_at(p, slot_size);
+		size_t used = at + 16 * count;
+
+		if (memcmp(p, STFILE_MAGIC, 4))
+			continue;
+		newest = newest || get_le(p + 4, 2) > STFILE_VERSION;
+		if (!at || count > (slot_size - at - 4) / 16 ||
+		    get_le(p + used, 4) != crc32(p, used))
+			continue;
+
+		int kind = get_le(p + 6, 2);
+		if (kind == SLOT_CHECKPOINT &&
+		    (!booted || memcmp(p + 24, boot, 16)))
+			continue;
+		if (kind != SLOT_DURABLE && kind != SLOT_CHECKPOINT)
+			continue;
+
+		if (!best || get_le(p + 16, 8) > best_seq) {
+			best = p;
+			best_seq = get_le(p + 16, 8);
 		}
 	}
 
+	if (!best)
+		return newest ? newer(axel) : damaged(axel);
+	if (!same_size(axel, best + 8) || !same_file(axel, best))
+		return 0;
+	return load_ranges(axel, best + ranges_at(best, slot_size),
+			   get_le(best + 44, 4));
+}
+
+/* The whole of the state file, which is never more than a few KB */
+static
+unsigned char *
+read_all(int fd, size_t *len)
+{
+	off_t size = lseek(fd, 0, SEEK_END);
+	unsigned char *buf;
+
+	if (size < 0 || lseek(fd, 0, SEEK_SET) == -1)
+		return NULL;
+
+	buf = malloc(size + 1);
+	if (!buf)
+		return NULL;
+
+	*len = 0;
+	while (*len < (size_t)size) {
+		ssize_t n = read(fd, buf + *len, size - *len);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		*len += n;
+	}
+
+	return buf;
+}
+
+int
+stfile_load(axel_t *axel)
+{
+	int fd = stfile_open(axel->filename, O_RDONLY, 0);
+	if (fd == -1)
+		return 0;
+
+	/* Whatever the state file says, the connections are laid afresh over
+	   what it leaves to do, as many as were asked for */
+	uint16_t wanted_conns = axel->conf->num_connections;
+	size_t len;
+	unsigned char *buf = read_all(fd, &len);
+	int ret;
+
 	close(fd);
+	if (!buf) {
+		printf(_("%s.st: Error, truncated state file\n"),
+		       axel->filename);
+		return -1;
+	}
 
-	if (!state_fits_download(axel)) {
-		axel_message(axel, _("State file %s.st belongs to another "
-				     "download, ignoring it."), axel->filename);
+	/* No older format can come to a whole number of slots */
+	if (len && len % (3 * SLOT_ALIGN) == 0)
+		ret = load_slots(axel, buf, len);
+	else if (len >= 4 && !memcmp(buf, STFILE_MAGIC, 4))
+		ret = load_versioned(axel, buf, len);
+	else
+		ret = load_unversioned(axel, buf, len);
+	free(buf);
+
+	if (ret >= 0 && !axel_conn_resize(axel, wanted_conns))
+		ret = -1;
+	if (ret <= 0) {
+		ranges_free(&axel->done);
 		axel->bytes_done = 0;
-		return axel_conn_resize(axel, wanted_conns) ? 0 : -1;
+		return ret;
 	}
 
+	axel->bytes_done = ranges_total(&axel->done);
 	axel_message(axel,
 		     _("State file found: %jd bytes downloaded, %jd to go."),
 		     (intmax_t)axel->bytes_done,
@@ -215,42 +612,225 @@ stfile_load(axel_t *axel)
 }
 
 
+static
+int
+write_all(int fd, const unsigned char *buf, size_t len)
+{
+	while (len) {
+		ssize_t n = write(fd, buf, len);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* Make a rename in the directory holding name survive a crash */
+static
+void
+sync_dir(const char *name)
+{
+	char *dir = strdup(name);
+	char *slash;
+	int fd;
+
+	if (!dir)
+		return;
+	slash = strrchr(dir, '/');
+	if (slash == dir)
+		slash[1] = 0;
+	else if (slash)
+		*slash = 0;
+	fd = open(slash ? dir : ".", O_RDONLY);
+	if (fd != -1) {
+		fsync(fd);
+		close(fd);
+	}
+	free(dir);
+}
+
+static
+size_t
+slot_size(size_t at, size_t capacity)
+{
+	size_t size = at + 16 * capacity + 4;
+
+	return (size + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+}
+
+/* Where the ranges start in the slots written for this download */
+static
+size_t
+ranges_offset(const axel_t *axel)
+{
+	size_t at = SLOT_HEADER + strlen(axel->etag) +
+		strlen(axel->last_modified);
+
+	return (at + 7) / 8 * 8;
+}
+
+/* Fill the slot at p in, which has room for capacity ranges, with done */
+static
+void
+encode_slot(const axel_t *axel, const ranges_t *done, unsigned char *p,
+	    size_t capacity, int kind, uint64_t seq)
+{
+	size_t etag_len = strlen(axel->etag);
+	size_t modified_len = strlen(axel->last_modified);
+	size_t at = ranges_offset(axel);
+	size_t used = at + 16 * done->count;
+
+	memcpy(p, STFILE_MAGIC, 4);
+	put_le(p + 4, STFILE_VERSION, 2);
+	put_le(p + 6, kind, 2);
+	put_le(p + 8, axel->size, 8);
+	put_le(p + 16, seq, 8);
+	if (kind != SLOT_CHECKPOINT || !boot_id(p + 24))
+		memset(p + 24, 0, 16);
+	put_le(p + 40, capacity, 4);
+	put_le(p + 44, done->count, 4);
+	put_le(p + 48, etag_len, 2);
+	put_le(p + 50, modified_len, 2);
+	put_le(p + 52, 0, 4);
+	memcpy(p + SLOT_HEADER, axel->etag, etag_len);
+	memcpy(p + SLOT_HEADER + etag_len, axel->last_modified, modified_len);
+	memset(p + SLOT_HEADER + etag_len + modified_len, 0,
+	       at - SLOT_HEADER - etag_len - modified_len);
+	for (size_t i = 0; i < done->count; i++) {
+		put_le(p + at + 16 * i, done->r[i].start, 8);
+		put_le(p + at + 16 * i + 8, done->r[i].end, 8);
+	}
+	put_le(p + used, crc32(p, used), 4);
+}
+
+/* Write a new state file out, with room for twice the ranges there are,
+ * rename it over the old one, and map it.  Returns as stfile_save(). */
+static
+int
+create_map(axel_t *axel)
+{
+	const struct stfile *old = axel->stfile;
+	struct stfile *st = calloc(1, sizeof(*st));
+	unsigned char *buf = NULL;
+
+	if (!st)
+		return -1;
+	size_t at = ranges_offset(axel);
+
+	st->slot_size = slot_size(at, 2 * axel->done.count);
+	st->capacity = (st->slot_size - at - 4) / 16;
+	st->seq = old ? old->seq + 1 : 1;
+	buf = calloc(3, st->slot_size);
+	if (!buf) {
+		free(st);
+		return -1;
+	}
+	encode_slot(axel, &axel->done, buf, st->capacity, SLOT_DURABLE,
+		    st->seq);
+
+	char *stname = stfile_makename(axel->filename, ".st");
+	char *tmpname = stfile_makename(axel->filename, ".st.tmp");
+	int ret = -1;
+	int fd = open(tmpname, O_CREAT | O_TRUNC | O_RDWR, 0666);
+	if (fd != -1) {
+		/* Written out rather than truncated to size, for the blocks
+		   to be there when the mapping is written back */
+		if (!write_all(fd, buf, 3 * st->slot_size) && !fsync(fd)) {
+			st->map = mmap(NULL, 3 * st->slot_size,
+				       PROT_READ | PROT_WRITE, MAP_SHARED,
+				       fd, 0);
+			if (st->map != MAP_FAILED)
+				ret = 0;
+		}
+		close(fd);
+	}
+
+	if (!ret && rename(tmpname, stname) == 0) {
+		sync_dir(stname);
+		stfile_close(axel);
+		axel->stfile = st;
+		st = NULL;
+	} else {
+		ret = -1;
+		if (fd != -1)
+			unlink(tmpname);
+	}
+
+	if (st && st->map && st->map != MAP_FAILED)
+		munmap(st->map, 3 * st->slot_size);
+	free(st);
+	free(tmpname);
+	free(stname);
+	free(buf);
+	return ret;
+}
+
 /**
  * Save the state of the current download.
  */
-void
+int
 stfile_save(axel_t *axel)
 {
+	struct stfile *st = axel->stfile;
+
 	/* No use for such a file if the server doesn't support
-	   resuming anyway.. */
-	if (!axel->conn[0].supported)
-		return;
+	   resuming anyway, nor if a pipe has had the data.. */
+	if (!axel->conn[0].supported || axel->stream)
+		return 0;
 
-	int fd;
-	fd = stfile_open(axel->filename, O_CREAT | O_TRUNC | O_WRONLY, 0666);
-	if (fd == -1) {
-		return;		/* Not 100% fatal.. */
-	}
+	/* Whatever the state says is done has to be on disk before it */
+	if (axel->writer && writer_sync(axel->writer) == -1)
+		return -1;
+	if (fdatasync(axel->outfd) == -1 && errno != EINVAL)
+		return -1;
 
-	ssize_t nwrite;
-	(void)nwrite; /* workaround unused variable warning */
-	nwrite =
-	    write(fd, &axel->conf->num_connections,
-		  sizeof(axel->conf->num_connections));
-	assert(nwrite == sizeof(axel->conf->num_connections));
+	if (!st || st->capacity < axel->done.count)
+		return create_map(axel);
 
-	nwrite = write(fd, &axel->bytes_done, sizeof(axel->bytes_done));
-	assert(nwrite == sizeof(axel->bytes_done));
+	unsigned char *p = st->map + !st->last * st->slot_size;
+	encode_slot(axel, &axel->done, p, st->capacity, SLOT_DURABLE,
+		    ++st->seq);
+	if (msync(p, st->slot_size, MS_SYNC) == -1)
+		return -1;
+	st->last = !st->last;
+	return 0;
+}
 
-	for (int i = 0; i < axel->conf->num_connections; i++) {
-		nwrite =
-		    write(fd, &axel->conn[i].currentbyte,
-			  sizeof(axel->conn[i].currentbyte));
-		assert(nwrite == sizeof(axel->conn[i].currentbyte));
-		nwrite =
-		    write(fd, &axel->conn[i].lastbyte,
-			  sizeof(axel->conn[i].lastbyte));
-		assert(nwrite == sizeof(axel->conn[i].lastbyte));
-	}
-	close(fd);
+int
+stfile_checkpoint(axel_t *axel)
+{
+	struct stfile *st = axel->stfile;
+	unsigned char boot[16];
+	ranges_t written;
+
+	if (!axel->conn[0].supported || axel->stream || !boot_id(boot))
+		return 0;
+
+	/* On its way to the disk is enough, without a crash; what the writer
+	   has yet to get to waits for the next one, rather than holding up
+	   every connection until it has */
+	if (writer_written(axel->writer, &axel->done, &written) == -1)
+		return -1;
+
+	/* A file with no room for them is for the next save to make */
+	if (st && st->capacity >= written.count)
+		encode_slot(axel, &written, st->map + 2 * st->slot_size,
+			    st->capacity, SLOT_CHECKPOINT, ++st->seq);
+	ranges_free(&written);
+	return 0;
+}
+
+void
+stfile_close(axel_t *axel)
+{
+	struct stfile *st = axel->stfile;
+
+	if (!st)
+		return;
+	munmap(st->map, 3 * st->slot_size);
+	free(st);
+	axel->stfile = NULL;
 }
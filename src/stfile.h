@@ -55,6 +55,20 @@ int stfile_unlink(const char *bname);
  * there was nothing to resume from, and -1 if the download cannot go ahead. */
 int stfile_load(axel_t *axel);
 
-void stfile_save(axel_t *axel);
+/* Write down the progress so far, once the data it covers is on disk.
+ *
+ * Returns 0 if it is saved, or nothing needed saving, and -1 if not; the
+ * state file saved before is then left as it was. */
+int stfile_save(axel_t *axel);
+
+/* Write down the progress so far, as far as the writer has handed it to the
+ * kernel, which costs next to nothing: nothing is waited for.  What is
+ * written this way survives the process being killed, but not the machine
+ * going down.  Until a save has made the file, or while it has no room for
+ * the ranges, it does nothing.  Returns as stfile_save() does. */
+int stfile_checkpoint(axel_t *axel);
+
+/* Let go of the state file, which stays on disk */
+void stfile_close(axel_t *axel);
 
 #endif				/* AXEL_STFILE_H */
@@ -0,0 +1,190 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Downloading from the start on: down a pipe, or for a file that is read
+   as it comes */
+
+#include "config.h"
+#include "axel.h"
+#include "stream.h"
+
+/* Standard output, once it has been set aside for the data */
+static int data_fd = -1;
+
+int
+stream_named(const char *fn)
+{
+	struct stat st;
+
+	if (!strcmp(fn, "-"))
+		return 1;
+	return !stat(fn, &st) && (S_ISFIFO(st.st_mode) ||
+				  S_ISSOCK(st.st_mode) ||
+				  S_ISCHR(st.st_mode));
+}
+
+int
+stream_stdout(void)
+{
+	data_fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+	if (data_fd == -1)
+		return -1;
+	if (dup2(STDERR_FILENO, STDOUT_FILENO) == -1) {
+		int err = errno;
+
+		close(data_fd);
+		data_fd = -1;
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+int
+stream_open(axel_t *axel)
+{
+	if (!axel_divide(axel))
+		return 0;
+	if (axel->sink)
+		return 1;
+
+	if (!strcmp(axel->filename, "-")) {
+		axel->outfd = data_fd;
+		data_fd = -1;
+	} else {
+		axel->outfd = open(axel->filename, O_WRONLY);
+	}
+	if (axel->outfd == -1) {
+		axel_message(axel, _("Error opening local file"));
+		return 0;
+	}
+
+	return 1;
+}
+
+/* Whether the download is to be fetched from the start on */
+static
+int
+in_order(const axel_t *axel)
+{
+	return (axel->stream && !axel->sink_seekable) ||
+	    axel->conf->sequential;
+}
+
+/* As much of the download as the blocks held for a pipe can take, shared
+   between the connections */
+static
+off_t
+slice(const axel_t *axel)
+{
+	off_t held = (off_t)axel->conf->stream_buffers *
+	    axel->conf->buffer_size;
+
+	return max(held / axel->conf->num_connections,
+		   (off_t)MIN_CHUNK_WORTH);
+}
+
+off_t
+stream_horizon(const axel_t *axel)
+{
+	range_t gap;
+
+	if (!in_order(axel) || axel->size == LLONG_MAX ||
+	    !ranges_gap(&axel->done, 0, axel->size, &gap))
+		return axel->size;
+
+	/* Every connection a slice from the first byte still to come */
+	return min(axel->size,
+		   gap.start + slice(axel) * axel->conf->num_connections);
+}
+
+void
+stream_trim(const axel_t *axel, range_t *gap)
+{
+	if (in_order(axel))
+		gap->end = min(gap->end, gap->start + slice(axel));
+}
+
+int
+stream_may_read(axel_t *axel, int thread)
+{
+	int head = -1;
+
+	if (!axel->stream || writer_spare(axel->writer) > 1)
+		return 1;
+
+	/* The pipe waits on whoever has the first bytes still to come */
+	for (int i = 0; i < axel->conf->num_connections; i++) {
+		const conn_t *conn = &axel->conn[i];
+
+		if (conn->currentbyte < conn->lastbyte &&
+		    (head == -1 ||
+		     conn->currentbyte < axel->conn[head].currentbyte))
+			head = i;
+	}
+
+	return thread == head;
+}
+
+void
+stream_publish(axel_t *axel)
+{
+	char name[MAX_STRING + 8], tmp[MAX_STRING + 12];
+	ranges_t written;
+	off_t avail = 0;
+	FILE *f;
+
+	/* As far as the writer has got, without waiting for it to get any
+	   further: the connections are not to wait on the disk */
+	if (!axel->conf->sequential || axel->stream ||
+	    writer_written(axel->writer, &axel->done, &written) == -1)
+		return;
+	if (written.count && written.r[0].start == 0)
+		avail = written.r[0].end;
+	ranges_free(&written);
+
+	/* Replaced whole, so that it is never read half written.  A reader
+	   left with an older figure is only behind, so failing is no worse */
+	snprintf(name, sizeof(name), "%s.avail", axel->filename);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+	f = fopen(tmp, "w");
+	if (!f)
+		return;
+	fprintf(f, "%jd\n", (intmax_t)avail);
+	if (fclose(f) == EOF || rename(tmp, name) == -1)
+		unlink(tmp);
+}
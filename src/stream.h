@@ -0,0 +1,83 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Downloading from the start on: down a pipe, or for a file that is read
+   as it comes */
+
+#ifndef AXEL_STREAM_H
+#define AXEL_STREAM_H
+
+/* A pipe, or standard output given as "-", takes the file from its start
+ * on, however many connections are fetching it.  What they get ahead of it
+ * is held by the writer until the pipe gets there; the connections are
+ * handed their work a slice at a time from there on, no more of it than
+ * that can hold, and one block is always kept for the connection the pipe
+ * is waiting on.
+ *
+ * With --sequential, a file is fetched the same way, a slice at a time from
+ * the first byte still to come, so that what is there from its start grows
+ * at the speed of the whole download rather than that of one connection. */
+
+/* Whether fn is "-", or something that cannot be written out of order */
+int stream_named(const char *fn);
+
+/* Set standard output aside for the data, and send whatever else would
+ * have gone there to standard error.  Returns -1 with errno set if it
+ * cannot. */
+int stream_stdout(void);
+
+/* Open the pipe, and lay the first slices of the download out.  Returns 0
+ * after saying why it could not.  A download with a sink has nothing to
+ * open; one that takes the data at any offset is laid out like a file. */
+int stream_open(axel_t *axel);
+
+/* Where to plan the connections' work up to */
+off_t stream_horizon(const axel_t *axel);
+
+/* Cut a gap down to one connection's slice */
+void stream_trim(const axel_t *axel, range_t *gap);
+
+/* Whether a connection may be read now, or is to leave the blocks left to
+ * the one the pipe is waiting on */
+int stream_may_read(axel_t *axel, int thread);
+
+/* With --sequential, tell whoever is reading the file as it comes how much
+ * of it there is from the start on, in a file named after it with .avail on
+ * the end.  Only what the writer has written counts; nothing is waited for. */
+void stream_publish(axel_t *axel);
+
+#endif				/* AXEL_STREAM_H */
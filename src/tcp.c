@@ -48,9 +48,10 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
-#include <sys/ioctl.h>
+#include <ifaddrs.h>
 #include <netinet/tcp.h>
 #include "axel.h"
+#include "dnscache.h"
 
 #ifndef TCP_FASTOPEN_CONNECT
 #ifdef __linux__
@@ -60,6 +61,14 @@
 #endif /* __linux__ */
 #endif /* !TCP_FASTOPEN_CONNECT */
 
+#ifndef IPPROTO_MPTCP
+#ifdef __linux__
+#define IPPROTO_MPTCP 262
+#else /* __linux__ */
+#define IPPROTO_MPTCP 0
+#endif /* __linux__ */
+#endif /* !IPPROTO_MPTCP */
+
 /*
  * Check if the given hostname is ipv6 literal
  * Returns 1 if true and 0 if false
@@ -77,28 +86,94 @@ tcp_error(char *hostname, int port, const char *reason)
 		hostname, port, reason);
 }
 
+typedef union {
+	struct sockaddr sa;
+	struct sockaddr_in in;
+	struct sockaddr_in6 in6;
+} sockaddr_u;
+
+/* The address of the given family a device has, leaving out IPv6
+   link-local ones, which are no use off the link */
+static
+socklen_t
+if_addr(const char *dev, int family, sockaddr_u *addr)
+{
+	struct ifaddrs *ifas;
+	socklen_t len = 0;
+
+	if (getifaddrs(&ifas) == -1)
+		return 0;
+	for (struct ifaddrs *ifa = ifas; ifa && !len; ifa = ifa->ifa_next) {
+		if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != family ||
+		    strcmp(ifa->ifa_name, dev))
+			continue;
+		if (family == AF_INET) {
+			len = sizeof(addr->in);
+		} else {
+			const struct sockaddr_in6 *in6 =
+			    (const struct sockaddr_in6 *)ifa->ifa_addr;
+
+			if (IN6_IS_ADDR_LINKLOCAL(&in6->sin6_addr))
+				continue;
+			len = sizeof(addr->in6);
+		}
+		memcpy(addr, ifa->ifa_addr, len);
+	}
+	freeifaddrs(ifas);
+	return len;
+}
+
+/* Send what goes out of fd from local_if: an IPv4 or IPv6 address, or a
+   device, held to where the system can and sent from its address either
+   way.  Returns 0, with errno set, if local_if has no address of the
+   family, or it will not do. */
+static
+int
+bind_local(int fd, int family, const char *local_if)
+{
+	sockaddr_u addr;
+	socklen_t len = 0;
+
+	memset(&addr, 0, sizeof(addr));
+	if (inet_pton(AF_INET, local_if, &addr.in.sin_addr) == 1) {
+		addr.in.sin_family = AF_INET;
+		len = sizeof(addr.in);
+	} else if (inet_pton(AF_INET6, local_if, &addr.in6.sin6_addr) == 1) {
+		addr.in6.sin6_family = AF_INET6;
+		len = sizeof(addr.in6);
+	} else {
+#ifdef SO_BINDTODEVICE
+		/* Not allowed to all, and the address does without it */
+		setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, local_if,
+			   strlen(local_if) + 1);
+#endif				/* SO_BINDTODEVICE */
+		len = if_addr(local_if, family, &addr);
+	}
+
+	if (!len || addr.sa.sa_family != family) {
+		errno = EADDRNOTAVAIL;
+		return 0;
+	}
+	if (family == AF_INET)
+		addr.in.sin_port = 0;
+	else
+		addr.in6.sin6_port = 0;
+	return bind(fd, &addr.sa, len) == 0;
+}
+
 /* Get a TCP connection */
 int
 tcp_connect(tcp_t *tcp, char *hostname, int port, int secure, char *local_if,
 	    unsigned io_timeout)
 {
-	struct sockaddr_in local_addr;
 	char portstr[10];
 	struct addrinfo ai_hints;
 	struct addrinfo *gai_results, *gai_result;
 	int ret;
 	int sock_fd = -1;
 
-	memset(&local_addr, 0, sizeof(local_addr));
-	if (local_if) {
-		if (!*local_if || tcp->ai_family != AF_INET) {
-			local_if = NULL;
-		} else {
-			local_addr.sin_family = AF_INET;
-			local_addr.sin_port = 0;
-			local_addr.sin_addr.s_addr = inet_addr(local_if);
-		}
-	}
+	if (local_if && !*local_if)
+		local_if = NULL;
 
 	snprintf(portstr, sizeof(portstr), "%d", port);
 
@@ -108,7 +183,7 @@ tcp_connect(tcp_t *tcp, char *hostname, int port, int secure, char *local_if,
 	ai_hints.ai_flags = AI_ADDRCONFIG;
 	ai_hints.ai_protocol = 0;
 
-	ret = getaddrinfo(hostname, portstr, &ai_hints, &gai_results);
+	ret = dnscache_lookup(hostname, portstr, &ai_hints, &gai_results);
 	if (ret != 0) {
 		tcp_error(hostname, port, gai_strerror(ret));
 		return -1;
@@ -122,16 +197,25 @@ tcp_connect(tcp_t *tcp, char *hostname, int port, int secure, char *local_if,
 			close(sock_fd);
 			sock_fd = -1;
 		}
-		sock_fd = socket(gai_result->ai_family,
-				 gai_result->ai_socktype,
-				 gai_result->ai_protocol);
+		if (tcp->mptcp && IPPROTO_MPTCP)
+			sock_fd = socket(gai_result->ai_family,
+					 gai_result->ai_socktype,
+					 IPPROTO_MPTCP);
+		/* Plain TCP where the kernel has no MPTCP, or has it off */
+		if (sock_fd == -1)
+			sock_fd = socket(gai_result->ai_family,
+					 gai_result->ai_socktype,
+					 gai_result->ai_protocol);
 		if (sock_fd == -1)
 			continue;
 
-		if (local_if && gai_result->ai_family == AF_INET) {
-			bind(sock_fd, (struct sockaddr *)&local_addr,
-			     sizeof(local_addr));
-			/* FIXME report errors */
+		/* An address of the other family is for the server's other
+		   addresses, if it has any */
+		if (local_if &&
+		    !bind_local(sock_fd, gai_result->ai_family, local_if)) {
+			close(sock_fd);
+			sock_fd = -1;
+			continue;
 		}
 
 		if (TCP_FASTOPEN_CONNECT) {
@@ -167,7 +251,7 @@ tcp_connect(tcp_t *tcp, char *hostname, int port, int secure, char *local_if,
 			break;
 	} while ((gai_result = gai_result->ai_next));
 
-	freeaddrinfo(gai_results);
+	dnscache_free(gai_results);
 
 	if (sock_fd == -1) {
 		tcp_error(hostname, port, strerror(errno));
@@ -178,7 +262,8 @@ tcp_connect(tcp_t *tcp, char *hostname, int port, int secure, char *local_if,
 
 #ifdef HAVE_SSL
 	if (secure) {
-		tcp->ssl = ssl_connect(sock_fd, hostname);
+		tcp->ssl = ssl_connect(sock_fd, hostname, NULL,
+				       tcp->insecure);
 		if (tcp->ssl == NULL) {
 			close(sock_fd);
 			return -1;
@@ -195,6 +280,61 @@ tcp_connect(tcp_t *tcp, char *hostname, int port, int secure, char *local_if,
 	return 1;
 }
 
+/* A UDP socket for QUIC, connected to the first of hostname's addresses it
+   can be, and non-blocking */
+int
+udp_connect(char *hostname, int port, sa_family_t family, char *local_if)
+{
+	char portstr[10];
+	struct addrinfo ai_hints;
+	struct addrinfo *gai_results, *gai_result;
+	int ret;
+	int sock_fd = -1;
+
+	if (local_if && !*local_if)
+		local_if = NULL;
+
+	snprintf(portstr, sizeof(portstr), "%d", port);
+
+	memset(&ai_hints, 0, sizeof(ai_hints));
+	ai_hints.ai_family = family;
+	ai_hints.ai_socktype = SOCK_DGRAM;
+	ai_hints.ai_flags = AI_ADDRCONFIG;
+
+	ret = dnscache_lookup(hostname, portstr, &ai_hints, &gai_results);
+	if (ret != 0) {
+		tcp_error(hostname, port, gai_strerror(ret));
+		return -1;
+	}
+
+	for (gai_result = gai_results; gai_result;
+	     gai_result = gai_result->ai_next) {
+		sock_fd = socket(gai_result->ai_family,
+				 gai_result->ai_socktype,
+				 gai_result->ai_protocol);
+		if (sock_fd == -1)
+			continue;
+		if ((!local_if ||
+		     bind_local(sock_fd, gai_result->ai_family, local_if)) &&
+		    !connect(sock_fd, gai_result->ai_addr,
+			     gai_result->ai_addrlen))
+			break;
+		close(sock_fd);
+		sock_fd = -1;
+	}
+
+	dnscache_free(gai_results);
+
+	if (sock_fd == -1) {
+		tcp_error(hostname, port, strerror(errno));
+		return -1;
+	}
+
+	fcntl(sock_fd, F_SETFL, O_NONBLOCK);
+	fcntl(sock_fd, F_SETFD, FD_CLOEXEC);
+	return sock_fd;
+}
+
 ssize_t
 tcp_read(tcp_t *tcp, void *buffer, int size)
 {
@@ -231,27 +371,3 @@ tcp_close(tcp_t *tcp)
 		tcp->fd = -1;
 	}
 }
-
-int
-get_if_ip(char *dst, size_t len, const char *iface)
-{
-	struct ifreq ifr;
-	int ret, fd = socket(PF_INET, SOCK_DGRAM, IPPROTO_IP);
-
-	if (fd < 0)
-		return 0;
-
-	memset(&ifr, 0, sizeof(struct ifreq));
-
-	strlcpy(ifr.ifr_name, iface, sizeof(ifr.ifr_name));
-	ifr.ifr_addr.sa_family = AF_INET;
-
-	ret = !ioctl(fd, SIOCGIFADDR, &ifr);
-	if (ret) {
-		struct sockaddr_in *x = (struct sockaddr_in *)&ifr.ifr_addr;
-		strlcpy(dst, inet_ntoa(x->sin_addr), len);
-	}
-	close(fd);
-
-	return ret;
-}
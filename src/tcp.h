@@ -56,6 +56,8 @@
 typedef struct {
 	int fd;
 	sa_family_t ai_family;
+	bool mptcp;		/* Multipath TCP, where the kernel has it */
+	bool insecure;		/* TLS without checking the certificate */
 #ifdef HAVE_SSL
 	SSL *ssl;
 #endif
@@ -66,9 +68,12 @@ int tcp_connect(tcp_t *tcp, char *hostname, int port, int secure,
 		char *local_if, unsigned io_timeout);
 void tcp_close(tcp_t *tcp);
 
+/* A UDP socket connected to hostname:port, for QUIC; returns -1 after
+   saying why not */
+int udp_connect(char *hostname, int port, sa_family_t family,
+		char *local_if);
+
 ssize_t tcp_read(tcp_t *tcp, void *buffer, int size);
 ssize_t tcp_write(tcp_t *tcp, void *buffer, int size);
 
-int get_if_ip(char *dst, size_t len, const char *iface);
-
 #endif				/* AXEL_TCP_H */
@@ -50,6 +50,10 @@
 #include "config.h"
 #include <sys/ioctl.h>
 #include "axel.h"
+#include "batch.h"
+#include "daemon.h"
+#include "manifest.h"
+#include "stream.h"
 
 
 static void stop(int signal);
@@ -63,10 +67,20 @@ static void print_version_info(void);
 static int get_term_width(void);
 
 int run = 1;
+static bool quiet;		/* -q: standard output goes to /dev/null */
 
 #define MAX_REDIR_OPT	256
 #define NO_NETRC_OPT	257
 #define LOCATION_TRUSTED_OPT	258
+#define SPEED_GROUP_OPT	259
+#define CHECKSUM_OPT	260
+#define SEED_OPT	261
+#define SEQUENTIAL_OPT	262
+#define DAEMON_OPT	263
+#define CONTROL_OPT	264
+#define HTTP2_OPT	265
+#define MPTCP_OPT	266
+#define HTTP3_OPT	267
 
 #ifdef NOGETOPTLONG
 #define getopt_long(a, b, c, d, e) getopt(a, b, c)
@@ -74,10 +88,20 @@ int run = 1;
 static struct option axel_options[] = {
 	/* name             has_arg flag  val */
 	{"max-speed",       1,      NULL, 's'},
+	{"speed-group",     1,      NULL, SPEED_GROUP_OPT},
+	{"checksum",        1,      NULL, CHECKSUM_OPT},
+	{"seed",            1,      NULL, SEED_OPT},
+	{"sequential",      0,      NULL, SEQUENTIAL_OPT},
 	{"num-connections", 1,      NULL, 'n'},
 	{"max-redirect",    1,      NULL, MAX_REDIR_OPT},
 	{"location-trusted",0,      NULL, LOCATION_TRUSTED_OPT},
+	{"http2",           0,      NULL, HTTP2_OPT},
+	{"http3",           0,      NULL, HTTP3_OPT},
+	{"mptcp",           0,      NULL, MPTCP_OPT},
 	{"output",          1,      NULL, 'o'},
+	{"input",           1,      NULL, 'i'},
+	{"daemon",          1,      NULL, DAEMON_OPT},
+	{"control",         1,      NULL, CONTROL_OPT},
 	{"search",          2,      NULL, 'S'},
 	{"netrc",           2,      NULL, 'R'},
 	{"no-netrc",        0,      NULL, NO_NETRC_OPT},
@@ -123,6 +147,8 @@ int
 parse_option(int option, conf_t *conf, char fn[MAX_STRING], int *do_search,
 	     int *verbose)
 {
+	digest_spec_t spec;
+
 	switch (option) {
 	case 'U':
 		conf_hdr_make(conf->add_header[HDR_USER_AGENT],
@@ -158,9 +184,52 @@ parse_option(int option, conf_t *conf, char fn[MAX_STRING], int *do_search,
 	case LOCATION_TRUSTED_OPT:
 		conf->location_trusted = 1;
 		break;
+	case HTTP2_OPT:
+		conf->http2 = 1;
+		break;
+	case HTTP3_OPT:
+		conf->http3 = 1;
+		break;
+	case MPTCP_OPT:
+		conf->mptcp = 1;
+		break;
+	case SPEED_GROUP_OPT:
+#ifdef HAVE_SHM_OPEN
+		strlcpy(conf->speed_group, optarg, sizeof(conf->speed_group));
+		break;
+#else
+		fprintf(stderr, _("Speed groups are not supported on this "
+				  "system\n"));
+		return 1;
+#endif
+	case CHECKSUM_OPT:
+		if (digest_spec_parse(&spec, optarg) == -1) {
+			fprintf(stderr, _("Bad checksum %s, expected "
+					  "ALGO:HEX\n"), optarg);
+			return 1;
+		}
+		strlcpy(conf->checksum, optarg, sizeof(conf->checksum));
+		break;
+	case SEED_OPT:
+		strlcpy(conf->seed, optarg, sizeof(conf->seed));
+		break;
+	case SEQUENTIAL_OPT:
+		conf->sequential = 1;
+		break;
 	case 'o':
 		strlcpy(fn, optarg, MAX_STRING);
 		break;
+	case 'i':
+		strlcpy(conf->input, optarg, sizeof(conf->input));
+		break;
+	case DAEMON_OPT:
+		strlcpy(conf->daemon_socket, optarg,
+			sizeof(conf->daemon_socket));
+		break;
+	case CONTROL_OPT:
+		strlcpy(conf->control_socket, optarg,
+			sizeof(conf->control_socket));
+		break;
 	case 'S':
 		*do_search = 1;
 		if (optarg) {
@@ -210,13 +279,8 @@ parse_option(int option, conf_t *conf, char fn[MAX_STRING], int *do_search,
 		print_version_info();
 		return 0;
 	case 'q':
-		close(1);
 		conf->verbose = -1;
-		if (open("/dev/null", O_WRONLY) != 1) {
-			fprintf(stderr,
-				_("Can't redirect stdout to /dev/null.\n"));
-			return 1;
-		}
+		quiet = true;
 		break;
 	case 'T':
 		conf->io_timeout = strtoul(optarg, NULL, 0);
@@ -247,7 +311,7 @@ parse_options(int argc, char *argv[], conf_t *conf, char fn[MAX_STRING],
 
 	while (1) {
 		int option = getopt_long(argc, argv,
-					 "s:n:o:S::R::46NqvhVapkcH:U:T:",
+					 "s:n:o:i:S::R::46NqvhVapkcH:U:T:",
 					 axel_options, NULL);
 		if (option == -1)
 			break;
@@ -264,7 +328,8 @@ parse_options(int argc, char *argv[], conf_t *conf, char fn[MAX_STRING],
 		conf->verbose = verbose;
 
 	if (conf->num_connections < 1 || conf->max_redirect < 0 ||
-	    argc - optind == 0) {
+	    (argc - optind == 0 && !*conf->input &&
+	     !*conf->daemon_socket)) {
 		print_help();
 		return 1;
 	}
@@ -311,8 +376,9 @@ get_url(char *argv[])
 }
 
 /**
- * Build the download, either from the mirrors a search turns up for s, or
- * from the URLs given on the command line.
+ * Build the download, either from the mirrors a search turns up for s, from
+ * the Metalink or zsync control file s names, or from the URLs given on the
+ * command line.
  *
  * Returns NULL after reporting why; print_messages() and axel_close() both
  * ignore a NULL axel, so the caller has nothing else to undo.
@@ -325,6 +391,8 @@ axel_setup(conf_t *conf, int do_search, char *s, int argc, char *argv[])
 	axel_t *axel;
 	int i, j;
 
+	if (!do_search && manifest_named(s))
+		return manifest_new(conf, s);
 	if (!do_search) {
 		search = calloc(argc - optind, sizeof(search_t));
 		if (!search)
@@ -410,6 +478,13 @@ set_filename(axel_t *axel, char fn[MAX_STRING])
 		return 0;
 	}
 
+	/* A pipe has nothing to resume, and no state file to do it with */
+	if (stream_named(fn)) {
+		axel->stream = true;
+		strlcpy(axel->filename, fn, sizeof(axel->filename));
+		return 0;
+	}
+
 	struct stat buf;
 
 	if (stat(fn, &buf) == 0 && S_ISDIR(buf.st_mode)) {
@@ -449,13 +524,17 @@ void
 download(axel_t *axel)
 {
 	const conf_t *conf = axel->conf;
+	off_t prev = axel->bytes_done;
 
 	while (!axel->ready && run) {
-		off_t prev;
-
-		prev = axel->bytes_done;
 		axel_do(axel);
 
+		/* Drawn when the redraw timer says so, rather than for every
+		   read, unless there is a message or the end to show */
+		if (!axel->redraw && !axel->message && !axel->ready)
+			continue;
+		axel->redraw = 0;
+
 		if (conf->progress_style == AXEL_PROGRESS_STYLE_PERCENTAGE) {
 			if (!axel->message && prev != axel->bytes_done)
 				printf("%u\n", calc_percentage(axel->bytes_done, axel->size));
@@ -485,9 +564,27 @@ download(axel_t *axel)
 			putchar('\n');
 		}
 		fflush(stdout);
+		prev = axel->bytes_done;
 	}
 }
 
+/* Send what would be printed on standard output to /dev/null instead */
+static
+int
+quiet_stdout(void)
+{
+	int fd = open("/dev/null", O_WRONLY);
+
+	if (fd == -1 || dup2(fd, STDOUT_FILENO) == -1) {
+		if (fd != -1)
+			close(fd);
+		return -1;
+	}
+	if (fd != STDOUT_FILENO)
+		close(fd);
+	return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -529,10 +626,32 @@ main(int argc, char *argv[])
 		goto free_conf;
 
 	ret = 1;
+
+	/* The data has standard output to itself, and the rest makes do with
+	   standard error */
+	if (!strcmp(fn, "-") && stream_stdout() == -1) {
+		fprintf(stderr, "%s\n", strerror(errno));
+		goto free_conf;
+	}
+	/* Only once the data has had its pick of it */
+	if (quiet && quiet_stdout() == -1) {
+		fprintf(stderr, _("Can't redirect stdout to /dev/null.\n"));
+		goto free_conf;
+	}
 #ifdef HAVE_SSL
-	ssl_init(conf);
+	ssl_init();
 #endif				/* HAVE_SSL */
 
+	if (*conf->input || *conf->daemon_socket) {
+		signal(SIGINT, stop);
+		signal(SIGTERM, stop);
+		if (*conf->daemon_socket)
+			ret = daemon_run(conf, conf->daemon_socket, fn, &run);
+		else
+			ret = batch_run(conf, conf->input, fn, &run);
+		goto free_conf;
+	}
+
 	s = get_url(argv);
 	if (!s)
 		goto free_conf;
@@ -583,7 +702,7 @@ main(int argc, char *argv[])
 	printf(_("\nDownloaded %s in %s. (%.2f KB/s)\n"), hsize, htime,
 	       (double)axel->bytes_per_second / 1024);
 
-	ret = axel->ready ? 0 : 2;
+	ret = axel->bad_checksum ? 1 : axel->ready ? 0 : 2;
 
  close_axel:
 	axel_close(axel);
@@ -601,32 +720,6 @@ stop(int signal)
 	run = 0;
 }
 
-/**
- * Integer base-2 logarithm.
- */
-static inline
-unsigned
-log2i(unsigned long long x)
-{
-	return x ? sizeof(x) * 8 - 1 - __builtin_clzll(x) : 0;
-}
-
-/* Convert a number of bytes to a human-readable form */
-char *
-axel_size_human(char *dst, size_t len, size_t value)
-{
-	double fval = (double)value;
-	const char * const oname[] = {
-		"", _("Kilo"), _("Mega"), _("Giga"), _("Tera"),
-	};
-	const unsigned int order = min(sizeof(oname) / sizeof(oname[0]) - 1,
-				       log2i(fval) / 10);
-
-	fval /= (double)(1 << order * 10);
-	int ret = snprintf(dst, len, _("%g %sbyte(s)"), fval, oname[order]);
-	return ret < 0 ? NULL : dst;
-}
-
 /* Convert a number of seconds to a human-readable form */
 char *
 time_human(char *dst, size_t len, unsigned int value)
@@ -812,7 +905,8 @@ print_help(void)
 		 "\n"
 		 "-s x\tSpecify maximum speed (bytes per second)\n"
 		 "-n x\tSpecify maximum number of connections\n"
-		 "-o f\tSpecify local output file\n"
+		 "-o f\tSpecify local output file, or - for stdout\n"
+		 "-i f\tDownload the URLs listed in f, or - for stdin\n"
 		 "-S[n]\tSearch for mirrors and download from n servers\n"
 		 "-R[f]\tTake credentials from f, or from the default .netrc\n"
 		 "-4\tUse the IPv4 protocol\n"
@@ -835,10 +929,20 @@ print_help(void)
 	printf(_("Usage: axel [options] url1 [url2] [url...]\n"
 		 "\n"
 		 "--max-speed=x\t\t-s x\tSpecify maximum speed (bytes per second)\n"
+		 "--speed-group=x\t\tShare the maximum speed with your other downloads in group x\n"
 		 "--num-connections=x\t-n x\tSpecify maximum number of connections\n"
 		 "--max-redirect=x\t\tSpecify maximum number of redirections\n"
 		 "--location-trusted\t\tKeep sending credential headers after a redirect\n"
-		 "--output=f\t\t-o f\tSpecify local output file\n"
+		 "--http2\t\t\t\tShare HTTP/2 connections between the connections to a server\n"
+		 "--http3\t\t\t\tShare QUIC connections, as HTTP/3, between the connections to a server\n"
+		 "--mptcp\t\t\t\tUse Multipath TCP where the system has it\n"
+		 "--checksum=a:x\t\t\tCheck the file hashes to x with algorithm a\n"
+		 "--seed=f\t\t\tCopy what f has of the file a .zsync describes\n"
+		 "--sequential\t\t\tFetch the file from its start on, to read as it comes\n"
+		 "--output=f\t\t-o f\tSpecify local output file, or - for stdout\n"
+		 "--input=f\t\t-i f\tDownload the URLs listed in f, or - for stdin\n"
+		 "--daemon=s\t\t\tTake URLs to download from the Unix socket s\n"
+		 "--control=s\t\t\tTake commands to retune the download from the Unix socket s\n"
 		 "--search[=n]\t\t-S[n]\tSearch for mirrors and download from n servers\n"
 		 "--netrc[=f]\t\t-R[f]\tTake credentials from f, or from the default .netrc\n"
 		 "--no-netrc\t\t\tDon't take credentials from any .netrc\n"
@@ -881,19 +985,3 @@ print_version_info(void)
 	       "\t\t    %s\n%s\n\n", _("and others."),
 	       _("Please, see the CREDITS file.\n\n"));
 }
-
-/* Print any message in the axel structure */
-void
-print_messages(axel_t *axel)
-{
-	message_t *m;
-
-	if (!axel)
-		return;
-
-	while ((m = axel->message)) {
-		printf("%s\n", m->text);
-		axel->message = m->next;
-		free(m);
-	}
-}
@@ -0,0 +1,116 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Token bucket behind --max-speed
+ *
+ * The old limiter measured the average speed after the fact and slept at the
+ * end of every pass to pull it back towards the limit, so every connection
+ * stalled at once, and the speed swung around the target as the sleep was
+ * tuned up and down in 10 ms steps.  A bucket decides before each read
+ * instead: what a connection may read is capped at its share of the tokens
+ * there are, and the loop sleeps only while the bucket is empty, for just as
+ * long as it takes to refill. */
+
+#include "config.h"
+
+#include "throttle.h"
+
+void
+throttle_init(throttle_t *t, unsigned long long rate, size_t burst,
+	      double now)
+{
+	t->rate = rate;
+	t->burst = burst ? burst : 1;
+	t->tokens = t->burst;
+	t->stamp = now;
+}
+
+void
+throttle_refill(throttle_t *t, double now)
+{
+	if (!t->rate)
+		return;
+
+	/* A clock that went backwards earns nothing, it just starts over */
+	if (now > t->stamp) {
+		t->tokens += (now - t->stamp) * t->rate;
+		if (t->tokens > t->burst)
+			t->tokens = t->burst;
+	}
+	t->stamp = now;
+}
+
+size_t
+throttle_share(const throttle_t *t, size_t want, int nreaders)
+{
+	if (!t->rate)
+		return want;
+
+	if (t->tokens < 1)
+		return 0;
+
+	/* Rounded up, so that a bucket holding less than one byte per reader
+	 * still lets the first of them through rather than none at all */
+	double share = t->tokens / (nreaders > 0 ? nreaders : 1);
+	size_t n = share + .999;
+
+	if (n > t->tokens)
+		n = t->tokens;
+
+	return n < want ? n : want;
+}
+
+void
+throttle_take(throttle_t *t, size_t used)
+{
+	if (t->rate)
+		t->tokens -= used;
+}
+
+double
+throttle_delay(const throttle_t *t, size_t want)
+{
+	if (!t->rate)
+		return 0;
+
+	if (want > t->burst)
+		want = t->burst;
+	if (t->tokens >= want)
+		return 0;
+
+	return (want - t->tokens) / t->rate;
+}
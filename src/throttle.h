@@ -0,0 +1,71 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Token bucket behind --max-speed */
+
+#ifndef AXEL_THROTTLE_H
+#define AXEL_THROTTLE_H
+
+#include <stddef.h>
+
+/* Tokens are bytes.  They trickle in at the configured rate and are spent
+ * by the reads, which ask first how many they may take; a bucket with a rate
+ * of zero never runs dry.  Times are in seconds, from whichever clock the
+ * caller keeps, as long as it is always the same one. */
+typedef struct {
+	unsigned long long rate;
+	double burst;
+	double tokens;
+	double stamp;
+} throttle_t;
+
+void throttle_init(throttle_t *t, unsigned long long rate, size_t burst,
+		   double now);
+
+/* Add what has trickled in since the last time this was called */
+void throttle_refill(throttle_t *t, double now);
+
+/* How much one of nreaders may read, out of want, so that they all get the
+ * same share of what is in the bucket now */
+size_t throttle_share(const throttle_t *t, size_t want, int nreaders);
+
+void throttle_take(throttle_t *t, size_t used);
+
+/* How long until there are want tokens, 0 if there already are */
+double throttle_delay(const throttle_t *t, size_t want);
+
+#endif				/* AXEL_THROTTLE_H */
@@ -0,0 +1,232 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Hierarchical timer wheel */
+
+#include "config.h"
+
+#include <limits.h>
+#include <string.h>
+
+#include "wheel.h"
+
+#define WHEEL_MASK	(WHEEL_SIZE - 1)
+#define LEVEL_SHIFT(level)	(WHEEL_BITS * (level))
+
+void
+wheel_init(wheel_t *w, unsigned long long now)
+{
+	memset(w, 0, sizeof(*w));
+	w->tick = now;
+}
+
+int
+wheel_pending(const wheel_timer_t *t)
+{
+	return t->pprev != NULL;
+}
+
+static
+void
+link_timer(wheel_timer_t **head, wheel_timer_t *t)
+{
+	t->next = *head;
+	if (t->next)
+		t->next->pprev = &t->next;
+	t->pprev = head;
+	*head = t;
+}
+
+static
+void
+unlink_timer(wheel_timer_t *t)
+{
+	*t->pprev = t->next;
+	if (t->next)
+		t->next->pprev = t->pprev;
+	t->next = NULL;
+	t->pprev = NULL;
+}
+
+/* File t in the lowest level whose ring still reaches its expiry.  One
+ * further away than the top ring goes round is parked in the furthest slot
+ * there, and filed again from its real expiry once it is brought down. */
+static
+void
+place(wheel_t *w, wheel_timer_t *t)
+{
+	unsigned long long when = t->expires > w->tick ? t->expires : w->tick;
+	unsigned long long delta = when - w->tick;
+	int level = 0;
+
+	while (level < WHEEL_LEVELS - 1 && delta >> LEVEL_SHIFT(level + 1))
+		level++;
+	if (delta >> LEVEL_SHIFT(WHEEL_LEVELS))
+		when = w->tick + (1ull << LEVEL_SHIFT(WHEEL_LEVELS)) - 1;
+
+	link_timer(&w->slot[level][(when >> LEVEL_SHIFT(level)) & WHEEL_MASK],
+		   t);
+}
+
+void
+wheel_add(wheel_t *w, wheel_timer_t *t, unsigned long long expires)
+{
+	if (wheel_pending(t))
+		unlink_timer(t);
+	else
+		w->count++;
+
+	t->expires = expires;
+	place(w, t);
+}
+
+void
+wheel_del(wheel_t *w, wheel_timer_t *t)
+{
+	if (!wheel_pending(t))
+		return;
+
+	unlink_timer(t);
+	w->count--;
+}
+
+/* Take a whole slot off the wheel, so that whatever its timers arm while it
+ * is being worked through cannot land back in it */
+static
+void
+detach(wheel_timer_t **slot, wheel_timer_t **list)
+{
+	*list = *slot;
+	*slot = NULL;
+	if (*list)
+		(*list)->pprev = list;
+}
+
+static
+void
+cascade(wheel_t *w, int level)
+{
+	wheel_timer_t *list;
+
+	detach(&w->slot[level][(w->tick >> LEVEL_SHIFT(level)) & WHEEL_MASK],
+	       &list);
+	while (list) {
+		wheel_timer_t *t = list;
+
+		unlink_timer(t);
+		place(w, t);
+	}
+}
+
+static
+void
+run_tick(wheel_t *w)
+{
+	wheel_timer_t *list;
+
+	/* Bring down the slot of each ring the one below has gone round */
+	for (int level = 1; level < WHEEL_LEVELS; level++) {
+		if (w->tick & ((1ull << LEVEL_SHIFT(level)) - 1))
+			break;
+		cascade(w, level);
+	}
+
+	/* The tick is over before anything fires: what a timer arms for now
+	 * is due on the next run, not a whole ring later */
+	detach(&w->slot[0][w->tick++ & WHEEL_MASK], &list);
+	while (list) {
+		wheel_timer_t *t = list;
+
+		unlink_timer(t);
+		w->count--;
+		t->fire(t);
+	}
+}
+
+unsigned long long
+wheel_next(const wheel_t *w)
+{
+	unsigned long long next = ULLONG_MAX;
+
+	if (!w->count)
+		return next;
+
+	/* Level 0 holds nothing further than a ring away, so its first busy
+	 * slot is the next expiry exactly */
+	for (int k = 0; k < WHEEL_SIZE; k++) {
+		if (w->slot[0][(w->tick + k) & WHEEL_MASK]) {
+			next = w->tick + k;
+			break;
+		}
+	}
+
+	/* Above it, a busy slot is due when its ring comes round to it */
+	for (int level = 1; level < WHEEL_LEVELS; level++) {
+		unsigned long long width = 1ull << LEVEL_SHIFT(level);
+		unsigned long long turn = (w->tick + width - 1) & ~(width - 1);
+
+		for (int k = 0; k < WHEEL_SIZE; k++) {
+			unsigned long long at = turn + k * width;
+
+			if (at >= next)
+				break;
+			if (w->slot[level][(at >> LEVEL_SHIFT(level)) &
+					   WHEEL_MASK]) {
+				next = at;
+				break;
+			}
+		}
+	}
+
+	return next;
+}
+
+void
+wheel_run(wheel_t *w, unsigned long long now)
+{
+	while (w->tick <= now) {
+		unsigned long long next = wheel_next(w);
+
+		/* Nothing in between but empty slots: skip over them */
+		if (next > now) {
+			w->tick = now + 1;
+			break;
+		}
+		w->tick = next;
+		run_tick(w);
+	}
+}
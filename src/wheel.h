@@ -0,0 +1,89 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+
+/* Hierarchical timer wheel */
+
+#ifndef AXEL_WHEEL_H
+#define AXEL_WHEEL_H
+
+/* Times are ticks of a millisecond, from whichever clock the caller keeps,
+ * as long as it is monotonic and always the same one.
+ *
+ * Arming, disarming and firing a timer cost the same however many others
+ * there are: each level of the wheel is a ring of slots a tick, 64 ticks,
+ * 4096 ticks... wide, and a timer sits in the slot of the lowest level that
+ * reaches its expiry, to be brought down a level whenever the ring below
+ * comes round to it. */
+#define WHEEL_BITS	6
+#define WHEEL_SIZE	(1 << WHEEL_BITS)
+#define WHEEL_LEVELS	4
+
+typedef struct wheel_timer wheel_timer_t;
+
+struct wheel_timer {
+	wheel_timer_t *next, **pprev;	/* pprev is NULL when not armed */
+	unsigned long long expires;
+	void (*fire)(wheel_timer_t *t);
+	void *data;
+	int id;
+};
+
+typedef struct {
+	unsigned long long tick;	/* the next one to run */
+	unsigned count;
+	wheel_timer_t *slot[WHEEL_LEVELS][WHEEL_SIZE];
+} wheel_t;
+
+void wheel_init(wheel_t *w, unsigned long long now);
+
+/* Arm t to fire once the wheel has been run up to expires, moving it if it
+ * was armed already; an expiry in the past fires on the next run */
+void wheel_add(wheel_t *w, wheel_timer_t *t, unsigned long long expires);
+void wheel_del(wheel_t *w, wheel_timer_t *t);
+int wheel_pending(const wheel_timer_t *t);
+
+/* The earliest tick worth running the wheel at, ULLONG_MAX if none.  It is
+ * never later than the next expiry, and may be earlier, when all there is
+ * to do then is bring timers down a level. */
+unsigned long long wheel_next(const wheel_t *w);
+
+/* Fire every timer due by now, in order of expiry.  A timer may re-arm
+ * itself, or arm and disarm others, from its fire function. */
+void wheel_run(wheel_t *w, unsigned long long now);
+
+#endif				/* AXEL_WHEEL_H */
@@ -0,0 +1,513 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+/* Disk writer thread */
+
+#include "config.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "writer.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+
+struct block {
+	struct block *next;
+	off_t offset;
+	size_t len;
+	char data[];
+};
+
+struct writer {
+	int fd;
+	int seekable;		/* or a pipe, written to in offset order */
+	off_t cursor;		/* where the pipe has got to */
+	struct block *ahead;	/* for further on in the pipe, by offset */
+	int nfree;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t work;	/* something was queued, or it is time to stop */
+	pthread_cond_t done;	/* a block came free, or the queue ran dry */
+	struct block *free, *queue, **tail;
+	int busy;		/* the thread holds a batch off the queue */
+	int stop;
+	int err;
+	ranges_t written;	/* what has got as far as the kernel */
+	struct block **batch;
+	char *pool;
+	writer_watch_fn *watch;
+	void *watch_arg;
+	writer_sink_fn *sink;
+	void *sink_arg;
+};
+
+static
+struct block *
+to_block(void *data)
+{
+	return (struct block *)((char *)data - offsetof(struct block, data));
+}
+
+static
+int
+by_offset(const void *a, const void *b)
+{
+	off_t x = (*(struct block * const *)a)->offset;
+	off_t y = (*(struct block * const *)b)->offset;
+
+	return (x > y) - (x < y);
+}
+
+/* Write all of iov at offset, however many goes it takes */
+static
+int
+write_run(writer_t *w, struct iovec *iov, int cnt, off_t offset)
+{
+	for (int i = 0; w->sink && i < cnt; i++) {
+		int err = w->sink(w->sink_arg, iov[i].iov_base,
+				  iov[i].iov_len, offset);
+
+		if (err)
+			return err;
+		offset += iov[i].iov_len;
+	}
+	if (w->sink)
+		return 0;
+
+	while (cnt) {
+		ssize_t n;
+
+#ifdef HAVE_PWRITEV
+		n = w->seekable ? pwritev(w->fd, iov, cnt, offset) :
+		    writev(w->fd, iov, cnt);
+#else
+		n = w->seekable ?
+		    pwrite(w->fd, iov->iov_base, iov->iov_len, offset) :
+		    write(w->fd, iov->iov_base, iov->iov_len);
+#endif
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n == -1)
+			return errno;
+		if (n == 0)
+			return EIO;
+
+		offset += n;
+		while (cnt && (size_t)n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			cnt--;
+		}
+		if (cnt) {
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+
+	return 0;
+}
+
+/* A pipe can only take what carries on from where it has got to: the rest
+ * of the batch joins the blocks waiting for what comes before them, and
+ * those it no longer has to wait for take its place.  Returns how many
+ * blocks are left in the batch to write. */
+static
+int
+in_order(writer_t *w, int n)
+{
+	struct block **p = &w->ahead;
+
+	for (int i = 0; i < n; i++) {
+		while (*p && (*p)->offset <= w->batch[i]->offset)
+			p = &(*p)->next;
+		w->batch[i]->next = *p;
+		*p = w->batch[i];
+		p = &w->batch[i]->next;
+	}
+
+	n = 0;
+	while (w->ahead && w->ahead->offset == w->cursor) {
+		w->batch[n++] = w->ahead;
+		w->cursor += w->ahead->len;
+		w->ahead = w->ahead->next;
+	}
+	return n;
+}
+
+/* Write n blocks of the batch, merging the ones that follow on from each
+ * other into one write.  Returns 0 or an errno. */
+static
+int
+write_batch(writer_t *w, int n)
+{
+	struct iovec iov[IOV_MAX];
+
+	for (int i = 0; i < n;) {
+		off_t offset = w->batch[i]->offset;
+		off_t end = offset;
+		int cnt = 0;
+
+		while (i < n && cnt < IOV_MAX && w->batch[i]->offset == end) {
+			iov[cnt].iov_base = w->batch[i]->data;
+			iov[cnt].iov_len = w->batch[i]->len;
+			end += w->batch[i]->len;
+			cnt++;
+			i++;
+		}
+
+		int err = write_run(w, iov, cnt, offset);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static
+void *
+writer_thread(void *arg)
+{
+	writer_t *w = arg;
+
+	pthread_mutex_lock(&w->lock);
+	for (;;) {
+		while (!w->queue && !w->stop)
+			pthread_cond_wait(&w->work, &w->lock);
+		if (!w->queue)
+			break;
+
+		/* Take the whole queue, and let the network side carry on
+		   queueing while it is written */
+		int n = 0;
+		for (struct block *b = w->queue; b; b = b->next)
+			w->batch[n++] = b;
+		w->queue = NULL;
+		w->tail = &w->queue;
+		w->busy = 1;
+		pthread_mutex_unlock(&w->lock);
+
+		qsort(w->batch, n, sizeof(*w->batch), by_offset);
+		if (!w->seekable)
+			n = in_order(w, n);
+
+		/* Past the first failure the download is over anyway */
+		int err = w->err ? 0 : write_batch(w, n);
+		for (int i = 0; !err && !w->err && w->watch && i < n; i++)
+			w->watch(w->watch_arg, w->batch[i]->data,
+				 w->batch[i]->offset, w->batch[i]->len);
+
+		pthread_mutex_lock(&w->lock);
+		for (int i = 0; !err && i < n; i++)
+			if (ranges_add(&w->written, w->batch[i]->offset,
+				       w->batch[i]->offset +
+				       w->batch[i]->len) == -1)
+				err = errno;
+		if (err && !w->err)
+			w->err = err;
+		for (int i = 0; i < n; i++) {
+			w->batch[i]->next = w->free;
+			w->free = w->batch[i];
+		}
+		w->nfree += n;
+		w->busy = 0;
+		pthread_cond_broadcast(&w->done);
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+writer_t *
+writer_new(int fd, size_t block_size, int nblocks)
+{
+	/* Each block starts where a struct block may */
+	size_t align = offsetof(struct { char c; struct block b; }, b);
+	size_t stride = (sizeof(struct block) + block_size + align - 1) &
+	    ~(align - 1);
+	writer_t *w;
+	int err;
+
+	if (nblocks < 1)
+		nblocks = 1;
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return NULL;
+
+	w->fd = fd;
+	w->seekable = lseek(fd, 0, SEEK_CUR) != -1;
+	w->tail = &w->queue;
+	ranges_init(&w->written);
+	w->pool = malloc(stride * nblocks);
+	w->batch = malloc(nblocks * sizeof(*w->batch));
+	if (!w->pool || !w->batch) {
+		err = errno;
+		goto fail;
+	}
+
+	for (int i = 0; i < nblocks; i++) {
+		struct block *b = (struct block *)(w->pool + i * stride);
+
+		b->next = w->free;
+		w->free = b;
+	}
+	w->nfree = nblocks;
+
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->work, NULL);
+	pthread_cond_init(&w->done, NULL);
+	err = pthread_create(&w->thread, NULL, writer_thread, w);
+	if (!err)
+		return w;
+
+	pthread_cond_destroy(&w->done);
+	pthread_cond_destroy(&w->work);
+	pthread_mutex_destroy(&w->lock);
+ fail:
+	free(w->batch);
+	free(w->pool);
+	free(w);
+	errno = err;
+	return NULL;
+}
+
+int
+writer_free(writer_t *w)
+{
+	if (!w)
+		return 0;
+
+	int ret = writer_sync(w);
+	int err = errno;
+
+	pthread_mutex_lock(&w->lock);
+	w->stop = 1;
+	pthread_cond_signal(&w->work);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread, NULL);
+
+	pthread_cond_destroy(&w->done);
+	pthread_cond_destroy(&w->work);
+	pthread_mutex_destroy(&w->lock);
+	ranges_free(&w->written);
+	free(w->batch);
+	free(w->pool);
+	free(w);
+
+	errno = err;
+	return ret;
+}
+
+void
+writer_sink(writer_t *w, writer_sink_fn *fn, void *arg, int in_order)
+{
+	w->sink = fn;
+	w->sink_arg = arg;
+	w->seekable = !in_order;
+}
+
+void *
+writer_get(writer_t *w)
+{
+	struct block *b;
+
+	pthread_mutex_lock(&w->lock);
+	b = w->free;
+	if (b) {
+		w->free = b->next;
+		w->nfree--;
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return b ? b->data : NULL;
+}
+
+int
+writer_spare(writer_t *w)
+{
+	int n;
+
+	pthread_mutex_lock(&w->lock);
+	n = w->nfree;
+	pthread_mutex_unlock(&w->lock);
+
+	return n;
+}
+
+void
+writer_put(writer_t *w, void *block, off_t offset, size_t len)
+{
+	struct block *b = to_block(block);
+
+	pthread_mutex_lock(&w->lock);
+	if (!len) {
+		b->next = w->free;
+		w->free = b;
+		w->nfree++;
+		pthread_cond_broadcast(&w->done);
+	} else {
+		b->offset = offset;
+		b->len = len;
+		b->next = NULL;
+		*w->tail = b;
+		w->tail = &b->next;
+		pthread_cond_signal(&w->work);
+	}
+	pthread_mutex_unlock(&w->lock);
+}
+
+void
+writer_watch(writer_t *w, writer_watch_fn *fn, void *arg)
+{
+	w->watch = fn;
+	w->watch_arg = arg;
+}
+
+int
+writer_wait(writer_t *w, const struct timeval *tv)
+{
+	struct timespec until;
+	int ret;
+
+	if (tv) {
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_sec += tv->tv_sec;
+		until.tv_nsec += tv->tv_usec * 1000;
+		if (until.tv_nsec >= 1000000000) {
+			until.tv_sec++;
+			until.tv_nsec -= 1000000000;
+		}
+	}
+
+	pthread_mutex_lock(&w->lock);
+	while (!w->free && !w->err) {
+		if (!tv)
+			pthread_cond_wait(&w->done, &w->lock);
+		else if (pthread_cond_timedwait(&w->done, &w->lock, &until))
+			break;
+	}
+	ret = w->free != NULL;
+	pthread_mutex_unlock(&w->lock);
+
+	return ret;
+}
+
+int
+writer_sync(writer_t *w)
+{
+	int err;
+
+	pthread_mutex_lock(&w->lock);
+	while (w->queue || w->busy)
+		pthread_cond_wait(&w->done, &w->lock);
+	err = w->err;
+	pthread_mutex_unlock(&w->lock);
+
+	if (err) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+int
+writer_error(writer_t *w)
+{
+	int err;
+
+	pthread_mutex_lock(&w->lock);
+	err = w->err;
+	pthread_mutex_unlock(&w->lock);
+
+	return err;
+}
+
+int
+writer_mark(writer_t *w, off_t start, off_t end, int written)
+{
+	int ret;
+
+	pthread_mutex_lock(&w->lock);
+	ret = written ? ranges_add(&w->written, start, end) :
+	    ranges_remove(&w->written, start, end);
+	pthread_mutex_unlock(&w->lock);
+
+	return ret;
+}
+
+int
+writer_written(writer_t *w, const ranges_t *done, ranges_t *out)
+{
+	const ranges_t *from = w ? &w->written : done;
+	range_t gap;
+	int ret = 0;
+
+	ranges_init(out);
+	if (w)
+		pthread_mutex_lock(&w->lock);
+	if (from->count) {
+		out->r = malloc(from->count * sizeof(*out->r));
+		if (out->r) {
+			memcpy(out->r, from->r, from->count * sizeof(*out->r));
+			out->count = out->alloc = from->count;
+		} else {
+			ret = -1;
+		}
+	}
+	if (w)
+		pthread_mutex_unlock(&w->lock);
+
+	/* Nor what has been written but is no longer done, such as a piece
+	   that failed its check and is being fetched again */
+	for (off_t pos = 0; !ret && out->count &&
+	     ranges_gap(done, pos, out->r[out->count - 1].end, &gap);
+	     pos = gap.end)
+		ret = ranges_remove(out, gap.start, gap.end);
+	if (ret)
+		ranges_free(out);
+	return ret;
+}
@@ -0,0 +1,114 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+
+/* Disk writer thread */
+
+#ifndef AXEL_WRITER_H
+#define AXEL_WRITER_H
+
+#include <sys/types.h>
+#include <sys/time.h>
+
+#include "ranges.h"
+
+/* The network side reads into blocks borrowed from a fixed pool, and hands
+ * them back tagged with where in the file they go; a thread of the
+ * writer's own puts them there, merging whatever is contiguous into one
+ * write.  A slow disk then holds up nothing but the pool: once every block
+ * is waiting for it, writer_get() has none to lend until some come back.
+ *
+ * A pipe, or anything else that cannot seek, is written from its start on:
+ * blocks queued ahead of where it has got to are held, out of the pool,
+ * until what comes before them has been written.  Every byte is to be
+ * queued once, and the pool is all there is to hold them. */
+typedef struct writer writer_t;
+
+writer_t *writer_new(int fd, size_t block_size, int nblocks);
+
+/* Wait for what has been queued to be written, stop the thread and free
+ * the pool.  Returns what writer_sync() would. */
+int writer_free(writer_t *w);
+
+/* A free block of block_size bytes, or NULL if all are in use */
+void *writer_get(writer_t *w);
+
+/* How many blocks writer_get() has to lend */
+int writer_spare(writer_t *w);
+
+/* Queue len bytes of block to be written at offset; a len of zero hands the
+ * block back unused */
+void writer_put(writer_t *w, void *block, off_t offset, size_t len);
+
+/* Have fn called with each block once it is written, from the writer's own
+ * thread, in offset order within each batch of them.  Set it before any
+ * block is queued. */
+typedef void writer_watch_fn(void *arg, const void *data, off_t offset,
+			     size_t len);
+void writer_watch(writer_t *w, writer_watch_fn *fn, void *arg);
+
+/* Hand the blocks to fn, from the writer's own thread, instead of writing
+ * them to the fd: a run of them at a time, each at its offset, in any order
+ * unless in_order asks for them the way a pipe gets them.  fn returns 0 or
+ * an errno.  Set it before any block is queued. */
+typedef int writer_sink_fn(void *arg, const void *data, size_t len,
+			   off_t offset);
+void writer_sink(writer_t *w, writer_sink_fn *fn, void *arg, int in_order);
+
+/* Wait up to tv, or for as long as it takes if tv is NULL, for a block to
+ * come free.  Returns whether there is one. */
+int writer_wait(writer_t *w, const struct timeval *tv);
+
+/* Wait for everything queued so far to be written, but for what a pipe
+ * holds until it gets there.  Returns -1 with errno
+ * set if any write has failed, this or any earlier time. */
+int writer_sync(writer_t *w);
+
+/* The errno of the first write to have failed, 0 if none has */
+int writer_error(writer_t *w);
+
+/* The writer keeps the ranges it has written.  Count [start, end) as
+ * written, or no longer so, for what was put in place, or found wanting,
+ * some other way.  Returns 0, or -1 with errno set. */
+int writer_mark(writer_t *w, off_t start, off_t end, int written);
+
+/* Into out, which it initialises, as much of done as has been written,
+ * without waiting for what is still queued: that is left out.  With no
+ * writer, all of done.  Returns 0, or -1 with errno set. */
+int writer_written(writer_t *w, const ranges_t *done, ranges_t *out);
+
+#endif				/* AXEL_WRITER_H */
@@ -0,0 +1,530 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+
+/* Reading a zsync control file, and finding its blocks in an older file */
+
+#include "config.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "ranges.h"
+#include "digest.h"
+#include "zsync.h"
+
+/* No control file has a header that long */
+#define HEADER_MAX	(64 << 10)
+
+/* Nor a file more blocks than this, with any sensible block size */
+#define BLOCKS_MAX	(1 << 28)
+
+/* How much of the old file is read at a time, at least */
+#define WINDOW		(1 << 20)
+
+/* The weak checksum, as zsync has it: a is the sum of the bytes, and b the
+   sum of each times its distance from the end of the block */
+struct rsum {
+	uint16_t a, b;
+};
+
+/* MD4 (RFC 1320), which OpenSSL may not offer any more, and which zsync
+ * uses to tell the blocks that really match from the ones whose weak
+ * checksums merely do. */
+
+#define F(x, y, z)	(((x) & (y)) | (~(x) & (z)))
+#define G(x, y, z)	(((x) & (y)) | ((x) & (z)) | ((y) & (z)))
+#define H(x, y, z)	((x) ^ (y) ^ (z))
+#define ROL(x, n)	((x) << (n) | (x) >> (32 - (n)))
+
+static
+void
+md4_block(uint32_t s[4], const unsigned char *p)
+{
+	static const int r1[] = { 3, 7, 11, 19 }, r2[] = { 3, 5, 9, 13 },
+	    r3[] = { 3, 9, 11, 15 };
+	static const int o2[] = { 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14,
+		3, 7, 11, 15 };
+	static const int o3[] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13,
+		3, 11, 7, 15 };
+	uint32_t x[16], a = s[0], b = s[1], c = s[2], d = s[3], t;
+
+	for (int i = 0; i < 16; i++)
+		x[i] = p[4 * i] | p[4 * i + 1] << 8 | p[4 * i + 2] << 16 |
+		    (uint32_t)p[4 * i + 3] << 24;
+
+	/* Each step works on the next word round, the others moving down */
+	for (int i = 0; i < 16; i++) {
+		t = a + F(b, c, d) + x[i];
+		t = ROL(t, r1[i % 4]);
+		a = d, d = c, c = b, b = t;
+	}
+	for (int i = 0; i < 16; i++) {
+		t = a + G(b, c, d) + x[o2[i]] + 0x5a827999;
+		t = ROL(t, r2[i % 4]);
+		a = d, d = c, c = b, b = t;
+	}
+	for (int i = 0; i < 16; i++) {
+		t = a + H(b, c, d) + x[o3[i]] + 0x6ed9eba1;
+		t = ROL(t, r3[i % 4]);
+		a = d, d = c, c = b, b = t;
+	}
+
+	s[0] += a, s[1] += b, s[2] += c, s[3] += d;
+}
+
+static
+void
+md4(const unsigned char *data, size_t len, unsigned char out[16])
+{
+	uint32_t s[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+	unsigned char last[128] = { 0 };
+	size_t tail = len % 64, n = tail < 56 ? 64 : 128;
+	uint64_t bits = (uint64_t)len * 8;
+
+	for (size_t i = 0; i + 64 <= len; i += 64)
+		md4_block(s, data + i);
+
+	memcpy(last, data + len - tail, tail);
+	last[tail] = 0x80;
+	for (int i = 0; i < 8; i++)
+		last[n - 8 + i] = bits >> 8 * i;
+	for (size_t i = 0; i < n; i += 64)
+		md4_block(s, last + i);
+
+	for (int i = 0; i < 16; i++)
+		out[i] = s[i / 4] >> 8 * (i % 4);
+}
+
+static
+struct rsum
+rsum(const unsigned char *p, size_t len)
+{
+	struct rsum r = { 0, 0 };
+
+	for (size_t n = len; n; n--, p++) {
+		r.a += *p;
+		r.b += n * *p;
+	}
+	return r;
+}
+
+/* The window moves on a byte, dropping out and taking in */
+static
+void
+roll(struct rsum *r, unsigned char out, unsigned char in, size_t len)
+{
+	r->a += in - out;
+	r->b += r->a - len * out;
+}
+
+int
+zsync_named(const char *arg)
+{
+	size_t len = strlen(arg);
+
+	return !strstr(arg, "://") && len > 6 &&
+	    !strcasecmp(arg + len - 6, ".zsync");
+}
+
+/* Take the header line in [s, end) into z */
+static
+int
+header(zsync_t *z, const char *s, const char *end)
+{
+	const char *colon = memchr(s, ':', end - s), *v;
+	char value[1024], *e;
+	size_t n;
+
+	if (!colon)
+		return -1;
+	for (v = colon + 1; v < end && *v == ' '; v++)
+		;
+	n = end - v < (ptrdiff_t)sizeof(value) ? (size_t)(end - v) :
+	    sizeof(value) - 1;
+	memcpy(value, v, n);
+	value[n] = 0;
+
+#define KEY(k) ((size_t)(colon - s) == strlen(k) && !strncasecmp(s, k, colon - s))
+	if (KEY("Filename")) {
+		/* Where it goes is up to the user: only the name is taken */
+		const char *base = strrchr(value, '/') ?
+		    strrchr(value, '/') + 1 : value;
+
+		if (!*base || !strcmp(base, ".") || !strcmp(base, ".."))
+			return -1;
+		free(z->filename);
+		z->filename = strdup(base);
+		return z->filename ? 0 : -1;
+	} else if (KEY("Blocksize")) {
+		z->blocksize = strtoul(value, &e, 10);
+		return *e || !z->blocksize || z->blocksize > (1 << 24) ? -1 : 0;
+	} else if (KEY("Length")) {
+		z->length = strtoll(value, &e, 10);
+		return *e || z->length < 0 ? -1 : 0;
+	} else if (KEY("Hash-Lengths")) {
+		return sscanf(value, "%d,%d,%d", &z->seq_matches,
+			      &z->rsum_bytes, &z->checksum_bytes) != 3 ||
+		    z->seq_matches < 1 || z->seq_matches > 2 ||
+		    z->rsum_bytes < 1 || z->rsum_bytes > 4 ||
+		    z->checksum_bytes < 3 || z->checksum_bytes > 16 ? -1 : 0;
+	} else if (KEY("URL")) {
+		char **urls = realloc(z->urls, (z->nurls + 1) * sizeof(*urls));
+
+		if (!urls)
+			return -1;
+		z->urls = urls;
+		urls[z->nurls] = strdup(value);
+		return urls[z->nurls++] ? 0 : -1;
+	} else if (KEY("SHA-1")) {
+		char spec[sizeof(value) + 8];
+
+		snprintf(spec, sizeof(spec), "sha1:%s", value);
+		return digest_spec_parse(&z->sha1, spec) || z->sha1.len != 20 ?
+		    -1 : 0;
+	}
+#undef KEY
+
+	/* The rest, Z-URL and Z-Map2 for one, are of no use here */
+	return 0;
+}
+
+zsync_t *
+zsync_parse(const char *data, size_t len)
+{
+	const char *s = data, *end = data + len, *nl;
+	size_t per;
+	zsync_t *z;
+
+	z = calloc(1, sizeof(*z));
+	if (!z)
+		return NULL;
+	z->length = -1;
+
+	/* Lines up to an empty one, then the checksums */
+	for (;; s = nl + 1) {
+		nl = memchr(s, '\n', end - s);
+		if (!nl || nl - data > HEADER_MAX)
+			goto invalid;
+		if (nl == s)
+			break;
+		errno = 0;
+		if (header(z, s, nl[-1] == '\r' ? nl - 1 : nl) == -1) {
+			if (errno == ENOMEM)
+				goto fail;
+			goto invalid;
+		}
+	}
+	s = nl + 1;
+
+	if (!z->filename || !z->blocksize || z->length < 0 ||
+	    !z->seq_matches || !z->nurls)
+		goto invalid;
+	z->blocks = (z->length + z->blocksize - 1) / z->blocksize;
+	per = z->rsum_bytes + z->checksum_bytes;
+	if (z->blocks > BLOCKS_MAX || (size_t)(end - s) != z->blocks * per)
+		goto invalid;
+	z->sums = malloc(z->blocks * per + 1);
+	if (!z->sums)
+		goto fail;
+	memcpy(z->sums, s, z->blocks * per);
+
+	return z;
+ invalid:
+	errno = EINVAL;
+ fail:
+	zsync_free(z);
+	return NULL;
+}
+
+zsync_t *
+zsync_load(const char *path)
+{
+	zsync_t *z = NULL;
+	struct stat st;
+	char *data;
+	int fd = open(path, O_RDONLY);
+
+	if (fd == -1)
+		return NULL;
+	if (fstat(fd, &st) == -1)
+		goto out;
+	if (st.st_size > HEADER_MAX + (off_t)BLOCKS_MAX * 20) {
+		errno = EFBIG;
+		goto out;
+	}
+	data = malloc(st.st_size + 1);
+	if (!data)
+		goto out;
+	for (off_t got = 0; got < st.st_size;) {
+		ssize_t n = read(fd, data + got, st.st_size - got);
+
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			if (!n)
+				errno = EIO;
+			free(data);
+			goto out;
+		}
+		got += n;
+	}
+	z = zsync_parse(data, st.st_size);
+	free(data);
+ out:
+	close(fd);
+	return z;
+}
+
+/* The blocks, by their weak checksums */
+struct index {
+	const zsync_t *z;
+	uint32_t mask;		/* of the weak checksum, as much as is kept */
+	size_t size;
+	ssize_t *head, *next;
+	bool *found;
+};
+
+static
+uint32_t
+stored_rsum(const zsync_t *z, size_t i)
+{
+	const unsigned char *p = z->sums +
+	    i * (z->rsum_bytes + z->checksum_bytes);
+	uint32_t r = 0;
+
+	for (int j = 0; j < z->rsum_bytes; j++)
+		r = r << 8 | p[j];
+	return r;
+}
+
+static
+size_t
+bucket(const struct index *idx, uint32_t r)
+{
+	r &= idx->mask;
+	return (r ^ r >> 16) * 2654435761u & (idx->size - 1);
+}
+
+static
+int
+index_new(struct index *idx, const zsync_t *z)
+{
+	idx->z = z;
+	idx->mask = z->rsum_bytes == 4 ? 0xffffffff :
+	    (1u << 8 * z->rsum_bytes) - 1;
+	for (idx->size = 16; idx->size < 2 * z->blocks; idx->size *= 2)
+		;
+	idx->head = malloc(idx->size * sizeof(*idx->head));
+	idx->next = malloc(z->blocks * sizeof(*idx->next));
+	idx->found = calloc(z->blocks, 1);
+	if (!idx->head || !idx->next || !idx->found)
+		return -1;
+
+	memset(idx->head, 0xff, idx->size * sizeof(*idx->head));
+	for (size_t i = z->blocks; i-- > 0;) {
+		size_t b = bucket(idx, stored_rsum(z, i));
+
+		idx->next[i] = idx->head[b];
+		idx->head[b] = i;
+	}
+	return 0;
+}
+
+static
+void
+index_free(struct index *idx)
+{
+	free(idx->head);
+	free(idx->next);
+	free(idx->found);
+}
+
+/* Whether the blocksize bytes at p are block i */
+static
+bool
+is_block(const struct index *idx, size_t i, const unsigned char *p,
+	 struct rsum r)
+{
+	const zsync_t *z = idx->z;
+	unsigned char sum[16];
+
+	if ((((uint32_t)r.a << 16 | r.b) & idx->mask) != stored_rsum(z, i))
+		return false;
+	md4(p, z->blocksize, sum);
+	return !memcmp(sum, z->sums + i * (z->rsum_bytes + z->checksum_bytes) +
+		       z->rsum_bytes, z->checksum_bytes);
+}
+
+/* Report the blocks at p whose weak checksum is r, and that were not found
+   already.  Returns how many bytes they make. */
+static
+off_t
+find(struct index *idx, const unsigned char *p, struct rsum r,
+     zsync_found_fn *fn, void *arg)
+{
+	const zsync_t *z = idx->z;
+	size_t bs = z->blocksize;
+	off_t found = 0;
+
+	for (ssize_t i = idx->head[bucket(idx, (uint32_t)r.a << 16 | r.b)];
+	     i != -1; i = idx->next[i]) {
+		/* With short checksums, a block only counts with the next */
+		size_t n = z->seq_matches > 1 && (size_t)i + 1 < z->blocks ?
+		    2 : 1;
+
+		if ((idx->found[i] && (n == 1 || idx->found[i + 1])) ||
+		    !is_block(idx, i, p, r) ||
+		    (n == 2 && !is_block(idx, i + 1, p + bs, rsum(p + bs, bs))))
+			continue;
+		for (size_t j = i; j < i + n; j++) {
+			off_t left = z->length - (off_t)j * bs;
+			size_t len = left < (off_t)bs ? (size_t)left : bs;
+
+			if (idx->found[j])
+				continue;
+			idx->found[j] = true;
+			fn(arg, p + (j - i) * bs, (off_t)j * bs, len);
+			found += len;
+		}
+	}
+	return found;
+}
+
+/* Fill the window from the file, up to cap, with zeros past what there is.
+   Returns 0, or -1 with errno set. */
+static
+int
+fill(int fd, unsigned char *buf, size_t *have, size_t cap, size_t pad,
+     off_t *size, off_t base)
+{
+	while (*have < cap) {
+		ssize_t n = read(fd, buf + *have, cap - *have);
+
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n == -1)
+			return -1;
+		if (!n) {
+			/* Shorter than it was */
+			*size = base + *have;
+			break;
+		}
+		*have += n;
+	}
+	memset(buf + *have, 0, cap + pad - *have);
+	return 0;
+}
+
+off_t
+zsync_seed(const zsync_t *z, const char *path, zsync_found_fn *fn, void *arg)
+{
+	size_t bs = z->blocksize, span = bs * z->seq_matches;
+	size_t cap = WINDOW > 2 * span ? WINDOW : 2 * span, have = 0;
+	struct index idx = { 0 };
+	off_t base = 0, x = 0, size, found = 0, n;
+	unsigned char *buf = NULL, *p;
+	bool fresh = true;
+	struct rsum r;
+	struct stat st;
+	int fd = open(path, O_RDONLY), err = 0;
+
+	if (fd == -1)
+		return -1;
+	if (fstat(fd, &st) == -1 || index_new(&idx, z) == -1 ||
+	    !(buf = malloc(cap + span))) {
+		err = errno;
+		goto out;
+	}
+
+	/* Block by block while they match, else a byte at a time */
+	for (size = st.st_size; x < size; x++) {
+		if (x + (off_t)span > base + (off_t)have && base + (off_t)have < size) {
+			memmove(buf, buf + (x - base), have - (x - base));
+			have -= x - base;
+			base = x;
+			if (fill(fd, buf, &have, cap, span, &size, base) == -1) {
+				err = errno;
+				goto out;
+			}
+		}
+
+		p = buf + (x - base);
+		if (fresh)
+			r = rsum(p, bs);
+		fresh = false;
+		n = find(&idx, p, r, fn, arg);
+		if (n) {
+			found += n;
+			x += bs - 1;
+			fresh = true;
+		} else {
+			roll(&r, p[0], p[bs], bs);
+		}
+	}
+ out:
+	index_free(&idx);
+	free(buf);
+	close(fd);
+	errno = err;
+	return err ? -1 : found;
+}
+
+void
+zsync_free(zsync_t *z)
+{
+	if (!z)
+		return;
+
+	for (int i = 0; i < z->nurls; i++)
+		free(z->urls[i]);
+	free(z->urls);
+	free(z->filename);
+	free(z->sums);
+	free(z);
+}
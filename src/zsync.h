@@ -0,0 +1,83 @@
+/*
+  Axel -- A lighter download accelerator for Linux and other Unices
+
+  Copyright 2026      Ismael Luceno
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  In addition, as a special exception, the copyright holders give
+  permission to link the code of portions of this program with the
+  OpenSSL library under certain conditions as described in each
+  individual source file, and distribute linked combinations including
+  the two.
+
+  You must obey the GNU General Public License in all respects for all
+  of the code used other than OpenSSL. If you modify file(s) with this
+  exception, you may extend this exception to your version of the
+  file(s), but you are not obligated to do so. If you do not wish to do
+  so, delete this exception statement from your version. If you delete
+  this exception statement from all source files in the program, then
+  also delete it here.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+
+
+/* Reading a zsync control file, and finding its blocks in an older file */
+
+#ifndef AXEL_ZSYNC_H
+#define AXEL_ZSYNC_H
+
+/* A .zsync file describes a file a block at a time: for each block a weak
+ * checksum that can be rolled along another file a byte at a time, and the
+ * start of an MD4 to tell the real matches from the chance ones.  Whatever
+ * blocks an older version of the file still has can be copied from it, and
+ * only the rest downloaded. */
+typedef struct {
+	char *filename;
+	off_t length;
+	size_t blocksize, blocks;
+	int seq_matches;	/* blocks that must match in a row */
+	int rsum_bytes, checksum_bytes;
+	digest_spec_t sha1;	/* of the whole file; len is 0 if none */
+	char **urls;
+	int nurls;
+	unsigned char *sums;	/* rsum_bytes and checksum_bytes a block */
+} zsync_t;
+
+/* Called with each run of blocks found, len bytes of them that belong at
+ * offset in the new file */
+typedef void zsync_found_fn(void *arg, const void *data, off_t offset,
+			    size_t len);
+
+/* Whether a command line argument names a zsync control file */
+int zsync_named(const char *arg);
+
+/* Read a control file from len bytes.  Returns NULL with errno set: EINVAL
+ * if it is not one axel can use. */
+zsync_t *zsync_parse(const char *data, size_t len);
+
+/* The same, from a file */
+zsync_t *zsync_load(const char *path);
+
+/* Look for the blocks of the file in the one at path, calling fn for each
+ * run of them found.  Returns how many bytes were, or -1 with errno set. */
+off_t zsync_seed(const zsync_t *z, const char *path, zsync_found_fn *fn,
+		 void *arg);
+
+void zsync_free(zsync_t *z);
+
+#endif				/* AXEL_ZSYNC_H */
@@ -0,0 +1,141 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/altsvc.c — where servers say they may also be reached
+ *
+ * Alt-Svc values are read as RFC 7838 writes them: several alternatives,
+ * percent-encoded protocol ids, bracketed IPv6 hosts, parameters in any
+ * order, and "clear"; anything else is refused as a whole.  What a server
+ * says replaces what it said before, except that an alternative found
+ * broken stays so, and one that has run out is not handed out.
+ */
+
+#include "config.h"
+
+#include "harness.h"
+
+#include "altsvc.h"
+
+TEST(alternatives_are_read_in_order)
+{
+	altsvc_t a[4];
+
+	ASSERT_EQ(altsvc_parse("h3=\":443\"; ma=3600, h2=\"alt.example:8443\"",
+			       a, 4), 2);
+	CHECK_STR(a[0].proto, "h3");
+	CHECK_STR(a[0].host, "");
+	CHECK_EQ(a[0].port, 443);
+	CHECK_EQ(a[0].max_age, 3600);
+	CHECK_STR(a[1].proto, "h2");
+	CHECK_STR(a[1].host, "alt.example");
+	CHECK_EQ(a[1].port, 8443);
+	CHECK_EQ(a[1].max_age, ALTSVC_MAX_AGE);
+
+	/* More than there is room for are skipped, not refused */
+	CHECK_EQ(altsvc_parse("h3=\":1\", h3=\":2\", h3=\":3\"", a, 2), 2);
+	CHECK_EQ(a[1].port, 2);
+}
+
+TEST(ids_hosts_and_parameters_in_full)
+{
+	altsvc_t a[2];
+
+	ASSERT_EQ(altsvc_parse("h%32=\"[::1]:8443\";persist=1;  ma=\"60\"",
+			       a, 2), 1);
+	CHECK_STR(a[0].proto, "h2");
+	CHECK_STR(a[0].host, "::1");
+	CHECK_EQ(a[0].port, 8443);
+	CHECK_EQ(a[0].max_age, 60);
+
+	CHECK_EQ(altsvc_parse("  clear ", a, 2), 0);
+}
+
+TEST(malformed_values_are_refused)
+{
+	altsvc_t a[2];
+
+	CHECK_EQ(altsvc_parse("", a, 2), -1);
+	CHECK_EQ(altsvc_parse("h2", a, 2), -1);
+	CHECK_EQ(altsvc_parse("h2=:443", a, 2), -1);
+	CHECK_EQ(altsvc_parse("h2=\":443", a, 2), -1);
+	CHECK_EQ(altsvc_parse("h2=\"host\"", a, 2), -1);
+	CHECK_EQ(altsvc_parse("h2=\":0\"", a, 2), -1);
+	CHECK_EQ(altsvc_parse("h2=\":443x\"", a, 2), -1);
+	CHECK_EQ(altsvc_parse("h2=\"[::1:443\"", a, 2), -1);
+	CHECK_EQ(altsvc_parse("h%3=\":443\"", a, 2), -1);
+	CHECK_EQ(altsvc_parse("h2=\":443\"; ma=soon", a, 2), -1);
+	CHECK_EQ(altsvc_parse("h2=\":443\" h3=\":443\"", a, 2), -1);
+	CHECK_EQ(altsvc_parse("h2=\":443\", clear", a, 2), -1);
+}
+
+TEST(what_a_server_says_replaces_what_it_said)
+{
+	char host[64];
+	int port;
+
+	altsvc_learn("a.example", 443, "h3=\":443\", h2=\"b.example:8443\"");
+	ASSERT_EQ(altsvc_lookup("a.example", 443, "h2", host, sizeof(host),
+				&port), 1);
+	CHECK_STR(host, "b.example");
+	CHECK_EQ(port, 8443);
+	CHECK_EQ(altsvc_lookup("a.example", 8443, "h2", host, sizeof(host),
+			       &port), 0);
+
+	/* Where the server is already is no alternative, but for HTTP/3,
+	   which is over UDP */
+	altsvc_learn("e.example", 443, "h2=\":443\", h3=\":443\"");
+	CHECK_EQ(altsvc_lookup("e.example", 443, "h2", host, sizeof(host),
+			       &port), 0);
+	ASSERT_EQ(altsvc_lookup("e.example", 443, "h3", host, sizeof(host),
+				&port), 1);
+	CHECK_STR(host, "e.example");
+	CHECK_EQ(port, 443);
+
+	/* Nonsense changes nothing; clear does */
+	altsvc_learn("a.example", 443, "h2=");
+	CHECK_EQ(altsvc_lookup("a.example", 443, "h2", host, sizeof(host),
+			       &port), 1);
+	altsvc_learn("a.example", 443, "clear");
+	CHECK_EQ(altsvc_lookup("a.example", 443, "h2", host, sizeof(host),
+			       &port), 0);
+}
+
+TEST(broken_and_expired_are_not_handed_out)
+{
+	char host[64];
+	int port;
+
+	altsvc_learn("c.example", 443, "h2=\":8443\"");
+	ASSERT_EQ(altsvc_lookup("c.example", 443, "h2", host, sizeof(host),
+				&port), 1);
+	CHECK_STR(host, "c.example");
+
+	/* Offered again after it failed, and still left alone */
+	altsvc_broken("c.example", 443, "h2");
+	altsvc_learn("c.example", 443, "h2=\":8443\", h2=\":9443\"");
+	ASSERT_EQ(altsvc_lookup("c.example", 443, "h2", host, sizeof(host),
+				&port), 1);
+	CHECK_EQ(port, 9443);
+
+	altsvc_learn("d.example", 443, "h2=\":8443\"; ma=0");
+	CHECK_EQ(altsvc_lookup("d.example", 443, "h2", host, sizeof(host),
+			       &port), 0);
+}
+
+int
+main(void)
+{
+	REGISTER_DESC(alternatives_are_read_in_order,
+		      "a value's alternatives come out in order, with their ages");
+	REGISTER_DESC(ids_hosts_and_parameters_in_full,
+		      "encoded ids, IPv6 hosts, any parameters, and clear");
+	REGISTER_DESC(malformed_values_are_refused,
+		      "a malformed value is refused as a whole");
+	REGISTER_DESC(what_a_server_says_replaces_what_it_said,
+		      "what a server says replaces what it said before");
+	REGISTER_DESC(broken_and_expired_are_not_handed_out,
+		      "broken alternatives stay broken, expired ones go");
+
+	RUN_ALL();
+	return DONE();
+}
@@ -0,0 +1,225 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/cli.c — what the axel program puts on its standard output
+ *
+ * The program as built, run from the top of the build tree the way
+ * tap-run runs every suite, fetching a file of the suite's own over
+ * file://.  With -o - the data has standard output to itself, all of it,
+ * with -q or without; and -q leaves standard output empty otherwise.  A
+ * Metalink mirror that sends bad pieces is dropped, and the pieces are
+ * fetched again from the good one.
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#ifdef HAVE_WOLFSSL
+#include <wolfssl/options.h>
+#include <wolfssl/wolfcrypt/settings.h>
+#include <wolfssl/openssl/evp.h>
+#elif defined(HAVE_SSL)
+#include <openssl/evp.h>
+#endif
+
+#include "harness.h"
+
+#define AXEL	"./axel"
+#define SIZE	(1024 * 1024 + 77)
+
+static char dir[] = "/tmp/axel-cli-XXXXXX";
+static char url[sizeof(dir) + 32], path[sizeof(dir) + 16];
+static char out[sizeof(dir) + 16];
+static unsigned char source[SIZE], got[SIZE + 4096];
+
+/* The file the downloads fetch, and a home with no axelrc in it */
+static
+void
+make_source(void)
+{
+	int fd;
+
+	if (!mkdtemp(dir) || setenv("HOME", dir, 1))
+		abort();
+	snprintf(path, sizeof(path), "%s/source", dir);
+	snprintf(out, sizeof(out), "%s/out", dir);
+	snprintf(url, sizeof(url), "file://%s", path);
+
+	for (size_t i = 0; i < SIZE; i++)
+		source[i] = (i * 13 + i / 4096) % 251;
+	fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd == -1 || write(fd, source, SIZE) != SIZE || close(fd))
+		abort();
+}
+
+/* Run axel with argv, taking what it writes on standard output into got.
+ * Returns how much it wrote, and its exit status in *status. */
+static
+ssize_t
+run(char *const argv[], int *status)
+{
+	ssize_t len = 0, n;
+	int fds[2];
+	pid_t pid;
+
+	if (pipe(fds) == -1)
+		return -1;
+	pid = fork();
+	if (pid == -1)
+		return -1;
+	if (!pid) {
+		int null = open("/dev/null", O_WRONLY);
+
+		dup2(fds[1], STDOUT_FILENO);
+		dup2(null, STDERR_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		execv(AXEL, argv);
+		_exit(127);
+	}
+
+	close(fds[1]);
+	while ((n = read(fds[0], got + len, sizeof(got) - len)) > 0)
+		len += n;
+	close(fds[0]);
+	if (waitpid(pid, status, 0) == -1)
+		return -1;
+	return len;
+}
+
+TEST(the_data_has_standard_output_to_itself)
+{
+	char *argv[] = { "axel", "-n", "4", "-o", "-", url, NULL };
+	int status;
+
+	CHECK_EQ(run(argv, &status), SIZE);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	CHECK(!memcmp(got, source, SIZE));
+}
+
+TEST(quiet_keeps_the_data_on_standard_output)
+{
+	char *argv[] = { "axel", "-q", "-n", "4", "-o", "-", url, NULL };
+	char *after[] = { "axel", "-n", "4", "-o", "-", "-q", url, NULL };
+	int status;
+
+	CHECK_EQ(run(argv, &status), SIZE);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	CHECK(!memcmp(got, source, SIZE));
+
+	/* Wherever on the command line -q comes */
+	CHECK_EQ(run(after, &status), SIZE);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	CHECK(!memcmp(got, source, SIZE));
+}
+
+TEST(quiet_leaves_standard_output_empty)
+{
+	char *argv[] = { "axel", "-q", "-o", out, url, NULL };
+	int status;
+
+	CHECK_EQ(run(argv, &status), 0);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	unlink(out);
+}
+
+#ifdef HAVE_SSL
+#define PIECE	(64 * 1024)
+
+/* A Metalink listing a mirror whose every piece is damaged ahead of one
+ * that has the file as it is, with SHA-1 hashes for the pieces */
+static
+int
+make_metalink(const char *meta, const char *bad)
+{
+	static unsigned char damaged[SIZE];
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int len;
+	FILE *f;
+	int fd;
+
+	memcpy(damaged, source, SIZE);
+	for (size_t i = 0; i < SIZE; i += PIECE)
+		damaged[i + (i + PIECE < SIZE ? PIECE / 2 : 0)] ^= 0xff;
+	fd = open(bad, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd == -1 || write(fd, damaged, SIZE) != SIZE || close(fd))
+		return -1;
+
+	f = fopen(meta, "w");
+	if (!f)
+		return -1;
+	fprintf(f, "<?xml version=\"1.0\"?>\n"
+		"<metalink xmlns=\"urn:ietf:params:xml:ns:metalink\">\n"
+		"<file name=\"out\">\n<size>%d</size>\n"
+		"<pieces length=\"%d\" type=\"sha-1\">", SIZE, PIECE);
+	for (size_t i = 0; i < SIZE; i += PIECE) {
+		EVP_Digest(source + i, i + PIECE < SIZE ? PIECE : SIZE - i,
+			   md, &len, EVP_sha1(), NULL);
+		fputs("<hash>", f);
+		for (unsigned int j = 0; j < len; j++)
+			fprintf(f, "%02x", md[j]);
+		fputs("</hash>", f);
+	}
+	fprintf(f, "</pieces>\n"
+		"<url priority=\"1\">file://%s</url>\n"
+		"<url priority=\"2\">file://%s</url>\n"
+		"</file>\n</metalink>\n", bad, path);
+	return fclose(f);
+}
+
+TEST(a_mirror_with_bad_pieces_is_dropped_for_a_good_one)
+{
+	char meta[sizeof(dir) + 16], bad[sizeof(dir) + 16];
+	char *argv[] = { "axel", "-q", "-n", "4", "-o", out, meta, NULL };
+	int status, fd;
+
+	snprintf(meta, sizeof(meta), "%s/two.meta4", dir);
+	snprintf(bad, sizeof(bad), "%s/bad", dir);
+	ASSERT_OK(make_metalink(meta, bad));
+
+	for (int n = 0; n < 4; n++) {
+		CHECK_EQ(run(argv, &status), 0);
+		CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+		fd = open(out, O_RDONLY);
+		CHECK_EQ(read(fd, got, sizeof(got)), SIZE);
+		CHECK(!memcmp(got, source, SIZE));
+		close(fd);
+		unlink(out);
+	}
+	unlink(meta);
+	unlink(bad);
+}
+#endif				/* HAVE_SSL */
+
+int
+main(void)
+{
+	int ret;
+
+	make_source();
+
+	REGISTER_DESC(the_data_has_standard_output_to_itself,
+		      "with -o -, standard output carries the data and nothing else");
+	REGISTER_DESC(quiet_keeps_the_data_on_standard_output,
+		      "-q with -o - still sends all the data down standard output");
+	REGISTER_DESC(quiet_leaves_standard_output_empty,
+		      "-q leaves standard output empty when writing a file");
+#ifdef HAVE_SSL
+	REGISTER_DESC(a_mirror_with_bad_pieces_is_dropped_for_a_good_one,
+		      "a mirror sending bad pieces is dropped for a good one");
+#endif
+
+	RUN_ALL();
+	ret = DONE();
+
+	unlink(path);
+	rmdir(dir);
+	return ret;
+}
@@ -21,24 +21,10 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "axel.h"
 
-/* src/conf.c reaches for this when a config file names an interface.  No
- * test here does, so this only has to exist, and defining it is what keeps
- * src/tcp.c -- and with it the rest of the network stack -- out of the
- * link.  It answers the way the real one does when it finds nothing. */
-int
-get_if_ip(char *dst, size_t len, const char *iface)
-{
-	(void)iface;
-
-	if (len)
-		*dst = 0;
-
-	return 0;
-}
-
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof(*(a)))
 
 /* A conf holding nothing but the given headers.  conf_init() is not what is
@@ -192,6 +178,88 @@ TEST(a_host_is_what_counts_not_the_protocol_it_is_reached_by)
 					    PROTO_HTTP, "example.org"));
 }
 
+/* ── keys set one at a time ──────────────────────────────────────────── */
+
+TEST(a_key_is_set_as_a_config_file_would_set_it)
+{
+	conf_t *conf = conf_with(NULL, 0);
+	char name[] = "index.htm", speed[] = "5000000000", n[] = "12";
+	char hosts[] = "a.example,b.example";
+
+	ASSERT(conf_set(conf, "default_filename", name));
+	ASSERT(conf_set(conf, "max_speed", speed));
+	ASSERT(conf_set(conf, "num_connections", n));
+	ASSERT(conf_set(conf, "no_proxy", hosts));
+	CHECK_STR(conf->default_filename, "index.htm");
+	CHECK_EQ(conf->max_speed, 5000000000ull);
+	CHECK_EQ(conf->num_connections, 12);
+
+	/* A list, as conn_init() walks it */
+	CHECK_STR(conf->no_proxy, "a.example");
+	CHECK_STR(conf->no_proxy + 10, "b.example");
+	CHECK_EQ(conf->no_proxy[20], 0);
+}
+
+TEST(an_unknown_key_or_a_bad_value_is_refused)
+{
+	conf_t *conf = conf_with(NULL, 0);
+	char value[] = "1", proto[] = "ipx";
+
+	ASSERT(!conf_set(conf, "no_such_key", value));
+	ASSERT(!conf_set(conf, "use_protocol", proto));
+}
+
+TEST(interfaces_are_kept_as_listed)
+{
+	conf_t *conf = conf_with(NULL, 0);
+	/* Whatever a buffer holds past the end is none of the list's */
+	char value[] = "eth0  fd00::1\0junk";
+	axel_if_t *f;
+
+	conf->interfaces = calloc(1, sizeof(*conf->interfaces));
+	ASSERT_NOTNULL(conf->interfaces);
+	conf->interfaces->next = conf->interfaces;
+	ASSERT(conf_set(conf, "interfaces", value));
+
+	f = conf->interfaces;
+	CHECK_STR(f->text, "eth0");
+	f = f->next;
+	CHECK_STR(f->text, "fd00::1");
+	CHECK(f->next == conf->interfaces);
+	free(f);
+	free(conf->interfaces);
+}
+
+TEST(a_list_in_a_config_file_is_read_whole)
+{
+	conf_t *conf = conf_with(NULL, 0);
+	char file[] = "/tmp/axelrc.XXXXXX";
+	axel_if_t *f;
+	FILE *fp;
+	int fd;
+
+	fd = mkstemp(file);
+	ASSERT(fd >= 0);
+	fp = fdopen(fd, "w");
+	ASSERT_NOTNULL(fp);
+	fputs("interfaces = eth0 fd00::1 \t# both of them\n", fp);
+	fclose(fp);
+
+	conf->interfaces = calloc(1, sizeof(*conf->interfaces));
+	ASSERT_NOTNULL(conf->interfaces);
+	conf->interfaces->next = conf->interfaces;
+	CHECK(conf_loadfile(conf, file));
+	unlink(file);
+
+	f = conf->interfaces;
+	CHECK_STR(f->text, "eth0");
+	f = f->next;
+	CHECK_STR(f->text, "fd00::1");
+	CHECK(f->next == conf->interfaces);
+	free(f);
+	free(conf->interfaces);
+}
+
 int
 main(void)
 {
@@ -231,6 +299,15 @@ main(void)
 	REGISTER_DESC(a_host_is_what_counts_not_the_protocol_it_is_reached_by,
 		      "the host decides, not which protocol reaches it");
 
+	REGISTER_DESC(a_key_is_set_as_a_config_file_would_set_it,
+		      "a key set on its own takes the value a file would give");
+	REGISTER_DESC(an_unknown_key_or_a_bad_value_is_refused,
+		      "an unknown key, or a value a key cannot take, is refused");
+	REGISTER_DESC(interfaces_are_kept_as_listed,
+		      "interfaces are kept as listed, devices by name");
+	REGISTER_DESC(a_list_in_a_config_file_is_read_whole,
+		      "a list in a config file is read to the end of its line");
+
 	RUN_ALL();
 	return DONE();
 }
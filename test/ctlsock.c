@@ -0,0 +1,315 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/ctlsock.c — the sockets --daemon and --control are told what to do
+ * over
+ *
+ * A command comes out whole however the reads split it, with a \r before
+ * its \n taken off and blank lines left out; a line too long to be any
+ * command ends the connection with a word as to why, one that just fits
+ * does not; a socket something still listens on is left to it, one left
+ * behind by a process that died is taken over, and anything there that is
+ * not a socket is left alone; nobody but the user can connect; and a
+ * connection taken on it is read without waiting, and not handed down to
+ * programs run.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "harness.h"
+
+#include "axel.h"
+#include "ctlsock.h"
+
+/* What the commands read so far were, one after the other */
+static char seen[4096];
+static int commands;
+
+static
+void
+command(void *arg, int fd, char *line)
+{
+	(void)arg;
+	(void)fd;
+	strlcat(seen, line, sizeof(seen));
+	strlcat(seen, "|", sizeof(seen));
+	commands++;
+}
+
+/* A connection to read from, and the end to write to it from */
+static
+int
+pair(ctlsock_t *c, int *peer)
+{
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+		return -1;
+	memset(c, 0, sizeof(*c));
+	c->fd = fds[0];
+	*peer = fds[1];
+	*seen = '\0';
+	commands = 0;
+	return 0;
+}
+
+static
+int
+feed(ctlsock_t *c, int peer, const char *s)
+{
+	if (write(peer, s, strlen(s)) != (ssize_t)strlen(s))
+		return -1;
+	return ctlsock_read(c, command, NULL);
+}
+
+static char dir[] = "/tmp/axel-ctlsock-XXXXXX";
+
+/* A path in a directory of the tests' own */
+static
+const char *
+path(const char *name)
+{
+	static char buf[sizeof(dir) + 32];
+
+	if (dir[strlen(dir) - 1] == 'X' && !mkdtemp(dir))
+		abort();
+	snprintf(buf, sizeof(buf), "%s/%s", dir, name);
+	return buf;
+}
+
+/* Whether something answers on the socket at p */
+static
+int
+answers(const char *p)
+{
+	struct sockaddr_un sa = { .sun_family = AF_UNIX };
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0), ret;
+
+	strlcpy(sa.sun_path, p, sizeof(sa.sun_path));
+	ret = fd != -1 && !connect(fd, (struct sockaddr *)&sa, sizeof(sa));
+	if (fd != -1)
+		close(fd);
+	return ret;
+}
+
+TEST(a_line_split_across_reads_comes_out_whole)
+{
+	ctlsock_t c;
+	int peer = -1;
+
+	ASSERT_OK(pair(&c, &peer));
+	CHECK_EQ(feed(&c, peer, "conn"), 1);
+	CHECK_EQ(commands, 0);
+	CHECK_EQ(feed(&c, peer, "ections 4\nspe"), 1);
+	CHECK_STR(seen, "connections 4|");
+	CHECK_EQ(feed(&c, peer, "ed 0\nstats\n"), 1);
+	CHECK_STR(seen, "connections 4|speed 0|stats|");
+	CHECK_EQ(c.len, 0);
+	close(peer);
+	close(c.fd);
+}
+
+TEST(crlf_is_taken_off_and_blank_lines_left_out)
+{
+	ctlsock_t c;
+	int peer = -1;
+
+	ASSERT_OK(pair(&c, &peer));
+	CHECK_EQ(feed(&c, peer, "stats\r\n\r\n\nspeed 10\r"), 1);
+	CHECK_EQ(feed(&c, peer, "\n"), 1);
+	CHECK_STR(seen, "stats|speed 10|");
+	CHECK_EQ(commands, 2);
+	close(peer);
+	close(c.fd);
+}
+
+TEST(a_line_too_long_ends_the_connection)
+{
+	char line[sizeof(((ctlsock_t *) 0)->line) + 1], reply[64];
+	ctlsock_t c;
+	int peer = -1, ret = 1;
+	ssize_t n;
+
+	ASSERT_OK(pair(&c, &peer));
+	memset(line, 'x', sizeof(line) - 1);
+	line[sizeof(line) - 1] = '\0';
+	ASSERT_EQ(write(peer, line, strlen(line)), (ssize_t)strlen(line));
+	for (int i = 0; ret && i < 8; i++)
+		ret = ctlsock_read(&c, command, NULL);
+	CHECK_EQ(ret, 0);
+	CHECK_EQ(commands, 0);
+
+	n = recv(peer, reply, sizeof(reply) - 1, MSG_DONTWAIT);
+	ASSERT_GT(n, 0);
+	reply[n] = '\0';
+	CHECK_STR(reply, "error line too long\n");
+	close(peer);
+	close(c.fd);
+}
+
+TEST(a_line_that_just_fits_is_taken)
+{
+	char line[sizeof(((ctlsock_t *) 0)->line) + 1];
+	ctlsock_t c;
+	int peer = -1;
+
+	ASSERT_OK(pair(&c, &peer));
+	memset(line, 'x', sizeof(line) - 2);
+	line[sizeof(line) - 2] = '\n';
+	line[sizeof(line) - 1] = '\0';
+	CHECK_EQ(feed(&c, peer, line), 1);
+	CHECK_EQ(commands, 1);
+	CHECK_EQ(strlen(seen), sizeof(line) - 1);
+	close(peer);
+	close(c.fd);
+}
+
+TEST(the_other_end_going_ends_the_connection)
+{
+	ctlsock_t c;
+	int peer = -1;
+
+	ASSERT_OK(pair(&c, &peer));
+	ASSERT_EQ(write(peer, "stats\nspe", 9), 9);
+	close(peer);
+	CHECK_EQ(ctlsock_read(&c, command, NULL), 1);
+	CHECK_EQ(ctlsock_read(&c, command, NULL), 0);
+	CHECK_STR(seen, "stats|");
+	close(c.fd);
+}
+
+TEST(only_the_user_can_connect)
+{
+	const char *p = path("private");
+	struct stat st;
+	int fd = ctlsock_listen(p, 1);
+
+	ASSERT_NE(fd, -1);
+	ASSERT_OK(lstat(p, &st));
+	CHECK(S_ISSOCK(st.st_mode));
+	CHECK_EQ(st.st_mode & 077, 0);
+	CHECK(answers(p));
+	close(fd);
+	unlink(p);
+}
+
+TEST(a_connection_taken_waits_on_nothing)
+{
+	const char *p = path("accept");
+	struct sockaddr_un sa = { .sun_family = AF_UNIX };
+	ctlsock_t c = { .fd = -1 };
+	int fd = ctlsock_listen(p, 1), peer;
+
+	ASSERT_NE(fd, -1);
+	CHECK(fcntl(fd, F_GETFD) & FD_CLOEXEC);
+
+	strlcpy(sa.sun_path, p, sizeof(sa.sun_path));
+	peer = socket(AF_UNIX, SOCK_STREAM, 0);
+	ASSERT_OK(connect(peer, (struct sockaddr *)&sa, sizeof(sa)));
+	c.fd = ctlsock_accept(fd);
+	ASSERT_NE(c.fd, -1);
+	CHECK(fcntl(c.fd, F_GETFD) & FD_CLOEXEC);
+	CHECK(fcntl(c.fd, F_GETFL) & O_NONBLOCK);
+
+	/* Nothing sent yet, and still there */
+	*seen = '\0';
+	CHECK_EQ(ctlsock_read(&c, command, NULL), 1);
+	CHECK_EQ(feed(&c, peer, "stats\n"), 1);
+	CHECK_STR(seen, "stats|");
+	close(peer);
+	close(c.fd);
+	close(fd);
+	unlink(p);
+}
+
+TEST(a_live_listener_is_left_to_it)
+{
+	const char *p = path("live");
+	int fd = ctlsock_listen(p, 1);
+
+	ASSERT_NE(fd, -1);
+	errno = 0;
+	CHECK_EQ(ctlsock_listen(p, 1), -1);
+	CHECK_EQ(errno, EADDRINUSE);
+
+	/* Still there, and still answering */
+	CHECK(answers(p));
+	close(fd);
+	unlink(p);
+}
+
+TEST(a_socket_left_behind_is_taken_over)
+{
+	const char *p = path("stale");
+	int fd = ctlsock_listen(p, 1);
+
+	/* As a process that died would leave it */
+	ASSERT_NE(fd, -1);
+	close(fd);
+	CHECK(!answers(p));
+
+	fd = ctlsock_listen(p, 1);
+	CHECK_NE(fd, -1);
+	CHECK(answers(p));
+	if (fd != -1)
+		close(fd);
+	unlink(p);
+}
+
+TEST(a_file_that_is_no_socket_is_left_alone)
+{
+	const char *p = path("file");
+	struct stat st;
+	FILE *f = fopen(p, "w");
+
+	ASSERT_NOTNULL(f);
+	fputs("not a socket\n", f);
+	fclose(f);
+
+	CHECK_EQ(ctlsock_listen(p, 1), -1);
+	ASSERT_OK(lstat(p, &st));
+	CHECK(S_ISREG(st.st_mode));
+	CHECK_EQ(st.st_size, 13);
+	unlink(p);
+}
+
+int
+main(void)
+{
+	int ret;
+
+	REGISTER_DESC(a_line_split_across_reads_comes_out_whole,
+		      "a command split across reads comes out whole");
+	REGISTER_DESC(crlf_is_taken_off_and_blank_lines_left_out,
+		      "a \\r before the \\n is taken off, blank lines left out");
+	REGISTER_DESC(a_line_too_long_ends_the_connection,
+		      "a line too long ends the connection, saying why");
+	REGISTER_DESC(a_line_that_just_fits_is_taken,
+		      "a line that just fits is taken");
+	REGISTER_DESC(the_other_end_going_ends_the_connection,
+		      "the other end going ends the connection, after its lines");
+	REGISTER_DESC(only_the_user_can_connect,
+		      "the socket is for nobody but the user to connect to");
+	REGISTER_DESC(a_connection_taken_waits_on_nothing,
+		      "a connection taken is read without waiting, and not inherited");
+	REGISTER_DESC(a_live_listener_is_left_to_it,
+		      "a socket something listens on is left to it");
+	REGISTER_DESC(a_socket_left_behind_is_taken_over,
+		      "a socket left behind by a process that died is taken over");
+	REGISTER_DESC(a_file_that_is_no_socket_is_left_alone,
+		      "a file there that is not a socket is left alone");
+
+	RUN_ALL();
+	ret = DONE();
+	rmdir(dir);
+	return ret;
+}
@@ -0,0 +1,183 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/digest.c — checking a download against a checksum as it is written
+ *
+ * A checksum is read from the command line as ALGO:HEX, or from the digest
+ * headers a server sends; and a file written in any order, or partly there
+ * before the hash started, hashes the same as one written from start to
+ * end, whether it matches or not.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "harness.h"
+
+#include "ranges.h"
+#include "digest.h"
+
+/* sha256("abc"), in base64 */
+static const char abc_b64[] = "ungWv48Bz+pBQUDeXa4iI7ADYaOWF3qctBD/YfIAFa0=";
+
+TEST(specs_are_read_as_algo_and_hex)
+{
+	digest_spec_t spec;
+
+	CHECK_OK(digest_spec_parse(&spec, "SHA-256:BA7816BF8F01CFEA414140DE"
+				   "5DAE2223B00361A396177A9CB410FF61F20015AD"));
+	CHECK_EQ(strcmp(spec.algo, "sha256"), 0);
+	CHECK_EQ(spec.len, 32);
+	CHECK_EQ(spec.want[0], 0xba);
+	CHECK_EQ(spec.want[31], 0xad);
+
+	CHECK_OK(digest_spec_parse(&spec,
+				   "md5:d41d8cd98f00b204e9800998ecf8427e"));
+	CHECK_EQ(strcmp(spec.algo, "md5"), 0);
+	CHECK_EQ(spec.len, 16);
+
+	CHECK_EQ(digest_spec_parse(&spec, "sha256"), -1);
+	CHECK_EQ(digest_spec_parse(&spec, ":abcd"), -1);
+	CHECK_EQ(digest_spec_parse(&spec, "sha256:"), -1);
+	CHECK_EQ(digest_spec_parse(&spec, "sha256:abc"), -1);
+	CHECK_EQ(digest_spec_parse(&spec, "sha256:zz"), -1);
+}
+
+TEST(servers_digests_are_read_from_either_header)
+{
+	digest_spec_t spec;
+	char header[256];
+
+	snprintf(header, sizeof(header), "sha-256=:%s:", abc_b64);
+	ASSERT_EQ(digest_spec_header(&spec, header, 1), 1);
+	CHECK_EQ(strcmp(spec.algo, "sha256"), 0);
+	ASSERT_EQ(spec.len, 32);
+	CHECK_EQ(spec.want[0], 0xba);
+	CHECK_EQ(spec.want[31], 0xad);
+
+	/* The older header has no colons, and may offer MD5 first */
+	snprintf(header, sizeof(header), "MD5=kAFQmDzST7DWlj99KOF/cg==, "
+		 "SHA-256=%s", abc_b64);
+	ASSERT_EQ(digest_spec_header(&spec, header, 0), 1);
+	CHECK_EQ(strcmp(spec.algo, "sha256"), 0);
+
+	/* Nothing usable */
+	CHECK_EQ(digest_spec_header(&spec, "md5=:kAFQmDzST7DWlj99KOF/cg==:",
+				    1), 0);
+	snprintf(header, sizeof(header), "sha-256=%s", abc_b64);
+	CHECK_EQ(digest_spec_header(&spec, header, 1), 0);
+	CHECK_EQ(digest_spec_header(&spec, "sha-256=:abc:", 1), 0);
+	CHECK_EQ(spec.len, 0);
+}
+
+#ifdef HAVE_SSL
+
+#define SIZE (3 << 20)
+
+/* A file of SIZE bytes of a pattern, and a SHA-256 spec for it, found by
+   hashing it in order */
+static char path[] = "/tmp/axel-digest-XXXXXX";
+static char *data;
+
+static
+void
+make_file(void)
+{
+	int fd = mkstemp(path);
+
+	data = malloc(SIZE);
+	for (size_t i = 0; i < SIZE; i++)
+		data[i] = i * 2654435761u >> 24;
+	if (write(fd, data, SIZE) != SIZE)
+		abort();
+	close(fd);
+}
+
+static
+int
+hash_file(const digest_spec_t *spec, const ranges_t *done,
+	  const off_t (*writes)[2], int n, char *hex)
+{
+	digest_t *d = digest_new(spec, path, SIZE);
+	int ret;
+
+	if (!d)
+		return -2;
+	if (digest_start(d, done) == -1) {
+		digest_free(d);
+		return -2;
+	}
+	for (int i = 0; i < n; i++)
+		digest_written(d, data + writes[i][0], writes[i][0],
+			       writes[i][1] - writes[i][0]);
+	ret = digest_result(d, hex, 2 * DIGEST_MAX + 1);
+	digest_free(d);
+	return ret;
+}
+
+TEST(any_order_hashes_the_same)
+{
+	static const off_t in_order[][2] = {
+		{ 0, SIZE / 3 }, { SIZE / 3, SIZE },
+	};
+	static const off_t shuffled[][2] = {
+		{ 2 * SIZE / 3, SIZE }, { SIZE / 3, 2 * SIZE / 3 },
+		{ 0, SIZE / 3 },
+	};
+	static const off_t resumed[][2] = {
+		{ 2 * SIZE / 3, SIZE }, { 0, SIZE / 3 },
+	};
+	digest_spec_t spec;
+	ranges_t done;
+	char hex[2 * DIGEST_MAX + 1], again[2 * DIGEST_MAX + 1];
+
+	make_file();
+	ranges_init(&done);
+	snprintf(again, sizeof(again), "sha256:%064d", 0);
+	ASSERT_OK(digest_spec_parse(&spec, again));
+
+	/* A wrong checksum of the right length, for what it hashes to */
+	ASSERT_EQ(hash_file(&spec, &done, in_order, 2, hex), 0);
+	CHECK_EQ(strlen(hex), 64);
+	snprintf(again, sizeof(again), "sha256:%s", hex);
+	ASSERT_OK(digest_spec_parse(&spec, again));
+
+	CHECK_EQ(hash_file(&spec, &done, in_order, 2, again), 1);
+	CHECK_EQ(hash_file(&spec, &done, shuffled, 3, again), 1);
+	CHECK_EQ(strcmp(hex, again), 0);
+
+	/* Some of it there already, from a run before; and then what if some
+	   of the rest never comes */
+	CHECK_OK(ranges_add(&done, SIZE / 3, 2 * SIZE / 3));
+	CHECK_EQ(hash_file(&spec, &done, resumed, 2, again), 1);
+	CHECK_EQ(hash_file(&spec, &done, resumed, 1, again), -1);
+	ranges_free(&done);
+
+	unlink(path);
+	free(data);
+}
+
+#endif				/* HAVE_SSL */
+
+int
+main(void)
+{
+	REGISTER_DESC(specs_are_read_as_algo_and_hex,
+		      "--checksum takes ALGO:HEX, and nothing else");
+	REGISTER_DESC(servers_digests_are_read_from_either_header,
+		      "Repr-Digest and Digest give the strongest digest offered");
+#ifdef HAVE_SSL
+	REGISTER_DESC(any_order_hashes_the_same,
+		      "a file written in any order, or resumed, hashes the same");
+#endif				/* HAVE_SSL */
+
+	RUN_ALL();
+	return DONE();
+}
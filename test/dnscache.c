@@ -0,0 +1,98 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/dnscache.c — what host names resolved to, kept for a while
+ *
+ * Each lookup hands back a list of its own, whether it came from the
+ * resolver or from the cache, so that freeing one leaves the others and the
+ * cache alone; the port and the hints are as much a part of the question as
+ * the host; and a lookup that fails is asked again next time.  Numeric
+ * hosts keep it all off the network.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "harness.h"
+
+#include "dnscache.h"
+
+static
+struct addrinfo
+numeric(void)
+{
+	struct addrinfo hints;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_NUMERICHOST;
+	return hints;
+}
+
+static
+int
+port_of(const struct addrinfo *ai)
+{
+	return ntohs(((const struct sockaddr_in *)ai->ai_addr)->sin_port);
+}
+
+TEST(each_answer_is_a_list_of_its_own)
+{
+	struct addrinfo hints = numeric(), *a, *b;
+
+	ASSERT_OK(dnscache_lookup("127.0.0.1", "80", &hints, &a));
+	ASSERT_OK(dnscache_lookup("127.0.0.1", "80", &hints, &b));
+	ASSERT_NOTNULL(a);
+	ASSERT_NOTNULL(b);
+	CHECK(a != b);
+	CHECK(a->ai_addr != b->ai_addr);
+	CHECK_EQ(a->ai_addrlen, b->ai_addrlen);
+	CHECK(!memcmp(a->ai_addr, b->ai_addr, a->ai_addrlen));
+
+	/* Freeing one leaves the other, and the cache, as they were */
+	dnscache_free(a);
+	CHECK_EQ(port_of(b), 80);
+	dnscache_free(b);
+	ASSERT_OK(dnscache_lookup("127.0.0.1", "80", &hints, &a));
+	CHECK_EQ(port_of(a), 80);
+	dnscache_free(a);
+}
+
+TEST(the_port_is_part_of_the_question)
+{
+	struct addrinfo hints = numeric(), *a, *b;
+
+	ASSERT_OK(dnscache_lookup("127.0.0.1", "8080", &hints, &a));
+	ASSERT_OK(dnscache_lookup("127.0.0.1", "8081", &hints, &b));
+	CHECK_EQ(port_of(a), 8080);
+	CHECK_EQ(port_of(b), 8081);
+	dnscache_free(a);
+	dnscache_free(b);
+}
+
+TEST(failures_are_asked_again)
+{
+	struct addrinfo hints = numeric(), *a = NULL;
+
+	CHECK_NE(dnscache_lookup("999.0.0.1", "80", &hints, &a), 0);
+	CHECK_NE(dnscache_lookup("999.0.0.1", "80", &hints, &a), 0);
+	CHECK_NULL(a);
+}
+
+int
+main(void)
+{
+	REGISTER_DESC(each_answer_is_a_list_of_its_own,
+		      "every lookup gets a list of its own, cached or not");
+	REGISTER_DESC(the_port_is_part_of_the_question,
+		      "the same host on another port is another answer");
+	REGISTER_DESC(failures_are_asked_again,
+		      "a failed lookup is not remembered");
+
+	RUN_ALL();
+	return DONE();
+}
@@ -0,0 +1,410 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/file.c — a file system as the source: file:// URLs
+ *
+ * A connection's thread reads its range of the file and nothing past it,
+ * however much longer the file is, or has the kernel copy that range to
+ * the output, never past the connection's last byte even when that is cut
+ * short between copies; an output the kernel cannot copy to is found out
+ * before any connection starts, and is read the usual way instead; a copy
+ * that fails says why; and an output is cloned whole only where the file
+ * system shares blocks, and left untouched otherwise.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "harness.h"
+
+#include "axel.h"
+#include "file.h"
+
+/* src/file.c calls back into src/axel.c and src/conn.c, which would bring
+ * the whole program into the link; these do what the real ones do, as far
+ * as a file:// connection can tell. */
+void
+axel_message(axel_t *axel, const char *format, ...)
+{
+	(void)axel;
+	(void)format;
+}
+
+int
+axel_divide(axel_t *axel)
+{
+	(void)axel;
+	return 1;
+}
+
+void
+conn_disconnect(conn_t *conn)
+{
+	if (conn->tcp && conn->tcp->fd > 0)
+		close(conn->tcp->fd);
+	conn->tcp = NULL;
+}
+
+ssize_t
+tcp_read(tcp_t *tcp, void *buffer, int size)
+{
+	return recv(tcp->fd, buffer, size, MSG_WAITALL);
+}
+
+#define SIZE	(3 * 1024 * 1024 + 123)
+
+static char dir[] = "/tmp/axel-file-XXXXXX";
+static char source[sizeof(dir) + 16];
+
+static
+unsigned char
+byte_at(off_t pos)
+{
+	return pos * 7 + (pos >> 12);
+}
+
+/* The file every test reads from, made once */
+static
+int
+make_source(void)
+{
+	static unsigned char data[SIZE];
+	int fd;
+
+	if (*source)
+		return 0;
+	if (!mkdtemp(dir))
+		return -1;
+	snprintf(source, sizeof(source), "%s/src", dir);
+	for (off_t i = 0; i < SIZE; i++)
+		data[i] = byte_at(i);
+	fd = open(source, O_CREAT | O_WRONLY | O_TRUNC, 0600);
+	if (fd == -1)
+		return -1;
+	if (write(fd, data, SIZE) != SIZE) {
+		close(fd);
+		return -1;
+	}
+	return close(fd);
+}
+
+/* A download of the file through one connection, writing to a new file
+ * opened with flags */
+static
+axel_t *
+download(int flags)
+{
+	axel_t *axel = calloc(1, sizeof(*axel));
+	char path[sizeof(dir) + 16];
+
+	if (!axel || make_source() == -1)
+		abort();
+	axel->conf = calloc(1, sizeof(conf_t));
+	axel->conn = calloc(1, sizeof(conn_t));
+	axel->url = calloc(1, sizeof(url_t));
+	if (!axel->conf || !axel->conn || !axel->url)
+		abort();
+	axel->url->next = axel->url;
+
+	snprintf(path, sizeof(path), "%s/out", dir);
+	unlink(path);
+	axel->outfd = open(path, O_CREAT | flags, 0600);
+	if (axel->outfd == -1)
+		abort();
+	axel->conn->proto = PROTO_FILE;
+	if (!file_set(axel->conn, source) || !file_open(axel->conn))
+		abort();
+	axel->size = axel->conn->size;
+	axel->conn->lastbyte = axel->size;
+	return axel;
+}
+
+static
+void
+done(axel_t *axel)
+{
+	conn_disconnect(axel->conn);
+	close(axel->outfd);
+	ranges_free(&axel->done);
+	free(axel->url);
+	free(axel->conn);
+	free(axel->conf);
+	free(axel);
+}
+
+/* Whether the output holds the source's bytes from start to end */
+static
+int
+output_matches(axel_t *axel, off_t start, off_t end)
+{
+	unsigned char buf[4096];
+
+	for (off_t pos = start; pos < end;) {
+		ssize_t n = pread(axel->outfd, buf,
+				  min(end - pos, (off_t)sizeof(buf)), pos);
+
+		if (n <= 0)
+			return 0;
+		for (ssize_t i = 0; i < n; i++)
+			if (buf[i] != byte_at(pos + i))
+				return 0;
+		pos += n;
+	}
+	return 1;
+}
+
+static
+off_t
+output_size(axel_t *axel)
+{
+	struct stat st;
+
+	return fstat(axel->outfd, &st) == -1 ? -1 : st.st_size;
+}
+
+TEST(only_absolute_local_paths_are_taken)
+{
+	conn_t conn = { 0 };
+
+	CHECK(file_set(&conn, "/srv/data/file.iso"));
+	CHECK_STR(conn.dir, "/srv/data/");
+	CHECK_STR(conn.file, "file.iso");
+	CHECK_STR(conn.host, "localhost");
+
+	CHECK(file_set(&conn, "localhost/srv/other.iso"));
+	CHECK_STR(conn.dir, "/srv/");
+	CHECK_STR(conn.file, "other.iso");
+
+	CHECK(!file_set(&conn, "example.com/srv/file.iso"));
+	CHECK(!file_set(&conn, "relative/file.iso"));
+}
+
+TEST(the_size_is_the_files_and_a_directory_is_refused)
+{
+	axel_t *axel = download(O_WRONLY);
+	conn_t conn = { 0 };
+
+	CHECK_EQ(axel->size, SIZE);
+	CHECK(axel->conn->supported);
+
+	ASSERT(file_set(&conn, "/tmp/"));
+	CHECK(!file_open(&conn));
+	CHECK_STR(conn.message, strerror(EISDIR));
+	done(axel);
+}
+
+TEST(a_thread_reads_its_range_and_nothing_past_it)
+{
+	axel_t *axel = download(O_WRONLY);
+	conn_t *conn = axel->conn;
+	static unsigned char buf[SIZE];
+	off_t got = 0;
+	ssize_t n;
+	int ok = 1;
+
+	conn->currentbyte = 1000;
+	conn->lastbyte = 1000 + 500 * 1024 + 17;
+	ASSERT(file_setup(conn));
+	while ((n = read(conn->tcp->fd, buf + got, sizeof(buf) - got)) > 0)
+		got += n;
+	CHECK_EQ(n, 0);
+	CHECK_EQ(got, conn->lastbyte - conn->currentbyte);
+	for (off_t i = 0; i < got; i++)
+		ok &= buf[i] == byte_at(conn->currentbyte + i);
+	CHECK(ok);
+	done(axel);
+}
+
+TEST(a_range_past_the_end_stops_at_the_end)
+{
+	axel_t *axel = download(O_WRONLY);
+	conn_t *conn = axel->conn;
+	static unsigned char buf[SIZE];
+	off_t got = 0;
+	ssize_t n;
+
+	conn->currentbyte = SIZE - 4096;
+	conn->lastbyte = SIZE + 1024 * 1024;
+	ASSERT(file_setup(conn));
+	while ((n = read(conn->tcp->fd, buf + got, sizeof(buf) - got)) > 0)
+		got += n;
+	CHECK_EQ(got, 4096);
+	done(axel);
+}
+
+#ifdef HAVE_COPY_FILE_RANGE
+/* Take copies as axel_do() would, until the thread says it is done */
+static
+off_t
+take_copies(axel_t *axel)
+{
+	conn_t *conn = axel->conn;
+	off_t size;
+
+	while (file_copy(axel, 0, 0, &size) && size > 0)
+		conn->currentbyte += size;
+	return size;
+}
+
+TEST(the_kernel_copies_the_range_to_the_output)
+{
+	axel_t *axel = download(O_RDWR);
+	conn_t *conn = axel->conn;
+
+	conn->copy_to = file_copy_to(axel, 0);
+	if (!conn->copy_to) {
+		/* Not here: the probe says so once, for every connection */
+		CHECK_EQ(axel->copy_range, -1);
+		done(axel);
+		return;
+	}
+	CHECK_EQ(axel->copy_range, 1);
+	CHECK_EQ(conn->copy_ahead, 128 * 1024);
+
+	conn->currentbyte = 4096;
+	ASSERT(file_setup(conn));
+	CHECK_EQ(take_copies(axel), 0);
+	CHECK_EQ(conn->currentbyte, SIZE);
+	CHECK(output_matches(axel, 4096, SIZE));
+	done(axel);
+}
+
+TEST(a_copy_never_runs_past_a_last_byte_cut_short)
+{
+	axel_t *axel = download(O_RDWR);
+	conn_t *conn = axel->conn;
+	off_t cut;
+
+	conn->copy_to = file_copy_to(axel, 0);
+	if (!conn->copy_to) {
+		done(axel);
+		return;
+	}
+	ASSERT(file_setup(conn));
+
+	/* Taken over by another connection once the thread is going, past
+	   the copy it makes unasked, as axel_reactivate() would */
+	cut = conn->currentbyte + conn->copy_ahead + 5000;
+	conn->lastbyte = cut;
+	CHECK_EQ(take_copies(axel), 0);
+	CHECK_EQ(conn->currentbyte, cut);
+	CHECK_EQ(output_size(axel), cut);
+	CHECK(output_matches(axel, 0, cut));
+	done(axel);
+}
+
+TEST(an_output_the_kernel_cannot_copy_to_is_read_instead)
+{
+	/* copy_file_range() refuses an output opened to append */
+	axel_t *axel = download(O_WRONLY | O_APPEND);
+	conn_t *conn = axel->conn;
+	off_t size;
+
+	conn->copy_to = file_copy_to(axel, 0);
+	CHECK_EQ(conn->copy_to, 0);
+	CHECK_EQ(conn->copy_ahead, 0);
+	CHECK_EQ(axel->copy_range, -1);
+	CHECK_EQ(output_size(axel), 0);
+
+	/* And is not tried again */
+	CHECK_EQ(file_copy_to(axel, 0), 0);
+
+	ASSERT(file_setup(conn));
+	CHECK_EQ(file_copy(axel, 0, 0, &size), 0);
+	done(axel);
+}
+
+TEST(a_copy_that_fails_says_why)
+{
+	axel_t *axel = download(O_RDONLY);
+	conn_t *conn = axel->conn;
+	off_t size = 0;
+
+	/* As if the probe had said yes, and the output had changed since */
+	axel->copy_range = 1;
+	conn->copy_to = file_copy_to(axel, 0);
+	ASSERT_EQ(conn->copy_to, axel->outfd);
+	ASSERT(file_setup(conn));
+	errno = 0;
+	CHECK_EQ(file_copy(axel, 0, 0, &size), 1);
+	CHECK_EQ(size, -1);
+	CHECK_EQ(errno, EBADF);
+	done(axel);
+}
+#endif				/* HAVE_COPY_FILE_RANGE */
+
+TEST(an_output_is_cloned_whole_or_left_untouched)
+{
+	axel_t *axel = download(O_RDWR);
+
+	if (file_clone(axel)) {
+		CHECK_EQ(axel->done.count, 1);
+		CHECK_EQ(axel->bytes_done, SIZE);
+		CHECK_EQ(output_size(axel), SIZE);
+		CHECK(output_matches(axel, 0, SIZE));
+	} else {
+		CHECK_EQ(axel->done.count, 0);
+		CHECK_EQ(axel->bytes_done, 0);
+		CHECK_EQ(output_size(axel), 0);
+	}
+	done(axel);
+}
+
+TEST(nothing_is_cloned_over_what_is_already_there)
+{
+	axel_t *axel = download(O_RDWR);
+
+	ASSERT_OK(ranges_add(&axel->done, 0, 4096));
+	CHECK_EQ(file_clone(axel), 0);
+	CHECK_EQ(axel->done.count, 1);
+	CHECK_EQ(output_size(axel), 0);
+	done(axel);
+}
+
+int
+main(void)
+{
+	int ret;
+
+	REGISTER_DESC(only_absolute_local_paths_are_taken,
+		      "file:// takes an absolute path, on no host but this one");
+	REGISTER_DESC(the_size_is_the_files_and_a_directory_is_refused,
+		      "the size is the file's, and a directory is refused");
+	REGISTER_DESC(a_thread_reads_its_range_and_nothing_past_it,
+		      "a connection's thread reads its range and nothing past it");
+	REGISTER_DESC(a_range_past_the_end_stops_at_the_end,
+		      "a range past the end of the file stops at its end");
+#ifdef HAVE_COPY_FILE_RANGE
+	REGISTER_DESC(the_kernel_copies_the_range_to_the_output,
+		      "the kernel copies a connection's range to the output");
+	REGISTER_DESC(a_copy_never_runs_past_a_last_byte_cut_short,
+		      "a copy stops at a last byte cut short between copies");
+	REGISTER_DESC(an_output_the_kernel_cannot_copy_to_is_read_instead,
+		      "an output the kernel cannot copy to is read the usual way");
+	REGISTER_DESC(a_copy_that_fails_says_why,
+		      "a copy that fails says why");
+#endif
+	REGISTER_DESC(an_output_is_cloned_whole_or_left_untouched,
+		      "an output is cloned whole where it can be, untouched where not");
+	REGISTER_DESC(nothing_is_cloned_over_what_is_already_there,
+		      "nothing is cloned over what a download already has");
+
+	RUN_ALL();
+	ret = DONE();
+
+	if (*source) {
+		char path[sizeof(dir) + 16];
+
+		unlink(source);
+		snprintf(path, sizeof(path), "%s/out", dir);
+		unlink(path);
+		rmdir(dir);
+	}
+	return ret;
+}
@@ -0,0 +1,175 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/iface.c — sharing connections out between interfaces
+ *
+ * Every interface is tried once; until there is a throughput to go by,
+ * connections are spread as the list weighs the interfaces, and after that
+ * each goes where it would get the most, which moves them off a link once
+ * it is full.  Throughput is taken once a second and smoothed, and an
+ * interface left without connections keeps what it last did.  Work stolen
+ * from a connection is split so that both would finish together.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "harness.h"
+
+#include "axel.h"
+
+static char eth0[] = "eth0", eth1[] = "eth1", eth0_again[] = "eth0";
+
+static
+void
+two(ifaces_t *ifs)
+{
+	memset(ifs, 0, sizeof(*ifs));
+	ifaces_add(ifs, eth0);
+	ifaces_add(ifs, eth1);
+}
+
+TEST(listed_twice_weighs_twice)
+{
+	ifaces_t ifs;
+
+	two(&ifs);
+	ASSERT_OK(ifaces_add(&ifs, eth0_again));
+	ASSERT_EQ(ifs.count, 2);
+	CHECK_EQ(ifs.i[0].weight, 2);
+	CHECK_EQ(ifs.i[1].weight, 1);
+	ifaces_free(&ifs);
+	CHECK_EQ(ifaces_pick(&ifs), -1);
+}
+
+TEST(untried_first_then_by_weight)
+{
+	ifaces_t ifs;
+
+	two(&ifs);
+	ifaces_add(&ifs, eth0_again);
+	CHECK_EQ(ifaces_pick(&ifs), 0);
+	ifs.i[0].used = true;
+	ifs.i[0].conns = 3;
+	CHECK_EQ(ifaces_pick(&ifs), 1);
+
+	/* Two to one, before anything has been measured */
+	ifs.i[1].used = true;
+	ifs.i[1].conns = 1;
+	ifs.i[0].conns = 1;
+	CHECK_EQ(ifaces_pick(&ifs), 0);
+	ifs.i[0].conns = 2;
+	CHECK_EQ(ifaces_pick(&ifs), 0);
+	ifs.i[0].conns = 3;
+	CHECK_EQ(ifaces_pick(&ifs), 1);
+	ifaces_free(&ifs);
+}
+
+TEST(connections_go_where_there_is_headroom)
+{
+	ifaces_t ifs;
+
+	two(&ifs);
+	ifs.i[0].used = ifs.i[1].used = true;
+	ifs.i[0].rate = 100;
+	ifs.i[0].conns = 4;
+	ifs.i[1].rate = 30;
+	ifs.i[1].conns = 1;
+	CHECK_EQ(ifaces_pick(&ifs), 0);
+	ifs.i[0].conns = 5;
+	CHECK_EQ(ifaces_pick(&ifs), 0);
+
+	/* A full link stops paying for more connections */
+	ifs.i[0].conns = 6;
+	CHECK_EQ(ifaces_pick(&ifs), 1);
+
+	/* What a dead one never did counts for nothing */
+	ifs.i[1].rate = 0;
+	ifs.i[1].conns = 0;
+	CHECK_EQ(ifaces_pick(&ifs), 0);
+	ifaces_free(&ifs);
+}
+
+TEST(throughput_is_sampled_and_smoothed)
+{
+	ifaces_t ifs;
+
+	two(&ifs);
+	ifs.i[0].conns = 1;
+	CHECK_EQ(ifaces_count(&ifs, 0, 1000, 10.0), 0);
+	CHECK_EQ(ifaces_count(&ifs, 0, 1000, 10.5), 0);
+	ASSERT_EQ(ifaces_count(&ifs, -1, 0, 11.0), 1);
+	CHECK_FLOAT_EQ(ifs.i[0].rate, 2000);
+	CHECK_FLOAT_EQ(ifs.i[1].rate, 0);
+
+	/* A quiet second halves it; one with no connections keeps its own */
+	ifs.i[1].rate = 500;
+	ASSERT_EQ(ifaces_count(&ifs, 0, 0, 12.0), 1);
+	CHECK_FLOAT_EQ(ifs.i[0].rate, 1000);
+	CHECK_FLOAT_EQ(ifs.i[1].rate, 500);
+	CHECK_FLOAT_EQ(ifaces_conn_rate(&ifs, 0), 1000);
+	CHECK_FLOAT_EQ(ifaces_conn_rate(&ifs, 5), 0);
+	ifaces_free(&ifs);
+}
+
+TEST(stolen_work_is_split_by_speed)
+{
+	conf_t conf = { .num_connections = 3 };
+	conn_t conn[3];
+	axel_t axel;
+
+	memset(&axel, 0, sizeof(axel));
+	memset(conn, 0, sizeof(conn));
+	axel.conf = &conf;
+	axel.conn = conn;
+	two(&axel.ifaces);
+	conn[0].iface = 0;
+	conn[1].iface = 1;
+	conn[2].iface = -1;
+
+	/* Nothing measured: bytes, and halves */
+	CHECK_FLOAT_EQ(iface_time_left(&axel, 0, 1000), 1000);
+	CHECK_EQ(iface_split(&axel, 0, 1000), 500);
+
+	/* A slow one takes longest, and keeps the least */
+	axel.ifaces.i[0].used = axel.ifaces.i[1].used = true;
+	axel.ifaces.i[0].conns = axel.ifaces.i[1].conns = 1;
+	axel.ifaces.i[0].rate = 10;
+	axel.ifaces.i[1].rate = 100;
+	CHECK_FLOAT_EQ(iface_time_left(&axel, 0, 1000), 100);
+	CHECK_FLOAT_EQ(iface_time_left(&axel, 1, 1000), 10);
+	CHECK_EQ(iface_split(&axel, 0, 1200), 200);
+
+	/* One not yet measured is in seconds too, as fast as the mean */
+	axel.ifaces.i[1].rate = 0;
+	CHECK_FLOAT_EQ(iface_time_left(&axel, 1, 1000), 100);
+	CHECK_FLOAT_EQ(iface_time_left(&axel, 2, 1000), 100);
+	axel.ifaces.i[1].rate = 30;
+	CHECK_FLOAT_EQ(iface_time_left(&axel, 2, 1000), 50);
+	axel.ifaces.i[1].rate = 100;
+
+	/* But never all, nor nothing */
+	axel.ifaces.i[0].rate = 1;
+	CHECK_EQ(iface_split(&axel, 0, 1000), 100);
+	ifaces_free(&axel.ifaces);
+}
+
+int
+main(void)
+{
+	REGISTER_DESC(listed_twice_weighs_twice,
+		      "an interface listed twice is one, weighing twice");
+	REGISTER_DESC(untried_first_then_by_weight,
+		      "untried interfaces go first, then the weights decide");
+	REGISTER_DESC(connections_go_where_there_is_headroom,
+		      "connections go where each would get the most");
+	REGISTER_DESC(throughput_is_sampled_and_smoothed,
+		      "throughput is taken each second, smoothed, kept when idle");
+	REGISTER_DESC(stolen_work_is_split_by_speed,
+		      "stolen work is split for both to finish together");
+
+	RUN_ALL();
+	return DONE();
+}
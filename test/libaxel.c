@@ -0,0 +1,407 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/libaxel.c — the engine as a program of someone else's drives it
+ *
+ * Everything here goes through libaxel.h alone, fetching a file of the
+ * suite's own over file://, which takes the same segmenting, stealing and
+ * writing as a server would without a server to run.  A download is
+ * stepped to its end, from a loop of the caller's or from libaxel_run(),
+ * and what comes out of it -- the data, wherever it was asked to go, the
+ * figures and the messages -- is what the header promises.  Settings and
+ * outputs are only taken before the start, and a sink that fails stops the
+ * download rather than lose data quietly.  Memory, and a memory file, are
+ * filled in whatever order the blocks come, never past what they hold.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+
+#include "harness.h"
+
+#include "libaxel.h"
+
+#define SIZE (3 * 1024 * 1024 + 123)
+
+static char dir[] = "/tmp/axel-libaxel-XXXXXX";
+static char url[sizeof(dir) + 32], path[sizeof(dir) + 16];
+static unsigned char *source;
+
+/* The file the downloads fetch, and a home with no axelrc in it, for the
+ * settings to be the same whoever runs the suite */
+static
+void
+make_source(void)
+{
+	int fd;
+
+	if (!mkdtemp(dir) || setenv("HOME", dir, 1))
+		abort();
+	snprintf(path, sizeof(path), "%s/source", dir);
+	snprintf(url, sizeof(url), "file://%s", path);
+
+	source = malloc(SIZE);
+	if (!source)
+		abort();
+	for (size_t i = 0; i < SIZE; i++)
+		source[i] = (i * 7 + i / 4096) % 251;
+	fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd == -1 || write(fd, source, SIZE) != SIZE || close(fd))
+		abort();
+}
+
+static
+void
+remove_source(void)
+{
+	unlink(path);
+	rmdir(dir);
+	free(source);
+}
+
+/* What a sink was handed, and how */
+struct sunk {
+	unsigned char *data;
+	size_t len;
+	off_t next;		/* where the last run ended */
+	int out_of_order;
+	int fail;		/* the errno to fail with, if any */
+};
+
+static
+int
+into(void *arg, const void *data, size_t len, off_t offset)
+{
+	struct sunk *s = arg;
+
+	if (s->fail)
+		return s->fail;
+	if (offset != s->next)
+		s->out_of_order = 1;
+	s->next = offset + len;
+	if ((size_t)offset > s->len || len > s->len - offset)
+		return EFBIG;
+	memcpy(s->data + offset, data, len);
+	return 0;
+}
+
+static
+libaxel_t *
+download(int connections)
+{
+	libaxel_t *d = libaxel_new(url);
+	char n[16];
+
+	if (!d)
+		return NULL;
+	snprintf(n, sizeof(n), "%d", connections);
+	if (libaxel_set(d, "num_connections", n) == -1 ||
+	    libaxel_set(d, "verbose", "0") == -1) {
+		libaxel_free(d);
+		return NULL;
+	}
+	return d;
+}
+
+TEST(a_download_is_stepped_to_its_end_from_the_callers_loop)
+{
+	struct sunk s = { .len = SIZE };
+	libaxel_t *d = download(4);
+	libaxel_stats_t st;
+	int ret, steps = 0, seen_running = 0;
+
+	ASSERT_NOTNULL(d);
+	s.data = calloc(1, SIZE);
+	ASSERT_NOTNULL(s.data);
+	ASSERT_OK(libaxel_output_sink(d, into, &s, 0));
+	ASSERT_OK(libaxel_start(d));
+
+	do {
+		struct timeval tv = { .tv_sec = 1 };
+		fd_set fds;
+		int maxfd = -1;
+
+		FD_ZERO(&fds);
+		ASSERT_OK(libaxel_fds(d, &fds, &maxfd, &tv));
+		CHECK_LE(tv.tv_sec, 1);
+		select(maxfd + 1, &fds, NULL, NULL, &tv);
+
+		libaxel_stats(d, &st);
+		if (st.status == -1) {
+			seen_running = 1;
+			CHECK_EQ(st.size, SIZE);
+			CHECK_EQ(st.connections, 4);
+			CHECK_LE(st.done, SIZE);
+		}
+		ret = libaxel_step(d);
+	} while (ret == 1 && ++steps < 100000);
+
+	CHECK_EQ(ret, 0);
+	CHECK(seen_running);
+	libaxel_stats(d, &st);
+	CHECK_EQ(st.status, 0);
+	CHECK_EQ(st.done, SIZE);
+	CHECK_EQ(st.active, 0);
+	CHECK(!memcmp(s.data, source, SIZE));
+
+	/* Done is done, however often it is asked */
+	CHECK_EQ(libaxel_step(d), 0);
+	CHECK_EQ(libaxel_fds(d, NULL, NULL, NULL), -1);
+	libaxel_free(d);
+	free(s.data);
+}
+
+TEST(settings_and_outputs_are_only_taken_before_the_start)
+{
+	struct sunk s = { .len = SIZE };
+	libaxel_t *d = download(2);
+
+	ASSERT_NOTNULL(d);
+	s.data = calloc(1, SIZE);
+	ASSERT_NOTNULL(s.data);
+
+	errno = 0;
+	CHECK_EQ(libaxel_set(d, "no_such_key", "1"), -1);
+	CHECK_EQ(errno, EINVAL);
+	CHECK_EQ(libaxel_set(d, "use_protocol", "ipx"), -1);
+	CHECK_OK(libaxel_set(d, "insecure", "1"));
+	CHECK_OK(libaxel_set(d, "max_speed", "0"));
+
+	ASSERT_OK(libaxel_output_sink(d, into, &s, 0));
+	ASSERT_OK(libaxel_start(d));
+	errno = 0;
+	CHECK_EQ(libaxel_set(d, "num_connections", "8"), -1);
+	CHECK_EQ(errno, EBUSY);
+	CHECK_EQ(libaxel_output_file(d, NULL), -1);
+	CHECK_EQ(libaxel_output_sink(d, into, &s, 1), -1);
+	CHECK_EQ(libaxel_start(d), -1);
+	CHECK_EQ(errno, EBUSY);
+
+	CHECK_EQ(libaxel_run(d), 0);
+	CHECK(!memcmp(s.data, source, SIZE));
+
+	/* Nor once it is over */
+	CHECK_EQ(libaxel_set(d, "num_connections", "8"), -1);
+	CHECK_EQ(libaxel_start(d), -1);
+	libaxel_free(d);
+	free(s.data);
+}
+
+TEST(a_sink_that_asks_for_order_gets_it)
+{
+	struct sunk s = { .len = SIZE };
+	libaxel_t *d = download(4);
+
+	ASSERT_NOTNULL(d);
+	s.data = calloc(1, SIZE);
+	ASSERT_NOTNULL(s.data);
+	ASSERT_OK(libaxel_output_sink(d, into, &s, 1));
+	ASSERT_OK(libaxel_start(d));
+	CHECK_EQ(libaxel_run(d), 0);
+
+	CHECK(!s.out_of_order);
+	CHECK_EQ(s.next, SIZE);
+	CHECK(!memcmp(s.data, source, SIZE));
+	libaxel_free(d);
+	free(s.data);
+}
+
+TEST(a_sink_that_fails_stops_the_download)
+{
+	struct sunk s = { .len = SIZE, .fail = EIO };
+	libaxel_t *d = download(2);
+	libaxel_stats_t st;
+
+	ASSERT_NOTNULL(d);
+	ASSERT_OK(libaxel_output_sink(d, into, &s, 0));
+	ASSERT_OK(libaxel_start(d));
+	CHECK_EQ(libaxel_run(d), -1);
+
+	libaxel_stats(d, &st);
+	CHECK_NE(st.status, 0);
+	CHECK_NE(st.status, -1);
+	CHECK_NOTNULL(libaxel_message(d));
+	libaxel_free(d);
+}
+
+TEST(a_file_is_written_whole_and_leaves_no_state_behind)
+{
+	char out[sizeof(dir) + 16], st_name[sizeof(out) + 3];
+	libaxel_t *d = download(3);
+	unsigned char *back = malloc(SIZE);
+	int fd;
+
+	ASSERT_NOTNULL(d);
+	ASSERT_NOTNULL(back);
+	snprintf(out, sizeof(out), "%s/out", dir);
+	snprintf(st_name, sizeof(st_name), "%s.st", out);
+	ASSERT_OK(libaxel_output_file(d, out));
+	ASSERT_OK(libaxel_start(d));
+	CHECK_EQ(libaxel_run(d), 0);
+	libaxel_free(d);
+
+	fd = open(out, O_RDONLY);
+	ASSERT(fd != -1);
+	CHECK_EQ(read(fd, back, SIZE), SIZE);
+	CHECK(!memcmp(back, source, SIZE));
+	CHECK_EQ(access(st_name, F_OK), -1);
+	close(fd);
+	unlink(out);
+	free(back);
+}
+
+TEST(a_download_that_cannot_start_says_why)
+{
+	libaxel_t *d = libaxel_new("file:///nonexistent/axel-libaxel-test");
+	libaxel_stats_t st;
+	const char *msg;
+	int messages = 0;
+
+	ASSERT_NOTNULL(d);
+	CHECK_EQ(libaxel_start(d), -1);
+	libaxel_stats(d, &st);
+	CHECK_EQ(st.status, 2);
+	CHECK_EQ(libaxel_step(d), -1);
+
+	/* Each message once, and then none */
+	while ((msg = libaxel_message(d)) && messages < 100) {
+		CHECK(*msg);
+		messages++;
+	}
+	CHECK_GT(messages, 0);
+	CHECK_NULL(libaxel_message(d));
+	libaxel_free(d);
+}
+
+TEST(memory_is_filled_at_the_offsets_the_connections_read)
+{
+	unsigned char *buf = malloc(SIZE + 16);
+	libaxel_t *d = download(8);
+
+	ASSERT_NOTNULL(d);
+	ASSERT_NOTNULL(buf);
+	/* Small blocks from eight connections come in every order */
+	ASSERT_OK(libaxel_set(d, "buffer_size", "4096"));
+	memset(buf, 0xee, SIZE + 16);
+	ASSERT_OK(libaxel_output_memory(d, buf, SIZE + 16));
+	ASSERT_OK(libaxel_start(d));
+	CHECK_EQ(libaxel_run(d), 0);
+	libaxel_free(d);
+
+	CHECK(!memcmp(buf, source, SIZE));
+	/* Nothing past the end of the download */
+	for (int i = 0; i < 16; i++)
+		CHECK_EQ(buf[SIZE + i], 0xee);
+	free(buf);
+}
+
+TEST(memory_too_small_for_the_download_fails_before_fetching)
+{
+	unsigned char *buf = malloc(SIZE - 1);
+	libaxel_t *d = download(4);
+	libaxel_stats_t st;
+	int bad = -1;
+
+	ASSERT_NOTNULL(d);
+	ASSERT_NOTNULL(buf);
+	memset(buf, 0xee, SIZE - 1);
+	ASSERT_OK(libaxel_output_memory(d, buf, SIZE - 1));
+	CHECK_EQ(libaxel_start(d), -1);
+	libaxel_stats(d, &st);
+	CHECK_NE(st.status, 0);
+	CHECK_NOTNULL(libaxel_message(d));
+	libaxel_free(d);
+
+	for (int i = 0; i < SIZE - 1 && bad == -1; i++)
+		if (buf[i] != 0xee)
+			bad = i;
+	CHECK_EQ(bad, -1);
+	free(buf);
+}
+
+TEST(a_memfd_grows_to_the_download_and_holds_it)
+{
+	unsigned char *back = malloc(SIZE);
+	libaxel_t *d = download(4);
+	struct stat st;
+	int fd;
+
+	ASSERT_NOTNULL(d);
+	ASSERT_NOTNULL(back);
+	fd = libaxel_output_memfd(d);
+	if (fd == -1 && errno == ENOSYS) {
+		/* Nothing to test where there are none */
+		libaxel_free(d);
+		free(back);
+		return;
+	}
+	ASSERT(fd != -1);
+	CHECK_OK(fstat(fd, &st));
+	CHECK_EQ(st.st_size, 0);
+
+	ASSERT_OK(libaxel_start(d));
+	CHECK_OK(fstat(fd, &st));
+	CHECK_EQ(st.st_size, SIZE);
+	CHECK_EQ(libaxel_run(d), 0);
+	libaxel_free(d);
+
+	/* The caller's to read and close, left as the download made it */
+	CHECK_OK(fstat(fd, &st));
+	CHECK_EQ(st.st_size, SIZE);
+	CHECK_EQ(pread(fd, back, SIZE, 0), SIZE);
+	CHECK(!memcmp(back, source, SIZE));
+	close(fd);
+	free(back);
+}
+
+TEST(a_url_too_long_to_hold_is_refused)
+{
+	char *long_url = malloc(64 * 1024);
+
+	ASSERT_NOTNULL(long_url);
+	memset(long_url, 'a', 64 * 1024 - 1);
+	long_url[64 * 1024 - 1] = '\0';
+	errno = 0;
+	CHECK_NULL(libaxel_new(long_url));
+	CHECK_EQ(errno, ENAMETOOLONG);
+	free(long_url);
+}
+
+int
+main(void)
+{
+	make_source();
+
+	REGISTER_DESC(a_download_is_stepped_to_its_end_from_the_callers_loop,
+		      "a download stepped from a select() loop fetches it all");
+	REGISTER_DESC(settings_and_outputs_are_only_taken_before_the_start,
+		      "settings and outputs are checked, and refused once started");
+	REGISTER_DESC(a_sink_that_asks_for_order_gets_it,
+		      "a sink that asks for order gets the data from its start on");
+	REGISTER_DESC(a_sink_that_fails_stops_the_download,
+		      "a sink that fails stops the download, and it says so");
+	REGISTER_DESC(a_file_is_written_whole_and_leaves_no_state_behind,
+		      "a file output comes out whole, with no state file left");
+	REGISTER_DESC(a_download_that_cannot_start_says_why,
+		      "a download that cannot start fails, with messages to take");
+	REGISTER_DESC(memory_is_filled_at_the_offsets_the_connections_read,
+		      "memory is filled out of order, each block at its offset");
+	REGISTER_DESC(memory_too_small_for_the_download_fails_before_fetching,
+		      "memory too small fails the start, and is left untouched");
+	REGISTER_DESC(a_memfd_grows_to_the_download_and_holds_it,
+		      "a memfd is sized to the download when it starts, and holds it");
+	REGISTER_DESC(a_url_too_long_to_hold_is_refused,
+		      "a URL too long to hold is refused up front");
+
+	RUN_ALL();
+	remove_source();
+	return DONE();
+}
@@ -0,0 +1,144 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/metalink.c — reading a Metalink
+ *
+ * The mirrors of the first file come out best first, with the strongest
+ * hash of the whole file and the hashes of its pieces; and one that does
+ * not add up, or would write outside the current directory, is refused.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "harness.h"
+
+#include "ranges.h"
+#include "digest.h"
+#include "metalink.h"
+
+static const char example[] =
+	"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	"<metalink xmlns=\"urn:ietf:params:xml:ns:metalink\">\n"
+	"  <!-- <file name=\"not-this.bin\"> -->\n"
+	"  <published>2009-05-15T12:23:23Z</published>\n"
+	"  <file name=\"some/dir/example.bin\">\n"
+	"    <size>300000</size>\n"
+	"    <description>Tom &amp; Jerry</description>\n"
+	"    <hash type=\"md5\">d41d8cd98f00b204e9800998ecf8427e</hash>\n"
+	"    <hash type=\"sha-256\">"
+	"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"
+	"</hash>\n"
+	"    <pieces length=\"262144\" type=\"sha-1\">\n"
+	"      <hash>a9993e364706816aba3e25717850c26c9cd0d89d</hash>\n"
+	"      <hash>da39a3ee5e6b4b0d3255bfef95601890afd80709</hash>\n"
+	"    </pieces>\n"
+	"    <url location=\"de\" priority=\"2\">http://b.example/x?a=1&amp;b=2"
+	"</url>\n"
+	"    <url>ftp://c.example/x</url>\n"
+	"    <url priority='1'>\n      http://a.example/x\n    </url>\n"
+	"    <metaurl mediatype=\"torrent\" priority=\"1\">http://t/x.torrent"
+	"</metaurl>\n"
+	"  </file>\n"
+	"  <file name=\"other.bin\"><url>http://d.example/y</url></file>\n"
+	"</metalink>\n";
+
+TEST(the_first_file_is_read)
+{
+	metalink_t *ml = metalink_parse(example, sizeof(example) - 1);
+
+	ASSERT_NOTNULL(ml);
+	CHECK_STR(ml->name, "example.bin");
+	CHECK_EQ(ml->size, 300000);
+
+	/* Best first, in the order given between equals */
+	ASSERT_EQ(ml->nurls, 3);
+	CHECK_STR(ml->urls[0].url, "http://a.example/x");
+	CHECK_STR(ml->urls[1].url, "http://b.example/x?a=1&b=2");
+	CHECK_STR(ml->urls[2].url, "ftp://c.example/x");
+
+	/* SHA-256 over MD5 */
+	CHECK_STR(ml->hash.algo, "sha256");
+	CHECK_EQ(ml->hash.len, 32);
+	CHECK_EQ(ml->hash.want[0], 0xba);
+
+	CHECK_STR(ml->piece_algo, "sha1");
+	CHECK_EQ(ml->piece_len, 262144);
+	ASSERT_EQ(ml->pieces, 2);
+	ASSERT_EQ(ml->piece_hash_len, 20);
+	CHECK_EQ(ml->piece_hashes[0], 0xa9);
+	CHECK_EQ(ml->piece_hashes[20], 0xda);
+	CHECK_EQ(ml->piece_hashes[39], 0x09);
+	metalink_free(ml);
+}
+
+/* example, with the first from replaced by to */
+static
+metalink_t *
+parse_edited(const char *from, const char *to)
+{
+	char xml[sizeof(example) + 64];
+	const char *at = strstr(example, from);
+
+	if (!at || strlen(example) - strlen(from) + strlen(to) >= sizeof(xml))
+		abort();
+	snprintf(xml, sizeof(xml), "%.*s%s%s", (int)(at - example), example,
+		 to, at + strlen(from));
+	return metalink_parse(xml, strlen(xml));
+}
+
+TEST(what_does_not_add_up_is_refused)
+{
+	static const char bare[] = "<metalink><file name=\"x\"/></metalink>";
+	metalink_t *ml;
+
+	/* Pieces that do not cover the size */
+	errno = 0;
+	CHECK_NULL(parse_edited("300000", "600000"));
+	CHECK_EQ(errno, EINVAL);
+	CHECK_NULL(parse_edited("<hash>da39", "<hash>da3"));
+	CHECK_NULL(parse_edited("length=\"262144\"", ""));
+
+	/* A name that is no name, or markup that never ends */
+	CHECK_NULL(parse_edited("some/dir/example.bin", ".."));
+	CHECK_NULL(parse_edited("some/dir/example.bin", "a/"));
+	CHECK_NULL(metalink_parse(example, strstr(example, "</metalink") -
+				  example + 3));
+
+	/* No mirrors */
+	CHECK_NULL(metalink_parse(bare, strlen(bare)));
+
+	/* Without pieces or a size it is still of use */
+	ml = parse_edited("<size>300000</size>", "");
+	ASSERT_NOTNULL(ml);
+	CHECK_EQ(ml->size, -1);
+	metalink_free(ml);
+}
+
+TEST(metalinks_are_told_from_urls)
+{
+	CHECK(metalink_named("debian.iso.meta4"));
+	CHECK(metalink_named("dir/x.METALINK"));
+	CHECK(!metalink_named("http://example.com/x.meta4"));
+	CHECK(!metalink_named(".meta4"));
+	CHECK(!metalink_named("example.com/x.iso"));
+}
+
+int
+main(void)
+{
+	REGISTER_DESC(the_first_file_is_read,
+		      "the first file's mirrors, best first, and hashes are read");
+	REGISTER_DESC(what_does_not_add_up_is_refused,
+		      "pieces short of the size, bad names and bad XML are refused");
+	REGISTER_DESC(metalinks_are_told_from_urls,
+		      "a .meta4 or .metalink file is told apart from a URL");
+
+	RUN_ALL();
+	return DONE();
+}
@@ -0,0 +1,166 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/multipart.c — reading a multipart/byteranges reply
+ *
+ * The body is fed in whatever pieces the reads cut it into, down to a byte
+ * at a time, and comes back as the payload of each part at the offset its
+ * Content-Range gives; a body that is not in parts is one range; and
+ * anything that does not say where its bytes go is refused.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "harness.h"
+
+#include "multipart.h"
+
+#define TYPE "multipart/byteranges; boundary=THIS_STRING_SEPARATES"
+
+static const char body[] =
+	"\r\n--THIS_STRING_SEPARATES\r\n"
+	"Content-Type: application/octet-stream\r\n"
+	"Content-Range: bytes 10-14/100\r\n"
+	"\r\n"
+	"abcde"
+	"\r\n--THIS_STRING_SEPARATES\r\n"
+	"Content-Range: bytes 40-42/100\r\n"
+	"\r\n"
+	"xyz"
+	"\r\n--THIS_STRING_SEPARATES--\r\n";
+
+/* Feed buf in pieces of at most step bytes, taking at most max bytes of
+   payload at a time, and lay the payload out in file; -1 if malformed */
+static
+int
+feed(multipart_t *mp, const char *buf, size_t len, size_t step, size_t max,
+     char *file)
+{
+	size_t pos = 0;
+
+	while (pos < len) {
+		size_t n, chunk = len - pos < step ? len - pos : step;
+		off_t offset;
+
+		ssize_t used = multipart_parse(mp, buf + pos, chunk, max, &n,
+					       &offset);
+		if (used < 0)
+			return -1;
+		pos += used;
+		memcpy(file + offset, buf + pos - n, n);
+	}
+	return 0;
+}
+
+TEST(parts_land_at_their_offsets)
+{
+	static const size_t steps[] = { 1, 2, 7, sizeof(body) };
+
+	for (size_t i = 0; i < sizeof(steps) / sizeof(*steps); i++) {
+		multipart_t mp;
+		char file[100];
+
+		memset(file, '.', sizeof(file));
+		ASSERT_EQ(multipart_init(&mp, TYPE), 1);
+		CHECK_OK(feed(&mp, body, sizeof(body) - 1, steps[i], 64,
+			      file));
+		CHECK_EQ(memcmp(file + 9, ".abcde.", 7), 0);
+		CHECK_EQ(memcmp(file + 39, ".xyz.", 5), 0);
+		CHECK(multipart_done(&mp));
+	}
+}
+
+TEST(payload_stops_where_it_starts)
+{
+	multipart_t mp;
+	size_t n;
+	off_t offset;
+
+	ASSERT_EQ(multipart_init(&mp, TYPE), 1);
+	ssize_t used = multipart_parse(&mp, body, sizeof(body) - 1, 2, &n,
+				       &offset);
+	CHECK_EQ(n, 0);
+	CHECK_EQ(body[used], 'a');
+	ASSERT(multipart_in_body(&mp, &offset));
+	CHECK_EQ(offset, 10);
+
+	/* And then comes no more than asked for */
+	CHECK_EQ(multipart_parse(&mp, body + used, 5, 2, &n, &offset), 2);
+	CHECK_EQ(n, 2);
+	CHECK_EQ(offset, 10);
+	CHECK(multipart_in_body(&mp, &offset));
+	CHECK_EQ(offset, 12);
+}
+
+TEST(boundaries_are_read_quoted_or_not)
+{
+	multipart_t mp;
+
+	CHECK_EQ(multipart_init(&mp, " multipart/byteranges; "
+				"boundary=\"a b\""), 1);
+	CHECK_EQ(strcmp(mp.delim, "--a b"), 0);
+	CHECK_EQ(multipart_init(&mp, "Multipart/ByteRanges;charset=x;"
+				"boundary=q7;x=y\r"), 1);
+	CHECK_EQ(strcmp(mp.delim, "--q7"), 0);
+
+	CHECK_EQ(multipart_init(&mp, "application/octet-stream"), 0);
+	CHECK_EQ(multipart_init(&mp, "multipart/byteranges"), 0);
+	CHECK_EQ(multipart_init(&mp, "multipart/byteranges; boundary="), 0);
+}
+
+TEST(one_range_is_its_own_body)
+{
+	multipart_t mp;
+	char file[100];
+
+	memset(file, '.', sizeof(file));
+	multipart_single(&mp, 20, 25);
+	CHECK_OK(feed(&mp, "hello", 5, 2, 64, file));
+	CHECK_EQ(memcmp(file + 19, ".hello.", 7), 0);
+	CHECK(multipart_done(&mp));
+
+	multipart_single(&mp, 20, 20);
+	CHECK(multipart_done(&mp));
+}
+
+TEST(parts_that_do_not_say_where_are_refused)
+{
+	static const char *bad[] = {
+		"--B\r\nContent-Type: text/plain\r\n\r\nabc",
+		"--B\r\nContent-Range: bytes 9-3/100\r\n\r\nabc",
+		"--B\r\nContent-Range: bytes */100\r\n\r\nabc",
+	};
+	char file[100];
+
+	for (size_t i = 0; i < sizeof(bad) / sizeof(*bad); i++) {
+		multipart_t mp;
+
+		ASSERT_EQ(multipart_init(&mp, "multipart/byteranges; "
+					 "boundary=B"), 1);
+		CHECK_EQ(feed(&mp, bad[i], strlen(bad[i]), 64, 64, file), -1);
+	}
+}
+
+int
+main(void)
+{
+	REGISTER_DESC(parts_land_at_their_offsets,
+		      "each part goes where its Content-Range says, however cut");
+	REGISTER_DESC(payload_stops_where_it_starts,
+		      "parsing stops at the payload, and takes no more than asked");
+	REGISTER_DESC(boundaries_are_read_quoted_or_not,
+		      "the boundary is found among the parameters, quoted or not");
+	REGISTER_DESC(one_range_is_its_own_body,
+		      "a reply that is not in parts is read as the one range");
+	REGISTER_DESC(parts_that_do_not_say_where_are_refused,
+		      "a part without a usable Content-Range is malformed");
+
+	RUN_ALL();
+	return DONE();
+}
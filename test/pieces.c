@@ -0,0 +1,165 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/pieces.c — checking a download a piece at a time
+ *
+ * A piece is checked once the last of it is written, whatever the order,
+ * and passed on whole if it matches; one that does not is reported, counts
+ * as not written, and is checked again once it has been written again.  A
+ * resume checks the pieces already there before anything else.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "harness.h"
+
+#include "ranges.h"
+#include "writer.h"
+#include "pieces.h"
+
+#ifdef HAVE_SSL
+
+#include <openssl/evp.h>
+
+#define PIECE	(64 << 10)
+#define COUNT	5
+#define SIZE	(COUNT * PIECE - 1000)
+
+static char path[] = "/tmp/axel-pieces-XXXXXX";
+static char data[SIZE];
+static unsigned char hashes[COUNT][20];
+
+/* What was passed on, piece by piece */
+static off_t fed[COUNT];
+
+static
+void
+feed(void *arg, const void *buf, off_t offset, size_t len)
+{
+	if (!memcmp(buf, data + offset, len))
+		fed[offset / PIECE] += len;
+}
+
+static
+void
+make_file(void)
+{
+	int fd = mkstemp(path);
+
+	for (size_t i = 0; i < SIZE; i++)
+		data[i] = i * 2654435761u >> 24;
+	for (int i = 0; i < COUNT; i++) {
+		size_t len = i < COUNT - 1 ? PIECE : SIZE - i * PIECE;
+
+		EVP_Digest(data + i * PIECE, len, hashes[i], NULL, EVP_sha1(),
+			   NULL);
+	}
+	if (write(fd, data, SIZE) != SIZE)
+		abort();
+	close(fd);
+}
+
+/* Write [start, end) of the file, with byte at bad flipped if inside */
+static
+void
+write_at(pieces_t *p, off_t start, off_t end, off_t bad)
+{
+	int fd = open(path, O_WRONLY);
+	char c = bad >= 0 ? data[bad] ^ 1 : 0;
+
+	if (pwrite(fd, data + start, end - start, start) != end - start ||
+	    (bad >= start && bad < end && pwrite(fd, &c, 1, bad) != 1))
+		abort();
+	close(fd);
+	pieces_written(p, data + start, start, end - start);
+}
+
+TEST(pieces_are_checked_as_they_are_written)
+{
+	ranges_t done;
+	pieces_t *p;
+	size_t index;
+
+	make_file();
+	ranges_init(&done);
+	p = pieces_new("sha1", *hashes, 20, COUNT, PIECE, path, SIZE);
+	ASSERT_NOTNULL(p);
+	pieces_feed(p, feed, NULL);
+	ASSERT_OK(pieces_start(p, &done));
+
+	/* Out of order, across pieces, the third written wrong */
+	write_at(p, 3 * PIECE - 10, SIZE, 2 * PIECE + 5);
+	write_at(p, PIECE / 2, 3 * PIECE - 10, 2 * PIECE + 5);
+	CHECK_OK(pieces_wait(p));
+	CHECK_EQ(fed[0], 0);
+	CHECK_EQ(fed[1], PIECE);
+	CHECK_EQ(fed[2], 0);
+	CHECK_EQ(fed[4], SIZE - 4 * PIECE);
+	ASSERT_EQ(pieces_failed(p, &index), 1);
+	CHECK_EQ(index, 2);
+	CHECK_EQ(pieces_failed(p, &index), 0);
+
+	/* Half of it again is not enough; all of it is */
+	write_at(p, 0, PIECE / 2, -1);
+	write_at(p, 2 * PIECE, 2 * PIECE + 10, -1);
+	CHECK_OK(pieces_wait(p));
+	CHECK_EQ(fed[0], PIECE);
+	CHECK_EQ(fed[2], 0);
+	write_at(p, 2 * PIECE, 3 * PIECE, -1);
+	CHECK_OK(pieces_wait(p));
+	CHECK_EQ(fed[2], PIECE);
+	CHECK_EQ(pieces_failed(p, &index), 0);
+	pieces_free(p);
+
+	/* A resume, with the fourth piece gone bad on disk */
+	memset(fed, 0, sizeof(fed));
+	CHECK_OK(ranges_add(&done, 0, SIZE));
+	{
+		int fd = open(path, O_WRONLY);
+		char c = data[3 * PIECE] ^ 1;
+
+		ASSERT_EQ(pwrite(fd, &c, 1, 3 * PIECE), 1);
+		close(fd);
+	}
+	p = pieces_new("sha1", *hashes, 20, COUNT, PIECE, path, SIZE);
+	ASSERT_NOTNULL(p);
+	pieces_feed(p, feed, NULL);
+	ASSERT_OK(pieces_start(p, &done));
+	CHECK_OK(pieces_wait(p));
+	CHECK_EQ(fed[0] + fed[1] + fed[2] + fed[4], SIZE - PIECE);
+	ASSERT_EQ(pieces_failed(p, &index), 1);
+	CHECK_EQ(index, 3);
+	pieces_free(p);
+	ranges_free(&done);
+
+	/* Hashes of the wrong length for the algorithm */
+	errno = 0;
+	CHECK_NULL(pieces_new("sha256", *hashes, 20, COUNT, PIECE, path,
+			      SIZE));
+	CHECK_EQ(errno, EINVAL);
+
+	unlink(path);
+}
+
+#endif				/* HAVE_SSL */
+
+int
+main(void)
+{
+#ifdef HAVE_SSL
+	REGISTER_DESC(pieces_are_checked_as_they_are_written,
+		      "each piece is checked once written, and again if it failed");
+#endif				/* HAVE_SSL */
+
+	RUN_ALL();
+	return DONE();
+}
@@ -0,0 +1,89 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/prealloc.c — claiming the disk space a download needs up front
+ *
+ * On a file system that can allocate, the file comes out holding blocks for
+ * every byte; one that cannot, and anything that is not a regular file, are
+ * left for the writes to deal with; and a download the disk has no room
+ * for fails before it starts.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "harness.h"
+
+#include "prealloc.h"
+
+static
+int
+temp_file(void)
+{
+	char path[] = "/tmp/axel-prealloc-XXXXXX";
+	int fd = mkstemp(path);
+
+	if (fd != -1)
+		unlink(path);
+	return fd;
+}
+
+TEST(the_file_gets_its_blocks_up_front)
+{
+	int fd = temp_file();
+	struct stat st;
+
+	ASSERT_NE(fd, -1);
+	int ret = prealloc(fd, 1 << 20);
+	CHECK_NE(ret, -1);
+	CHECK_OK(fstat(fd, &st));
+
+	/* Where it is claimed, it is claimed in full */
+	if (ret == 1) {
+		CHECK_EQ(st.st_size, 1 << 20);
+		CHECK_GE((off_t)st.st_blocks * 512, 1 << 20);
+	}
+	close(fd);
+}
+
+TEST(no_room_fails_before_anything_is_written)
+{
+	int fd = temp_file();
+	struct stat st;
+
+	ASSERT_NE(fd, -1);
+	errno = 0;
+	CHECK_EQ(prealloc(fd, (off_t)1 << 60), -1);
+	CHECK(errno == ENOSPC || errno == EFBIG);
+	CHECK_OK(fstat(fd, &st));
+	CHECK_EQ(st.st_blocks, 0);
+	close(fd);
+}
+
+TEST(a_pipe_is_left_alone)
+{
+	int fds[2];
+
+	ASSERT_OK(pipe(fds));
+	CHECK_EQ(prealloc(fds[1], 1 << 20), 0);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+int
+main(void)
+{
+	REGISTER_DESC(the_file_gets_its_blocks_up_front,
+		      "where the file system can, every byte gets its block up front");
+	REGISTER_DESC(no_room_fails_before_anything_is_written,
+		      "a size the disk has no room for fails with nothing written");
+	REGISTER_DESC(a_pipe_is_left_alone,
+		      "anything but a regular file is left for the writes to fill");
+
+	RUN_ALL();
+	return DONE();
+}
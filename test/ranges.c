@@ -0,0 +1,217 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/ranges.c — the set of bytes a download has done
+ *
+ * Ranges added in any order come out sorted and merged, so that the set is
+ * as small as what it describes; the gaps between them are found wherever
+ * they start; and the connections a resume asks for are spread over the
+ * gaps as evenly as the minimum piece allows.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "harness.h"
+
+#include "ranges.h"
+
+#define MB (1 << 20)
+
+TEST(touching_ranges_merge)
+{
+	ranges_t set;
+
+	ranges_init(&set);
+	CHECK_OK(ranges_add(&set, 10, 20));
+	CHECK_OK(ranges_add(&set, 30, 40));
+	CHECK_OK(ranges_add(&set, 0, 5));
+	CHECK_EQ(set.count, 3);
+
+	/* Bridging two, and touching one at either end */
+	CHECK_OK(ranges_add(&set, 20, 30));
+	CHECK_EQ(set.count, 2);
+	CHECK_OK(ranges_add(&set, 5, 10));
+	ASSERT_EQ(set.count, 1);
+	CHECK_EQ(set.r[0].start, 0);
+	CHECK_EQ(set.r[0].end, 40);
+	CHECK_EQ(ranges_total(&set), 40);
+	ranges_free(&set);
+}
+
+TEST(overlaps_count_once)
+{
+	ranges_t set;
+
+	ranges_init(&set);
+	CHECK_OK(ranges_add(&set, 100, 200));
+	CHECK_OK(ranges_add(&set, 150, 250));
+	CHECK_OK(ranges_add(&set, 120, 130));
+	CHECK_OK(ranges_add(&set, 50, 300));
+	CHECK_OK(ranges_add(&set, 400, 400));
+	ASSERT_EQ(set.count, 1);
+	CHECK_EQ(ranges_total(&set), 250);
+	ranges_free(&set);
+}
+
+TEST(many_reads_stay_few_ranges)
+{
+	ranges_t set;
+
+	/* Four connections reading a block at a time, interleaved */
+	ranges_init(&set);
+	for (off_t off = 0; off < MB; off += 1024)
+		for (int c = 0; c < 4; c++)
+			ASSERT_OK(ranges_add(&set, c * MB + off,
+					     c * MB + off + 1024));
+	CHECK_EQ(set.count, 1);
+	CHECK_EQ(ranges_total(&set), 4 * MB);
+	ranges_free(&set);
+}
+
+TEST(removing_trims_and_splits)
+{
+	ranges_t set;
+
+	ranges_init(&set);
+	CHECK_OK(ranges_add(&set, 0, 100));
+	CHECK_OK(ranges_add(&set, 200, 300));
+	CHECK_OK(ranges_add(&set, 400, 500));
+
+	/* Out of the middle */
+	CHECK_OK(ranges_remove(&set, 40, 60));
+	ASSERT_EQ(set.count, 4);
+	CHECK_EQ(set.r[0].end, 40);
+	CHECK_EQ(set.r[1].start, 60);
+
+	/* Across several, and where there is nothing */
+	CHECK_OK(ranges_remove(&set, 80, 450));
+	ASSERT_EQ(set.count, 3);
+	CHECK_EQ(set.r[1].start, 60);
+	CHECK_EQ(set.r[1].end, 80);
+	CHECK_EQ(set.r[2].start, 450);
+	CHECK_OK(ranges_remove(&set, 100, 400));
+	CHECK_OK(ranges_remove(&set, 40, 60));
+	CHECK_EQ(ranges_total(&set), 40 + 20 + 50);
+
+	/* Exactly one, at either end */
+	CHECK_OK(ranges_remove(&set, 0, 40));
+	CHECK_OK(ranges_remove(&set, 450, 500));
+	ASSERT_EQ(set.count, 1);
+	CHECK_EQ(set.r[0].start, 60);
+	CHECK_EQ(set.r[0].end, 80);
+	ranges_free(&set);
+}
+
+TEST(gaps_are_found_from_anywhere)
+{
+	ranges_t set;
+	range_t gap;
+
+	ranges_init(&set);
+	CHECK_OK(ranges_add(&set, 10, 20));
+	CHECK_OK(ranges_add(&set, 30, 40));
+
+	ASSERT_EQ(ranges_gap(&set, 0, 100, &gap), 1);
+	CHECK_EQ(gap.start, 0);
+	CHECK_EQ(gap.end, 10);
+	ASSERT_EQ(ranges_gap(&set, 15, 100, &gap), 1);
+	CHECK_EQ(gap.start, 20);
+	CHECK_EQ(gap.end, 30);
+	ASSERT_EQ(ranges_gap(&set, 25, 100, &gap), 1);
+	CHECK_EQ(gap.start, 25);
+	CHECK_EQ(gap.end, 30);
+	ASSERT_EQ(ranges_gap(&set, 40, 100, &gap), 1);
+	CHECK_EQ(gap.start, 40);
+	CHECK_EQ(gap.end, 100);
+	CHECK_EQ(ranges_gap(&set, 35, 40, &gap), 0);
+	ranges_free(&set);
+}
+
+TEST(a_fresh_download_splits_evenly)
+{
+	ranges_t set;
+	range_t pieces[4];
+
+	ranges_init(&set);
+	ASSERT_EQ(ranges_plan(&set, 10 * MB + 3, 4, MB, pieces), 4);
+	for (int i = 0; i < 4; i++) {
+		CHECK_EQ(pieces[i].start, i * ((10 * MB + 3) / 4));
+		CHECK_EQ(pieces[i].end, i == 3 ? 10 * MB + 3 :
+			 (i + 1) * ((10 * MB + 3) / 4));
+	}
+
+	/* No piece narrower than the minimum */
+	CHECK_EQ(ranges_plan(&set, 3 * MB, 4, MB, pieces), 3);
+	CHECK_EQ(ranges_plan(&set, MB / 2, 4, MB, pieces), 1);
+	CHECK_EQ(pieces[0].end, MB / 2);
+}
+
+TEST(the_widest_gaps_get_the_connections)
+{
+	ranges_t set;
+	range_t pieces[8];
+
+	/* Gaps of 1, 6 and 2 MB */
+	ranges_init(&set);
+	CHECK_OK(ranges_add(&set, MB, 2 * MB));
+	CHECK_OK(ranges_add(&set, 8 * MB, 9 * MB));
+	ASSERT_EQ(ranges_plan(&set, 11 * MB, 6, MB / 4, pieces), 6);
+
+	/* Cutting the 6 in four leaves wider pieces than cutting the 2 */
+	off_t want[][2] = {
+		{ 0, MB }, { 4 * MB / 2, 7 * MB / 2 }, { 7 * MB / 2, 10 * MB / 2 },
+		{ 10 * MB / 2, 13 * MB / 2 }, { 13 * MB / 2, 8 * MB },
+		{ 9 * MB, 11 * MB },
+	};
+	for (int i = 0; i < 6; i++) {
+		CHECK_EQ(pieces[i].start, want[i][0]);
+		CHECK_EQ(pieces[i].end, want[i][1]);
+	}
+	ranges_free(&set);
+}
+
+TEST(more_gaps_than_connections_leaves_the_rest)
+{
+	ranges_t set;
+	range_t pieces[2];
+
+	ranges_init(&set);
+	for (int i = 0; i < 5; i++)
+		CHECK_OK(ranges_add(&set, 2 * i * MB + MB, 2 * i * MB + 2 * MB));
+	ASSERT_EQ(ranges_plan(&set, 10 * MB, 2, MB / 4, pieces), 2);
+	CHECK_EQ(pieces[0].start, 0);
+	CHECK_EQ(pieces[1].start, 2 * MB);
+	CHECK_EQ(pieces[1].end, 3 * MB);
+
+	/* Nothing to do once it is all done */
+	CHECK_OK(ranges_add(&set, 0, 10 * MB));
+	CHECK_EQ(ranges_plan(&set, 10 * MB, 2, MB / 4, pieces), 0);
+	ranges_free(&set);
+}
+
+int
+main(void)
+{
+	REGISTER_DESC(touching_ranges_merge,
+		      "ranges that touch merge into one, from either side");
+	REGISTER_DESC(overlaps_count_once,
+		      "overlapping ranges count their bytes once");
+	REGISTER_DESC(many_reads_stay_few_ranges,
+		      "block-sized reads from interleaved connections collapse");
+	REGISTER_DESC(removing_trims_and_splits,
+		      "taking bytes out trims, drops or splits the ranges they hit");
+	REGISTER_DESC(gaps_are_found_from_anywhere,
+		      "the gap after a position is found, inside a range or not");
+	REGISTER_DESC(a_fresh_download_splits_evenly,
+		      "an empty set splits evenly, never under the minimum piece");
+	REGISTER_DESC(the_widest_gaps_get_the_connections,
+		      "spare connections go where they leave the widest pieces");
+	REGISTER_DESC(more_gaps_than_connections_leaves_the_rest,
+		      "with more gaps than connections the first ones are given");
+
+	RUN_ALL();
+	return DONE();
+}
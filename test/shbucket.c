@@ -0,0 +1,256 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/shbucket.c — the bucket shared by a --speed-group
+ *
+ * The bucket keeps to the real clock, so every group here is given a rate
+ * of a byte or so per second: slow enough that nothing a test does is
+ * measurably refilled halfway through.  Each test makes its own group,
+ * named after the process, and removes it again.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "harness.h"
+
+#include "shbucket.h"
+
+static char group[64];
+
+static
+const char *
+new_group(void)
+{
+	static int n;
+
+	snprintf(group, sizeof(group), "test-%ld-%d", (long)getpid(), n++);
+	return group;
+}
+
+#ifdef HAVE_SHM_OPEN
+static
+void
+remove_group(void)
+{
+	shbucket_unlink(group);
+}
+
+TEST(joining_a_group_nobody_made_fails)
+{
+	errno = 0;
+	ASSERT_NULL(shbucket_open(new_group(), 0, 1000));
+	ASSERT_EQ(errno, ENOENT);
+}
+
+TEST(a_name_with_a_slash_is_refused)
+{
+	errno = 0;
+	ASSERT_NULL(shbucket_open("a/b", 1, 1000));
+	ASSERT_EQ(errno, EINVAL);
+}
+
+TEST(a_new_group_starts_full)
+{
+	shbucket_t *b = shbucket_open(new_group(), 1, 1000);
+
+	ASSERT_NOTNULL(b);
+	CHECK_EQ(shbucket_take(b, 5000, 1), 1000);
+	CHECK_EQ(shbucket_take(b, 5000, 1), 0);
+	shbucket_close(b);
+	remove_group();
+}
+
+TEST(members_draw_from_the_same_tokens)
+{
+	shbucket_t *a = shbucket_open(new_group(), 1, 1000);
+	shbucket_t *b = shbucket_open(group, 0, 0);
+
+	CHECK_NOTNULL(a);
+	CHECK_NOTNULL(b);
+	if (a && b) {
+		CHECK_EQ(shbucket_take(a, 600, 1), 600);
+		CHECK_EQ(shbucket_take(b, 5000, 1), 400);
+		CHECK_EQ(shbucket_rate(b), 1);
+	}
+	shbucket_close(a);
+	shbucket_close(b);
+	remove_group();
+}
+
+TEST(joining_with_a_rate_sets_it_for_everyone)
+{
+	shbucket_t *a = shbucket_open(new_group(), 1, 1000);
+	shbucket_t *b = shbucket_open(group, 2, 1000);
+
+	CHECK_NOTNULL(a);
+	CHECK_NOTNULL(b);
+	if (a && b)
+		CHECK_EQ(shbucket_rate(a), 2);
+	shbucket_close(a);
+	shbucket_close(b);
+	remove_group();
+}
+
+TEST(tokens_given_back_are_capped_at_the_burst)
+{
+	shbucket_t *b = shbucket_open(new_group(), 1, 1000);
+
+	ASSERT_NOTNULL(b);
+	CHECK_EQ(shbucket_take(b, 1000, 1), 1000);
+	shbucket_give(b, 300);
+	CHECK_EQ(shbucket_take(b, 5000, 1), 300);
+	shbucket_give(b, 5000);
+	CHECK_EQ(shbucket_take(b, 5000, 1), 1000);
+	shbucket_close(b);
+	remove_group();
+}
+
+TEST(readers_get_an_even_share)
+{
+	shbucket_t *b = shbucket_open(new_group(), 1, 1000);
+
+	ASSERT_NOTNULL(b);
+	CHECK_EQ(shbucket_take(b, 5000, 4), 250);
+	CHECK_EQ(shbucket_take(b, 100, 3), 100);
+	shbucket_close(b);
+	remove_group();
+}
+
+TEST(the_delay_is_the_time_the_missing_tokens_take)
+{
+	shbucket_t *b = shbucket_open(new_group(), 1000, 1000);
+
+	ASSERT_NOTNULL(b);
+	CHECK_EQ(shbucket_take(b, 1000, 1), 1000);
+	double wait = shbucket_delay(b, 100);
+	CHECK_FLOAT_LE(wait, .1);
+	CHECK_FLOAT_GT(wait, .05);
+	CHECK_FLOAT_EQ(shbucket_delay(b, 0), 0);
+	shbucket_close(b);
+	remove_group();
+}
+
+/* Processes hammering the bucket a token at a time: none of the tokens may
+ * be handed out twice, and none may go missing */
+TEST(racing_processes_take_each_token_once)
+{
+	enum { PROCS = 4, TOKENS = 100000 };
+	shbucket_t *b = shbucket_open(new_group(), 1, TOKENS);
+	int fds[2];
+	unsigned long total = 0;
+
+	ASSERT_NOTNULL(b);
+	CHECK_OK(pipe(fds));
+	for (int i = 0; i < PROCS; i++) {
+		if (fork() == 0) {
+			unsigned long n = 0;
+
+			while (shbucket_take(b, 1, 1))
+				n++;
+			_exit(write(fds[1], &n, sizeof(n)) != sizeof(n));
+		}
+	}
+	for (int i = 0; i < PROCS; i++) {
+		unsigned long n;
+
+		if (read(fds[0], &n, sizeof(n)) == sizeof(n))
+			total += n;
+		wait(NULL);
+	}
+	close(fds[0]);
+	close(fds[1]);
+
+	/* A second or two at a byte per second may trickle in on top */
+	CHECK_GE(total, TOKENS);
+	CHECK_LE(total, TOKENS + 5);
+	shbucket_close(b);
+	remove_group();
+}
+
+TEST(a_removed_group_keeps_its_members)
+{
+	shbucket_t *b = shbucket_open(new_group(), 1, 1000);
+
+	ASSERT_NOTNULL(b);
+	CHECK_OK(shbucket_unlink(group));
+	CHECK_EQ(shbucket_take(b, 10, 1), 10);
+
+	/* Nobody joins it any more: asking for it again makes another */
+	errno = 0;
+	CHECK_NULL(shbucket_open(group, 0, 1000));
+	CHECK_EQ(errno, ENOENT);
+	CHECK_EQ(shbucket_unlink(group), -1);
+	shbucket_close(b);
+}
+
+TEST(a_group_is_the_users_own)
+{
+	shbucket_t *b = shbucket_open(new_group(), 1, 1000);
+	char path[128];
+	struct stat st;
+	int fd;
+
+	ASSERT_NOTNULL(b);
+	snprintf(path, sizeof(path), "/axel-%lu-%s", (unsigned long)getuid(),
+		 group);
+	fd = shm_open(path, O_RDONLY, 0);
+	ASSERT_NE(fd, -1);
+	CHECK_OK(fstat(fd, &st));
+	CHECK_EQ(st.st_uid, getuid());
+	CHECK_EQ(st.st_mode & 0777, 0600);
+	close(fd);
+	shbucket_close(b);
+	remove_group();
+}
+#else				/* HAVE_SHM_OPEN */
+TEST(there_are_no_groups_to_join)
+{
+	errno = 0;
+	ASSERT_NULL(shbucket_open(new_group(), 1, 1000));
+	CHECK_EQ(errno, ENOSYS);
+	CHECK_EQ(shbucket_unlink(group), -1);
+}
+#endif				/* HAVE_SHM_OPEN */
+
+int
+main(void)
+{
+#ifdef HAVE_SHM_OPEN
+	REGISTER_DESC(joining_a_group_nobody_made_fails,
+		      "joining a group without giving a rate needs the group to exist");
+	REGISTER_DESC(a_name_with_a_slash_is_refused,
+		      "a group name with a slash in it is refused");
+	REGISTER_DESC(a_new_group_starts_full,
+		      "a new group starts out holding its burst");
+	REGISTER_DESC(members_draw_from_the_same_tokens,
+		      "members of a group draw from the same tokens at the same rate");
+	REGISTER_DESC(joining_with_a_rate_sets_it_for_everyone,
+		      "joining with a rate sets it for every member");
+	REGISTER_DESC(tokens_given_back_are_capped_at_the_burst,
+		      "tokens given back return to the group, up to its burst");
+	REGISTER_DESC(readers_get_an_even_share,
+		      "ready readers get an even share, capped at what they want");
+	REGISTER_DESC(the_delay_is_the_time_the_missing_tokens_take,
+		      "the delay is how long the missing tokens take to arrive");
+	REGISTER_DESC(racing_processes_take_each_token_once,
+		      "processes racing for tokens take each one exactly once");
+	REGISTER_DESC(a_removed_group_keeps_its_members,
+		      "a removed group serves its members, but takes no more");
+	REGISTER_DESC(a_group_is_the_users_own,
+		      "a group is the user's own, for nobody else to open");
+#else
+	REGISTER_DESC(there_are_no_groups_to_join,
+		      "without shared memory there are no groups to join");
+#endif
+
+	RUN_ALL();
+	return DONE();
+}
@@ -0,0 +1,498 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/stfile.c — the state file an interrupted download resumes from
+ *
+ * What is saved comes back as it was, byte for byte the same on any
+ * machine, whatever number of connections resumes from it; a save torn
+ * halfway leaves the one before it to resume from, and a checkpoint is
+ * believed only on the boot that wrote it; a file that was damaged, cut
+ * short, or written for a download of another size or another version of
+ * the file, is ignored rather than believed; and one written before the
+ * format had a version is still read.
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "harness.h"
+
+#include "axel.h"
+#include "stfile.h"
+
+/* src/stfile.c calls back into src/axel.c, which would bring the whole
+ * program into the link; these do what the real ones do, as far as the
+ * state file can tell. */
+static int messages;
+
+void
+axel_message(axel_t *axel, const char *format, ...)
+{
+	(void)axel;
+	(void)format;
+	messages++;
+}
+
+int
+axel_conn_resize(axel_t *axel, uint16_t nconns)
+{
+	void *new_conn = realloc(axel->conn, sizeof(conn_t) * nconns);
+	if (!new_conn)
+		return 0;
+
+	axel->conn = new_conn;
+	if (nconns > axel->conf->num_connections)
+		memset(axel->conn + axel->conf->num_connections, 0,
+		       sizeof(conn_t) * (nconns - axel->conf->num_connections));
+	axel->conf->num_connections = nconns;
+	return 1;
+}
+
+int
+axel_divide(axel_t *axel)
+{
+	off_t seg_len = axel->size / axel->conf->num_connections;
+
+	for (int i = 0; i < axel->conf->num_connections; i++) {
+		axel->conn[i].currentbyte = seg_len * i;
+		axel->conn[i].lastbyte = seg_len * i + seg_len;
+	}
+	axel->conn[axel->conf->num_connections - 1].lastbyte = axel->size;
+	return 1;
+}
+
+int
+writer_sync(writer_t *w)
+{
+	(void)w;
+	return 0;
+}
+
+/* With no writer, all that is done is written */
+int
+writer_written(writer_t *w, const ranges_t *done, ranges_t *out)
+{
+	(void)w;
+	ranges_init(out);
+	for (size_t i = 0; i < done->count; i++)
+		if (ranges_add(out, done->r[i].start, done->r[i].end) == -1)
+			return -1;
+	return 0;
+}
+
+static char dir[] = "/tmp/axel-stfile-XXXXXX";
+
+/* A download of size bytes over nconns connections, none of them started,
+ * writing to a file in dir */
+static
+axel_t *
+download(off_t size, uint16_t nconns)
+{
+	axel_t *axel = calloc(1, sizeof(*axel));
+	conf_t *conf = calloc(1, sizeof(*conf));
+
+	if (!axel || !conf)
+		abort();
+	if (dir[strlen(dir) - 1] == 'X' && !mkdtemp(dir))
+		abort();
+
+	axel->conf = conf;
+	axel->size = size;
+	snprintf(axel->filename, sizeof(axel->filename), "%s/file", dir);
+	axel->outfd = open(axel->filename, O_CREAT | O_WRONLY, 0666);
+	if (axel->outfd == -1 || !axel_conn_resize(axel, nconns))
+		abort();
+	axel_divide(axel);
+	axel->conn[0].supported = 1;
+	return axel;
+}
+
+static
+void
+done(axel_t *axel)
+{
+	stfile_close(axel);
+	stfile_unlink(axel->filename);
+	close(axel->outfd);
+	unlink(axel->filename);
+	ranges_free(&axel->done);
+	free(axel->conf);
+	free(axel->conn);
+	free(axel);
+}
+
+/* Replace the state file with the len bytes at buf */
+static
+void
+put_stfile(const axel_t *axel, const void *buf, size_t len)
+{
+	char name[MAX_STRING + 3];
+	int fd;
+
+	/* Another file, not the one a save may still have mapped */
+	snprintf(name, sizeof(name), "%s.st", axel->filename);
+	unlink(name);
+	fd = open(name, O_CREAT | O_WRONLY, 0666);
+	if (fd == -1 || write(fd, buf, len) != (ssize_t)len)
+		abort();
+	close(fd);
+}
+
+/* The state file, into buf; returns its length */
+static
+size_t
+get_stfile(const axel_t *axel, unsigned char *buf, size_t len)
+{
+	char name[MAX_STRING + 3];
+	ssize_t n;
+	int fd;
+
+	snprintf(name, sizeof(name), "%s.st", axel->filename);
+	fd = open(name, O_RDONLY);
+	if (fd == -1)
+		return 0;
+	n = read(fd, buf, len);
+	close(fd);
+	return n < 0 ? 0 : n;
+}
+
+/* Half of each connection's share done */
+static
+void
+make_progress(axel_t *axel)
+{
+	axel->bytes_done = 0;
+	for (int i = 0; i < axel->conf->num_connections; i++) {
+		conn_t *conn = &axel->conn[i];
+		off_t half = (conn->lastbyte - conn->currentbyte) / 2;
+
+		if (ranges_add(&axel->done, conn->currentbyte,
+			       conn->currentbyte + half))
+			abort();
+		conn->currentbyte += half;
+		axel->bytes_done += half;
+	}
+}
+
+/* What src/stfile.c checks every slot with */
+static
+uint32_t
+crc32(const unsigned char *p, size_t len)
+{
+	uint32_t crc = 0xffffffff;
+
+	while (len--) {
+		crc ^= *p++;
+		for (int k = 0; k < 8; k++)
+			crc = crc >> 1 ^ (0xedb88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+static
+void
+forget(axel_t *axel)
+{
+	stfile_close(axel);
+	ranges_free(&axel->done);
+	free(axel->conf);
+	free(axel->conn);
+	free(axel);
+}
+
+TEST(what_is_saved_is_what_comes_back)
+{
+	axel_t *a = download(1000003, 3);
+	axel_t *b = download(1000003, 8);
+
+	make_progress(a);
+	ASSERT_OK(stfile_save(a));
+	ASSERT_EQ(stfile_load(b), 1);
+
+	/* The connections are for axel_divide() to lay out again */
+	CHECK_EQ(b->conf->num_connections, 8);
+	CHECK_EQ(b->bytes_done, a->bytes_done);
+	ASSERT_EQ(b->done.count, 3);
+	for (int i = 0; i < 3; i++) {
+		CHECK_EQ(b->done.r[i].start, a->done.r[i].start);
+		CHECK_EQ(b->done.r[i].end, a->done.r[i].end);
+	}
+	done(a);
+	forget(b);
+}
+
+TEST(the_layout_is_the_same_everywhere)
+{
+	static const unsigned char want[] = {
+		'A', 'X', 'S', 'T', 5, 0, 0, 0,
+		0x00, 0x01, 0x02, 0x03, 0, 0, 0, 0,	/* size */
+		0x01, 0x00, 0x00, 0x00, 0, 0, 0, 0,	/* sequence */
+		0, 0, 0, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 0, 0, 0,			/* boot id */
+		0xfc, 0x00, 0x00, 0x00,			/* room */
+		0x01, 0x00, 0x00, 0x00,			/* ranges */
+		0, 0, 0, 0, 0, 0, 0, 0,			/* no validators */
+		0x00, 0x00, 0x00, 0x00, 0, 0, 0, 0,	/* start */
+		0x80, 0x00, 0x01, 0x00, 0, 0, 0, 0,	/* end */
+	};
+	static unsigned char buf[4 * 4096];
+	axel_t *axel = download(0x03020100, 1);
+
+	ASSERT_OK(ranges_add(&axel->done, 0, 0x10080));
+	ASSERT_OK(stfile_save(axel));
+	size_t len = get_stfile(axel, buf, sizeof(buf));
+	CHECK_EQ(len, 3 * 4096);
+	CHECK(!memcmp(buf, want, sizeof(want)));
+	CHECK_EQ(buf[sizeof(want)] | buf[sizeof(want) + 1] << 8 |
+		 buf[sizeof(want) + 2] << 16 |
+		 (uint32_t)buf[sizeof(want) + 3] << 24,
+		 crc32(buf, sizeof(want)));
+	done(axel);
+}
+
+TEST(a_damaged_file_is_ignored)
+{
+	static unsigned char buf[3 * 4096];
+	axel_t *axel = download(1 << 20, 4);
+
+	make_progress(axel);
+	ASSERT_OK(stfile_save(axel));
+	size_t len = get_stfile(axel, buf, sizeof(buf));
+	ASSERT_EQ(len, sizeof(buf));
+
+	/* A single bit anywhere in the one slot there is, past the magic,
+	   the checksum included */
+	for (size_t at = 4; at < 56 + 4 * 16 + 4; at += 7) {
+		buf[at] ^= 0x10;
+		put_stfile(axel, buf, len);
+		buf[at] ^= 0x10;
+
+		messages = 0;
+		CHECK_EQ(stfile_load(axel), 0);
+		CHECK_EQ(axel->bytes_done, 0);
+		CHECK_EQ(axel->conf->num_connections, 4);
+		CHECK_EQ(messages, 1);
+	}
+	done(axel);
+}
+
+TEST(a_file_cut_short_is_ignored)
+{
+	static unsigned char buf[3 * 4096];
+	axel_t *axel = download(1 << 20, 2);
+
+	make_progress(axel);
+	ASSERT_OK(stfile_save(axel));
+	size_t len = get_stfile(axel, buf, sizeof(buf));
+
+	for (size_t cut = 4; cut < len; cut += 61) {
+		put_stfile(axel, buf, cut);
+		CHECK_EQ(stfile_load(axel), 0);
+		CHECK_EQ(axel->bytes_done, 0);
+	}
+	done(axel);
+}
+
+TEST(another_size_is_another_download)
+{
+	axel_t *a = download(1 << 20, 2);
+	axel_t *b = download(2 << 20, 2);
+
+	make_progress(a);
+	ASSERT_OK(stfile_save(a));
+	CHECK_EQ(stfile_load(b), 0);
+	CHECK_EQ(b->bytes_done, 0);
+	CHECK_EQ(b->done.count, 0);
+	done(a);
+	forget(b);
+}
+
+TEST(a_changed_file_is_another_download)
+{
+	axel_t *a = download(1 << 20, 2);
+	axel_t *b = download(1 << 20, 2);
+
+	strcpy(a->etag, "\"v1\"");
+	strcpy(a->last_modified, "Mon, 19 Oct 2026 10:00:00 GMT");
+	make_progress(a);
+	ASSERT_OK(stfile_save(a));
+
+	/* A server that says nothing cannot say it changed */
+	ASSERT_EQ(stfile_load(b), 1);
+	ranges_free(&b->done);
+
+	strcpy(b->etag, "\"v2\"");
+	CHECK_EQ(stfile_load(b), 0);
+	CHECK_EQ(b->bytes_done, 0);
+
+	strcpy(b->etag, "\"v1\"");
+	strcpy(b->last_modified, "Mon, 19 Oct 2026 11:00:00 GMT");
+	CHECK_EQ(stfile_load(b), 0);
+
+	strcpy(b->last_modified, a->last_modified);
+	CHECK_EQ(stfile_load(b), 1);
+	CHECK_EQ(b->bytes_done, a->bytes_done);
+	done(a);
+	forget(b);
+}
+
+TEST(a_torn_save_leaves_the_one_before)
+{
+	static unsigned char buf[3 * 4096];
+	axel_t *a = download(1 << 20, 2);
+	axel_t *b = download(1 << 20, 2);
+
+	ASSERT_OK(ranges_add(&a->done, 0, 1000));
+	ASSERT_OK(stfile_save(a));
+	ASSERT_OK(ranges_add(&a->done, 1000, 5000));
+	ASSERT_OK(stfile_save(a));
+	ASSERT_EQ(get_stfile(a, buf, sizeof(buf)), sizeof(buf));
+
+	/* The second save went to the second slot */
+	ASSERT_EQ(stfile_load(b), 1);
+	CHECK_EQ(b->bytes_done, 5000);
+	ranges_free(&b->done);
+
+	buf[4096 + 60] ^= 1;
+	put_stfile(a, buf, sizeof(buf));
+	ASSERT_EQ(stfile_load(b), 1);
+	CHECK_EQ(b->bytes_done, 1000);
+	done(a);
+	forget(b);
+}
+
+TEST(a_checkpoint_holds_until_a_reboot)
+{
+	static unsigned char buf[3 * 4096];
+	axel_t *a = download(1 << 20, 2);
+	axel_t *b = download(1 << 20, 2);
+
+	/* Nothing to tell one boot from the next: no checkpoints then */
+	if (access("/proc/sys/kernel/random/boot_id", R_OK)) {
+		done(a);
+		forget(b);
+		return;
+	}
+
+	ASSERT_OK(ranges_add(&a->done, 0, 1000));
+	ASSERT_OK(stfile_save(a));
+	ASSERT_OK(ranges_add(&a->done, 1000, 7000));
+	ASSERT_OK(stfile_checkpoint(a));
+	ASSERT_EQ(get_stfile(a, buf, sizeof(buf)), sizeof(buf));
+
+	ASSERT_EQ(stfile_load(b), 1);
+	CHECK_EQ(b->bytes_done, 7000);
+	ranges_free(&b->done);
+
+	/* Another boot id, with the checksum made to match */
+	unsigned char *slot = buf + 2 * 4096;
+	size_t used = 56 + 16;
+	slot[24] ^= 1;
+	uint32_t crc = crc32(slot, used);
+	for (int i = 0; i < 4; i++)
+		slot[used + i] = crc >> (8 * i);
+	put_stfile(a, buf, sizeof(buf));
+
+	ASSERT_EQ(stfile_load(b), 1);
+	CHECK_EQ(b->bytes_done, 1000);
+	done(a);
+	forget(b);
+}
+
+TEST(the_file_grows_with_the_ranges)
+{
+	axel_t *a = download(1 << 20, 2);
+	axel_t *b = download(1 << 20, 2);
+
+	ASSERT_OK(ranges_add(&a->done, 0, 10));
+	ASSERT_OK(stfile_save(a));
+	for (int i = 1; i < 1000; i++)
+		ASSERT_OK(ranges_add(&a->done, 100 * i, 100 * i + 10));
+	ASSERT_OK(stfile_save(a));
+	ASSERT_OK(stfile_checkpoint(a));
+
+	ASSERT_EQ(stfile_load(b), 1);
+	CHECK_EQ(b->done.count, 1000);
+	CHECK_EQ(b->bytes_done, 10000);
+	done(a);
+	forget(b);
+}
+
+TEST(an_unversioned_file_is_still_read)
+{
+	axel_t *axel = download(1 << 20, 2);
+	unsigned char buf[256], *p = buf;
+	uint16_t nconns = 2;
+	off_t done_bytes = 3000;
+	off_t ranges[] = { 1000, 1 << 19, (1 << 19) + 2000, 1 << 20 };
+
+	memcpy(p, &nconns, sizeof(nconns));
+	p += sizeof(nconns);
+	memcpy(p, &done_bytes, sizeof(done_bytes));
+	p += sizeof(done_bytes);
+	memcpy(p, ranges, sizeof(ranges));
+	p += sizeof(ranges);
+	put_stfile(axel, buf, p - buf);
+
+	axel_conn_resize(axel, 5);
+	ASSERT_EQ(stfile_load(axel), 1);
+	CHECK_EQ(axel->conf->num_connections, 5);
+	CHECK_EQ(axel->bytes_done, 3000);
+	ASSERT_EQ(axel->done.count, 2);
+	CHECK_EQ(axel->done.r[0].start, 0);
+	CHECK_EQ(axel->done.r[0].end, 1000);
+	CHECK_EQ(axel->done.r[1].start, 1 << 19);
+	CHECK_EQ(axel->done.r[1].end, (1 << 19) + 2000);
+	done(axel);
+}
+
+TEST(saving_leaves_one_whole_file)
+{
+	char name[MAX_STRING + 8];
+	axel_t *axel = download(1 << 20, 2);
+
+	put_stfile(axel, "junk", 4);
+	make_progress(axel);
+	ASSERT_OK(stfile_save(axel));
+
+	snprintf(name, sizeof(name), "%s.st.tmp", axel->filename);
+	CHECK_NE(access(name, F_OK), 0);
+	CHECK_EQ(stfile_load(axel), 1);
+	done(axel);
+}
+
+int
+main(void)
+{
+	REGISTER_DESC(what_is_saved_is_what_comes_back,
+		      "the ranges saved load back as they were, for any -n");
+	REGISTER_DESC(the_layout_is_the_same_everywhere,
+		      "the file is little-endian, whatever the machine");
+	REGISTER_DESC(a_damaged_file_is_ignored,
+		      "a flipped bit anywhere makes the file ignored, not believed");
+	REGISTER_DESC(a_file_cut_short_is_ignored,
+		      "a file cut short at any length is ignored");
+	REGISTER_DESC(another_size_is_another_download,
+		      "a state saved for a file of another size is ignored");
+	REGISTER_DESC(a_changed_file_is_another_download,
+		      "a state saved under another ETag or date is ignored");
+	REGISTER_DESC(a_torn_save_leaves_the_one_before,
+		      "a save torn halfway leaves the one before it to load");
+	REGISTER_DESC(a_checkpoint_holds_until_a_reboot,
+		      "a checkpoint is newer than a save, but only on its own boot");
+	REGISTER_DESC(the_file_grows_with_the_ranges,
+		      "more ranges than a slot holds make for a bigger file");
+	REGISTER_DESC(an_unversioned_file_is_still_read,
+		      "a state file from before the version field still loads");
+	REGISTER_DESC(saving_leaves_one_whole_file,
+		      "a save replaces the old file whole and leaves no temporary");
+
+	RUN_ALL();
+	int ret = DONE();
+	rmdir(dir);
+	return ret;
+}
@@ -0,0 +1,167 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/throttle.c — the token bucket behind --max-speed
+ *
+ * What the limiter promises is arithmetic: over any stretch of time no more
+ * goes through than the rate allows plus one bucketful, and what is in the
+ * bucket is split evenly between the connections that want it.  The clock
+ * is whatever the caller passes in, so none of this has to sleep.
+ */
+
+#include "config.h"
+
+#include "harness.h"
+
+#include "throttle.h"
+
+TEST(a_bucket_with_no_rate_never_runs_dry)
+{
+	throttle_t t;
+
+	throttle_init(&t, 0, 100, 0);
+	throttle_take(&t, 1000000);
+	ASSERT_EQ(throttle_share(&t, 5000, 4), 5000);
+	ASSERT_FLOAT_EQ(throttle_delay(&t, 5000), 0);
+}
+
+TEST(a_new_bucket_starts_full)
+{
+	throttle_t t;
+
+	throttle_init(&t, 1000, 500, 0);
+	ASSERT_EQ(throttle_share(&t, 5000, 1), 500);
+}
+
+TEST(the_bucket_fills_at_the_rate_and_no_further)
+{
+	throttle_t t;
+
+	throttle_init(&t, 1000, 500, 0);
+	throttle_take(&t, 500);
+	ASSERT_EQ(throttle_share(&t, 5000, 1), 0);
+
+	throttle_refill(&t, .25);
+	ASSERT_EQ(throttle_share(&t, 5000, 1), 250);
+
+	throttle_refill(&t, 10);
+	ASSERT_EQ(throttle_share(&t, 5000, 1), 500);
+}
+
+TEST(readers_get_an_even_share)
+{
+	throttle_t t;
+
+	throttle_init(&t, 1000, 400, 0);
+	ASSERT_EQ(throttle_share(&t, 5000, 4), 100);
+	ASSERT_EQ(throttle_share(&t, 50, 4), 50);
+}
+
+TEST(what_one_reader_leaves_goes_to_the_rest)
+{
+	throttle_t t;
+
+	/* The first of four only wants 10, so the other three split 390 */
+	throttle_init(&t, 1000, 400, 0);
+	throttle_take(&t, throttle_share(&t, 10, 4));
+	ASSERT_EQ(throttle_share(&t, 5000, 3), 130);
+}
+
+TEST(a_nearly_empty_bucket_still_lets_someone_through)
+{
+	throttle_t t;
+
+	throttle_init(&t, 1000, 400, 0);
+	throttle_take(&t, 398);
+	ASSERT_EQ(throttle_share(&t, 5000, 4), 1);
+	throttle_take(&t, 1);
+	ASSERT_EQ(throttle_share(&t, 5000, 3), 1);
+	throttle_take(&t, 1);
+	ASSERT_EQ(throttle_share(&t, 5000, 2), 0);
+}
+
+TEST(the_delay_is_the_time_the_missing_tokens_take)
+{
+	throttle_t t;
+
+	throttle_init(&t, 1000, 500, 0);
+	throttle_take(&t, 500);
+	ASSERT_FLOAT_EQ(throttle_delay(&t, 100), .1);
+
+	throttle_refill(&t, .1);
+	ASSERT_FLOAT_EQ(throttle_delay(&t, 100), 0);
+}
+
+TEST(no_delay_waits_for_more_than_the_bucket_holds)
+{
+	throttle_t t;
+
+	throttle_init(&t, 1000, 500, 0);
+	ASSERT_FLOAT_EQ(throttle_delay(&t, 5000), 0);
+	throttle_take(&t, 500);
+	ASSERT_FLOAT_EQ(throttle_delay(&t, 5000), .5);
+}
+
+TEST(a_clock_going_backwards_earns_nothing)
+{
+	throttle_t t;
+
+	throttle_init(&t, 1000, 500, 10);
+	throttle_take(&t, 500);
+	throttle_refill(&t, 5);
+	ASSERT_EQ(throttle_share(&t, 5000, 1), 0);
+
+	/* ...and picks up from where it went back to */
+	throttle_refill(&t, 5.25);
+	ASSERT_EQ(throttle_share(&t, 5000, 1), 250);
+}
+
+TEST(the_rate_holds_over_a_long_run)
+{
+	throttle_t t;
+	unsigned long long total = 0;
+
+	/* Four readers that always want more, polled every 7 ms for 100 s:
+	 * the bucket may let through its initial fill and the rate, no more,
+	 * and nothing near it less */
+	throttle_init(&t, 100000, 5000, 0);
+	for (int tick = 1; tick <= 100000 / 7; tick++) {
+		throttle_refill(&t, tick * .007);
+		for (int r = 4; r > 0; r--) {
+			size_t n = throttle_share(&t, 4096, r);
+			throttle_take(&t, n);
+			total += n;
+		}
+	}
+
+	ASSERT_LE(total, 100000ull * 100 + 5000);
+	ASSERT_GE(total, 100000ull * 100 * 99 / 100);
+}
+
+int
+main(void)
+{
+	REGISTER_DESC(a_bucket_with_no_rate_never_runs_dry,
+		      "a bucket with no rate grants whatever is asked for");
+	REGISTER_DESC(a_new_bucket_starts_full,
+		      "a new bucket starts out holding its burst");
+	REGISTER_DESC(the_bucket_fills_at_the_rate_and_no_further,
+		      "the bucket fills at the rate and stops at the burst");
+	REGISTER_DESC(readers_get_an_even_share,
+		      "ready readers get an even share, capped at what they want");
+	REGISTER_DESC(what_one_reader_leaves_goes_to_the_rest,
+		      "what one reader leaves over is shared by the rest");
+	REGISTER_DESC(a_nearly_empty_bucket_still_lets_someone_through,
+		      "a bucket with less than a byte each still lets one through");
+	REGISTER_DESC(the_delay_is_the_time_the_missing_tokens_take,
+		      "the delay is how long the missing tokens take to arrive");
+	REGISTER_DESC(no_delay_waits_for_more_than_the_bucket_holds,
+		      "a wait is never for more than the bucket can hold");
+	REGISTER_DESC(a_clock_going_backwards_earns_nothing,
+		      "a clock that goes backwards adds no tokens");
+	REGISTER_DESC(the_rate_holds_over_a_long_run,
+		      "over a long run the rate holds to within a percent");
+
+	RUN_ALL();
+	return DONE();
+}
@@ -0,0 +1,264 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/wheel.c — the timer wheel behind connection timeouts and other
+ * timed events
+ *
+ * What the wheel promises is that a timer fires on the first run that
+ * reaches its expiry, never earlier, and that timers fire in order, however
+ * far off they were armed and however the runs are spaced.  Ticks are
+ * whatever the test says they are, so none of this has to sleep.
+ */
+
+#include "config.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+#include "harness.h"
+
+#include "wheel.h"
+
+/* What fired, and at what tick of the run that fired it */
+static int fired[1024];
+static unsigned long long fired_at[1024];
+static int nfired;
+static unsigned long long run_to;
+
+static
+void
+record(wheel_timer_t *t)
+{
+	if (nfired < 1024) {
+		fired[nfired] = t->id;
+		fired_at[nfired] = run_to;
+	}
+	nfired++;
+}
+
+static
+void
+run(wheel_t *w, unsigned long long now)
+{
+	run_to = now;
+	wheel_run(w, now);
+}
+
+static
+void
+arm(wheel_t *w, wheel_timer_t *t, int id, unsigned long long expires)
+{
+	t->fire = record;
+	t->id = id;
+	t->pprev = NULL;
+	wheel_add(w, t, expires);
+}
+
+static
+void
+reset(void)
+{
+	nfired = 0;
+}
+
+TEST(a_timer_fires_on_the_run_that_reaches_it)
+{
+	wheel_t w;
+	wheel_timer_t t;
+
+	reset();
+	wheel_init(&w, 1000);
+	arm(&w, &t, 1, 1010);
+	run(&w, 1009);
+	ASSERT_EQ(nfired, 0);
+	ASSERT(wheel_pending(&t));
+	run(&w, 1010);
+	ASSERT_EQ(nfired, 1);
+	ASSERT(!wheel_pending(&t));
+	run(&w, 5000);
+	ASSERT_EQ(nfired, 1);
+}
+
+TEST(an_expiry_in_the_past_fires_on_the_next_run)
+{
+	wheel_t w;
+	wheel_timer_t t;
+
+	reset();
+	wheel_init(&w, 1000);
+	run(&w, 2000);
+	arm(&w, &t, 1, 0);
+	ASSERT_EQ(wheel_next(&w), 2001);
+	run(&w, 2001);
+	ASSERT_EQ(nfired, 1);
+}
+
+TEST(timers_fire_in_order_of_expiry)
+{
+	wheel_t w;
+	wheel_timer_t t[4];
+
+	reset();
+	wheel_init(&w, 0);
+	arm(&w, &t[0], 0, 300000);
+	arm(&w, &t[1], 1, 70);
+	arm(&w, &t[2], 2, 5000);
+	arm(&w, &t[3], 3, 3);
+	run(&w, 1000000);
+	ASSERT_EQ(nfired, 4);
+	ASSERT_EQ(fired[0], 3);
+	ASSERT_EQ(fired[1], 1);
+	ASSERT_EQ(fired[2], 2);
+	ASSERT_EQ(fired[3], 0);
+}
+
+TEST(a_disarmed_timer_never_fires)
+{
+	wheel_t w;
+	wheel_timer_t t[2];
+
+	reset();
+	wheel_init(&w, 0);
+	arm(&w, &t[0], 0, 50);
+	arm(&w, &t[1], 1, 100000);
+	wheel_del(&w, &t[0]);
+	wheel_del(&w, &t[1]);
+	wheel_del(&w, &t[1]);
+	ASSERT_EQ(wheel_next(&w), ULLONG_MAX);
+	run(&w, 1000000);
+	ASSERT_EQ(nfired, 0);
+}
+
+TEST(re_arming_moves_the_timer)
+{
+	wheel_t w;
+	wheel_timer_t t;
+
+	reset();
+	wheel_init(&w, 0);
+	arm(&w, &t, 0, 10);
+	wheel_add(&w, &t, 20000);
+	run(&w, 19999);
+	ASSERT_EQ(nfired, 0);
+	run(&w, 20000);
+	ASSERT_EQ(nfired, 1);
+	ASSERT_EQ(w.count, 0);
+}
+
+TEST(next_is_never_after_the_first_expiry)
+{
+	wheel_t w;
+	wheel_timer_t t[2];
+
+	wheel_init(&w, 100);
+	arm(&w, &t[0], 0, 150);
+	ASSERT_EQ(wheel_next(&w), 150);
+
+	/* Further off, it may be early, to bring the timer down a level */
+	wheel_del(&w, &t[0]);
+	arm(&w, &t[1], 1, 45000);
+	ASSERT_LE(wheel_next(&w), 45000);
+	ASSERT_GT(wheel_next(&w), 100);
+}
+
+TEST(a_timer_beyond_the_top_ring_still_fires_on_time)
+{
+	wheel_t w;
+	wheel_timer_t t;
+	unsigned long long far = 1ull << (WHEEL_BITS * WHEEL_LEVELS + 3);
+
+	reset();
+	wheel_init(&w, 7);
+	arm(&w, &t, 0, far + 7);
+	for (unsigned long long now = 7; now < far + 7; now += 999983)
+		run(&w, now);
+	ASSERT_EQ(nfired, 0);
+	run(&w, far + 7);
+	ASSERT_EQ(nfired, 1);
+}
+
+static wheel_t *periodic_wheel;
+
+static
+void
+periodic(wheel_timer_t *t)
+{
+	record(t);
+	wheel_add(periodic_wheel, t, t->expires + 250);
+}
+
+TEST(a_timer_may_re_arm_itself)
+{
+	wheel_t w;
+	wheel_timer_t t = { .fire = periodic };
+
+	reset();
+	periodic_wheel = &w;
+	wheel_init(&w, 0);
+	wheel_add(&w, &t, 250);
+	run(&w, 10000);
+	ASSERT_EQ(nfired, 40);
+}
+
+/* Lots of timers armed at random, run at random intervals: each has to fire
+ * on the first run to reach it, and they have to come out in order */
+TEST(random_timers_fire_on_time_and_in_order)
+{
+	enum { N = 500 };
+	static wheel_timer_t t[N];
+	static unsigned long long expires[N];
+	wheel_t w;
+	int bad = -1;
+
+	reset();
+	srand(1);
+	wheel_init(&w, 12345);
+	for (int i = 0; i < N; i++) {
+		expires[i] = 12345 + rand() % 3000000;
+		arm(&w, &t[i], i, expires[i]);
+	}
+	unsigned long long now = 12345, prev = now;
+	while (w.count) {
+		prev = now;
+		now += rand() % 20000;
+		run(&w, now);
+		for (int k = 0; k < nfired && k < N; k++) {
+			unsigned long long e = expires[fired[k]];
+			if (bad == -1 && fired_at[k] == now &&
+			    (e > now || e <= prev))
+				bad = k;
+		}
+	}
+	ASSERT_EQ(bad, -1);
+	ASSERT_EQ(nfired, N);
+	for (int k = 1; k < N; k++)
+		if (bad == -1 && expires[fired[k]] < expires[fired[k - 1]])
+			bad = k;
+	ASSERT_EQ(bad, -1);
+}
+
+int
+main(void)
+{
+	REGISTER_DESC(a_timer_fires_on_the_run_that_reaches_it,
+		      "a timer fires on the first run to reach its expiry, once");
+	REGISTER_DESC(an_expiry_in_the_past_fires_on_the_next_run,
+		      "a timer armed for the past fires on the next run");
+	REGISTER_DESC(timers_fire_in_order_of_expiry,
+		      "timers fire in order of expiry, whatever level they sat in");
+	REGISTER_DESC(a_disarmed_timer_never_fires,
+		      "a disarmed timer never fires, and disarming twice is harmless");
+	REGISTER_DESC(re_arming_moves_the_timer,
+		      "arming an armed timer moves it rather than adding another");
+	REGISTER_DESC(next_is_never_after_the_first_expiry,
+		      "the next tick to run at is never after the first expiry");
+	REGISTER_DESC(a_timer_beyond_the_top_ring_still_fires_on_time,
+		      "a timer further off than the wheel reaches fires on time");
+	REGISTER_DESC(a_timer_may_re_arm_itself,
+		      "a timer may re-arm itself from its fire function");
+	REGISTER_DESC(random_timers_fire_on_time_and_in_order,
+		      "random timers run at random intervals fire on time and in order");
+
+	RUN_ALL();
+	return DONE();
+}
@@ -0,0 +1,277 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/writer.c — the thread that puts downloaded blocks on disk
+ *
+ * Blocks go in at whatever offsets the connections got to, in whatever
+ * order they got there; what has to come out is a file with each of them
+ * in its place once writer_sync() returns, a pool that runs dry rather
+ * than grow, and a failed write that is reported rather than lost.  A pipe
+ * gets the same blocks from its start on, however they were queued.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "harness.h"
+
+#include "writer.h"
+
+static
+int
+temp_file(void)
+{
+	char path[] = "/tmp/axel-writer-XXXXXX";
+	int fd = mkstemp(path);
+
+	if (fd != -1)
+		unlink(path);
+	return fd;
+}
+
+static
+void
+put(writer_t *w, char c, off_t offset, size_t len)
+{
+	char *block = writer_get(w);
+
+	if (!block)
+		return;
+	memset(block, c, len);
+	writer_put(w, block, offset, len);
+}
+
+TEST(blocks_land_where_they_were_queued_for)
+{
+	int fd = temp_file();
+	writer_t *w = writer_new(fd, 100, 8);
+	char buf[400];
+
+	ASSERT_NOTNULL(w);
+	put(w, 'c', 200, 100);
+	put(w, 'a', 0, 100);
+	put(w, 'd', 300, 100);
+	put(w, 'b', 100, 100);
+	CHECK_OK(writer_sync(w));
+	CHECK_EQ(pread(fd, buf, sizeof(buf), 0), 400);
+	for (int i = 0; i < 400; i++)
+		if (buf[i] != 'a' + i / 100) {
+			CHECK_EQ(buf[i], 'a' + i / 100);
+			break;
+		}
+	CHECK_OK(writer_free(w));
+	close(fd);
+}
+
+TEST(a_partly_filled_block_writes_only_its_length)
+{
+	int fd = temp_file();
+	writer_t *w = writer_new(fd, 100, 2);
+	struct stat st;
+
+	ASSERT_NOTNULL(w);
+	put(w, 'x', 10, 5);
+	CHECK_OK(writer_free(w));
+	CHECK_OK(fstat(fd, &st));
+	CHECK_EQ(st.st_size, 15);
+	close(fd);
+}
+
+TEST(the_pool_runs_dry_instead_of_growing)
+{
+	int fd = temp_file();
+	writer_t *w = writer_new(fd, 100, 2);
+	struct timeval tv = { .tv_usec = 1000 };
+
+	ASSERT_NOTNULL(w);
+	void *a = writer_get(w);
+	void *b = writer_get(w);
+	CHECK_NOTNULL(a);
+	CHECK_NOTNULL(b);
+	CHECK_NULL(writer_get(w));
+	CHECK_EQ(writer_wait(w, &tv), 0);
+
+	/* A block handed back unused is free again at once */
+	writer_put(w, a, 0, 0);
+	CHECK_EQ(writer_wait(w, &tv), 1);
+	CHECK_NOTNULL(writer_get(w));
+
+	/* ...and a written one, once it has been written */
+	writer_put(w, b, 0, 100);
+	CHECK_EQ(writer_wait(w, NULL), 1);
+	CHECK_OK(writer_free(w));
+	close(fd);
+}
+
+TEST(a_failed_write_is_reported)
+{
+	int fd = open("/dev/null", O_RDONLY);
+	writer_t *w = writer_new(fd, 100, 2);
+
+	ASSERT_NOTNULL(w);
+	put(w, 'x', 0, 100);
+	CHECK_EQ(writer_sync(w), -1);
+	CHECK_EQ(errno, EBADF);
+	CHECK_EQ(writer_error(w), EBADF);
+	CHECK_EQ(writer_free(w), -1);
+	close(fd);
+}
+
+TEST(a_pipe_gets_the_blocks_in_offset_order)
+{
+	int fds[2];
+	char buf[8] = "";
+
+	ASSERT_OK(pipe(fds));
+	writer_t *w = writer_new(fds[1], 4, 4);
+	ASSERT_NOTNULL(w);
+
+	/* Held, out of the pool, until the pipe gets to it */
+	put(w, 'c', 4, 2);
+	CHECK_OK(writer_sync(w));
+	CHECK_EQ(writer_spare(w), 3);
+	put(w, 'b', 2, 2);
+	put(w, 'a', 0, 2);
+	CHECK_OK(writer_sync(w));
+	CHECK_EQ(writer_spare(w), 4);
+	CHECK_OK(writer_free(w));
+	CHECK_EQ(read(fds[0], buf, sizeof(buf) - 1), 6);
+	CHECK_STR(buf, "aabbcc");
+	close(fds[0]);
+	close(fds[1]);
+}
+
+/* What a sink is handed, copied into memory at its offset */
+static char sunk[16];
+
+static
+int
+into_memory(void *arg, const void *data, size_t len, off_t offset)
+{
+	int *calls = arg;
+
+	if (offset + len > sizeof(sunk) - 1)
+		return ERANGE;
+	memcpy(sunk + offset, data, len);
+	(*calls)++;
+	return 0;
+}
+
+TEST(a_sink_takes_the_blocks_instead_of_the_fd)
+{
+	writer_t *w = writer_new(-1, 4, 4);
+	int calls = 0;
+
+	ASSERT_NOTNULL(w);
+	writer_sink(w, into_memory, &calls, 0);
+	put(w, 'c', 8, 4);
+	put(w, 'a', 0, 4);
+	CHECK_OK(writer_sync(w));
+	put(w, 'b', 4, 4);
+	CHECK_OK(writer_sync(w));
+	CHECK_STR(sunk, "aaaabbbbcccc");
+	CHECK_GE(calls, 3);
+
+	/* Its errors are the writer's */
+	put(w, 'd', 12, 4);
+	CHECK_EQ(writer_sync(w), -1);
+	CHECK_EQ(writer_error(w), ERANGE);
+	CHECK_EQ(writer_free(w), -1);
+}
+
+/* Many more blocks than the pool holds, queued as fast as they come back:
+ * the file has to come out whole all the same */
+TEST(a_long_stream_of_blocks_comes_out_whole)
+{
+	enum { N = 5000, SIZE = 512 };
+	int fd = temp_file();
+	writer_t *w = writer_new(fd, SIZE, 16);
+	int bad = -1;
+
+	ASSERT_NOTNULL(w);
+	for (int i = 0; i < N; i++) {
+		/* Two streams, like two connections, interleaved */
+		int k = i % 2 ? N / 2 + i / 2 : i / 2;
+
+		while (!writer_wait(w, NULL)) ;
+		put(w, k % 251, (off_t)k * SIZE, SIZE);
+	}
+	CHECK_OK(writer_free(w));
+
+	char *buf = malloc(SIZE);
+	for (int k = 0; k < N && bad == -1; k++) {
+		if (pread(fd, buf, SIZE, (off_t)k * SIZE) != SIZE ||
+		    buf[0] != (char)(k % 251) || buf[SIZE - 1] != (char)(k % 251))
+			bad = k;
+	}
+	free(buf);
+	CHECK_EQ(bad, -1);
+	close(fd);
+}
+
+/* The checkpoint and the .avail file go by this, and are not to wait for
+ * the disk to get it */
+TEST(what_has_been_written_is_known_without_waiting)
+{
+	int fd = temp_file();
+	writer_t *w = writer_new(fd, 4, 4);
+	ranges_t done, written;
+
+	ASSERT_NOTNULL(w);
+	ranges_init(&done);
+	ASSERT_OK(ranges_add(&done, 0, 16));
+	put(w, 'a', 0, 4);
+	put(w, 'b', 8, 4);
+	ASSERT_OK(writer_sync(w));
+
+	/* Written by someone else, and no longer done */
+	ASSERT_OK(writer_mark(w, 12, 16, 1));
+	ASSERT_OK(writer_mark(w, 0, 2, 0));
+	ASSERT_OK(ranges_remove(&done, 8, 10));
+	ASSERT_OK(writer_written(w, &done, &written));
+	ASSERT_EQ(written.count, 2);
+	CHECK_EQ(written.r[0].start, 2);
+	CHECK_EQ(written.r[0].end, 4);
+	CHECK_EQ(written.r[1].start, 10);
+	CHECK_EQ(written.r[1].end, 16);
+	ranges_free(&written);
+
+	/* With no writer, all of it */
+	ASSERT_OK(writer_written(NULL, &done, &written));
+	CHECK_EQ(ranges_total(&written), 14);
+	ranges_free(&written);
+	ranges_free(&done);
+	CHECK_OK(writer_free(w));
+	close(fd);
+}
+
+int
+main(void)
+{
+	REGISTER_DESC(blocks_land_where_they_were_queued_for,
+		      "blocks queued out of order land at their own offsets");
+	REGISTER_DESC(a_partly_filled_block_writes_only_its_length,
+		      "a partly filled block writes only as much as it holds");
+	REGISTER_DESC(the_pool_runs_dry_instead_of_growing,
+		      "the pool runs dry rather than grow, until blocks come back");
+	REGISTER_DESC(a_failed_write_is_reported,
+		      "a failed write is reported by sync, error and free alike");
+	REGISTER_DESC(a_pipe_gets_the_blocks_in_offset_order,
+		      "a pipe gets the blocks in offset order, whatever they came in");
+	REGISTER_DESC(a_sink_takes_the_blocks_instead_of_the_fd,
+		      "a sink is handed each block at its offset, and can fail");
+	REGISTER_DESC(a_long_stream_of_blocks_comes_out_whole,
+		      "a stream many times the pool's size comes out whole");
+	REGISTER_DESC(what_has_been_written_is_known_without_waiting,
+		      "what has been written is known, less what is no longer done");
+
+	RUN_ALL();
+	return DONE();
+}
@@ -0,0 +1,190 @@
+// SPDX-FileCopyrightText: Copyright 2026 Ismael Luceno <ismael@iodev.co.uk>
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * test/zsync.c — finding the blocks of a file in an older one
+ *
+ * A control file is read as zsync writes it, and checked to add up; and
+ * the blocks of the file it describes are found in an older version
+ * wherever they have moved to, whether one match is enough or, with
+ * shorter checksums, two in a row are needed.  The checksums were made
+ * with zsync's own algorithms, MD4 and all.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "harness.h"
+
+#include "ranges.h"
+#include "digest.h"
+#include "zsync.h"
+
+#define SIZE	620
+#define BS	64
+#define BLOCKS	((SIZE + BS - 1) / BS)
+
+static const char header[] =
+	"zsync: 0.6.2\n"
+	"Filename: ../new.img\n"
+	"Blocksize: 64\n"
+	"Length: 620\n"
+	"Hash-Lengths: %s\n"
+	"URL: http://example.com/new.img\n"
+	"Z-URL: new.img.gz\n"
+	"SHA-1: c1a36f54c1e6de81dc3d8ebeb354b0b23eb077ad\n"
+	"\n";
+
+/* For 1,4,16 and 2,2,5 */
+static const char long_sums[] =
+	"1fd6edd4f4f7ca26639a233d5875fcad892f9c441f4dee5455e2a8075646eb2a"
+	"8c14054b410085691fc41af14d6408681382e5398d6d22ac25a1dfe8203c1dad"
+	"2ec2d2f6a789b4d68a17521cccaa2e781fb3fe47bc8a2049ecb2c1de31d3f959"
+	"1288a997202a05fec4f308fce0d5621632617cc69e6310101fa20dd25d1d40fd"
+	"adc616f2b89dd6ebaca6741c201b128f087339a38c98a856c3f8a08e4be11a25"
+	"1f920a23eba8f3633b0b53da60c39e5bc0d74c0f1607b03650e35bdedf8b0f3b"
+	"358ef4180a40118f";
+static const char short_sums[] =
+	"edd4f4f7ca2663ee5455e2a807561af14d640868131dad2ec2d2f6a7fe47bc8a"
+	"2049ec05fec4f308fce00dd25d1d40fdad128f087339a38c0a23eba8f3633bb0"
+	"3650e35bdedf";
+
+static unsigned char data[SIZE];
+static bool found[BLOCKS];
+static bool wrong;
+
+static
+void
+make_data(void)
+{
+	for (uint32_t i = 0; i < SIZE; i++)
+		data[i] = i * 2654435761u >> 24;
+}
+
+/* The control file, with hash lengths hl and the sums in hex */
+static
+zsync_t *
+control(const char *hl, const char *hex, size_t len)
+{
+	char buf[1024];
+	size_t n = snprintf(buf, sizeof(buf), header, hl);
+
+	for (size_t i = 0; i < len; i++) {
+		char byte[3] = { hex[2 * i], hex[2 * i + 1], 0 };
+
+		buf[n + i] = strtoul(byte, NULL, 16);
+	}
+	return zsync_parse(buf, n + len);
+}
+
+static
+void
+got(void *arg, const void *block, off_t offset, size_t len)
+{
+	if (offset % BS || offset + len > SIZE ||
+	    len != (offset / BS < BLOCKS - 1 ? BS : SIZE % BS) ||
+	    memcmp(block, data + offset, len) || found[offset / BS])
+		wrong = true;
+	else
+		found[offset / BS] = true;
+}
+
+TEST(control_files_are_read)
+{
+	zsync_t *z;
+
+	make_data();
+	z = control("1,4,16", long_sums, 200);
+	ASSERT_NOTNULL(z);
+	CHECK_STR(z->filename, "new.img");
+	CHECK_EQ(z->length, SIZE);
+	CHECK_EQ(z->blocksize, BS);
+	CHECK_EQ(z->blocks, BLOCKS);
+	CHECK_EQ(z->seq_matches, 1);
+	CHECK_EQ(z->checksum_bytes, 16);
+	ASSERT_EQ(z->nurls, 1);
+	CHECK_STR(z->urls[0], "http://example.com/new.img");
+	CHECK_STR(z->sha1.algo, "sha1");
+	CHECK_EQ(z->sha1.want[0], 0xc1);
+	zsync_free(z);
+
+	/* Checksums short of the blocks, or sizes out of range */
+	errno = 0;
+	CHECK_NULL(control("1,4,16", long_sums, 180));
+	CHECK_EQ(errno, EINVAL);
+	CHECK_NULL(control("3,4,16", long_sums, 200));
+	CHECK_NULL(control("1,5,15", long_sums, 200));
+}
+
+/* The old version: some bytes in front, block 3 changed, block 6 gone */
+static
+const char *
+old_file(void)
+{
+	static char path[] = "/tmp/axel-zsync-XXXXXX";
+	static unsigned char old[13 + SIZE];
+	size_t n = 13;
+	int fd = mkstemp(path);
+
+	memset(old, 'x', n);
+	memcpy(old + n, data, 6 * BS);
+	old[n + 3 * BS + 10] ^= 1;
+	n += 6 * BS;
+	memcpy(old + n, data + 7 * BS, SIZE - 7 * BS);
+	n += SIZE - 7 * BS;
+	if (write(fd, old, n) != (ssize_t)n)
+		abort();
+	close(fd);
+	return path;
+}
+
+TEST(blocks_are_found_where_they_moved)
+{
+	static const char *const hl[] = { "1,4,16", "2,2,5" };
+	static const char *const sums[] = { long_sums, short_sums };
+	static const size_t len[] = { 200, 70 };
+	const char *path = old_file();
+
+	for (int i = 0; i < 2; i++) {
+		zsync_t *z = control(hl[i], sums[i], len[i]);
+
+		ASSERT_NOTNULL(z);
+		memset(found, 0, sizeof(found));
+		wrong = false;
+		CHECK_EQ(zsync_seed(z, path, got, NULL), SIZE - 2 * BS);
+		CHECK(!wrong);
+		for (int b = 0; b < BLOCKS; b++)
+			CHECK_EQ(found[b], b != 3 && b != 6);
+		zsync_free(z);
+	}
+	unlink(path);
+}
+
+TEST(control_files_are_told_from_urls)
+{
+	CHECK(zsync_named("dir/image.iso.zsync"));
+	CHECK(!zsync_named("http://example.com/image.iso.zsync"));
+	CHECK(!zsync_named(".zsync"));
+	CHECK(!zsync_named("image.iso"));
+}
+
+int
+main(void)
+{
+	REGISTER_DESC(control_files_are_read,
+		      "a control file is read, and refused if it does not add up");
+	REGISTER_DESC(blocks_are_found_where_they_moved,
+		      "blocks are found in an older file wherever they moved to");
+	REGISTER_DESC(control_files_are_told_from_urls,
+		      "a .zsync file is told apart from a URL");
+
+	RUN_ALL();
+	return DONE();
+}